@@ -475,6 +475,7 @@ ExternalProject_Add(director
     -DUSE_COLLECTIONS:BOOL=${USE_COLLECTIONS}
     -DUSE_LIBBOT:BOOL=${USE_LIBBOT}
     -DUSE_DRAKE:BOOL=${USE_DRAKE}
+    -DUSE_KINECT:BOOL=${USE_KINECT}
 
     ${default_cmake_args}
     ${eigen_args}
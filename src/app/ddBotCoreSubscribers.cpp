@@ -0,0 +1,469 @@
+#include "ddBotCoreSubscribers.h"
+
+#include <vtkCellArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkIntArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkStringArray.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <lcmtypes/bot_core/planar_lidar_t.hpp>
+#include <lcmtypes/bot_core/pointcloud_t.hpp>
+#include <lcmtypes/bot_core/robot_state_t.hpp>
+#include <lcmtypes/bot_core/viewer_draw_t.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
+namespace
+{
+
+//-----------------------------------------------------------------------------
+template <class MessageType>
+bool DecodeMessage(const lcm::ReceiveBuffer* rbuf, MessageType& msg)
+{
+  return msg.decode(rbuf->data, 0, rbuf->data_size) == static_cast<int>(rbuf->data_size);
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkCellArray> NewVertexCells(vtkIdType numberOfVerts)
+{
+  vtkNew<vtkIdTypeArray> cells;
+  cells->SetNumberOfValues(numberOfVerts*2);
+  vtkIdType* ids = cells->GetPointer(0);
+  for (vtkIdType i = 0; i < numberOfVerts; ++i)
+  {
+    ids[i*2] = 1;
+    ids[i*2+1] = i;
+  }
+
+  vtkSmartPointer<vtkCellArray> cellArray = vtkSmartPointer<vtkCellArray>::New();
+  cellArray->SetCells(numberOfVerts, cells.GetPointer());
+  return cellArray;
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkFloatArray> NewFloatArray(const char* name, const std::vector<float>& values)
+{
+  vtkSmartPointer<vtkFloatArray> array = vtkSmartPointer<vtkFloatArray>::New();
+  array->SetName(name);
+  array->SetNumberOfValues(values.size());
+  std::copy(values.begin(), values.end(), array->GetPointer(0));
+  return array;
+}
+
+//-----------------------------------------------------------------------------
+// Computes roll, pitch, yaw from a (w, x, y, z) quaternion.  Matches
+// transformUtils.quaternionToRollPitchYaw(), the static xyz euler angles.
+void QuaternionToRollPitchYaw(double w, double x, double y, double z, double rpy[3])
+{
+  const double norm = std::sqrt(w*w + x*x + y*y + z*z);
+  if (norm > 0.0)
+  {
+    w /= norm;
+    x /= norm;
+    y /= norm;
+    z /= norm;
+  }
+
+  const double m00 = 1.0 - 2.0*(y*y + z*z);
+  const double m10 = 2.0*(x*y + w*z);
+  const double m20 = 2.0*(x*z - w*y);
+  const double m21 = 2.0*(y*z + w*x);
+  const double m22 = 1.0 - 2.0*(x*x + y*y);
+
+  const double cy = std::sqrt(m00*m00 + m10*m10);
+  if (cy > 4.0 * std::numeric_limits<double>::epsilon())
+  {
+    rpy[0] = std::atan2(m21, m22);
+    rpy[1] = std::atan2(-m20, cy);
+    rpy[2] = std::atan2(m10, m00);
+  }
+  else
+  {
+    const double m11 = 1.0 - 2.0*(x*x + z*z);
+    const double m12 = 2.0*(y*z - w*x);
+    rpy[0] = std::atan2(-m12, m11);
+    rpy[1] = std::atan2(-m20, cy);
+    rpy[2] = 0.0;
+  }
+}
+
+} // end namespace
+
+
+//-----------------------------------------------------------------------------
+ddDecodedMessageSubscriber::ddDecodedMessageSubscriber(const QString& channel, QObject* parent)
+  : ddLCMSubscriber(channel, parent)
+{
+  mDecodeErrors = 0;
+}
+
+//-----------------------------------------------------------------------------
+ddDecodedMessageSubscriber::~ddDecodedMessageSubscriber()
+{
+}
+
+//-----------------------------------------------------------------------------
+void ddDecodedMessageSubscriber::subscribe(lcm::LCM* lcmHandle)
+{
+  if (this->subscribeDirectly(lcmHandle))
+  {
+    mLCMSubscription = lcmHandle->subscribe(mChannel.toAscii().data(), &ddDecodedMessageSubscriber::decodedMessageHandler, this);
+    return;
+  }
+
+  mSubscription = ddLCMDispatcher::instance()->subscribe(mChannel.toAscii().data(),
+    [this](const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+    {
+      this->decodedMessageHandler(rbuf, channel);
+    });
+}
+
+//-----------------------------------------------------------------------------
+void ddDecodedMessageSubscriber::decodedMessageHandler(const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+{
+  vtkSmartPointer<vtkPolyData> polyData;
+  qint64 utime = 0;
+
+  if (!this->decodeMessage(rbuf, polyData, utime))
+  {
+    QMutexLocker locker(&mPolyDataMutex);
+    ++mDecodeErrors;
+    return;
+  }
+
+  {
+    QMutexLocker locker(&mPolyDataMutex);
+    mLastChannel = QString(channel.c_str());
+    DecodedMessage& message = mDecodedMessages[mLastChannel];
+    message.mPolyData = polyData;
+    message.mUtime = utime;
+  }
+
+  this->messageHandler(rbuf, channel);
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddDecodedMessageSubscriber::getPolyData(vtkPolyData* polyData)
+{
+  QMutexLocker locker(&mPolyDataMutex);
+  QString channel = mLastChannel;
+  locker.unlock();
+  return this->getPolyData(channel, polyData);
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddDecodedMessageSubscriber::getPolyData(const QString& channel, vtkPolyData* polyData)
+{
+  QMutexLocker locker(&mPolyDataMutex);
+  if (!polyData || !mDecodedMessages.contains(channel))
+  {
+    return 0;
+  }
+
+  const DecodedMessage& message = mDecodedMessages[channel];
+  polyData->ShallowCopy(message.mPolyData);
+  return message.mUtime;
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddDecodedMessageSubscriber::getDecodeErrorCount() const
+{
+  QMutexLocker locker(&mPolyDataMutex);
+  return mDecodeErrors;
+}
+
+
+//-----------------------------------------------------------------------------
+ddRobotStateSubscriber::ddRobotStateSubscriber(const QString& channel, QObject* parent)
+  : ddDecodedMessageSubscriber(channel, parent)
+{
+}
+
+//-----------------------------------------------------------------------------
+void ddRobotStateSubscriber::setJointNames(const QStringList& jointNames)
+{
+  QMutexLocker locker(&mJointNamesMutex);
+  mJointNames = jointNames;
+}
+
+//-----------------------------------------------------------------------------
+QStringList ddRobotStateSubscriber::jointNames() const
+{
+  QMutexLocker locker(&mJointNamesMutex);
+  return mJointNames;
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddRobotStateSubscriber::getPose(vtkDoubleArray* pose)
+{
+  vtkSmartPointer<vtkPolyData> polyData = vtkSmartPointer<vtkPolyData>::New();
+  qint64 utime = this->getPolyData(polyData);
+  if (!pose || !utime)
+  {
+    return 0;
+  }
+
+  pose->DeepCopy(polyData->GetFieldData()->GetArray("pose"));
+  return utime;
+}
+
+//-----------------------------------------------------------------------------
+bool ddRobotStateSubscriber::decodeMessage(const lcm::ReceiveBuffer* rbuf, vtkSmartPointer<vtkPolyData>& polyData, qint64& utime)
+{
+  bot_core::robot_state_t msg;
+  if (!DecodeMessage(rbuf, msg))
+  {
+    return false;
+  }
+
+  std::map<std::string, float> jointPositions;
+  for (size_t i = 0; i < msg.joint_name.size() && i < msg.joint_position.size(); ++i)
+  {
+    jointPositions[msg.joint_name[i]] = msg.joint_position[i];
+  }
+
+  QStringList jointNames = this->jointNames();
+
+  vtkSmartPointer<vtkDoubleArray> pose = vtkSmartPointer<vtkDoubleArray>::New();
+  pose->SetName("pose");
+  pose->SetNumberOfValues(6 + jointNames.size());
+  double* poseValues = pose->GetPointer(0);
+
+  poseValues[0] = msg.pose.translation.x;
+  poseValues[1] = msg.pose.translation.y;
+  poseValues[2] = msg.pose.translation.z;
+  QuaternionToRollPitchYaw(msg.pose.rotation.w, msg.pose.rotation.x, msg.pose.rotation.y, msg.pose.rotation.z, poseValues + 3);
+
+  int missingJoints = 0;
+  for (int i = 0; i < jointNames.size(); ++i)
+  {
+    std::map<std::string, float>::const_iterator itr = jointPositions.find(jointNames[i].toAscii().data());
+    if (itr == jointPositions.end())
+    {
+      poseValues[6 + i] = 0.0;
+      ++missingJoints;
+    }
+    else
+    {
+      poseValues[6 + i] = itr->second;
+    }
+  }
+
+  vtkNew<vtkIntArray> missingJointsArray;
+  missingJointsArray->SetName("missing_joints");
+  missingJointsArray->InsertNextValue(missingJoints);
+
+  polyData = vtkSmartPointer<vtkPolyData>::New();
+  polyData->GetFieldData()->AddArray(pose);
+  polyData->GetFieldData()->AddArray(missingJointsArray.GetPointer());
+  polyData->GetFieldData()->AddArray(NewFloatArray("joint_position", msg.joint_position));
+  polyData->GetFieldData()->AddArray(NewFloatArray("joint_velocity", msg.joint_velocity));
+  polyData->GetFieldData()->AddArray(NewFloatArray("joint_effort", msg.joint_effort));
+
+  utime = msg.utime;
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+ddPointCloudSubscriber::ddPointCloudSubscriber(const QString& channel, QObject* parent)
+  : ddDecodedMessageSubscriber(channel, parent)
+{
+}
+
+//-----------------------------------------------------------------------------
+bool ddPointCloudSubscriber::decodeMessage(const lcm::ReceiveBuffer* rbuf, vtkSmartPointer<vtkPolyData>& polyData, qint64& utime)
+{
+  bot_core::pointcloud_t msg;
+  if (!DecodeMessage(rbuf, msg))
+  {
+    return false;
+  }
+
+  const vtkIdType numberOfPoints = msg.points.size();
+
+  vtkNew<vtkPoints> points;
+  points->SetDataTypeToFloat();
+  points->SetNumberOfPoints(numberOfPoints);
+  float* pointValues = static_cast<vtkFloatArray*>(points->GetData())->GetPointer(0);
+  for (vtkIdType i = 0; i < numberOfPoints; ++i)
+  {
+    const std::vector<float>& point = msg.points[i];
+    for (int j = 0; j < 3; ++j)
+    {
+      pointValues[3*i + j] = j < static_cast<int>(point.size()) ? point[j] : 0.0f;
+    }
+  }
+
+  polyData = vtkSmartPointer<vtkPolyData>::New();
+  polyData->SetPoints(points.GetPointer());
+  polyData->SetVerts(NewVertexCells(numberOfPoints));
+
+  std::map<std::string, const std::vector<float>*> channels;
+  for (size_t i = 0; i < msg.channel_names.size() && i < msg.channels.size(); ++i)
+  {
+    if (static_cast<vtkIdType>(msg.channels[i].size()) != numberOfPoints)
+    {
+      continue;
+    }
+
+    channels[msg.channel_names[i]] = &msg.channels[i];
+    polyData->GetPointData()->AddArray(NewFloatArray(msg.channel_names[i].c_str(), msg.channels[i]));
+  }
+
+  if (channels.count("r") && channels.count("g") && channels.count("b"))
+  {
+    const std::vector<float>* colorChannels[3] = {channels["r"], channels["g"], channels["b"]};
+
+    vtkNew<vtkUnsignedCharArray> rgb;
+    rgb->SetName("rgb");
+    rgb->SetNumberOfComponents(3);
+    rgb->SetNumberOfTuples(numberOfPoints);
+    unsigned char* rgbValues = rgb->GetPointer(0);
+    for (vtkIdType i = 0; i < numberOfPoints; ++i)
+    {
+      for (int j = 0; j < 3; ++j)
+      {
+        rgbValues[3*i + j] = static_cast<unsigned char>(255 * (*colorChannels[j])[i]);
+      }
+    }
+    polyData->GetPointData()->AddArray(rgb.GetPointer());
+  }
+
+  utime = msg.utime;
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+ddPlanarLidarSubscriber::ddPlanarLidarSubscriber(const QString& channel, QObject* parent)
+  : ddDecodedMessageSubscriber(channel, parent)
+{
+}
+
+//-----------------------------------------------------------------------------
+bool ddPlanarLidarSubscriber::decodeMessage(const lcm::ReceiveBuffer* rbuf, vtkSmartPointer<vtkPolyData>& polyData, qint64& utime)
+{
+  bot_core::planar_lidar_t msg;
+  if (!DecodeMessage(rbuf, msg))
+  {
+    return false;
+  }
+
+  const vtkIdType numberOfRanges = msg.ranges.size();
+  const bool hasIntensities = (msg.intensities.size() == msg.ranges.size());
+
+  vtkNew<vtkPoints> points;
+  points->SetDataTypeToFloat();
+  points->SetNumberOfPoints(numberOfRanges);
+  float* pointValues = static_cast<vtkFloatArray*>(points->GetData())->GetPointer(0);
+
+  vtkNew<vtkFloatArray> ranges;
+  ranges->SetName("range");
+  ranges->SetNumberOfValues(numberOfRanges);
+
+  vtkNew<vtkFloatArray> intensities;
+  intensities->SetName("intensity");
+  intensities->SetNumberOfValues(hasIntensities ? numberOfRanges : 0);
+
+  vtkIdType numberOfPoints = 0;
+  for (vtkIdType i = 0; i < numberOfRanges; ++i)
+  {
+    const float range = msg.ranges[i];
+    if (range < 0)
+    {
+      continue;
+    }
+
+    const double theta = msg.rad0 + i*msg.radstep;
+    pointValues[3*numberOfPoints] = range * std::cos(theta);
+    pointValues[3*numberOfPoints + 1] = range * std::sin(theta);
+    pointValues[3*numberOfPoints + 2] = 0.0f;
+    ranges->SetValue(numberOfPoints, range);
+    if (hasIntensities)
+    {
+      intensities->SetValue(numberOfPoints, msg.intensities[i]);
+    }
+    ++numberOfPoints;
+  }
+
+  points->SetNumberOfPoints(numberOfPoints);
+  ranges->SetNumberOfValues(numberOfPoints);
+
+  polyData = vtkSmartPointer<vtkPolyData>::New();
+  polyData->SetPoints(points.GetPointer());
+  polyData->SetVerts(NewVertexCells(numberOfPoints));
+  polyData->GetPointData()->AddArray(ranges.GetPointer());
+  if (hasIntensities)
+  {
+    intensities->SetNumberOfValues(numberOfPoints);
+    polyData->GetPointData()->AddArray(intensities.GetPointer());
+  }
+
+  utime = msg.utime;
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+ddViewerDrawSubscriber::ddViewerDrawSubscriber(const QString& channel, QObject* parent)
+  : ddDecodedMessageSubscriber(channel, parent)
+{
+}
+
+//-----------------------------------------------------------------------------
+bool ddViewerDrawSubscriber::decodeMessage(const lcm::ReceiveBuffer* rbuf, vtkSmartPointer<vtkPolyData>& polyData, qint64& utime)
+{
+  bot_core::viewer_draw_t msg;
+  if (!DecodeMessage(rbuf, msg))
+  {
+    return false;
+  }
+
+  const vtkIdType numberOfLinks = msg.num_links;
+
+  vtkNew<vtkPoints> points;
+  points->SetDataTypeToDouble();
+  points->SetNumberOfPoints(numberOfLinks);
+  double* positions = static_cast<vtkDoubleArray*>(points->GetData())->GetPointer(0);
+
+  vtkNew<vtkDoubleArray> quaternions;
+  quaternions->SetName("quaternion");
+  quaternions->SetNumberOfComponents(4);
+  quaternions->SetNumberOfTuples(numberOfLinks);
+  double* quaternionValues = quaternions->GetPointer(0);
+
+  vtkNew<vtkIntArray> robotNums;
+  robotNums->SetName("robot_num");
+  robotNums->SetNumberOfValues(numberOfLinks);
+
+  vtkNew<vtkStringArray> linkNames;
+  linkNames->SetName("link_name");
+  linkNames->SetNumberOfValues(numberOfLinks);
+
+  for (vtkIdType i = 0; i < numberOfLinks; ++i)
+  {
+    std::copy(msg.position[i].begin(), msg.position[i].begin() + 3, positions + 3*i);
+    std::copy(msg.quaternion[i].begin(), msg.quaternion[i].begin() + 4, quaternionValues + 4*i);
+    robotNums->SetValue(i, msg.robot_num[i]);
+    linkNames->SetValue(i, msg.link_name[i]);
+  }
+
+  polyData = vtkSmartPointer<vtkPolyData>::New();
+  polyData->SetPoints(points.GetPointer());
+  polyData->GetPointData()->AddArray(quaternions.GetPointer());
+  polyData->GetPointData()->AddArray(robotNums.GetPointer());
+  polyData->GetPointData()->AddArray(linkNames.GetPointer());
+
+  utime = msg.timestamp;
+  return true;
+}
@@ -0,0 +1,154 @@
+#ifndef __ddBotCoreSubscribers_h
+#define __ddBotCoreSubscribers_h
+
+#include "ddLCMSubscriber.h"
+#include "ddAppConfigure.h"
+
+#include <QMap>
+#include <QStringList>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+#include <lcm/lcm-cpp.hpp>
+
+class vtkDoubleArray;
+
+
+// Subscribers that decode bot_core messages into vtk arrays on the lcm
+// thread, before messageReceived() is emitted.
+//
+// Each message is decoded into a new vtkPolyData that replaces the previous
+// one, the arrays of a published vtkPolyData are never modified.  Slots
+// connected to messageReceived() call getPolyData() to receive a shallow copy
+// that shares the decoded arrays, so vtkNumpy.getNumpyFromVtk() returns a
+// view of the decoded buffers without copying them.  Messages that fail to
+// decode are dropped and counted by getDecodeErrorCount().
+
+class DD_APP_EXPORT ddDecodedMessageSubscriber : public ddLCMSubscriber
+{
+  Q_OBJECT
+
+public:
+
+  ddDecodedMessageSubscriber(const QString& channel, QObject* parent=NULL);
+  virtual ~ddDecodedMessageSubscriber();
+
+  virtual void subscribe(lcm::LCM* lcmHandle);
+
+  // Shallow copies the most recently decoded message to polyData and returns
+  // its utime, or returns 0 if no message has been decoded.
+  qint64 getPolyData(vtkPolyData* polyData);
+
+  // Same as above for the most recent message on the given channel, for
+  // subscribers whose channel is a regular expression.
+  qint64 getPolyData(const QString& channel, vtkPolyData* polyData);
+
+  qint64 getDecodeErrorCount() const;
+
+protected:
+
+  // Decodes the message into a new vtkPolyData.  Returns false if the message
+  // could not be decoded.  Called on the lcm thread.
+  virtual bool decodeMessage(const lcm::ReceiveBuffer* rbuf, vtkSmartPointer<vtkPolyData>& polyData, qint64& utime) = 0;
+
+  void decodedMessageHandler(const lcm::ReceiveBuffer* rbuf, const std::string& channel);
+
+  struct DecodedMessage
+  {
+    vtkSmartPointer<vtkPolyData> mPolyData;
+    qint64 mUtime;
+  };
+
+  mutable QMutex mPolyDataMutex;
+  QMap<QString, DecodedMessage> mDecodedMessages;
+  QString mLastChannel;
+  qint64 mDecodeErrors;
+};
+
+
+// Decodes bot_core::robot_state_t into the field data array "pose", a
+// float64 array in drake pose order: base x, y, z, roll, pitch, yaw followed
+// by the positions of the joints given to setJointNames().  Joints that are
+// missing from the message are set to zero and counted by the field data
+// array "missing_joints".  The arrays "joint_position", "joint_velocity" and
+// "joint_effort" hold the message values in message order.
+class DD_APP_EXPORT ddRobotStateSubscriber : public ddDecodedMessageSubscriber
+{
+  Q_OBJECT
+
+public:
+
+  ddRobotStateSubscriber(const QString& channel, QObject* parent=NULL);
+
+  // Sets the joint names of the drake pose, not including the six floating
+  // base joints.
+  void setJointNames(const QStringList& jointNames);
+  QStringList jointNames() const;
+
+  // Copies the most recently decoded pose to pose and returns its utime.
+  qint64 getPose(vtkDoubleArray* pose);
+
+protected:
+
+  virtual bool decodeMessage(const lcm::ReceiveBuffer* rbuf, vtkSmartPointer<vtkPolyData>& polyData, qint64& utime);
+
+  mutable QMutex mJointNamesMutex;
+  QStringList mJointNames;
+};
+
+
+// Decodes bot_core::pointcloud_t into float32 points with vertex cells.
+// Each channel is added as a float32 point data array with the channel name.
+// If the channels "r", "g" and "b" are present they are also combined into
+// the unsigned char point data array "rgb".
+class DD_APP_EXPORT ddPointCloudSubscriber : public ddDecodedMessageSubscriber
+{
+  Q_OBJECT
+
+public:
+
+  ddPointCloudSubscriber(const QString& channel, QObject* parent=NULL);
+
+protected:
+
+  virtual bool decodeMessage(const lcm::ReceiveBuffer* rbuf, vtkSmartPointer<vtkPolyData>& polyData, qint64& utime);
+};
+
+
+// Decodes bot_core::planar_lidar_t into float32 points in the sensor frame,
+// one point with a vertex cell for each non negative range.  The point data
+// arrays "range" and, if the message has one intensity per range,
+// "intensity" hold the values of the returned points.
+class DD_APP_EXPORT ddPlanarLidarSubscriber : public ddDecodedMessageSubscriber
+{
+  Q_OBJECT
+
+public:
+
+  ddPlanarLidarSubscriber(const QString& channel, QObject* parent=NULL);
+
+protected:
+
+  virtual bool decodeMessage(const lcm::ReceiveBuffer* rbuf, vtkSmartPointer<vtkPolyData>& polyData, qint64& utime);
+};
+
+
+// Decodes bot_core::viewer_draw_t into one point per link.  The points are
+// the float64 link positions, the point data holds the float64 array
+// "quaternion" (w, x, y, z), the int array "robot_num" and the string array
+// "link_name".
+class DD_APP_EXPORT ddViewerDrawSubscriber : public ddDecodedMessageSubscriber
+{
+  Q_OBJECT
+
+public:
+
+  ddViewerDrawSubscriber(const QString& channel, QObject* parent=NULL);
+
+protected:
+
+  virtual bool decodeMessage(const lcm::ReceiveBuffer* rbuf, vtkSmartPointer<vtkPolyData>& polyData, qint64& utime);
+};
+
+#endif
@@ -1,25 +1,281 @@
 #include "ddBotImageQueue.h"
+#include "ddLCMDispatcher.h"
 
-#include <zlib.h>
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
 
+#include <vtkDataArray.h>
 #include <vtkIdTypeArray.h>
 #include <vtkCellArray.h>
 #include <vtkNew.h>
 
 #include <multisense_utils/multisense_utils.hpp>
+#include <cmath>
+#include <limits>
 #include <vector>
 
+namespace
+{
+
+//-----------------------------------------------------------------------------
+// Returns a pointer to the image's scalars, sized for the image.  The scalars
+// array is reused if no vtkImageData returned by getImage() still holds it,
+// otherwise a new array is allocated.
+uint8_t* AllocateScalars(ddBotImageQueue::DecodedImage* image, int numberOfComponents, int scalarType)
+{
+  vtkSmartPointer<vtkDataArray>& scalars = image->Scalars;
+  if (!scalars || scalars->GetReferenceCount() > 1 || scalars->GetDataType() != scalarType)
+  {
+    scalars.TakeReference(vtkDataArray::CreateDataArray(scalarType));
+    scalars->SetName("image");
+  }
+
+  image->NumberOfComponents = numberOfComponents;
+  image->ScalarType = scalarType;
+  scalars->SetNumberOfComponents(numberOfComponents);
+  scalars->SetNumberOfTuples(static_cast<vtkIdType>(image->Width)*image->Height);
+  return static_cast<uint8_t*>(scalars->GetVoidPointer(0));
+}
+
+//-----------------------------------------------------------------------------
+struct JPEGErrorManager
+{
+  jpeg_error_mgr Manager;
+  jmp_buf Jump;
+};
+
+//-----------------------------------------------------------------------------
+void JPEGErrorExit(j_common_ptr info)
+{
+  JPEGErrorManager* errorManager = reinterpret_cast<JPEGErrorManager*>(info->err);
+  longjmp(errorManager->Jump, 1);
+}
+
+//-----------------------------------------------------------------------------
+// Decodes a jpeg to rgb at 1/scale of its size, scale is 1, 2, 4 or 8.
+// libjpeg scales in the DCT domain, so a scaled decode skips most of the
+// inverse DCT and color conversion work instead of decoding the full image
+// and downsampling it.  The image size is rounded up, like libjpeg does.
+bool DecodeJPEG(const uint8_t* data, size_t size, int scale, ddBotImageQueue::DecodedImage* image)
+{
+  jpeg_decompress_struct info;
+  JPEGErrorManager errorManager;
+  info.err = jpeg_std_error(&errorManager.Manager);
+  errorManager.Manager.error_exit = JPEGErrorExit;
+
+  if (setjmp(errorManager.Jump))
+  {
+    jpeg_destroy_decompress(&info);
+    return false;
+  }
+
+  jpeg_create_decompress(&info);
+  jpeg_mem_src(&info, const_cast<uint8_t*>(data), size);
+  jpeg_read_header(&info, TRUE);
+
+  info.out_color_space = JCS_RGB;
+  info.scale_num = 1;
+  info.scale_denom = scale;
+  jpeg_calc_output_dimensions(&info);
+
+  image->Width = info.output_width;
+  image->Height = info.output_height;
+  image->Scale = scale;
+  const size_t rowStride = static_cast<size_t>(info.output_width)*3;
+  uint8_t* outPtr = AllocateScalars(image, 3, VTK_UNSIGNED_CHAR);
+
+  jpeg_start_decompress(&info);
+  while (info.output_scanline < info.output_height)
+  {
+    JSAMPROW row = outPtr + info.output_scanline*rowStride;
+    jpeg_read_scanlines(&info, &row, 1);
+  }
+  jpeg_finish_decompress(&info);
+  jpeg_destroy_decompress(&info);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+template <class T>
+void DownsampleImage(const T* inPtr, int inWidth, int inHeight, int numberOfComponents, int factor, T* outPtr)
+{
+  const int outWidth = (inWidth + factor - 1)/factor;
+  const int outHeight = (inHeight + factor - 1)/factor;
+
+  for (int y = 0; y < outHeight; ++y)
+  {
+    const int y0 = y*factor;
+    const int y1 = std::min(y0 + factor, inHeight);
+    for (int x = 0; x < outWidth; ++x)
+    {
+      const int x0 = x*factor;
+      const int x1 = std::min(x0 + factor, inWidth);
+      const int count = (y1 - y0)*(x1 - x0);
+
+      for (int c = 0; c < numberOfComponents; ++c)
+      {
+        uint32_t sum = 0;
+        for (int yy = y0; yy < y1; ++yy)
+        {
+          const T* rowPtr = inPtr + (static_cast<size_t>(yy)*inWidth + x0)*numberOfComponents + c;
+          for (int xx = x0; xx < x1; ++xx, rowPtr += numberOfComponents)
+          {
+            sum += *rowPtr;
+          }
+        }
+        outPtr[(static_cast<size_t>(y)*outWidth + x)*numberOfComponents + c] = static_cast<T>((sum + count/2)/count);
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Averages factor x factor blocks of the input image into the output image,
+// the size is rounded up like a scaled jpeg decode.
+void DownsampleImage(const ddBotImageQueue::DecodedImage* input, int factor, ddBotImageQueue::DecodedImage* output)
+{
+  output->Width = (input->Width + factor - 1)/factor;
+  output->Height = (input->Height + factor - 1)/factor;
+  output->Scale = input->Scale*factor;
+  output->Utime = input->Utime;
+  output->HasLocalToCamera = input->HasLocalToCamera;
+  output->LocalToCamera = input->LocalToCamera;
+
+  uint8_t* outPtr = AllocateScalars(output, input->NumberOfComponents, input->ScalarType);
+  const void* inPtr = input->Scalars->GetVoidPointer(0);
+  if (input->ScalarType == VTK_UNSIGNED_SHORT)
+  {
+    DownsampleImage(static_cast<const uint16_t*>(inPtr), input->Width, input->Height,
+      input->NumberOfComponents, factor, reinterpret_cast<uint16_t*>(outPtr));
+  }
+  else
+  {
+    DownsampleImage(static_cast<const uint8_t*>(inPtr), input->Width, input->Height,
+      input->NumberOfComponents, factor, outPtr);
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Returns the pyramid level of an image scale, or -1 if the scale is not 1,
+// 2, 4 or 8.
+int PyramidLevel(int scale)
+{
+  switch (scale)
+  {
+    case 1: return 0;
+    case 2: return 1;
+    case 4: return 2;
+    case 8: return 3;
+    default: return -1;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Decodes the image message into the image scalars.  Jpeg images are decoded
+// at 1/scale of their size, other formats at full size.  Returns false for an
+// unhandled pixel format or a corrupt image.
+bool DecodeImage(const bot_core::image_t& message, bool zlibCompression, int scale, ddBotImageQueue::DecodedImage* image)
+{
+  const size_t w = message.width;
+  const size_t h = message.height;
+
+  image->Width = message.width;
+  image->Height = message.height;
+  image->Scale = 1;
+  image->Utime = message.utime;
+
+  if (w == 0 || h == 0)
+  {
+    image->Scalars = 0;
+    return true;
+  }
+
+  int pixelFormat = message.pixelformat;
+  bool isZlibCompressed = zlibCompression;
+  ddDepthCodec::Compression depthCompression;
+  bool deltaPredictor;
+
+  if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_INVALID)
+  {
+    pixelFormat = bot_core::image_t::PIXEL_FORMAT_LE_GRAY16;
+    isZlibCompressed = true;
+  }
+  else if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_GRAY
+          && message.row_stride/w == 2)
+  {
+    pixelFormat = bot_core::image_t::PIXEL_FORMAT_LE_GRAY16;
+  }
+
+  // the message may hold fewer bytes than the image
+  const size_t messageSize = std::min(message.data.size(), static_cast<size_t>(std::max(message.size, 0)));
+
+  if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_RGB)
+  {
+    uint8_t* outPtr = AllocateScalars(image, 3, VTK_UNSIGNED_CHAR);
+    std::copy(message.data.begin(), message.data.begin() + std::min(messageSize, w*h*3), outPtr);
+  }
+  else if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_MJPEG)
+  {
+    return DecodeJPEG(message.data.data(), messageSize, scale, image);
+  }
+  else if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_GRAY)
+  {
+    uint8_t* outPtr = AllocateScalars(image, 1, VTK_UNSIGNED_CHAR);
+    std::copy(message.data.begin(), message.data.begin() + std::min(messageSize, w*h), outPtr);
+  }
+  else if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_LE_GRAY16)
+  {
+    uint8_t* outPtr = AllocateScalars(image, 1, VTK_UNSIGNED_SHORT);
+    if (isZlibCompressed)
+    {
+      return ddDepthCodec::decode(message.data.data(), messageSize, ddDepthCodec::ZlibCompression, false,
+                                  reinterpret_cast<uint16_t*>(outPtr), w*h);
+    }
+    else
+    {
+      std::copy(message.data.begin(), message.data.begin() + std::min(messageSize, w*h*2), outPtr);
+    }
+  }
+  else if (ddDepthCodec::parsePixelFormat(pixelFormat, &depthCompression, &deltaPredictor))
+  {
+    uint8_t* outPtr = AllocateScalars(image, 1, VTK_UNSIGNED_SHORT);
+    return ddDepthCodec::decode(message.data.data(), messageSize, depthCompression, deltaPredictor,
+                                reinterpret_cast<uint16_t*>(outPtr), w*h);
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
+}
+
 
 //-----------------------------------------------------------------------------
 ddBotImageQueue::ddBotImageQueue(QObject* parent) : QObject(parent)
 {
   mBotParam = 0;
   mBotFrames = 0;
+  mFrameCache = 0;
+  mImageHistoryMemoryBudget = 0;
+  mDepthCompression = ddDepthCodec::ZlibCompression;
+  mDepthDeltaPredictor = false;
 }
 
 //-----------------------------------------------------------------------------
 ddBotImageQueue::~ddBotImageQueue()
 {
+  // subscribers deliver on the worker pool, remove them before the camera
+  // data they write to is deleted
+  foreach (ddLCMSubscriber* subscriber, mSubscribers.values())
+  {
+    mLCM->removeSubscriber(subscriber);
+    delete subscriber;
+  }
+
   foreach (CameraData* cameraData, mCameraData.values())
   {
     delete cameraData;
@@ -52,9 +308,137 @@ bool ddBotImageQueue::initCameraData(const QString& cameraName, CameraData* came
     printf("Failed to get coord_frame for camera: %s\n", qPrintable(cameraName));
     cameraData->mHasCalibration = false;
   }
+
+  if (cameraData->mCamTrans)
+  {
+    this->initCameraProjection(cameraName, cameraData);
+  }
   return true;
 }
 
+//-----------------------------------------------------------------------------
+void ddBotImageQueue::initCameraProjection(const QString& cameraName, CameraData* cameraData)
+{
+  ddCameraProjection::Intrinsics intrinsics = {
+    bot_camtrans_get_focal_length_x(cameraData->mCamTrans),
+    bot_camtrans_get_focal_length_y(cameraData->mCamTrans),
+    bot_camtrans_get_skew(cameraData->mCamTrans),
+    bot_camtrans_get_principal_x(cameraData->mCamTrans),
+    bot_camtrans_get_principal_y(cameraData->mCamTrans),
+    0.0, 0.0, 0.0, 0.0, 0.0};
+
+  // the distortion parameters are not exposed by BotCamTrans, read them with
+  // the keys bot_param_get_new_camtrans uses
+  const QString prefix = QString("cameras.") + cameraName + QString(".intrinsic_cal.");
+  std::string model = "null";
+  char* val = NULL;
+  if (bot_param_get_str(mBotParam, (prefix + "distortion_model").toAscii().data(), &val) == 0)
+  {
+    model = val;
+    free(val);
+  }
+
+  if (model == "plumb-bob")
+  {
+    double k[3] = {0.0, 0.0, 0.0};
+    double p[2] = {0.0, 0.0};
+    bot_param_get_double_array(mBotParam, (prefix + "distortion_k").toAscii().data(), k, 3);
+    bot_param_get_double_array(mBotParam, (prefix + "distortion_p").toAscii().data(), p, 2);
+    intrinsics.K1 = k[0];
+    intrinsics.K2 = k[1];
+    intrinsics.K3 = k[2];
+    intrinsics.P1 = p[0];
+    intrinsics.P2 = p[1];
+  }
+  else if (model != "null")
+  {
+    // projected point by point with bot_camtrans
+    return;
+  }
+
+  ddCameraProjection projection;
+  projection.setIntrinsics(intrinsics);
+
+  // use the batch projection only if it agrees with bot_camtrans over the
+  // image
+  const double width = bot_camtrans_get_image_width(cameraData->mCamTrans);
+  const double height = bot_camtrans_get_image_height(cameraData->mCamTrans);
+  for (int i = 0; i <= 8; ++i)
+  {
+    for (int j = 0; j <= 8; ++j)
+    {
+      double ray[3];
+      bot_camtrans_unproject_pixel(cameraData->mCamTrans, width*i/8.0, height*j/8.0, ray);
+      const double point[3] = {ray[0]*2.0, ray[1]*2.0, ray[2]*2.0};
+
+      double expected[3];
+      double pixel[2];
+      const bool expectedInFront = bot_camtrans_project_point(cameraData->mCamTrans, point, expected) == 0;
+      const bool inFront = projection.projectPoint(point, pixel);
+      if (expectedInFront != inFront
+          || (inFront && (std::fabs(expected[0] - pixel[0]) > 0.05 || std::fabs(expected[1] - pixel[1]) > 0.05)))
+      {
+        printf("Camera %s: batch projection does not match bot_camtrans, projecting point by point\n", qPrintable(cameraName));
+        return;
+      }
+    }
+  }
+
+  cameraData->mProjection.reset(new ddCameraProjection(projection));
+}
+
+//-----------------------------------------------------------------------------
+void ddBotImageQueue::projectPoints(CameraData* cameraData, vtkPoints* points, const Eigen::Isometry3d& transform, float* pixels)
+{
+  const size_t numberOfPoints = points->GetNumberOfPoints();
+  const int dataType = points->GetDataType();
+
+  if (cameraData->mProjection && (dataType == VTK_FLOAT || dataType == VTK_DOUBLE))
+  {
+    ddCameraProjection projection(*cameraData->mProjection);
+    double matrix[12];
+    for (int i = 0; i < 3; ++i)
+    {
+      for (int j = 0; j < 4; ++j)
+      {
+        matrix[i*4 + j] = transform(i, j);
+      }
+    }
+    projection.setTransform(matrix);
+
+    if (dataType == VTK_FLOAT)
+    {
+      projection.projectPoints(static_cast<const float*>(points->GetVoidPointer(0)), numberOfPoints, pixels);
+    }
+    else
+    {
+      projection.projectPoints(static_cast<const double*>(points->GetVoidPointer(0)), numberOfPoints, pixels);
+    }
+    return;
+  }
+
+  ddCameraProjection::parallelFor(numberOfPoints, [&](size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+    {
+      Eigen::Vector3d pt;
+      points->GetPoint(i, pt.data());
+      pt = transform * pt;
+
+      double pix[3];
+      if (bot_camtrans_project_point(cameraData->mCamTrans, pt.data(), pix) == 0)
+      {
+        pixels[2*i] = pix[0];
+        pixels[2*i + 1] = pix[1];
+      }
+      else
+      {
+        pixels[2*i] = pixels[2*i + 1] = std::numeric_limits<float>::quiet_NaN();
+      }
+    }
+  });
+}
+
 //-----------------------------------------------------------------------------
 void ddBotImageQueue::init(ddLCMThread* lcmThread,
                            const QString& botConfigFile) {
@@ -69,6 +453,7 @@ void ddBotImageQueue::init(ddLCMThread* lcmThread,
 
   mBotFrames = bot_frames_get_global(lcmThread->lcmHandle()->getUnderlyingLCM(),
                                      mBotParam);
+  mFrameCache = ddFrameTransformCache::instance(mBotFrames, mBotParam);
 
   // char** cameraNames = bot_param_get_all_camera_names(mBotParam);
   // for (int i = 0; cameraNames[i] != 0; ++i) {
@@ -87,6 +472,8 @@ bool ddBotImageQueue::addCameraStream(const QString& channel)
 //-----------------------------------------------------------------------------
 bool ddBotImageQueue::addCameraStream(const QString& channel, const QString& cameraName, int imageType)
 {
+  QMutexLocker locker(&this->mChannelMutex);
+
   if (!this->mCameraData.contains(cameraName))
   {
     CameraData* cameraData = new CameraData;
@@ -110,6 +497,7 @@ bool ddBotImageQueue::addCameraStream(const QString& channel, const QString& cam
   if (!this->mSubscribers.contains(channel))
   {
     ddLCMSubscriber* subscriber = new ddLCMSubscriber(channel, this);
+    subscriber->setWorkerPoolEnabled(true);
 
     if (imageType >= 0)
     {
@@ -157,6 +545,12 @@ QStringList ddBotImageQueue::getBotFrameNames() const
   return names;
 }
 
+//-----------------------------------------------------------------------------
+qint64 ddBotImageQueue::getCurrentUtime() const
+{
+  return ddLCMDispatcher::instance()->currentUtime();
+}
+
 //-----------------------------------------------------------------------------
 int ddBotImageQueue::getTransform(const QString& fromFrame, const QString& toFrame, qint64 utime, vtkTransform* transform)
 {
@@ -165,8 +559,8 @@ int ddBotImageQueue::getTransform(const QString& fromFrame, const QString& toFra
     return 0;
     }
 
-  double matx[16];
-  int status = bot_frames_get_trans_mat_4x4_with_utime(mBotFrames, fromFrame.toAscii().data(),  toFrame.toAscii().data(), utime, matx);
+  Eigen::Isometry3d mat;
+  int status = this->getTransform(fromFrame.toAscii().data(), toFrame.toAscii().data(), mat, utime);
   if (!status)
     {
     return 0;
@@ -177,7 +571,7 @@ int ddBotImageQueue::getTransform(const QString& fromFrame, const QString& toFra
   {
     for (int j = 0; j < 4; ++j)
     {
-      vtkmat->SetElement(i, j, matx[i*4+j]);
+      vtkmat->SetElement(i, j, mat(i,j));
     }
   }
 
@@ -193,8 +587,15 @@ int ddBotImageQueue::getTransform(const QString& fromFrame, const QString& toFra
     return 0;
     }
 
-  double matx[16];
-  int status = bot_frames_get_trans_mat_4x4(mBotFrames, fromFrame.toAscii().data(),  toFrame.toAscii().data(), matx);
+  // during log replay the latest transform is the one at the log time
+  if (ddLCMDispatcher::instance()->replayIsEnabled())
+    {
+    return this->getTransform(fromFrame, toFrame, this->getCurrentUtime(), transform);
+    }
+
+  // the latest transform
+  Eigen::Isometry3d mat;
+  int status = this->getTransform(fromFrame.toAscii().data(), toFrame.toAscii().data(), mat, -1);
   if (!status)
     {
     return 0;
@@ -205,7 +606,7 @@ int ddBotImageQueue::getTransform(const QString& fromFrame, const QString& toFra
   {
     for (int j = 0; j < 4; ++j)
     {
-      vtkmat->SetElement(i, j, matx[i*4+j]);
+      vtkmat->SetElement(i, j, mat(i,j));
     }
   }
 
@@ -217,19 +618,18 @@ int ddBotImageQueue::getTransform(const QString& fromFrame, const QString& toFra
 int ddBotImageQueue::getTransform(std::string from_frame, std::string to_frame,
                    Eigen::Isometry3d & mat, qint64 utime)
 {
-  double matx[16];
-  int status = bot_frames_get_trans_mat_4x4_with_utime( mBotFrames, from_frame.c_str(),  to_frame.c_str(), utime, matx);
-  if (!status)
+  if (!mFrameCache)
     {
     return 0;
     }
 
-  for (int i = 0; i < 4; ++i) {
-    for (int j = 0; j < 4; ++j) {
-      mat(i,j) = matx[i*4+j];
+  const int fromId = mFrameCache->frameId(from_frame);
+  const int toId = mFrameCache->frameId(to_frame);
+  if (utime < 0)
+    {
+    return mFrameCache->getTransform(fromId, toId, mat);
     }
-  }
-  return status;
+  return mFrameCache->getTransform(fromId, toId, utime, mat);
 }
 
 //-----------------------------------------------------------------------------
@@ -241,8 +641,179 @@ qint64 ddBotImageQueue::getImage(const QString& cameraName, vtkImageData* image)
     return 0;
   }
 
-  image->DeepCopy(toVtkImage(cameraData));
-  return cameraData->mImageMessage.utime;
+  // shares the decoded scalars, see toVtkImage
+  std::shared_ptr<const DecodedImage> decodedImage = this->getDecodedImage(cameraData);
+  image->ShallowCopy(this->toVtkImage(decodedImage.get()));
+  return decodedImage ? decodedImage->Utime : 0;
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddBotImageQueue::getImage(const QString& cameraName, qint64 utime, vtkImageData* image)
+{
+  CameraData* cameraData = this->getCameraData(cameraName);
+  if (!cameraData)
+  {
+    return 0;
+  }
+
+  std::shared_ptr<const DecodedImage> decodedImage = this->getDecodedImage(cameraData, utime);
+  image->ShallowCopy(this->toVtkImage(decodedImage.get()));
+  return decodedImage ? decodedImage->Utime : 0;
+}
+
+//-----------------------------------------------------------------------------
+void ddBotImageQueue::setImageHistoryMemoryBudget(qint64 bytes)
+{
+  mImageHistoryMemoryBudget = std::max(qint64(0), bytes);
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddBotImageQueue::getImageHistoryMemoryBudget() const
+{
+  return mImageHistoryMemoryBudget;
+}
+
+//-----------------------------------------------------------------------------
+int ddBotImageQueue::getImageHistoryLength(const QString& cameraName)
+{
+  CameraData* cameraData = this->getCameraData(cameraName);
+  if (!cameraData)
+  {
+    return 0;
+  }
+
+  QMutexLocker locker(&cameraData->mMutex);
+  return static_cast<int>(cameraData->mImageHistory.size());
+}
+
+//-----------------------------------------------------------------------------
+void ddBotImageQueue::setImageDecodeScale(const QString& cameraName, int scale)
+{
+  CameraData* cameraData = this->getCameraData(cameraName);
+  if (!cameraData)
+  {
+    return;
+  }
+
+  if (PyramidLevel(scale) < 0)
+  {
+    printf("Error: image scale must be 1, 2, 4 or 8, got %d\n", scale);
+    return;
+  }
+
+  cameraData->mDecodeScale = scale;
+}
+
+//-----------------------------------------------------------------------------
+int ddBotImageQueue::getImageDecodeScale(const QString& cameraName)
+{
+  CameraData* cameraData = this->getCameraData(cameraName);
+  return cameraData ? static_cast<int>(cameraData->mDecodeScale) : 1;
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddBotImageQueue::getScaledImage(const QString& cameraName, int scale, vtkImageData* image)
+{
+  CameraData* cameraData = this->getCameraData(cameraName);
+  if (!cameraData)
+  {
+    return 0;
+  }
+
+  const int level = PyramidLevel(scale);
+  if (level < 0)
+  {
+    printf("Error: image scale must be 1, 2, 4 or 8, got %d\n", scale);
+    return 0;
+  }
+
+  // from now on the handler keeps the jpeg of the latest image
+  cameraData->mHasImagePyramid = true;
+
+  std::shared_ptr<const DecodedImage> decodedImage = this->getPyramidImage(cameraData, level);
+  image->ShallowCopy(this->toVtkImage(decodedImage.get()));
+  return decodedImage ? decodedImage->Utime : 0;
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const ddBotImageQueue::DecodedImage> ddBotImageQueue::getPyramidImage(CameraData* cameraData, int level)
+{
+  const int scale = 1 << level;
+
+  std::shared_ptr<const DecodedImage> latest;
+  std::shared_ptr<const DecodedImage> source;
+  std::shared_ptr<const std::vector<uint8_t> > compressedImage;
+  std::shared_ptr<DecodedImage> scaledImage;
+  {
+    QMutexLocker locker(&cameraData->mMutex);
+    if (cameraData->mImageHistory.empty())
+    {
+      return std::shared_ptr<const DecodedImage>();
+    }
+
+    latest = cameraData->mImageHistory.back();
+    if (latest->Scale == scale || !latest->Scalars)
+    {
+      return latest;
+    }
+
+    std::shared_ptr<const DecodedImage>& cached = cameraData->mPyramid[level];
+    if (cached && cached->Utime == latest->Utime)
+    {
+      return cached;
+    }
+
+    if (cameraData->mCompressedImage && cameraData->mCompressedImageUtime == latest->Utime)
+    {
+      compressedImage = cameraData->mCompressedImage;
+    }
+
+    // without the jpeg, downsample the smallest image that is still larger
+    // than the requested scale
+    if (latest->Scale < scale)
+    {
+      source = latest;
+      for (int i = level - 1; i >= 0; --i)
+      {
+        const std::shared_ptr<const DecodedImage>& finer = cameraData->mPyramid[i];
+        if (finer && finer->Utime == latest->Utime && finer->Scale > source->Scale)
+        {
+          source = finer;
+          break;
+        }
+      }
+    }
+
+    // reuse the previous image of this level if no reader holds it
+    scaledImage = std::const_pointer_cast<DecodedImage>(cached);
+    cached.reset();
+  }
+
+  if (!scaledImage || scaledImage.use_count() > 1)
+  {
+    scaledImage.reset(new DecodedImage);
+  }
+
+  if (compressedImage && DecodeJPEG(compressedImage->data(), compressedImage->size(), scale, scaledImage.get()))
+  {
+    scaledImage->Utime = latest->Utime;
+    scaledImage->HasLocalToCamera = latest->HasLocalToCamera;
+    scaledImage->LocalToCamera = latest->LocalToCamera;
+  }
+  else if (source)
+  {
+    DownsampleImage(source.get(), scale/source->Scale, scaledImage.get());
+  }
+  else
+  {
+    // the image was decoded smaller than the requested scale and its jpeg
+    // is not kept, the latest image is the closest there is
+    return latest;
+  }
+
+  QMutexLocker locker(&cameraData->mMutex);
+  cameraData->mPyramid[level] = scaledImage;
+  return scaledImage;
 }
 
 //-----------------------------------------------------------------------------
@@ -254,6 +825,7 @@ qint64 ddBotImageQueue::getCurrentImageTime(const QString& cameraName)
     return 0;
   }
 
+  QMutexLocker locker(&cameraData->mMutex);
   return cameraData->mImageMessage.utime;
 }
 
@@ -266,7 +838,21 @@ void ddBotImageQueue::colorizePoints(const QString& cameraName, vtkPolyData* pol
     return;
   }
 
-  colorizePoints(polyData, cameraData);
+  std::shared_ptr<const DecodedImage> image = this->getDecodedImage(cameraData);
+  this->colorizePoints(polyData, cameraData, image.get());
+}
+
+//-----------------------------------------------------------------------------
+void ddBotImageQueue::colorizePoints(const QString& cameraName, vtkPolyData* polyData, qint64 utime)
+{
+  CameraData* cameraData = this->getCameraData(cameraName);
+  if (!cameraData)
+  {
+    return;
+  }
+
+  std::shared_ptr<const DecodedImage> image = this->getDecodedImage(cameraData, utime);
+  this->colorizePoints(polyData, cameraData, image.get());
 }
 
 //-----------------------------------------------------------------------------
@@ -278,7 +864,21 @@ void ddBotImageQueue::computeTextureCoords(const QString& cameraName, vtkPolyDat
     return;
   }
 
-  this->computeTextureCoords(polyData, cameraData);
+  std::shared_ptr<const DecodedImage> image = this->getDecodedImage(cameraData);
+  this->computeTextureCoords(polyData, cameraData, image.get());
+}
+
+//-----------------------------------------------------------------------------
+void ddBotImageQueue::computeTextureCoords(const QString& cameraName, vtkPolyData* polyData, qint64 utime)
+{
+  CameraData* cameraData = this->getCameraData(cameraName);
+  if (!cameraData)
+  {
+    return;
+  }
+
+  std::shared_ptr<const DecodedImage> image = this->getDecodedImage(cameraData, utime);
+  this->computeTextureCoords(polyData, cameraData, image.get());
 }
 
 //-----------------------------------------------------------------------------
@@ -369,16 +969,25 @@ void ddBotImageQueue::getBodyToCameraTransform(const QString& cameraName, vtkTra
 //-----------------------------------------------------------------------------
 ddBotImageQueue::CameraData* ddBotImageQueue::getCameraData(const QString& cameraName)
 {
+  QMutexLocker locker(&this->mChannelMutex);
   return this->mCameraData.value(cameraName, NULL);
 }
 
 //-----------------------------------------------------------------------------
 void ddBotImageQueue::onImagesMessage(const QByteArray& data, const QString& channel)
 {
-  bot_core::images_t& message = this->mImagesMessageMap[channel];
+  // decode outside of any lock, then publish the message by swapping the
+  // shared pointer so readers never see a partially decoded message
+  QSharedPointer<bot_core::images_t> messagePtr(new bot_core::images_t);
+  bot_core::images_t& message = *messagePtr;
   message.decode(data.data(), 0, data.size());
 
-  const QMap<int, QString> cameraNameMap = mChannelMap[channel];
+  QMap<int, QString> cameraNameMap;
+  {
+    QMutexLocker locker(&this->mChannelMutex);
+    this->mImagesMessageMap[channel] = messagePtr;
+    cameraNameMap = mChannelMap[channel];
+  }
 
   for (QMap<int, QString>::const_iterator itr = cameraNameMap.constBegin(); itr != cameraNameMap.end(); ++itr)
   {
@@ -400,47 +1009,164 @@ void ddBotImageQueue::onImagesMessage(const QByteArray& data, const QString& cha
       return;
     }
 
-    CameraData* cameraData = this->getCameraData(cameraName);
+    this->setImageMessage(this->getCameraData(cameraName), *imageMessage);
+  }
+}
 
-    QMutexLocker locker(&cameraData->mMutex);
-    cameraData->mImageMessage = *imageMessage;
-    cameraData->mImageBuffer.clear();
+//-----------------------------------------------------------------------------
+void ddBotImageQueue::onImageMessage(const QByteArray& data, const QString& channel)
+{
+  QString cameraName;
+  {
+    QMutexLocker locker(&this->mChannelMutex);
+    cameraName = mChannelMap[channel][-1];
+  }
 
-    if (cameraData->mHasCalibration)
-    {
-      this->getTransform("local", cameraData->mCoordFrame, cameraData->mLocalToCamera, cameraData->mImageMessage.utime);
-      //this->getTransform("utorso", cameraData->mCoordFrame, cameraData->mBodyToCamera, cameraData->mImageMessage.utime);
-    }
+  CameraData* cameraData = this->getCameraData(cameraName);
+
+  bot_core::image_t message;
+  message.decode(data.data(), 0, data.size());
 
-    //printf("got image %s: %d %d\n", cameraData->mName.c_str(), cameraData->mImageMessage.width, cameraData->mImageMessage.height);
+  if (message.utime == 0)
+  {
+    QMutexLocker locker(&cameraData->mMutex);
+    message.utime = cameraData->mImageMessage.utime + 1;
   }
+
+  this->setImageMessage(cameraData, message);
 }
 
 //-----------------------------------------------------------------------------
-void ddBotImageQueue::onImageMessage(const QByteArray& data, const QString& channel)
+void ddBotImageQueue::setImageMessage(CameraData* cameraData, const bot_core::image_t& message)
 {
-  const QString& cameraName = mChannelMap[channel][-1];
+  // take the back image, or a new one if a reader still holds it from when
+  // it was in the history
+  std::shared_ptr<DecodedImage> image;
+  {
+    QMutexLocker locker(&cameraData->mMutex);
+    image.swap(cameraData->mBackImage);
+  }
 
-  CameraData* cameraData = this->getCameraData(cameraName);
+  if (!image || image.use_count() > 1)
+  {
+    // DecodedImage holds an aligned Eigen type, so no make_shared
+    image.reset(new DecodedImage);
+  }
+
+  // decode outside of the camera lock, this is the expensive part
+  const bool decoded = DecodeImage(message, cameraData->mZlibCompression, cameraData->mDecodeScale, image.get());
+  if (!decoded)
+  {
+    std::cout << "failed to decode image with pixelformat " << message.pixelformat << " for camera " << cameraData->mName.c_str() << std::endl;
+  }
 
-  int64_t prevTimestamp = cameraData->mImageMessage.utime;
+  image->HasLocalToCamera = cameraData->mHasCalibration
+    && this->getTransform("local", cameraData->mCoordFrame, image->LocalToCamera, message.utime);
+
+  // keep the message without its data, the decoded image replaces it
+  bot_core::image_t header;
+  header.utime = message.utime;
+  header.width = message.width;
+  header.height = message.height;
+  header.row_stride = message.row_stride;
+  header.pixelformat = message.pixelformat;
+  header.size = message.size;
+  header.nmetadata = message.nmetadata;
+  header.metadata = message.metadata;
+
+  // keep the jpeg so scaled images can be decoded from it, see getScaledImage
+  std::shared_ptr<const std::vector<uint8_t> > compressedImage;
+  if (decoded && cameraData->mHasImagePyramid && message.pixelformat == bot_core::image_t::PIXEL_FORMAT_MJPEG)
+  {
+    compressedImage = std::make_shared<const std::vector<uint8_t> >(message.data);
+  }
 
   QMutexLocker locker(&cameraData->mMutex);
-  cameraData->mImageMessage.decode(data.data(), 0, data.size());
-  cameraData->mImageBuffer.clear();
 
-  if (cameraData->mImageMessage.utime == 0)
+  // handlers on different workers may finish out of order
+  if (message.utime >= cameraData->mImageMessage.utime)
+  {
+    std::swap(cameraData->mImageMessage, header);
+    if (image->HasLocalToCamera)
+    {
+      cameraData->mLocalToCamera = image->LocalToCamera;
+    }
+    if (decoded)
+    {
+      cameraData->mCompressedImage = compressedImage;
+      cameraData->mCompressedImageUtime = message.utime;
+    }
+  }
+
+  if (!decoded)
+  {
+    cameraData->mBackImage = image;
+    return;
+  }
+
+  std::deque<std::shared_ptr<const DecodedImage> >& history = cameraData->mImageHistory;
+  std::deque<std::shared_ptr<const DecodedImage> >::iterator itr = history.end();
+  while (itr != history.begin() && (*(itr - 1))->Utime > image->Utime)
   {
-    cameraData->mImageMessage.utime = prevTimestamp + 1;
+    --itr;
   }
+  history.insert(itr, image);
+  cameraData->mImageHistorySize += image->memorySize();
 
-  if (cameraData->mHasCalibration)
+  // keep the latest image regardless of the budget
+  const size_t budget = static_cast<size_t>(mImageHistoryMemoryBudget);
+  while (history.size() > 1 && cameraData->mImageHistorySize > budget)
   {
-    this->getTransform("local", cameraData->mCoordFrame, cameraData->mLocalToCamera, cameraData->mImageMessage.utime);
-    //this->getTransform("utorso", cameraData->mCoordFrame, cameraData->mBodyToCamera, cameraData->mImageMessage.utime);
+    cameraData->mImageHistorySize -= history.front()->memorySize();
+    cameraData->mBackImage = std::const_pointer_cast<DecodedImage>(history.front());
+    history.pop_front();
   }
+}
 
-  //printf("got image %s: %d %d\n", cameraData->mName.c_str(), cameraData->mImageMessage.width, cameraData->mImageMessage.height);
+//-----------------------------------------------------------------------------
+std::shared_ptr<const ddBotImageQueue::DecodedImage> ddBotImageQueue::getDecodedImage(CameraData* cameraData)
+{
+  QMutexLocker locker(&cameraData->mMutex);
+  if (cameraData->mImageHistory.empty())
+  {
+    return std::shared_ptr<const DecodedImage>();
+  }
+  return cameraData->mImageHistory.back();
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const ddBotImageQueue::DecodedImage> ddBotImageQueue::getDecodedImage(CameraData* cameraData, qint64 utime)
+{
+  QMutexLocker locker(&cameraData->mMutex);
+  const std::deque<std::shared_ptr<const DecodedImage> >& history = cameraData->mImageHistory;
+  if (history.empty())
+  {
+    return std::shared_ptr<const DecodedImage>();
+  }
+
+  // the first image at or after utime, or the image before it if that is
+  // nearer
+  size_t first = 0;
+  size_t count = history.size();
+  while (count > 0)
+  {
+    const size_t step = count / 2;
+    if (history[first + step]->Utime < utime)
+    {
+      first += step + 1;
+      count -= step + 1;
+    }
+    else
+    {
+      count = step;
+    }
+  }
+
+  if (first == history.size() || (first > 0 && utime - history[first - 1]->Utime < history[first]->Utime - utime))
+  {
+    --first;
+  }
+  return history[first];
 }
 
 void ddBotImageQueue::openLCMFile(const QString& filename)
@@ -477,89 +1203,28 @@ bool ddBotImageQueue::readNextImagesMessage()
 }
 
 //-----------------------------------------------------------------------------
-vtkSmartPointer<vtkImageData> ddBotImageQueue::toVtkImage(CameraData* cameraData)
+vtkSmartPointer<vtkImageData> ddBotImageQueue::toVtkImage(const DecodedImage* decodedImage)
 {
-  QMutexLocker locker(&cameraData->mMutex);
-
-  size_t w = cameraData->mImageMessage.width;
-  size_t h = cameraData->mImageMessage.height;
-
-  if (w == 0 || h == 0)
-  {
-    return vtkSmartPointer<vtkImageData>::New();
-  }
-
-  int nComponents = 3;
-  int componentType = VTK_UNSIGNED_CHAR;
-
-  int pixelFormat = cameraData->mImageMessage.pixelformat;
-  bool isZlibCompressed = cameraData->mZlibCompression;
-
-  if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_INVALID)
-  {
-    pixelFormat = bot_core::image_t::PIXEL_FORMAT_LE_GRAY16;
-    isZlibCompressed = true;
-  }
-  else if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_GRAY
-          && cameraData->mImageMessage.row_stride/w == 2)
-  {
-    pixelFormat = bot_core::image_t::PIXEL_FORMAT_LE_GRAY16;
-  }
-
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
 
-  if (!cameraData->mImageBuffer.size())
+  if (!decodedImage || !decodedImage->Scalars)
   {
-    if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_RGB)
-    {
-      cameraData->mImageBuffer = cameraData->mImageMessage.data;
-    }
-    else if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_MJPEG)
-    {
-      cameraData->mImageBuffer.resize(w*h*3);
-      jpeg_decompress_8u_rgb(cameraData->mImageMessage.data.data(), cameraData->mImageMessage.size, cameraData->mImageBuffer.data(), w, h, w*3);
-    }
-    else if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_GRAY)
-    {
-      cameraData->mImageBuffer = cameraData->mImageMessage.data;
-      nComponents = 1;
-    }
-    else if (pixelFormat == bot_core::image_t::PIXEL_FORMAT_LE_GRAY16)
-    {
-
-      if (isZlibCompressed)
-      {
-        cameraData->mImageBuffer.resize(w*h*2);
-        unsigned long len = cameraData->mImageBuffer.size();
-        uncompress(cameraData->mImageBuffer.data(), &len, cameraData->mImageMessage.data.data(), cameraData->mImageMessage.size);
-      }
-      else
-      {
-        cameraData->mImageBuffer = cameraData->mImageMessage.data;
-      }
-
-      nComponents = 1;
-      componentType = VTK_UNSIGNED_SHORT;
-    }
-    else
-    {
-      std::cout << "unhandled image pixelformat " << pixelFormat << " for camera " << cameraData->mName.c_str() << std::endl;
-      return vtkSmartPointer<vtkImageData>::New();
-    }
+    return image;
   }
 
-  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  const int w = decodedImage->Width;
+  const int h = decodedImage->Height;
 
   image->SetWholeExtent(0, w-1, 0, h-1, 0, 0);
   image->SetSpacing(1.0, 1.0, 1.0);
   image->SetOrigin(0.0, 0.0, 0.0);
   image->SetExtent(image->GetWholeExtent());
-  image->SetNumberOfScalarComponents(nComponents);
-  image->SetScalarType(componentType);
-  image->AllocateScalars();
-
-  unsigned char* outPtr = static_cast<unsigned char*>(image->GetScalarPointer(0, 0, 0));
+  image->SetNumberOfScalarComponents(decodedImage->NumberOfComponents);
+  image->SetScalarType(decodedImage->ScalarType);
 
-  std::copy(cameraData->mImageBuffer.begin(), cameraData->mImageBuffer.end(), outPtr);
+  // the image adopts the decoded scalars without a copy, the camera does not
+  // decode into them again while the image holds a reference
+  image->GetPointData()->SetScalars(decodedImage->Scalars);
 
   return image;
 }
@@ -645,37 +1310,32 @@ namespace {
     memcpy(&msg.data[0], image->GetScalarPointer(), msg.size);
   }
 
-  void vtkToCompressedDepthMessage(vtkImageData* image, bot_core::image_t& msg)
+  // Zlib without the predictor is sent as PIXEL_FORMAT_INVALID, which the
+  // existing depth image receivers read as zlib compressed depth, the other
+  // compressions are tagged with their ddDepthCodec pixel format.
+  void vtkToCompressedDepthMessage(vtkImageData* image, bot_core::image_t& msg,
+                                   ddDepthCodec::Compression compression, bool deltaPredictor)
   {
     int width = image->GetDimensions()[0];
     int height = image->GetDimensions()[1];
     int nComponents = image->GetNumberOfScalarComponents();
 
-
-    static std::vector<uint8_t> compressBuffer;
-
-    uLongf sourceSize = width*height*nComponents*2;
-    uLongf bufferSize = compressBound(sourceSize);
-
-    if (compressBuffer.size() < bufferSize)
-    {
-      printf("--->resizing compress buffer to %lu\n", bufferSize);
-      compressBuffer.resize(bufferSize);
-    }
-
-    uLongf compressedSize = compressBuffer.size();
-
-    compress2(&compressBuffer[0], &compressedSize,
-      static_cast<Bytef*>(image->GetScalarPointer()), sourceSize, Z_BEST_SPEED);
+    ddDepthCodec::encode(static_cast<const uint16_t*>(image->GetScalarPointer()),
+      static_cast<size_t>(width)*height*nComponents, compression, deltaPredictor, msg.data);
 
     msg.width = width;
     msg.height = height;
     msg.nmetadata = 0;
     msg.row_stride = 0;
-    msg.pixelformat = bot_core::image_t::PIXEL_FORMAT_INVALID;
-    msg.data.resize(compressedSize);
+    if (compression == ddDepthCodec::ZlibCompression && !deltaPredictor)
+    {
+      msg.pixelformat = bot_core::image_t::PIXEL_FORMAT_INVALID;
+    }
+    else
+    {
+      msg.pixelformat = ddDepthCodec::pixelFormat(compression, deltaPredictor);
+    }
     msg.size = msg.data.size();
-    memcpy(&msg.data[0], &compressBuffer[0], compressedSize);
   }
 
 }
@@ -696,10 +1356,65 @@ void ddBotImageQueue::publishRGBDImagesMessage(const QString& channel,
   msg.images[1].utime = utime;
 
   vtkToRGBImageMessage(colorImage, msg.images[0]);
-  vtkToCompressedDepthMessage(depthImage, msg.images[1]);
+  vtkToCompressedDepthMessage(depthImage, msg.images[1], mDepthCompression, mDepthDeltaPredictor);
   mLCM->lcmHandle()->publish(channel.toLatin1().data(), &msg);
 }
 
+//-----------------------------------------------------------------------------
+bool ddBotImageQueue::setDepthCompression(int compression, bool deltaPredictor)
+{
+  if (compression < ddDepthCodec::ZlibCompression || compression > ddDepthCodec::ZstdCompression
+      || !ddDepthCodec::compressionIsSupported(static_cast<ddDepthCodec::Compression>(compression)))
+  {
+    printf("Error: depth compression %d is not supported\n", compression);
+    return false;
+  }
+
+  mDepthCompression = static_cast<ddDepthCodec::Compression>(compression);
+  mDepthDeltaPredictor = deltaPredictor;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool ddBotImageQueue::depthCompressionIsSupported(int compression)
+{
+  return compression >= ddDepthCodec::ZlibCompression && compression <= ddDepthCodec::ZstdCompression
+    && ddDepthCodec::compressionIsSupported(static_cast<ddDepthCodec::Compression>(compression));
+}
+
+//-----------------------------------------------------------------------------
+QByteArray ddBotImageQueue::compressDepthImage(vtkImageData* depthImage, int compression, bool deltaPredictor)
+{
+  if (!depthImage || depthImage->GetScalarType() != VTK_UNSIGNED_SHORT
+      || !depthCompressionIsSupported(compression))
+  {
+    return QByteArray();
+  }
+
+  std::vector<uint8_t> data;
+  ddDepthCodec::encode(static_cast<const uint16_t*>(depthImage->GetScalarPointer()),
+    static_cast<size_t>(depthImage->GetNumberOfPoints())*depthImage->GetNumberOfScalarComponents(),
+    static_cast<ddDepthCodec::Compression>(compression), deltaPredictor, data);
+  return QByteArray(reinterpret_cast<const char*>(data.data()), static_cast<int>(data.size()));
+}
+
+//-----------------------------------------------------------------------------
+bool ddBotImageQueue::decompressDepthImage(const QByteArray& data, int compression, bool deltaPredictor, vtkImageData* depthImage)
+{
+  if (!depthImage || depthImage->GetScalarType() != VTK_UNSIGNED_SHORT
+      || !depthCompressionIsSupported(compression))
+  {
+    return false;
+  }
+
+  const bool success = ddDepthCodec::decode(reinterpret_cast<const uint8_t*>(data.constData()), data.size(),
+    static_cast<ddDepthCodec::Compression>(compression), deltaPredictor,
+    static_cast<uint16_t*>(depthImage->GetScalarPointer()),
+    static_cast<size_t>(depthImage->GetNumberOfPoints())*depthImage->GetNumberOfScalarComponents());
+  depthImage->Modified();
+  return success;
+}
+
 //-----------------------------------------------------------------------------
 void ddBotImageQueue::publishRGBImageMessage(const QString& channel, vtkImageData* image, qint64 utime)
 {
@@ -712,13 +1427,19 @@ void ddBotImageQueue::publishRGBImageMessage(const QString& channel, vtkImageDat
 //-----------------------------------------------------------------------------
 void ddBotImageQueue::getPointCloudFromImages(const QString& channel, vtkPolyData* polyData, int decimation, int removeSize, float rangeThreshold)
 {
-  if (!this->mImagesMessageMap.contains(channel))
+  QSharedPointer<bot_core::images_t> msgPtr;
+  {
+    QMutexLocker locker(&this->mChannelMutex);
+    msgPtr = this->mImagesMessageMap.value(channel);
+  }
+
+  if (!msgPtr)
   {
     printf("no images received on channel: %s\n", qPrintable(channel));
     return;
   }
 
-  bot_core::images_t& msg = this->mImagesMessageMap[channel];
+  bot_core::images_t& msg = *msgPtr;
 
   // Read the camera calibration from params (including baseline:
   QString channel_left = channel + QString("_LEFT");
@@ -791,7 +1512,7 @@ int ddBotImageQueue::projectPoints(const QString& cameraName, vtkPolyData* polyD
 }
 
 //-----------------------------------------------------------------------------
-void ddBotImageQueue::colorizePoints(vtkPolyData* polyData, CameraData* cameraData)
+void ddBotImageQueue::colorizePoints(vtkPolyData* polyData, CameraData* cameraData, const DecodedImage* image)
 {
   if (!cameraData->mHasCalibration)
   {
@@ -799,11 +1520,25 @@ void ddBotImageQueue::colorizePoints(vtkPolyData* polyData, CameraData* cameraDa
     return;
   }
 
-  QMutexLocker locker(&cameraData->mMutex);
+  if (!image || !image->Scalars || !image->HasLocalToCamera)
+  {
+    return;
+  }
 
-  size_t w = cameraData->mImageMessage.width;
-  size_t h = cameraData->mImageMessage.height;
-  size_t buf_size = w*h*3;
+  if (image->NumberOfComponents != 3 || image->ScalarType != VTK_UNSIGNED_CHAR)
+  {
+    printf("Error: expected an rgb image for camera %s\n", cameraData->mName.c_str());
+    return;
+  }
+
+  // the camera pose at the time of the image
+  const Eigen::Isometry3d& localToCamera = image->LocalToCamera;
+
+  const uint8_t* imageBuffer = static_cast<const uint8_t*>(image->Scalars->GetVoidPointer(0));
+  size_t w = image->Width;
+  size_t h = image->Height;
+  // the points project to full size pixels
+  const float pixelScale = 1.0f/image->Scale;
 
   bool computeDist = false;
   if (cameraData->mName == "CAMERACHEST_LEFT" || cameraData->mName == "CAMERACHEST_RIGHT")
@@ -811,18 +1546,6 @@ void ddBotImageQueue::colorizePoints(vtkPolyData* polyData, CameraData* cameraDa
     computeDist = true;
   }
 
-  if (!cameraData->mImageBuffer.size())
-  {
-    if (cameraData->mImageMessage.pixelformat != bot_core::image_t::PIXEL_FORMAT_MJPEG)
-    {
-      printf("Error: expected PIXEL_FORMAT_MJPEG for camera %s\n", cameraData->mName.c_str());
-      return;
-    }
-
-    cameraData->mImageBuffer.resize(buf_size);
-    jpeg_decompress_8u_rgb(cameraData->mImageMessage.data.data(), cameraData->mImageMessage.size, cameraData->mImageBuffer.data(), w, h, w*3);
-  }
-
   vtkSmartPointer<vtkUnsignedCharArray> rgb = vtkUnsignedCharArray::SafeDownCast(polyData->GetPointData()->GetArray("rgb"));
   if (!rgb)
   {
@@ -838,39 +1561,46 @@ void ddBotImageQueue::colorizePoints(vtkPolyData* polyData, CameraData* cameraDa
   }
 
   const vtkIdType nPoints = polyData->GetNumberOfPoints();
-  for (vtkIdType i = 0; i < nPoints; ++i)
+  if (!nPoints)
   {
-    Eigen::Vector3d ptLocal;
-    polyData->GetPoint(i, ptLocal.data());
-    Eigen::Vector3d pt = cameraData->mLocalToCamera * ptLocal;
+    return;
+  }
 
-    double in[] = {pt[0], pt[1], pt[2]};
-    double pix[3];
-    if (bot_camtrans_project_point(cameraData->mCamTrans, in, pix) == 0)
+  std::vector<float> pixels(2*nPoints);
+  this->projectPoints(cameraData, polyData->GetPoints(), localToCamera, pixels.data());
+
+  unsigned char* rgbPtr = rgb->GetPointer(0);
+  ddCameraProjection::parallelFor(nPoints, [&](size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
     {
+      const float pix[2] = {pixels[2*i]*pixelScale, pixels[2*i + 1]*pixelScale};
+      if (std::isnan(pix[0]) || std::isnan(pix[1]) || pix[0] <= -1.0f || pix[1] <= -1.0f || pix[0] >= w || pix[1] >= h)
+      {
+        continue;
+      }
+
+      // truncates toward zero like the per point projection did
       int px = static_cast<int>(pix[0]);
       int py = static_cast<int>(pix[1]);
 
-      if (px >= 0 && px < w && py >= 0 && py < h)
+      if (computeDist)
       {
-
-        if (computeDist)
+        float u = pix[0] / (w-1);
+        float v = pix[1] / (h-1);
+        if  ( ((0.5 - u)*(0.5 - u) + (0.5 - v)*(0.5 -v)) > 0.2 )
         {
-          float u = pix[0] / (w-1);
-          float v = pix[1] / (h-1);
-          if  ( ((0.5 - u)*(0.5 - u) + (0.5 - v)*(0.5 -v)) > 0.2 )
-          {
-            continue;
-          }
+          continue;
         }
-
-        size_t bufIndex = w*py*3 + px*3;
-        rgb->SetComponent(i, 0, cameraData->mImageBuffer[bufIndex + 0]);
-        rgb->SetComponent(i, 1, cameraData->mImageBuffer[bufIndex + 1]);
-        rgb->SetComponent(i, 2, cameraData->mImageBuffer[bufIndex + 2]);
       }
+
+      const unsigned char* color = imageBuffer + w*py*3 + px*3;
+      unsigned char* outColor = rgbPtr + 3*i;
+      outColor[0] = color[0];
+      outColor[1] = color[1];
+      outColor[2] = color[2];
     }
-  }
+  });
 }
 
 //-----------------------------------------------------------------------------
@@ -918,7 +1648,7 @@ QList<double> ddBotImageQueue::getCameraFrustumBounds(CameraData* cameraData)
 }
 
 //-----------------------------------------------------------------------------
-void ddBotImageQueue::computeTextureCoords(vtkPolyData* polyData, CameraData* cameraData)
+void ddBotImageQueue::computeTextureCoords(vtkPolyData* polyData, CameraData* cameraData, const DecodedImage* image)
 {
   if (!cameraData->mHasCalibration)
   {
@@ -926,10 +1656,21 @@ void ddBotImageQueue::computeTextureCoords(vtkPolyData* polyData, CameraData* ca
     return;
   }
 
-  QMutexLocker locker(&cameraData->mMutex);
-
-  size_t w = cameraData->mImageMessage.width;
-  size_t h = cameraData->mImageMessage.height;
+  size_t w = 0;
+  size_t h = 0;
+  float pixelScale = 1.0f;
+  if (image)
+  {
+    w = image->Width;
+    h = image->Height;
+    pixelScale = 1.0f/image->Scale;
+  }
+  else
+  {
+    QMutexLocker locker(&cameraData->mMutex);
+    w = cameraData->mImageMessage.width;
+    h = cameraData->mImageMessage.height;
+  }
 
   bool computeDist = false;
   if (cameraData->mName == "CAMERACHEST_LEFT" || cameraData->mName == "CAMERACHEST_RIGHT")
@@ -952,30 +1693,28 @@ void ddBotImageQueue::computeTextureCoords(vtkPolyData* polyData, CameraData* ca
   }
 
   const vtkIdType nPoints = polyData->GetNumberOfPoints();
-  for (vtkIdType i = 0; i < nPoints; ++i)
+  if (!nPoints)
   {
-    Eigen::Vector3d ptLocal;
-    polyData->GetPoint(i, ptLocal.data());
-    //Eigen::Vector3d pt = cameraData->mLocalToCamera * ptLocal;
-    //Eigen::Vector3d pt = cameraData->mBodyToCamera * ptLocal;
-    Eigen::Vector3d pt = ptLocal;
+    return;
+  }
 
-    double in[] = {pt[0], pt[1], pt[2]};
-    double pix[3];
-    if (bot_camtrans_project_point(cameraData->mCamTrans, in, pix) == 0)
+  // the points are already in the camera frame
+  std::vector<float> pixels(2*nPoints);
+  this->projectPoints(cameraData, polyData->GetPoints(), Eigen::Isometry3d::Identity(), pixels.data());
+
+  float* tcoordsPtr = tcoords->GetPointer(0);
+  ddCameraProjection::parallelFor(nPoints, [&](size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
     {
-      float u = pix[0] / (w-1);
-      float v = pix[1] / (h-1);
+      const float* pix = &pixels[2*i];
+      if (std::isnan(pix[0]) || std::isnan(pix[1]))
+      {
+        continue;
+      }
 
-      //if (u >= 0 && u <= 1.0 && v >= 0 && v <= 1.0)
-      //{
-        //if (computeDist &&  ((0.5 - u)*(0.5 - u) + (0.5 - v)*(0.5 -v)) > 0.14)
-        //{
-        //  continue;
-        //}
-        tcoords->SetComponent(i, 0, u);
-        tcoords->SetComponent(i, 1, v);
-      //}
+      tcoordsPtr[2*i] = pix[0]*pixelScale / (w-1);
+      tcoordsPtr[2*i + 1] = pix[1]*pixelScale / (h-1);
     }
-  }
+  });
 }
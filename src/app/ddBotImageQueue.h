@@ -2,15 +2,23 @@
 #define __ddBotImageQueue_h
 
 #include <QObject>
+#include <QSharedPointer>
 #include <ddMacros.h>
 
 #include "ddLCMThread.h"
+#include "ddCameraProjection.h"
+#include "ddDepthCodec.h"
+#include "ddFrameTransformCache.h"
 #include "ddLCMSubscriber.h"
 #include "ddAppConfigure.h"
 
 
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include <Eigen/Geometry>
 #include <lcm/lcm-cpp.hpp>
@@ -33,6 +41,7 @@
 #include <vtkImageData.h>
 #include <vtkPolyData.h>
 #include <vtkPointData.h>
+#include <vtkDataArray.h>
 #include <vtkUnsignedCharArray.h>
 #include <vtkFloatArray.h>
 #include <vtkTransform.h>
@@ -44,6 +53,31 @@ class DD_APP_EXPORT ddBotImageQueue : public QObject
 
 public:
 
+  // A decoded camera image and the camera pose at its time.  The scalars
+  // are adopted by the vtkImageData returned from getImage(), so they are
+  // reference counted.
+  struct DecodedImage
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    vtkSmartPointer<vtkDataArray> Scalars;
+    int Width;
+    int Height;
+    int NumberOfComponents;
+    int ScalarType;
+    // the image is 1/Scale of the camera image size, camera pixel
+    // coordinates are divided by Scale to index it
+    int Scale;
+    int64_t Utime;
+    bool HasLocalToCamera;
+    Eigen::Isometry3d LocalToCamera;
+
+    size_t memorySize() const
+    {
+      return Scalars ? Scalars->GetNumberOfTuples()*Scalars->GetNumberOfComponents()*Scalars->GetDataTypeSize() : 0;
+    }
+  };
+
   class CameraData
   {
     public:
@@ -53,16 +87,46 @@ public:
     std::string mName;
     std::string mCoordFrame;
     BotCamTrans* mCamTrans;
+    // the last image message, without its data
     bot_core::image_t mImageMessage;
     Eigen::Isometry3d mLocalToCamera;
     Eigen::Isometry3d mBodyToCamera;
-    std::vector<uint8_t> mImageBuffer;
+
+    // Images are decoded by the message handler, which runs on the lcm
+    // worker pool, into the back image, which is then added to the image
+    // history.  The history is sorted by utime and its oldest images are
+    // removed when it exceeds the memory budget, the last one removed
+    // becomes the back image.  Readers take a reference to an image in the
+    // history and use it without holding the lock.
+    std::deque<std::shared_ptr<const DecodedImage> > mImageHistory;
+    size_t mImageHistorySize;
+    std::shared_ptr<DecodedImage> mBackImage;
     QMutex mMutex;
 
+    // Jpeg images are decoded at 1/mDecodeScale of their size.  Scaled
+    // copies of the latest image, 1/1, 1/2, 1/4 and 1/8, are made on request
+    // and cached in mPyramid until a newer image arrives.  Once a scaled image
+    // has been requested the jpeg of the latest image is kept, so the scaled
+    // copies are decoded from it instead of from the full image.
+    std::atomic<int> mDecodeScale;
+    std::atomic<bool> mHasImagePyramid;
+    std::shared_ptr<const DecodedImage> mPyramid[4];
+    std::shared_ptr<const std::vector<uint8_t> > mCompressedImage;
+    int64_t mCompressedImageUtime;
+
+    // Batch projection with the camera's intrinsics, null if the camera's
+    // distortion model is not supported by ddCameraProjection.
+    std::unique_ptr<ddCameraProjection> mProjection;
+
     CameraData()
     {
+      mCamTrans = 0;
       mHasCalibration = false;
       mZlibCompression = false;
+      mImageHistorySize = 0;
+      mDecodeScale = 1;
+      mHasImagePyramid = false;
+      mCompressedImageUtime = 0;
       mImageMessage.width = 0;
       mImageMessage.height = 0;
       mImageMessage.utime = 0;
@@ -92,9 +156,46 @@ public:
 
   void init(ddLCMThread* lcmThread, const QString& botConfigFile);
 
+  // Sets the image to the latest decoded image of the camera.  The image
+  // shares its scalars with the camera without a copy and must be treated as
+  // read only; the camera decodes new images into other buffers while the
+  // image holds them.  Returns the utime of the image, or 0 if the camera
+  // has no decoded image.
   qint64 getImage(const QString& cameraName, vtkImageData* image);
+
+  // Returns the utime of the latest image message, which may differ from the
+  // utime returned by getImage() if the message could not be decoded.
   qint64 getCurrentImageTime(const QString& cameraName);
 
+  // Sets the image to the image in the camera's history that is nearest to
+  // utime and returns its utime, or 0 if the camera has no images.  Without
+  // an image history budget the history only holds the latest image.
+  qint64 getImage(const QString& cameraName, qint64 utime, vtkImageData* image);
+
+  // Sets the memory each camera may use for past images, in bytes.  The
+  // latest image is always kept.  The default is 0, which keeps only the
+  // latest image; callers that look up images by utime opt in with a budget.
+  void setImageHistoryMemoryBudget(qint64 bytes);
+  qint64 getImageHistoryMemoryBudget() const;
+
+  // Returns the number of images in the camera's history.
+  int getImageHistoryLength(const QString& cameraName);
+
+  // Sets the camera's jpeg images to be decoded at 1/scale of their size,
+  // scale is 1, 2, 4 or 8.  libjpeg scales while decoding, which is much
+  // faster than a full size decode.  getImage() then returns scaled images,
+  // and pixel coordinates of the camera model are divided by scale to index
+  // them.  Other pixel formats are always decoded at full size.
+  void setImageDecodeScale(const QString& cameraName, int scale);
+  int getImageDecodeScale(const QString& cameraName);
+
+  // Sets the image to the latest image of the camera at 1/scale of its size,
+  // scale is 1, 2, 4 or 8, and returns its utime.  Scaled images are cached
+  // until the next image arrives.  Jpeg images are decoded again at the
+  // requested scale, other images are downsampled.  Like getImage() the
+  // image must be treated as read only.
+  qint64 getScaledImage(const QString& cameraName, int scale, vtkImageData* image);
+
   // Returns four xyz vectors as a 12 element list.  The vectors are rays
   // representing the top left, top right, bottom right, and bottom left
   // edges of the camera frustum.
@@ -104,9 +205,34 @@ public:
 
   void colorizePoints(const QString& cameraName, vtkPolyData* polyData);
 
+  // Colors the points from the image nearest to utime, using the camera
+  // pose at the time of that image.
+  void colorizePoints(const QString& cameraName, vtkPolyData* polyData, qint64 utime);
+
   void computeTextureCoords(const QString& cameraName, vtkPolyData* polyData);
+  void computeTextureCoords(const QString& cameraName, vtkPolyData* polyData, qint64 utime);
 
   void publishRGBDImagesMessage(const QString& channel, vtkImageData* colorImage, vtkImageData* depthImage, qint64 utime);
+
+  // Sets the compression of depth images published by
+  // publishRGBDImagesMessage: 0 zlib (the default), 1 lz4 or 2 zstd, see
+  // ddDepthCodec.  Receivers decode depth images by their pixel format, but
+  // only director decodes lz4, zstd and the delta predictor; zlib without
+  // the predictor is readable by every depth image receiver.  Returns false
+  // if the compression is not supported by this build.
+  bool setDepthCompression(int compression, bool deltaPredictor);
+  static bool depthCompressionIsSupported(int compression);
+
+  // Compresses a 16 bit depth image the way publishRGBDImagesMessage does.
+  // Returns an empty array if the image is not 16 bit or the compression is
+  // not supported.
+  static QByteArray compressDepthImage(vtkImageData* depthImage, int compression, bool deltaPredictor);
+
+  // Decompresses data from compressDepthImage into depthImage, which must be
+  // allocated as a 16 bit image of the original dimensions.  Returns false if
+  // the data is corrupt or does not match the image size.
+  static bool decompressDepthImage(const QByteArray& data, int compression, bool deltaPredictor, vtkImageData* depthImage);
+
   void publishRGBImageMessage(const QString& channel, vtkImageData* image, qint64 utime);
 
   // Computes a point cloud with rgb and copies it into the given polyData.
@@ -129,8 +255,14 @@ public:
   void getCameraProjectionTransform(const QString& cameraName, vtkTransform* transform);
 
   int getTransform(const QString& fromFrame, const QString& toFrame, qint64 utime, vtkTransform* transform);
+
+  // Gets the latest transform, or during in process log replay the
+  // transform at the log time returned by getCurrentUtime().
   int getTransform(const QString& fromFrame, const QString& toFrame, vtkTransform* transform);
 
+  // Returns the system time, or the log time during in process log replay.
+  qint64 getCurrentUtime() const;
+
   QStringList getBotFrameNames() const;
   QStringList getCameraNames() const;
   
@@ -146,27 +278,52 @@ protected:
 
   CameraData* getCameraData(const QString& cameraName);
   bool initCameraData(const QString& cameraName, CameraData* cameraData);
+  void initCameraProjection(const QString& cameraName, CameraData* cameraData);
+
+  // Projects the points, transformed by the given transform, to pixels,
+  // written as xy pairs.  Points that do not project are written as NaN.
+  void projectPoints(CameraData* cameraData, vtkPoints* points, const Eigen::Isometry3d& transform, float* pixels);
 
-  vtkSmartPointer<vtkImageData> toVtkImage(CameraData* cameraData);
+  vtkSmartPointer<vtkImageData> toVtkImage(const DecodedImage* decodedImage);
 
-  void colorizePoints(vtkPolyData* polyData, CameraData* cameraData);
+  // Decodes the image message and makes it the front image of the camera.
+  void setImageMessage(CameraData* cameraData, const bot_core::image_t& message);
 
-  void computeTextureCoords(vtkPolyData* polyData, CameraData* cameraData);
+  // Returns the latest image, or the image nearest to utime.
+  std::shared_ptr<const DecodedImage> getDecodedImage(CameraData* cameraData);
+  std::shared_ptr<const DecodedImage> getDecodedImage(CameraData* cameraData, qint64 utime);
+
+  // Returns the latest image at the scale of the pyramid level.
+  std::shared_ptr<const DecodedImage> getPyramidImage(CameraData* cameraData, int level);
+
+  void colorizePoints(vtkPolyData* polyData, CameraData* cameraData, const DecodedImage* image);
+
+  void computeTextureCoords(vtkPolyData* polyData, CameraData* cameraData, const DecodedImage* image);
 
   QList<double> getCameraFrustumBounds(CameraData* cameraData);
 
+  // Gets the transform from the frame cache, utime < 0 for the latest.
   int getTransform(std::string from_frame, std::string to_frame,
                      Eigen::Isometry3d& mat, qint64 utime);
 
   BotParam* mBotParam;
   BotFrames* mBotFrames;
+  ddFrameTransformCache* mFrameCache;
 
   ddLCMThread* mLCM;
+  // guards mChannelMap, mImagesMessageMap and mCameraData, which are read by
+  // the message handlers on the worker pool
+  QMutex mChannelMutex;
   QMap<QString, QMap<int, QString> > mChannelMap;
-  QMap<QString, bot_core::images_t> mImagesMessageMap;
+  QMap<QString, QSharedPointer<bot_core::images_t> > mImagesMessageMap;
   QMap<QString, ddLCMSubscriber*> mSubscribers;
   QMap<QString, CameraData*> mCameraData;
 
+  std::atomic<qint64> mImageHistoryMemoryBudget;
+
+  ddDepthCodec::Compression mDepthCompression;
+  bool mDepthDeltaPredictor;
+
   lcm::LogFile* logFile;
 };
 
@@ -0,0 +1,228 @@
+#include "ddCameraProjection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+// Points are projected in blocks of this many, small enough for the
+// structure of arrays buffers to stay in the L1 cache.
+const size_t BlockSize = 256;
+
+// Chunks smaller than this are not worth a thread.
+const size_t MinimumChunkSize = 32768;
+
+//-----------------------------------------------------------------------------
+struct ProjectionParameters
+{
+  float fx, fy, skew, cx, cy;
+  float k1, k2, k3, p1, p2;
+};
+
+//-----------------------------------------------------------------------------
+inline void ProjectScalar(const ProjectionParameters& p, bool distort, float x, float y, float z, float* pixel)
+{
+  if (!(z > 0.0f))
+  {
+    pixel[0] = pixel[1] = std::numeric_limits<float>::quiet_NaN();
+    return;
+  }
+
+  const float invZ = 1.0f / z;
+  float u = x * invZ;
+  float v = y * invZ;
+
+  if (distort)
+  {
+    const float r2 = u*u + v*v;
+    const float radial = 1.0f + r2*(p.k1 + r2*(p.k2 + r2*p.k3));
+    const float uv = u*v;
+    const float du = u*radial + 2.0f*p.p1*uv + p.p2*(r2 + 2.0f*u*u);
+    const float dv = v*radial + p.p1*(r2 + 2.0f*v*v) + 2.0f*p.p2*uv;
+    u = du;
+    v = dv;
+  }
+
+  pixel[0] = p.fx*u + p.skew*v + p.cx;
+  pixel[1] = p.fy*v + p.cy;
+}
+
+#ifdef __SSE2__
+//-----------------------------------------------------------------------------
+// Projects four points of the structure of arrays buffers.
+inline void ProjectSSE(const ProjectionParameters& p, bool distort, const float* x, const float* y, const float* z, float* pixels)
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 nan = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+
+  const __m128 vz = _mm_loadu_ps(z);
+  const __m128 inFront = _mm_cmpgt_ps(vz, zero);
+  const __m128 invZ = _mm_div_ps(one, vz);
+  __m128 u = _mm_mul_ps(_mm_loadu_ps(x), invZ);
+  __m128 v = _mm_mul_ps(_mm_loadu_ps(y), invZ);
+
+  if (distort)
+  {
+    const __m128 r2 = _mm_add_ps(_mm_mul_ps(u, u), _mm_mul_ps(v, v));
+    __m128 radial = _mm_add_ps(_mm_set1_ps(p.k2), _mm_mul_ps(r2, _mm_set1_ps(p.k3)));
+    radial = _mm_add_ps(_mm_set1_ps(p.k1), _mm_mul_ps(r2, radial));
+    radial = _mm_add_ps(one, _mm_mul_ps(r2, radial));
+
+    const __m128 p1 = _mm_set1_ps(p.p1);
+    const __m128 p2 = _mm_set1_ps(p.p2);
+    const __m128 uv2 = _mm_mul_ps(two, _mm_mul_ps(u, v));
+    const __m128 du = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, radial), _mm_mul_ps(p1, uv2)),
+      _mm_mul_ps(p2, _mm_add_ps(r2, _mm_mul_ps(two, _mm_mul_ps(u, u)))));
+    const __m128 dv = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v, radial), _mm_mul_ps(p2, uv2)),
+      _mm_mul_ps(p1, _mm_add_ps(r2, _mm_mul_ps(two, _mm_mul_ps(v, v)))));
+    u = du;
+    v = dv;
+  }
+
+  __m128 px = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.fx), u), _mm_mul_ps(_mm_set1_ps(p.skew), v)), _mm_set1_ps(p.cx));
+  __m128 py = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.fy), v), _mm_set1_ps(p.cy));
+
+  px = _mm_or_ps(_mm_and_ps(inFront, px), _mm_andnot_ps(inFront, nan));
+  py = _mm_or_ps(_mm_and_ps(inFront, py), _mm_andnot_ps(inFront, nan));
+
+  // interleave to xy pairs
+  _mm_storeu_ps(pixels, _mm_unpacklo_ps(px, py));
+  _mm_storeu_ps(pixels + 4, _mm_unpackhi_ps(px, py));
+}
+#endif
+
+}
+
+//-----------------------------------------------------------------------------
+ddCameraProjection::ddCameraProjection()
+{
+  Intrinsics intrinsics = {1.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  this->setIntrinsics(intrinsics);
+
+  const double identity[12] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0};
+  this->setTransform(identity);
+}
+
+//-----------------------------------------------------------------------------
+void ddCameraProjection::setIntrinsics(const Intrinsics& intrinsics)
+{
+  mIntrinsics = intrinsics;
+  mHasDistortion = intrinsics.K1 != 0.0 || intrinsics.K2 != 0.0 || intrinsics.K3 != 0.0
+    || intrinsics.P1 != 0.0 || intrinsics.P2 != 0.0;
+}
+
+//-----------------------------------------------------------------------------
+void ddCameraProjection::setTransform(const double matrix[12])
+{
+  std::copy(matrix, matrix + 12, mTransform);
+}
+
+//-----------------------------------------------------------------------------
+bool ddCameraProjection::projectPoint(const double point[3], double pixel[2]) const
+{
+  float in[3] = {static_cast<float>(point[0]), static_cast<float>(point[1]), static_cast<float>(point[2])};
+  float out[2];
+  this->projectRange(in, 0, 1, out);
+  pixel[0] = out[0];
+  pixel[1] = out[1];
+  return !std::isnan(out[0]);
+}
+
+//-----------------------------------------------------------------------------
+template <class T>
+void ddCameraProjection::projectRange(const T* points, size_t begin, size_t end, float* pixels) const
+{
+  const Intrinsics& in = mIntrinsics;
+  const ProjectionParameters p = {
+    float(in.FocalLengthX), float(in.FocalLengthY), float(in.Skew), float(in.PrincipalX), float(in.PrincipalY),
+    float(in.K1), float(in.K2), float(in.K3), float(in.P1), float(in.P2)};
+  const float* m = mTransform;
+
+  float x[BlockSize];
+  float y[BlockSize];
+  float z[BlockSize];
+
+  for (size_t blockStart = begin; blockStart < end; blockStart += BlockSize)
+  {
+    const size_t blockSize = std::min(BlockSize, end - blockStart);
+    const T* point = points + 3*blockStart;
+
+    // transform into the structure of arrays block
+    for (size_t i = 0; i < blockSize; ++i, point += 3)
+    {
+      const float px = static_cast<float>(point[0]);
+      const float py = static_cast<float>(point[1]);
+      const float pz = static_cast<float>(point[2]);
+      x[i] = m[0]*px + m[1]*py + m[2]*pz + m[3];
+      y[i] = m[4]*px + m[5]*py + m[6]*pz + m[7];
+      z[i] = m[8]*px + m[9]*py + m[10]*pz + m[11];
+    }
+
+    float* out = pixels + 2*blockStart;
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= blockSize; i += 4)
+    {
+      ProjectSSE(p, mHasDistortion, x + i, y + i, z + i, out + 2*i);
+    }
+#endif
+    for (; i < blockSize; ++i)
+    {
+      ProjectScalar(p, mHasDistortion, x[i], y[i], z[i], out + 2*i);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ddCameraProjection::projectPoints(const float* points, size_t numberOfPoints, float* pixels) const
+{
+  parallelFor(numberOfPoints, [&](size_t begin, size_t end)
+  {
+    this->projectRange(points, begin, end, pixels);
+  });
+}
+
+//-----------------------------------------------------------------------------
+void ddCameraProjection::projectPoints(const double* points, size_t numberOfPoints, float* pixels) const
+{
+  parallelFor(numberOfPoints, [&](size_t begin, size_t end)
+  {
+    this->projectRange(points, begin, end, pixels);
+  });
+}
+
+//-----------------------------------------------------------------------------
+void ddCameraProjection::parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& function)
+{
+  const size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+  const size_t numberOfChunks = std::max(size_t(1), std::min(hardwareThreads, count / MinimumChunkSize));
+  if (numberOfChunks == 1)
+  {
+    function(0, count);
+    return;
+  }
+
+  const size_t chunkSize = (count + numberOfChunks - 1) / numberOfChunks;
+  std::vector<std::thread> threads;
+  for (size_t begin = chunkSize; begin < count; begin += chunkSize)
+  {
+    threads.push_back(std::thread(function, begin, std::min(count, begin + chunkSize)));
+  }
+
+  function(0, std::min(count, chunkSize));
+
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].join();
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef __ddCameraProjection_h
+#define __ddCameraProjection_h
+
+#include "ddAppConfigure.h"
+
+#include <cstddef>
+#include <functional>
+
+
+// Projects batches of points to camera pixels with the pinhole model and
+// plumb bob (Brown-Conrady) lens distortion.
+//
+// Points are transformed and copied into small structure of arrays float
+// blocks, which are projected four at a time with SSE when it is available.
+// Large batches are split into chunks that are projected on several threads.
+// The results are written directly to the caller's buffer, so projecting a
+// point costs no virtual calls and no per point allocation.
+
+class DD_APP_EXPORT ddCameraProjection
+{
+public:
+
+  struct Intrinsics
+  {
+    double FocalLengthX;
+    double FocalLengthY;
+    double Skew;
+    double PrincipalX;
+    double PrincipalY;
+
+    // plumb bob distortion, all zero for an undistorted camera
+    double K1;
+    double K2;
+    double K3;
+    double P1;
+    double P2;
+  };
+
+  ddCameraProjection();
+
+  void setIntrinsics(const Intrinsics& intrinsics);
+  const Intrinsics& intrinsics() const
+  {
+    return mIntrinsics;
+  }
+
+  // Sets the transform applied to points before they are projected, a row
+  // major 3x4 matrix.  The default is the identity.
+  void setTransform(const double matrix[12]);
+
+  // Projects numberOfPoints xyz triples and writes a pixel xy pair per point
+  // to pixels.  Points that are not in front of the camera are given NaN
+  // pixel coordinates.
+  void projectPoints(const float* points, size_t numberOfPoints, float* pixels) const;
+  void projectPoints(const double* points, size_t numberOfPoints, float* pixels) const;
+
+  // Projects a single point, for comparison with other camera models.
+  // Returns false if the point is not in front of the camera.
+  bool projectPoint(const double point[3], double pixel[2]) const;
+
+  // Calls function(begin, end) for ranges that cover [0, count), on several
+  // threads if count is large.
+  static void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& function);
+
+private:
+
+  template <class T>
+  void projectRange(const T* points, size_t begin, size_t end, float* pixels) const;
+
+  Intrinsics mIntrinsics;
+  bool mHasDistortion;
+  float mTransform[12];
+};
+
+#endif
@@ -51,6 +51,14 @@ public:
     updateAverage();
   }
 
+  // Counts the given number of units, for example bytes, so averageFPS()
+  // returns units per second.
+  void update(size_t count)
+  {
+    mFramesThisWindow += count;
+    updateAverage();
+  }
+
   double averageFPS()
   {
     updateAverage();
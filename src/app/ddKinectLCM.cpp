@@ -1,38 +1,33 @@
 #include "ddKinectLCM.h"
+#include "ddDepthCodec.h"
 
-#include <vtkIdTypeArray.h>
-#include <vtkCellArray.h>
-#include <vtkNew.h>
-
-#include <lcmtypes/kinect/frame_msg_t.hpp>
-#include <lcmtypes/kinect_frame_msg_t.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include <image_utils/jpeg.h>
-#include <pcl/point_cloud.h>
-#include <pcl/point_types.h>
-#include <zlib.h>
 
-//-----------------------------------------------------------------------------
-ddKinectLCM::ddKinectLCM(QObject* parent) : QObject(parent)
-{
-  mPolyData = vtkSmartPointer<vtkPolyData>::New();
-}
+namespace {
 
+// the disparity values of the 11 bit depth format
+const size_t NumberOfDisparities = 2048;
 
-//-----------------------------------------------------------------------------
-void ddKinectLCM::init(ddLCMThread* lcmThread, const QString& botConfigFile)
+//----------------------------------------------------------------------------
+void MultiplyUVD(const float* m, int rows, float u, float v, float d, float* result)
 {
-  
-  mLCM = lcmThread;
-  
-  QString channelName = "KINECT_FRAME";
-  ddLCMSubscriber* subscriber = new ddLCMSubscriber(channelName, this);
-
-  this->connect(subscriber, SIGNAL(messageReceived(const QByteArray&, const QString&)),
-          SLOT(onKinectFrame(const QByteArray&, const QString&)), Qt::DirectConnection);
-
-  mLCM->addSubscriber(subscriber);
+  for (int i = 0; i < rows; ++i)
+  {
+    const float* row = m + i*4;
+    result[i] = row[0]*u + row[1]*v + row[2]*d + row[3];
+  }
+}
 
+//----------------------------------------------------------------------------
+// The calibration used when the config does not give one.
+void SetDefaultCalibration(KinectCalibration* kcal)
+{
   /*
   Originally was this:
   kcal = kinect_calib_new();
@@ -56,7 +51,6 @@ void ddKinectLCM::init(ddLCMThread* lcmThread, const QString& botConfigFile)
 
   // This is in full agreement with Kintinuous: (calibrationAsus.yml)
   // NB: if changing this, it should be kept in sync
-  kcal = kinect_calib_new();
   kcal->intrinsics_depth.fx = 528.01442863461716;//was 576.09757860;
   kcal->intrinsics_depth.cx = 320;
   kcal->intrinsics_depth.cy = 267.0;
@@ -72,274 +66,660 @@ void ddKinectLCM::init(ddLCMThread* lcmThread, const QString& botConfigFile)
   double depth_to_rgb_translation[] ={ -0.015756, -0.000923, 0.002316};
   memcpy(kcal->depth_to_rgb_rot, rotation, 9*sizeof(double));
   memcpy(kcal->depth_to_rgb_translation, depth_to_rgb_translation  , 3*sizeof(double));
+}
 
+}
 
+//-----------------------------------------------------------------------------
+ddKinectLCM::ddKinectLCM(QObject* parent) : QObject(parent)
+{
+  mLCM = 0;
+  mChannel = "KINECT_FRAME";
 
-  // Data buffer
-  rgb_buf_ = (uint8_t*) malloc(10*1024 * 1024 * sizeof(uint8_t)); 
+  mCalibration = kinect_calib_new();
+  SetDefaultCalibration(mCalibration);
+  mDecimation = 1;
+  mCalibrationRevision = 0;
 
+  kcal = kinect_calib_new();
+  *kcal = *mCalibration;
+  decimate_ = mDecimation;
+  mAppliedRevision = mCalibrationRevision;
+
+  mUseRayTable = false;
+  mRGBDistortion = false;
+  mRayTableWidth = 0;
+  mRayTableHeight = 0;
+  mRayTableFormat = -1;
 
-  decimate_ =1.0;
+  for (int i = 0; i < NumberOfFrameBuffers; ++i)
+  {
+    FrameBuffer& frame = mFrames[i];
+    frame.PolyData = vtkSmartPointer<vtkPolyData>::New();
+    frame.Points = vtkSmartPointer<vtkPoints>::New();
+    frame.Points->SetDataTypeToFloat();
+    frame.Colors = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    frame.Colors->SetName("rgb_colors");
+    frame.Colors->SetNumberOfComponents(3);
+    frame.Utime = 0;
+
+    frame.PolyData->SetPoints(frame.Points);
+    frame.PolyData->GetPointData()->AddArray(frame.Colors);
+  }
+
+  mWriteFrame = 0;
+  mLatestFrame = 1;
+  mReadFrame = 2;
+  mHasNewFrame = false;
+  mShouldStop = false;
 }
 
+//-----------------------------------------------------------------------------
+ddKinectLCM::~ddKinectLCM()
+{
+  if (mThread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mPendingMutex);
+      mShouldStop = true;
+    }
+    mPendingCondition.notify_one();
+    mThread.join();
+  }
+
+  kinect_calib_destroy(kcal);
+  kinect_calib_destroy(mCalibration);
+}
+
+
+//-----------------------------------------------------------------------------
+void ddKinectLCM::init(ddLCMThread* lcmThread, const QString& botConfigFile)
+{
+  
+  mLCM = lcmThread;
+  
+  ddLCMSubscriber* subscriber = new ddLCMSubscriber(mChannel, this);
+
+  this->connect(subscriber, SIGNAL(messageReceived(const QByteArray&, const QString&)),
+          SLOT(onKinectFrame(const QByteArray&, const QString&)), Qt::DirectConnection);
+
+  mLCM->addSubscriber(subscriber);
+
+  if (!mThread.joinable())
+  {
+    mThread = std::thread(&ddKinectLCM::threadLoop, this);
+  }
+}
 
 
 //-----------------------------------------------------------------------------
-static inline void
-_matrix_vector_multiply_3x4_4d (const double m[12], const double v[4],
-    double result[3])
+void ddKinectLCM::init(ddLCMThread* lcmThread, const QString& botConfigFile, const QString& sensorName)
 {
-  result[0] = m[0]*v[0] + m[1]*v[1] + m[2] *v[2] + m[3] *v[3];
-  result[1] = m[4]*v[0] + m[5]*v[1] + m[6] *v[2] + m[7] *v[3];
-  result[2] = m[8]*v[0] + m[9]*v[1] + m[10]*v[2] + m[11]*v[3];
+  this->readConfig(lcmThread, botConfigFile, sensorName);
+  this->init(lcmThread, botConfigFile);
 }
 
 
 //-----------------------------------------------------------------------------
-void unpack_kinect_frame(const kinect_frame_msg_t *msg, uint8_t* rgb_data, KinectCalibration* kcal, int decimate_, 
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud){
-
-  /////////////////////////////////////////////////////////////////////
-  /// 1.1 RGB:
-  // TODO check width, height
-  if(msg->image.image_data_format == KINECT_IMAGE_MSG_T_VIDEO_RGB) {
-    memcpy(rgb_data, msg->image.image_data,
-        msg->depth.width * msg->depth.height * 3);
-  } else if(msg->image.image_data_format == KINECT_IMAGE_MSG_T_VIDEO_RGB_JPEG) {
-    jpeg_decompress_8u_rgb (msg->image.image_data, msg->image.image_data_nbytes,
-        rgb_data, msg->image.width, msg->image.height, msg->image.width* 3);
-    //jpegijg_decompress_8u_rgb(msg->image.image_data, msg->image.image_data_nbytes,
-    //        rgb_data, msg->image.width, msg->image.height, msg->image.width* 3);
-  }
-
-  /////////////////////////////////////////////////////////////////////
-  /// 1.2. DEPTH:
-  uint8_t* uncompress_buffer = NULL;
-  int uncompress_buffer_size = 0;
-  const uint8_t* depth_data =NULL; //= msg->depth.depth_data;
-  // 1.2.1 De-compress if necessary:
-  if(msg->depth.compression != KINECT_DEPTH_MSG_T_COMPRESSION_NONE) {
-    //std:: cout << "compression \n ";
-    if(msg->depth.uncompressed_size > uncompress_buffer_size) {
-      uncompress_buffer_size = msg->depth.uncompressed_size;
-      uncompress_buffer = (uint8_t*) realloc(uncompress_buffer, uncompress_buffer_size);
+void ddKinectLCM::readConfig(ddLCMThread* lcmThread, const QString& botConfigFile, const QString& sensorName)
+{
+  BotParam* botParam = 0;
+  if (botConfigFile.length()) {
+    botParam = bot_param_new_from_file(botConfigFile.toAscii().data());
+  } else {
+    while (!botParam) {
+      botParam = bot_param_new_from_server(
+          lcmThread->lcmHandle()->getUnderlyingLCM(), 0);
+    }
+  }
+
+  const QString block = QString("depth_cameras.") + sensorName;
+  if (!botParam || !bot_param_has_key(botParam, block.toAscii().data())) {
+    printf("Could not find %s in the config, using the default calibration\n", block.toAscii().data());
+    if (botParam) {
+      bot_param_destroy(botParam);
     }
-    unsigned long dlen = msg->depth.uncompressed_size;
-    int status = uncompress(uncompress_buffer, &dlen, 
-        msg->depth.depth_data, msg->depth.depth_data_nbytes);
-    if(status != Z_OK) {
-      return;
+    return;
+  }
+
+  const QString prefix = block + QString(".");
+
+  char* channelName = 0;
+  if (bot_param_get_str(botParam, (prefix + "lcm_channel").toAscii().data(), &channelName) == 0) {
+    this->setChannel(channelName);
+    free(channelName);
+  }
+
+  int decimation = 0;
+  if (bot_param_get_int(botParam, (prefix + "decimation").toAscii().data(), &decimation) == 0) {
+    this->setDecimation(decimation);
+  }
+
+  double depthIntrinsics[3];
+  if (bot_param_get_double_array(botParam, (prefix + "depth_intrinsics").toAscii().data(), depthIntrinsics, 3) == 3) {
+    this->setDepthIntrinsics(depthIntrinsics[0], depthIntrinsics[1], depthIntrinsics[2]);
+  }
+
+  double rgbIntrinsics[5];
+  if (bot_param_get_double_array(botParam, (prefix + "rgb_intrinsics").toAscii().data(), rgbIntrinsics, 5) == 5) {
+    this->setRGBIntrinsics(rgbIntrinsics[0], rgbIntrinsics[1], rgbIntrinsics[2], rgbIntrinsics[3], rgbIntrinsics[4]);
+  }
+
+  double value;
+  if (bot_param_get_double(botParam, (prefix + "shift_offset").toAscii().data(), &value) == 0) {
+    this->setShiftOffset(value);
+  }
+  if (bot_param_get_double(botParam, (prefix + "projector_depth_baseline").toAscii().data(), &value) == 0) {
+    this->setProjectorDepthBaseline(value);
+  }
+
+  double rotation[9];
+  double translation[3];
+  if (bot_param_get_double_array(botParam, (prefix + "depth_to_rgb_rotation").toAscii().data(), rotation, 9) == 9
+      && bot_param_get_double_array(botParam, (prefix + "depth_to_rgb_translation").toAscii().data(), translation, 3) == 3) {
+    QList<double> rotationList;
+    QList<double> translationList;
+    for (int i = 0; i < 9; ++i) {
+      rotationList << rotation[i];
     }
-    depth_data =(uint8_t*) uncompress_buffer;
-  }else{
-    depth_data = (uint8_t*) msg->depth.depth_data;
-  }
-
-  int npixels = msg->depth.width * msg->depth.height;
-  if (msg->depth.depth_data_format == KINECT_DEPTH_MSG_T_DEPTH_11BIT){ 
-    /////////////////////////////////////////////////////////////////////
-    // Freenect Data
-    uint16_t* disparity_array = (uint16_t*) malloc(msg->depth.width * msg->depth.height * sizeof(uint16_t)); 
-    if(G_BYTE_ORDER == G_LITTLE_ENDIAN) {
-      int16_t* rdd = (int16_t*) depth_data;
-      int i;
-      for(i=0; i<npixels; i++) {
-        int d = rdd[i];
-        disparity_array[i] = d;
-      }
-    } else {
-      fprintf(stderr, "Big endian systems not supported\n");
+    for (int i = 0; i < 3; ++i) {
+      translationList << translation[i];
     }
+    this->setDepthToRGBTransform(rotationList, translationList);
+  }
 
-    /// 2 Calculate transformation matrices:
-    double depth_to_rgb_uvd[12];
-    double depth_to_depth_xyz[16];
-    kinect_calib_get_depth_uvd_to_rgb_uvw_3x4(kcal, depth_to_rgb_uvd);
-    kinect_calib_get_depth_uvd_to_depth_xyz_4x4(kcal, depth_to_depth_xyz);
-    double depth_to_depth_xyz_trans[16];
-    //_matrix_transpose_4x4d(depth_to_depth_xyz, depth_to_depth_xyz_trans);
-    bot_matrix_transpose_4x4d(depth_to_depth_xyz, depth_to_depth_xyz_trans);
-
-    // 3 for each depth point find the corresponding xyz and then RGB
-    //   then put into PCL structure
-    cloud->width    =(int) (msg->depth.width/ (double) decimate_) ;
-    cloud->height   =(int) (msg->depth.height/ (double) decimate_);
-    cloud->is_dense = false;
-    cloud->points.resize (cloud->width * cloud->height);
-    double xyzw2[4];
-    int j2=0;
-    // NB: the order of these loop was changed... aug 2011. important
-    for(int v=0; v<msg->depth.height; v=v+ decimate_) { // t2b state->height 480
-      for(int u=0; u<msg->depth.width; u=u+decimate_ ) {  //l2r state->width 640
-        // 3.4.1 compute distorted pixel coordinates
-        uint16_t disparity = disparity_array[v*msg->depth.width+u];
-        double uvd_depth[4] = { u, v, disparity, 1 };
-        double uvd_rgb[3];
-        _matrix_vector_multiply_3x4_4d(depth_to_rgb_uvd, uvd_depth, uvd_rgb);
-        double uv_rect[2] = {
-            uvd_rgb[0] / uvd_rgb[2],
-            uvd_rgb[1] / uvd_rgb[2]
-        };
-        double uv_dist[2];
-        kinect_calib_distort_rgb_uv(kcal, uv_rect, uv_dist);
-        int u_rgb = uv_dist[0] + 0.5;
-        int v_rgb = uv_dist[1] + 0.5;
-        uint8_t r, g, b;
-        if(u_rgb >= msg->depth.width || u_rgb < 0 || v_rgb >= msg->depth.height || v_rgb < 0) {
-          r = g = b = 0;
-        } else {
-          r = rgb_data[v_rgb*msg->depth.width*3 + u_rgb*3 + 0];
-          g = rgb_data[v_rgb*msg->depth.width*3 + u_rgb*3 + 1];
-          b = rgb_data[v_rgb*msg->depth.width*3 + u_rgb*3 + 2];
-        }
-        // 3.4.2 find the xyz location of the points:
-        bot_matrix_multiply(depth_to_depth_xyz, 4, 4,
-            uvd_depth, 4, 1, xyzw2);
-
-        cloud->points[j2].x = xyzw2[0]/xyzw2[3]; //x right+
-        cloud->points[j2].y = xyzw2[1]/xyzw2[3]; //y down+
-        cloud->points[j2].z = xyzw2[2]/xyzw2[3]; //z forward+
-
-        cloud->points[j2].b =b;
-        cloud->points[j2].r =r;
-        cloud->points[j2].g =g;
-        j2++;
+  bot_param_destroy(botParam);
+}
+
+
+//-----------------------------------------------------------------------------
+void ddKinectLCM::setChannel(const QString& channelName)
+{
+  mChannel = channelName;
+}
+
+
+//-----------------------------------------------------------------------------
+QString ddKinectLCM::getChannel() const
+{
+  return mChannel;
+}
+
+
+//-----------------------------------------------------------------------------
+void ddKinectLCM::setDecimation(int decimation)
+{
+  std::lock_guard<std::mutex> lock(mCalibrationMutex);
+  mDecimation = std::max(decimation, 1);
+  ++mCalibrationRevision;
+}
+
+
+//-----------------------------------------------------------------------------
+int ddKinectLCM::getDecimation() const
+{
+  std::lock_guard<std::mutex> lock(mCalibrationMutex);
+  return mDecimation;
+}
+
+
+//-----------------------------------------------------------------------------
+void ddKinectLCM::setDepthIntrinsics(double fx, double cx, double cy)
+{
+  std::lock_guard<std::mutex> lock(mCalibrationMutex);
+  mCalibration->intrinsics_depth.fx = fx;
+  mCalibration->intrinsics_depth.cx = cx;
+  mCalibration->intrinsics_depth.cy = cy;
+  ++mCalibrationRevision;
+}
+
+
+//-----------------------------------------------------------------------------
+void ddKinectLCM::setRGBIntrinsics(double fx, double cx, double cy, double k1, double k2)
+{
+  std::lock_guard<std::mutex> lock(mCalibrationMutex);
+  mCalibration->intrinsics_rgb.fx = fx;
+  mCalibration->intrinsics_rgb.cx = cx;
+  mCalibration->intrinsics_rgb.cy = cy;
+  mCalibration->intrinsics_rgb.k1 = k1;
+  mCalibration->intrinsics_rgb.k2 = k2;
+  ++mCalibrationRevision;
+}
+
+
+//-----------------------------------------------------------------------------
+void ddKinectLCM::setShiftOffset(double shiftOffset)
+{
+  std::lock_guard<std::mutex> lock(mCalibrationMutex);
+  mCalibration->shift_offset = shiftOffset;
+  ++mCalibrationRevision;
+}
+
+
+//-----------------------------------------------------------------------------
+void ddKinectLCM::setProjectorDepthBaseline(double baseline)
+{
+  std::lock_guard<std::mutex> lock(mCalibrationMutex);
+  mCalibration->projector_depth_baseline = baseline;
+  ++mCalibrationRevision;
+}
+
+
+//-----------------------------------------------------------------------------
+void ddKinectLCM::setDepthToRGBTransform(const QList<double>& rotation, const QList<double>& translation)
+{
+  if (rotation.size() != 9 || translation.size() != 3)
+  {
+    printf("ddKinectLCM: the depth to rgb transform needs 9 rotation and 3 translation values\n");
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mCalibrationMutex);
+  for (int i = 0; i < 9; ++i)
+  {
+    mCalibration->depth_to_rgb_rot[i] = rotation[i];
+  }
+  for (int i = 0; i < 3; ++i)
+  {
+    mCalibration->depth_to_rgb_translation[i] = translation[i];
+  }
+  ++mCalibrationRevision;
+}
+
+
+//-----------------------------------------------------------------------------
+void ddKinectLCM::updateRayTable(int width, int height, int depthFormat)
+{
+  if (width == mRayTableWidth && height == mRayTableHeight && depthFormat == mRayTableFormat)
+  {
+    return;
+  }
+
+  mRayTableWidth = width;
+  mRayTableHeight = height;
+  mRayTableFormat = depthFormat;
+  mRays.resize(size_t(width)*height*2);
+  mRowDepths.resize(width);
+  mRowPixels.resize(width);
+
+  if (depthFormat == kinect::depth_msg_t::DEPTH_MM)
+  {
+    const double constant = 1.0 / kcal->intrinsics_rgb.fx;
+    float* ray = mRays.data();
+    for (int v = 0; v < height; ++v)
+    {
+      for (int u = 0; u < width; ++u, ray += 2)
+      {
+        ray[0] = (u - kcal->intrinsics_depth.cx)*constant; //x right+
+        ray[1] = (v - kcal->intrinsics_depth.cy)*constant; //y down+
       }
     }
-    free(disparity_array);
-
-  }else if(msg->depth.depth_data_format == KINECT_DEPTH_MSG_T_DEPTH_MM  ){ 
-    /////////////////////////////////////////////////////////////////////
-    // Openni Data
-    // 1.2.2 unpack raw byte data into float values in mm
-
-    // NB: no depth return is given 0 range - and becomes 0,0,0 here
-    const uint16_t* val = reinterpret_cast<const uint16_t*>( depth_data );
-
-    cloud->width    =(int) (msg->depth.width/ (double) decimate_) ;
-    cloud->height   =(int) (msg->depth.height/ (double) decimate_); 
-    cloud->is_dense = false;
-    cloud->points.resize (cloud->width * cloud->height);
-    int j2=0;
-    for(int v=0; v<msg->depth.height; v=v+ decimate_) { // t2b self->height 480
-      for(int u=0; u<msg->depth.width; u=u+decimate_ ) {  //l2r self->width 640
-        uint8_t r = rgb_data[v*msg->depth.width*3 + u*3 + 0];
-        uint8_t g = rgb_data[v*msg->depth.width*3 + u*3 + 1];
-        uint8_t b = rgb_data[v*msg->depth.width*3 + u*3 + 2];
-        double constant = 1.0f / kcal->intrinsics_rgb.fx ;
-        double disparity_d = val[v*msg->depth.width+u]  / 1000.0; // convert to m
-
-        if (disparity_d!=0){
-          cloud->points[j2].x = (((double) u)- kcal->intrinsics_depth.cx)*disparity_d*constant; //x right+
-          cloud->points[j2].y = (((double) v)- kcal->intrinsics_depth.cy)*disparity_d*constant; //y down+
-          cloud->points[j2].z = disparity_d;  //z forward+
-          cloud->points[j2].b =b;
-          cloud->points[j2].r =r;
-          cloud->points[j2].g =g;
-          j2++;
-        }
+    mUseRayTable = true;
+    return;
+  }
 
+  double depthToXYZ[16];
+  double depthToRGB[12];
+  kinect_calib_get_depth_uvd_to_depth_xyz_4x4(kcal, depthToXYZ);
+  kinect_calib_get_depth_uvd_to_rgb_uvw_3x4(kcal, depthToRGB);
+  std::copy(depthToXYZ, depthToXYZ + 16, mDepthToXYZ);
+  std::copy(depthToRGB, depthToRGB + 12, mDepthToRGB);
+
+  // The unprojection of (u, v, disparity) is projective.  For the kinect
+  // calibration z depends on the disparity alone and x, y are z times the
+  // ray through the pixel, so a point is its ray scaled by a z looked up by
+  // disparity.  The rays are taken at a reference disparity and the
+  // factorization is checked on a grid of pixels and disparities; if it does
+  // not hold the full unprojection is evaluated per pixel.
+  const float referenceDisparity = 600;
+  float xyzw[4];
+  float* ray = mRays.data();
+  for (int v = 0; v < height; ++v)
+  {
+    for (int u = 0; u < width; ++u, ray += 2)
+    {
+      MultiplyUVD(mDepthToXYZ, 4, u, v, referenceDisparity, xyzw);
+      ray[0] = xyzw[0]/xyzw[2];
+      ray[1] = xyzw[1]/xyzw[2];
+    }
+  }
+
+  mDisparityDepths.resize(NumberOfDisparities);
+  for (size_t d = 0; d < NumberOfDisparities; ++d)
+  {
+    MultiplyUVD(mDepthToXYZ, 4, 0, 0, d, xyzw);
+    mDisparityDepths[d] = xyzw[2]/xyzw[3];
+  }
+
+  mUseRayTable = true;
+  const float disparities[] = {300, 600, 900};
+  for (int i = 0; i < 9 && mUseRayTable; ++i)
+  {
+    for (int j = 0; j < 9 && mUseRayTable; ++j)
+    {
+      const int u = (width - 1)*i/8;
+      const int v = (height - 1)*j/8;
+      for (int k = 0; k < 3; ++k)
+      {
+        const float d = disparities[k];
+        const float* r = &mRays[(size_t(v)*width + u)*2];
+        const float z = mDisparityDepths[static_cast<size_t>(d)];
+        MultiplyUVD(mDepthToXYZ, 4, u, v, d, xyzw);
+        const float point[3] = {r[0]*z, r[1]*z, z};
+        for (int c = 0; c < 3; ++c)
+        {
+          const float expected = xyzw[c]/xyzw[3];
+          if (std::abs(point[c] - expected) > 1e-4f*(std::abs(expected) + 1e-2f))
+          {
+            mUseRayTable = false;
+          }
+        }
       }
     }
-    cloud->points.resize (j2);
   }
 
-  if(msg->depth.compression != KINECT_DEPTH_MSG_T_COMPRESSION_NONE) {
-    free(uncompress_buffer); 
+  // the rgb distortion is applied per point only if it is not the identity
+  mRGBDistortion = false;
+  for (int i = 0; i < 5 && !mRGBDistortion; ++i)
+  {
+    for (int j = 0; j < 5 && !mRGBDistortion; ++j)
+    {
+      double uvRect[2] = {(width - 1)*i/4.0, (height - 1)*j/4.0};
+      double uvDist[2];
+      kinect_calib_distort_rgb_uv(kcal, uvRect, uvDist);
+      mRGBDistortion = std::abs(uvDist[0] - uvRect[0]) > 1e-3 || std::abs(uvDist[1] - uvRect[1]) > 1e-3;
+    }
   }
 }
 
 
-namespace {
+//-----------------------------------------------------------------------------
+bool ddKinectLCM::unpackColors()
+{
+  const kinect::image_msg_t& image = mMessage.image;
+  const size_t size = size_t(image.width)*image.height*3;
+  if (mColors.size() < size)
+  {
+    mColors.resize(size);
+  }
 
+  if (image.image_data_format == kinect::image_msg_t::VIDEO_RGB)
+  {
+    if (image.image_data.size() < size)
+    {
+      return false;
+    }
+    memcpy(mColors.data(), image.image_data.data(), size);
+    return true;
+  }
+  else if (image.image_data_format == kinect::image_msg_t::VIDEO_RGB_JPEG)
+  {
+    return jpeg_decompress_8u_rgb(image.image_data.data(), image.image_data_nbytes,
+        mColors.data(), image.width, image.height, image.width*3) == 0;
+  }
+  return false;
+}
 
 
-//----------------------------------------------------------------------------
-vtkSmartPointer<vtkCellArray> NewVertexCells(vtkIdType numberOfVerts)
+//-----------------------------------------------------------------------------
+const uint16_t* ddKinectLCM::unpackDepth()
 {
-  vtkNew<vtkIdTypeArray> cells;
-  cells->SetNumberOfValues(numberOfVerts*2);
-  vtkIdType* ids = cells->GetPointer(0);
-  for (vtkIdType i = 0; i < numberOfVerts; ++i)
+  const kinect::depth_msg_t& depth = mMessage.depth;
+  const size_t numberOfPixels = size_t(depth.width)*depth.height;
+
+  if (depth.compression == kinect::depth_msg_t::COMPRESSION_NONE)
+  {
+    if (depth.depth_data.size() < numberOfPixels*sizeof(uint16_t))
     {
-    ids[i*2] = 1;
-    ids[i*2+1] = i;
+      return 0;
     }
+    return reinterpret_cast<const uint16_t*>(depth.depth_data.data());
+  }
 
-  vtkSmartPointer<vtkCellArray> cellArray = vtkSmartPointer<vtkCellArray>::New();
-  cellArray->SetCells(numberOfVerts, cells.GetPointer());
-  return cellArray;
+  if (mDepth.size() < numberOfPixels)
+  {
+    mDepth.resize(numberOfPixels);
+  }
+  if (!ddDepthCodec::decode(depth.depth_data.data(), depth.depth_data_nbytes,
+      ddDepthCodec::ZlibCompression, false, mDepth.data(), numberOfPixels))
+  {
+    return 0;
+  }
+  return mDepth.data();
 }
 
 
-
-//----------------------------------------------------------------------------
-vtkSmartPointer<vtkPolyData> PolyDataFromPointCloud(pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr cloud)
+//-----------------------------------------------------------------------------
+void ddKinectLCM::fillFrameBuffer(FrameBuffer& frame, const uint16_t* depth, bool hasColors)
 {
-  vtkIdType nr_points = cloud->points.size();
+  const int width = mMessage.depth.width;
+  const int height = mMessage.depth.height;
+  const int step = std::max(decimate_, 1);
+  const vtkIdType maxPoints = vtkIdType((width + step - 1)/step)*((height + step - 1)/step);
+
+  // the arrays only grow, shrinking them keeps their memory
+  frame.Points->SetNumberOfPoints(maxPoints);
+  frame.Colors->SetNumberOfTuples(maxPoints);
 
-  vtkNew<vtkPoints> points;
-  points->SetDataTypeToFloat();
-  points->SetNumberOfPoints(nr_points);
+  float* points = static_cast<vtkFloatArray*>(frame.Points->GetData())->GetPointer(0);
+  unsigned char* colors = frame.Colors->GetPointer(0);
 
-  vtkNew<vtkUnsignedCharArray> rgbArray;
-  rgbArray->SetName("rgb_colors");
-  rgbArray->SetNumberOfComponents(3);
-  rgbArray->SetNumberOfTuples(nr_points);
+  const int rgbWidth = hasColors ? mMessage.image.width : 0;
+  const int rgbHeight = hasColors ? mMessage.image.height : 0;
+  const uint8_t* rgb = mColors.data();
 
-  vtkIdType j = 0;    
-  for (vtkIdType i = 0; i < nr_points; ++i)
+  vtkIdType numberOfPoints = 0;
+
+  if (mRayTableFormat == kinect::depth_msg_t::DEPTH_MM)
   {
-    // Check if the point is invalid
-    if (!pcl_isfinite (cloud->points[i].x) ||
-        !pcl_isfinite (cloud->points[i].y) ||
-        !pcl_isfinite (cloud->points[i].z))
-      continue;
-
-    float point[3] = {cloud->points[i].x, cloud->points[i].y, cloud->points[i].z};
-    unsigned char color[3] = {cloud->points[i].r, cloud->points[i].g, cloud->points[i].b};
-    points->SetPoint(j, point);
-    rgbArray->SetTupleValue(j, color);
-    j++;
-  }
-  nr_points = j;
-  points->SetNumberOfPoints(nr_points);
-  rgbArray->SetNumberOfTuples(nr_points);
-
-  vtkSmartPointer<vtkPolyData> polyData = vtkSmartPointer<vtkPolyData>::New();
-  polyData->SetPoints(points.GetPointer());
-  polyData->GetPointData()->AddArray(rgbArray.GetPointer());
-  polyData->SetVerts(NewVertexCells(nr_points));
-  return polyData;
-}
+    // NB: no depth return is given 0 range, it is skipped
+    const bool sameSize = (rgbWidth == width && rgbHeight == height);
+    for (int v = 0; v < height; v += step)
+    {
+      const float* rays = &mRays[size_t(v)*width*2];
+      const uint16_t* row = depth + size_t(v)*width;
+      for (int u = 0; u < width; u += step)
+      {
+        if (!row[u])
+        {
+          continue;
+        }
 
+        const float z = row[u]*0.001f; // convert to m
+        float* point = points + numberOfPoints*3;
+        point[0] = rays[u*2]*z;
+        point[1] = rays[u*2+1]*z;
+        point[2] = z;
+
+        unsigned char* color = colors + numberOfPoints*3;
+        if (sameSize)
+        {
+          const uint8_t* pixel = rgb + (size_t(v)*width + u)*3;
+          color[0] = pixel[0];
+          color[1] = pixel[1];
+          color[2] = pixel[2];
+        }
+        else
+        {
+          color[0] = color[1] = color[2] = 0;
+        }
+        ++numberOfPoints;
+      }
+    }
+  }
+  else
+  {
+    const float* disparityDepths = mDisparityDepths.data();
+    const float* m = mDepthToRGB;
+    float* depths = mRowDepths.data();
+    int* pixels = mRowPixels.data();
+    for (int v = 0; v < height; v += step)
+    {
+      const float* rays = &mRays[size_t(v)*width*2];
+      const uint16_t* row = depth + size_t(v)*width;
+
+      // the z of each point in the row and the offset of its pixel in the
+      // rgb image, or -1 if it is outside, in a loop without branches that
+      // the compiler vectorizes
+      for (int u = 0; u < width; u += step)
+      {
+        const uint16_t disparity = std::min(row[u], static_cast<uint16_t>(NumberOfDisparities - 1));
+        const float d = disparity;
+        depths[u] = disparityDepths[disparity];
+
+        const float w = 1.0f/(m[8]*u + m[9]*v + m[10]*d + m[11]);
+        const int uRGB = (m[0]*u + m[1]*v + m[2]*d + m[3])*w + 0.5f;
+        const int vRGB = (m[4]*u + m[5]*v + m[6]*d + m[7])*w + 0.5f;
+        pixels[u] = (unsigned(uRGB) < unsigned(rgbWidth) && unsigned(vRGB) < unsigned(rgbHeight))
+          ? (vRGB*rgbWidth + uRGB)*3 : -1;
+      }
 
-};
+      if (mRGBDistortion)
+      {
+        for (int u = 0; u < width; u += step)
+        {
+          const uint16_t disparity = std::min(row[u], static_cast<uint16_t>(NumberOfDisparities - 1));
+          float uvw[3];
+          MultiplyUVD(mDepthToRGB, 3, u, v, disparity, uvw);
+          double uvRect[2] = {uvw[0]/uvw[2], uvw[1]/uvw[2]};
+          double uvDist[2];
+          kinect_calib_distort_rgb_uv(kcal, uvRect, uvDist);
+          const int uRGB = uvDist[0] + 0.5;
+          const int vRGB = uvDist[1] + 0.5;
+          pixels[u] = (unsigned(uRGB) < unsigned(rgbWidth) && unsigned(vRGB) < unsigned(rgbHeight))
+            ? (vRGB*rgbWidth + uRGB)*3 : -1;
+        }
+      }
 
+      for (int u = 0; u < width; u += step)
+      {
+        float* point = points + numberOfPoints*3;
+        if (mUseRayTable)
+        {
+          const float z = depths[u];
+          point[0] = rays[u*2]*z;
+          point[1] = rays[u*2+1]*z;
+          point[2] = z;
+        }
+        else
+        {
+          float xyzw[4];
+          MultiplyUVD(mDepthToXYZ, 4, u, v, std::min(row[u], static_cast<uint16_t>(NumberOfDisparities - 1)), xyzw);
+          point[0] = xyzw[0]/xyzw[3];
+          point[1] = xyzw[1]/xyzw[3];
+          point[2] = xyzw[2]/xyzw[3];
+        }
+
+        if (!std::isfinite(point[0]) || !std::isfinite(point[1]) || !std::isfinite(point[2]))
+        {
+          continue;
+        }
+
+        unsigned char* color = colors + numberOfPoints*3;
+        if (pixels[u] < 0)
+        {
+          color[0] = color[1] = color[2] = 0;
+        }
+        else
+        {
+          const uint8_t* pixel = rgb + pixels[u];
+          color[0] = pixel[0];
+          color[1] = pixel[1];
+          color[2] = pixel[2];
+        }
+        ++numberOfPoints;
+      }
+    }
+  }
+
+  frame.Points->SetNumberOfPoints(numberOfPoints);
+  frame.Colors->SetNumberOfTuples(numberOfPoints);
+
+  frame.Points->Modified();
+  frame.Colors->Modified();
+  frame.PolyData->Modified();
+}
 
 
 //-----------------------------------------------------------------------------
-void ddKinectLCM::onKinectFrame(const QByteArray& data, const QString& channel)
+void ddKinectLCM::convertFrame(const QByteArray& data)
 {
-  
-  kinect_frame_msg_t message;
+  {
+    std::lock_guard<std::mutex> lock(mCalibrationMutex);
+    if (mAppliedRevision != mCalibrationRevision)
+    {
+      *kcal = *mCalibration;
+      decimate_ = mDecimation;
+      mAppliedRevision = mCalibrationRevision;
+      // recompute the ray table at this frame
+      mRayTableFormat = -1;
+    }
+  }
 
-  kinect_frame_msg_t_decode (data.data(), 0, 1e9, &message);
+  if (mMessage.decode(data.constData(), 0, data.size()) < 0)
+  {
+    return;
+  }
 
-  //printf("got kinect frame %d\n", message.timestamp);
+  const int depthFormat = mMessage.depth.depth_data_format;
+  if (depthFormat != kinect::depth_msg_t::DEPTH_11BIT && depthFormat != kinect::depth_msg_t::DEPTH_MM)
+  {
+    return;
+  }
 
-  //convert to pcl object:
-  pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZRGB>);
-  unpack_kinect_frame(&message, rgb_buf_, kcal, decimate_,  cloud);
+  const uint16_t* depth = this->unpackDepth();
+  if (!depth)
+  {
+    return;
+  }
 
-  kinect_frame_msg_t_decode_cleanup(&message);
-  //printf("Decoded point cloud with %u\n", cloud->size());
+  const bool hasColors = this->unpackColors();
+  this->updateRayTable(mMessage.depth.width, mMessage.depth.height, depthFormat);
 
-  vtkSmartPointer<vtkPolyData> polyData = PolyDataFromPointCloud(cloud);
+  FrameBuffer& frame = mFrames[mWriteFrame];
+  this->fillFrameBuffer(frame, depth, hasColors);
+  frame.Utime = mMessage.timestamp;
 
   QMutexLocker locker(&this->mPolyDataMutex);
-  this->mPolyData = polyData;
-  this->mUtime = message.timestamp;
+  std::swap(mWriteFrame, mLatestFrame);
+  mHasNewFrame = true;
+}
+
+
+//-----------------------------------------------------------------------------
+void ddKinectLCM::threadLoop()
+{
+  QByteArray data;
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mPendingMutex);
+      mPendingCondition.wait(lock, [this]{ return mShouldStop || !mPendingData.isEmpty(); });
+      if (mShouldStop)
+      {
+        return;
+      }
+      data = mPendingData;
+      mPendingData.clear();
+    }
+
+    this->convertFrame(data);
+    data.clear();
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void ddKinectLCM::onKinectFrame(const QByteArray& data, const QString& channel)
+{
+  // Only the latest frame is kept, a frame that arrives while the previous
+  // one is converted replaces the one waiting.  The array shares the message
+  // bytes, so handing it over does not copy them.
+  {
+    std::lock_guard<std::mutex> lock(mPendingMutex);
+    mPendingData = data;
+  }
+  mPendingCondition.notify_one();
 }
 
 
@@ -347,7 +727,11 @@ void ddKinectLCM::onKinectFrame(const QByteArray& data, const QString& channel)
 qint64 ddKinectLCM::getPointCloudFromKinect(vtkPolyData* polyDataRender)
 {
   QMutexLocker locker(&this->mPolyDataMutex);
-  polyDataRender->ShallowCopy(this->mPolyData);
-  return this->mUtime;
+  if (mHasNewFrame)
+  {
+    std::swap(mReadFrame, mLatestFrame);
+    mHasNewFrame = false;
+  }
+  polyDataRender->ShallowCopy(mFrames[mReadFrame].PolyData);
+  return mFrames[mReadFrame].Utime;
 }
-
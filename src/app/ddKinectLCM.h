@@ -2,21 +2,30 @@
 #define __ddKinectLCM_h
 
 #include <QObject>
+#include <QByteArray>
+#include <QMutex>
 
 #include "ddLCMThread.h"
 #include "ddLCMSubscriber.h"
 #include "ddAppConfigure.h"
 
 
+#include <condition_variable>
+#include <mutex>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include <lcm/lcm-cpp.hpp>
 #include <bot_frames/bot_frames.h>
+#include <bot_param/param_client.h>
+#include <lcmtypes/kinect/frame_msg_t.hpp>
 
 #include <vtkSmartPointer.h>
 #include <vtkPolyData.h>
 #include <vtkPointData.h>
+#include <vtkPoints.h>
 #include <vtkUnsignedCharArray.h>
 #include <vtkFloatArray.h>
 #include <vtkTransform.h>
@@ -24,6 +33,20 @@
 
 #include <kinect/kinect-utils.h>
 
+// Converts KINECT_FRAME messages to colored point clouds.
+//
+// The lcm thread only hands the latest message to a conversion thread, which
+// decodes it into a persistent message and writes the points and colors
+// directly into the vtk arrays of one of three frame buffers: one being
+// written, the latest complete frame, and the frame last returned by
+// getPointCloudFromKinect().  Pixels are unprojected with a table of rays
+// computed from the calibration once per image size, depth format and
+// calibration, so a point is its ray scaled by its depth.  All buffers keep
+// their capacity, so a frame of an unchanged size allocates nothing.
+//
+// The class needs the kinect-utils library and lcmtypes_kinect, it is only
+// built with USE_KINECT.
+
 class DD_APP_EXPORT ddKinectLCM : public QObject
 {
   Q_OBJECT
@@ -31,8 +54,35 @@ class DD_APP_EXPORT ddKinectLCM : public QObject
 public:
 
   ddKinectLCM(QObject* parent=NULL);
-  
+  virtual ~ddKinectLCM();
+
+  // Subscribes to the channel, KINECT_FRAME unless set before init().
   void init(ddLCMThread* lcmThread, const QString& botConfigFile);
+
+  // Reads the channel, decimation and calibration of the sensor from the
+  // depth_cameras.<sensorName> block of the config.  Keys missing from the
+  // block keep their values:
+  //   lcm_channel, decimation,
+  //   depth_intrinsics = [fx, cx, cy],
+  //   rgb_intrinsics = [fx, cx, cy, k1, k2],
+  //   shift_offset, projector_depth_baseline,
+  //   depth_to_rgb_rotation (row major 3x3), depth_to_rgb_translation
+  void init(ddLCMThread* lcmThread, const QString& botConfigFile, const QString& sensorName);
+
+  // The channel takes effect at init(), the other settings at the next
+  // frame.  The ray table is recomputed when the calibration changes.
+  void setChannel(const QString& channelName);
+  QString getChannel() const;
+  void setDecimation(int decimation);
+  int getDecimation() const;
+  void setDepthIntrinsics(double fx, double cx, double cy);
+  void setRGBIntrinsics(double fx, double cx, double cy, double k1, double k2);
+  void setShiftOffset(double shiftOffset);
+  void setProjectorDepthBaseline(double baseline);
+  void setDepthToRGBTransform(const QList<double>& rotation, const QList<double>& translation);
+
+  // Shallow copies the latest frame into polyDataRender and returns its
+  // utime.  The arrays are not written again until the next call.
   qint64 getPointCloudFromKinect(vtkPolyData* polyDataRender);
 
 protected slots:
@@ -42,17 +92,70 @@ protected slots:
 
 protected:
 
+  struct FrameBuffer
+  {
+    vtkSmartPointer<vtkPolyData> PolyData;
+    vtkSmartPointer<vtkPoints> Points;
+    vtkSmartPointer<vtkUnsignedCharArray> Colors;
+    int64_t Utime;
+  };
+
+  enum { NumberOfFrameBuffers = 3 };
+
+  void readConfig(ddLCMThread* lcmThread, const QString& botConfigFile, const QString& sensorName);
+  void threadLoop();
+  void convertFrame(const QByteArray& data);
+  bool unpackColors();
+  const uint16_t* unpackDepth();
+  void updateRayTable(int width, int height, int depthFormat);
+  void fillFrameBuffer(FrameBuffer& frame, const uint16_t* depth, bool hasColors);
+
   ddLCMThread* mLCM;
+  QString mChannel;
 
+  // the settings, copied to kcal and decimate_ at the start of a frame when
+  // the revision changes
+  KinectCalibration* mCalibration;
+  int mDecimation;
+  int mCalibrationRevision;
+  mutable std::mutex mCalibrationMutex;
+
+  // used by the conversion thread only
   KinectCalibration* kcal;
   int decimate_;
-    
-  uint8_t* rgb_buf_ ;
-
-  vtkSmartPointer<vtkPolyData> mPolyData;
-  int64_t mUtime;
+  int mAppliedRevision;
+
+  kinect::frame_msg_t mMessage;
+  std::vector<uint8_t> mColors;
+  std::vector<uint16_t> mDepth;
+
+  // The ray through each pixel with z = 1, see updateRayTable().
+  std::vector<float> mRays;
+  // The z of a point by its 11 bit disparity.
+  std::vector<float> mDisparityDepths;
+  // the z and rgb pixel offset of each point in a row
+  std::vector<float> mRowDepths;
+  std::vector<int> mRowPixels;
+  bool mUseRayTable;
+  bool mRGBDistortion;
+  float mDepthToXYZ[16];
+  float mDepthToRGB[12];
+  int mRayTableWidth;
+  int mRayTableHeight;
+  int mRayTableFormat;
+
+  FrameBuffer mFrames[NumberOfFrameBuffers];
+  int mWriteFrame;
+  int mLatestFrame;
+  int mReadFrame;
+  bool mHasNewFrame;
   QMutex mPolyDataMutex;
 
+  QByteArray mPendingData;
+  std::mutex mPendingMutex;
+  std::condition_variable mPendingCondition;
+  bool mShouldStop;
+  std::thread mThread;
 };
 
 #endif
@@ -0,0 +1,374 @@
+#include "ddLCMLogPlayer.h"
+
+#include "ddLCMDispatcher.h"
+#include "ddLCMEventLog.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+}
+
+//-----------------------------------------------------------------------------
+ddLCMLogPlayer::ddLCMLogPlayer(QObject* parent) : QObject(parent)
+{
+  mShouldStop = false;
+  mPlaybackFactor = 1.0;
+  mInProcessReplay = false;
+  mRealTime = true;
+  mIsPlaying = false;
+  mNextEventIndex = 0;
+}
+
+//-----------------------------------------------------------------------------
+ddLCMLogPlayer::~ddLCMLogPlayer()
+{
+  this->closeLog();
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogPlayer::openLog(const QString& filename)
+{
+  // keep the replay mode, closeLog() would turn it off
+  this->stop();
+  mLog.reset();
+  mNextEventIndex = 0;
+
+  std::unique_ptr<ddLCMEventLog> log(new ddLCMEventLog);
+  if (!log->open(filename.toLocal8Bit().data()) || !log->numberOfEvents())
+  {
+    return false;
+  }
+
+  mLog = std::move(log);
+  mNextEventIndex = 0;
+  this->updatePublishedChannels();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogPlayer::closeLog()
+{
+  this->setInProcessReplayEnabled(false);
+  mLog.reset();
+  mNextEventIndex = 0;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogPlayer::setInProcessReplayEnabled(bool enabled)
+{
+  this->stop();
+  if (enabled != mInProcessReplay)
+  {
+    mInProcessReplay = enabled;
+    ddLCMDispatcher::instance()->setReplayEnabled(enabled);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogPlayer::inProcessReplayIsEnabled() const
+{
+  return mInProcessReplay;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogPlayer::setPublishedChannels(const QStringList& channels)
+{
+  this->stop();
+  mPublishedChannels = channels;
+  this->updatePublishedChannels();
+}
+
+//-----------------------------------------------------------------------------
+QStringList ddLCMLogPlayer::publishedChannels() const
+{
+  return mPublishedChannels;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogPlayer::updatePublishedChannels()
+{
+  mPublishChannel.assign(mLog ? mLog->numberOfChannels() : 0, false);
+  foreach (const QString& channel, mPublishedChannels)
+  {
+    const int channelId = mLog ? mLog->channelId(channel.toAscii().data()) : -1;
+    if (channelId >= 0)
+    {
+      mPublishChannel[channelId] = true;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogPlayer::setRealTimeEnabled(bool enabled)
+{
+  mRealTime = enabled;
+  mCondition.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogPlayer::realTimeIsEnabled() const
+{
+  return mRealTime;
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogPlayer::logIsOpen() const
+{
+  return mLog.get() != 0;
+}
+
+//-----------------------------------------------------------------------------
+QString ddLCMLogPlayer::logFilename() const
+{
+  return mLog ? QString::fromLocal8Bit(mLog->filename().c_str()) : QString();
+}
+
+//-----------------------------------------------------------------------------
+int ddLCMLogPlayer::getNumberOfEvents() const
+{
+  return mLog ? static_cast<int>(mLog->numberOfEvents()) : 0;
+}
+
+//-----------------------------------------------------------------------------
+QStringList ddLCMLogPlayer::getChannelNames() const
+{
+  QStringList channelNames;
+  for (int i = 0; mLog && i < mLog->numberOfChannels(); ++i)
+  {
+    channelNames << mLog->channelName(i).c_str();
+  }
+  return channelNames;
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogPlayer::indexWasLoaded() const
+{
+  return mLog && mLog->indexWasLoaded();
+}
+
+//-----------------------------------------------------------------------------
+double ddLCMLogPlayer::getNextEventTime(const QString& channel, double time) const
+{
+  if (!mLog)
+  {
+    return -1.0;
+  }
+
+  const size_t startIndex = mLog->findEvent(mLog->startTimestamp() + static_cast<int64_t>(time * 1e6));
+  const size_t eventIndex = mLog->findNextEventOnChannel(mLog->channelId(channel.toAscii().data()), startIndex);
+  if (eventIndex >= mLog->numberOfEvents())
+  {
+    return -1.0;
+  }
+
+  return (mLog->event(eventIndex).Timestamp - mLog->startTimestamp()) * 1e-6;
+}
+
+//-----------------------------------------------------------------------------
+QList<double> ddLCMLogPlayer::getTimeHistogram() const
+{
+  QList<double> histogram;
+  for (size_t i = 0; mLog && i < mLog->timeHistogram().size(); ++i)
+  {
+    histogram << mLog->timeHistogram()[i];
+  }
+  return histogram;
+}
+
+//-----------------------------------------------------------------------------
+double ddLCMLogPlayer::getTimeHistogramBinWidth() const
+{
+  return mLog ? mLog->timeHistogramBinWidth() * 1e-6 : 0.0;
+}
+
+//-----------------------------------------------------------------------------
+double ddLCMLogPlayer::getEndTime() const
+{
+  return mLog ? (mLog->endTimestamp() - mLog->startTimestamp()) * 1e-6 : 0.0;
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddLCMLogPlayer::getTimestampOffset() const
+{
+  return mLog ? mLog->startTimestamp() : 0;
+}
+
+//-----------------------------------------------------------------------------
+double ddLCMLogPlayer::getCurrentTime() const
+{
+  const size_t eventIndex = mNextEventIndex;
+  if (!mLog || eventIndex >= mLog->numberOfEvents())
+  {
+    return this->getEndTime();
+  }
+  return (mLog->event(eventIndex).Timestamp - mLog->startTimestamp()) * 1e-6;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogPlayer::setPlaybackFactor(double factor)
+{
+  if (factor <= 0.0)
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPlaybackFactor = factor;
+  }
+  mCondition.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+double ddLCMLogPlayer::getPlaybackFactor() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mPlaybackFactor;
+}
+
+//-----------------------------------------------------------------------------
+size_t ddLCMLogPlayer::findEventIndex(double time) const
+{
+  const size_t eventIndex = mLog->findEvent(mLog->startTimestamp() + static_cast<int64_t>(time * 1e6));
+  return std::min(eventIndex, mLog->numberOfEvents() - 1);
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogPlayer::playback(double startTime, double endTime)
+{
+  this->stop();
+  if (!mLog)
+  {
+    return;
+  }
+
+  const size_t startIndex = this->findEventIndex(startTime);
+  const size_t endIndex = endTime < 0 ? mLog->numberOfEvents() :
+    mLog->findEvent(mLog->startTimestamp() + static_cast<int64_t>(endTime * 1e6) + 1);
+
+  mNextEventIndex = startIndex;
+  mShouldStop = false;
+  mIsPlaying = true;
+  mThread = std::thread(&ddLCMLogPlayer::playbackLoop, this, startIndex, endIndex);
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogPlayer::skipToTime(double time, double playLength)
+{
+  this->stop();
+  if (!mLog)
+  {
+    return;
+  }
+
+  size_t eventIndex = this->findEventIndex(time);
+  const int64_t endTimestamp = mLog->event(eventIndex).Timestamp + static_cast<int64_t>(playLength * 1e6);
+
+  do
+  {
+    this->publishEvent(eventIndex++);
+  }
+  while (eventIndex < mLog->numberOfEvents() && mLog->event(eventIndex).Timestamp <= endTimestamp);
+
+  mNextEventIndex = eventIndex;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogPlayer::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mShouldStop = true;
+  }
+  mCondition.notify_all();
+
+  if (mThread.joinable())
+  {
+    mThread.join();
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogPlayer::isPlaying() const
+{
+  return mIsPlaying;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogPlayer::publishEvent(size_t eventIndex)
+{
+  const ddLCMEventLog::Event& event = mLog->event(eventIndex);
+  if (mInProcessReplay)
+  {
+    ddLCMDispatcher::instance()->inject(mLog->channelName(event.ChannelId),
+      mLog->eventData(eventIndex), event.DataSize, event.Timestamp);
+  }
+
+  if (!mInProcessReplay || mPublishChannel[event.ChannelId])
+  {
+    ddLCMDispatcher::instance()->lcmHandle()->publish(mLog->channelName(event.ChannelId),
+      mLog->eventData(eventIndex), event.DataSize);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogPlayer::playbackLoop(size_t eventIndex, size_t endIndex)
+{
+  double anchorFactor = 0.0;
+  int64_t anchorTimestamp = 0;
+  Clock::time_point anchorTime;
+
+  for (; eventIndex < endIndex; ++eventIndex)
+  {
+    const int64_t timestamp = mLog->event(eventIndex).Timestamp;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mShouldStop)
+    {
+      if (!mRealTime)
+      {
+        anchorFactor = 0.0;
+        break;
+      }
+
+      // restart the clock at this event when the playback factor changes
+      if (mPlaybackFactor != anchorFactor)
+      {
+        anchorFactor = mPlaybackFactor;
+        anchorTimestamp = timestamp;
+        anchorTime = Clock::now();
+      }
+
+      const Clock::time_point dueTime = anchorTime +
+        std::chrono::microseconds(static_cast<int64_t>((timestamp - anchorTimestamp) / anchorFactor));
+
+      if (Clock::now() >= dueTime)
+      {
+        break;
+      }
+
+      // wakes early when stopped or the playback factor changes
+      mCondition.wait_until(lock, dueTime);
+    }
+
+    if (mShouldStop)
+    {
+      break;
+    }
+    lock.unlock();
+
+    this->publishEvent(eventIndex);
+    mNextEventIndex = eventIndex + 1;
+  }
+
+  mIsPlaying = false;
+  if (eventIndex >= endIndex)
+  {
+    emit this->playbackFinished();
+  }
+}
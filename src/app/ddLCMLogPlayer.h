@@ -0,0 +1,137 @@
+#ifndef __ddLCMLogPlayer_h
+#define __ddLCMLogPlayer_h
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ddAppConfigure.h"
+
+class ddLCMEventLog;
+
+
+// Plays back an lcm log file by publishing its events on the lcm instance of
+// the ddLCMDispatcher.
+//
+// The log is memory mapped and indexed by ddLCMEventLog, so opening a large
+// log does not read the event payloads and seeking is a binary search.
+// Playback runs on its own thread, events are published at their log time
+// divided by the playback factor, measured on a monotonic clock.  Times are
+// in seconds relative to the first event of the log.
+//
+// With in process replay enabled, events are injected into the dispatcher's
+// subscriptions, which include every ddLCMSubscriber and the VTK lcm
+// sources, instead of being published.  Live lcm traffic is ignored and the
+// dispatcher's clock follows the log until the log is closed or in process
+// replay is disabled.  Combined with setRealTimeEnabled(false) a log is
+// processed as fast as the subscribers handle it.
+
+class DD_APP_EXPORT ddLCMLogPlayer : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  ddLCMLogPlayer(QObject* parent=NULL);
+  virtual ~ddLCMLogPlayer();
+
+  // Opening a log stops playback and keeps the in-process replay mode.
+  // Closing the log turns in-process replay off.
+  bool openLog(const QString& filename);
+  void closeLog();
+
+  bool logIsOpen() const;
+  QString logFilename() const;
+
+  int getNumberOfEvents() const;
+  QStringList getChannelNames() const;
+
+  // Returns true if the event index was loaded from the log's sidecar index
+  // file instead of scanning the log.
+  bool indexWasLoaded() const;
+
+  // Returns the log time of the first event on the channel at or after the
+  // given time, or -1 if there is none.
+  double getNextEventTime(const QString& channel, double time) const;
+
+  // Returns the number of events in each bin of a coarse histogram of event
+  // times, see getTimeHistogramBinWidth().
+  QList<double> getTimeHistogram() const;
+  double getTimeHistogramBinWidth() const;
+
+  // Returns the log time of the last event.
+  double getEndTime() const;
+
+  // Returns the log timestamp of the first event in microseconds.
+  qint64 getTimestampOffset() const;
+
+  // Returns the log time of the next event to be published.
+  double getCurrentTime() const;
+
+  void setPlaybackFactor(double factor);
+  double getPlaybackFactor() const;
+
+  // See the class comment.  Changing the mode stops playback.
+  void setInProcessReplayEnabled(bool enabled);
+  bool inProcessReplayIsEnabled() const;
+
+  // Sets channels that are also published through lcm during in process
+  // replay, for clients that subscribe to the lcm_t directly instead of
+  // through the dispatcher.  Frame transforms do not need this, the
+  // ddFrameTransformCache receives its updates through the dispatcher.
+  void setPublishedChannels(const QStringList& channels);
+  QStringList publishedChannels() const;
+
+  // If false, playback does not wait for event times and the playback
+  // factor is ignored.  The default is true.
+  void setRealTimeEnabled(bool enabled);
+  bool realTimeIsEnabled() const;
+
+  // Publishes the events from startTime to endTime on the playback thread
+  // and returns immediately.  A negative endTime plays to the end of the log.
+  void playback(double startTime, double endTime=-1.0);
+
+  // Stops playback and seeks to the given time, then publishes the events
+  // that are at most playLength seconds after it.
+  void skipToTime(double time, double playLength=0.0);
+
+  void stop();
+  bool isPlaying() const;
+
+signals:
+
+  void playbackFinished();
+
+protected:
+
+  void playbackLoop(size_t eventIndex, size_t endIndex);
+  void publishEvent(size_t eventIndex);
+  void updatePublishedChannels();
+  size_t findEventIndex(double time) const;
+
+  std::unique_ptr<ddLCMEventLog> mLog;
+
+  mutable std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::thread mThread;
+  bool mShouldStop;
+  double mPlaybackFactor;
+  bool mInProcessReplay;
+  std::atomic<bool> mRealTime;
+  QStringList mPublishedChannels;
+  std::vector<bool> mPublishChannel;
+  std::atomic<bool> mIsPlaying;
+  std::atomic<size_t> mNextEventIndex;
+
+  Q_DISABLE_COPY(ddLCMLogPlayer);
+};
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef __ddLCMMessageBufferPool_h
+#define __ddLCMMessageBufferPool_h
+
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+#include "ddAppConfigure.h"
+
+#include <cstring>
+
+
+// A pool of reference counted byte slabs used to hold received LCM messages.
+//
+// Slabs are QByteArrays, so handing a message to a consumer only increments
+// the slab's reference count; the bytes are never copied again after the
+// receive buffer is copied into the slab.  A slab is reused for a new message
+// once every consumer has released its reference, so in steady state no
+// memory is allocated on the LCM thread.
+//
+// Slabs are grouped by power of two size class.  A message is stored in a
+// slab whose reserved capacity is the next power of two above the message
+// size, so QByteArray::resize() reuses the slab without reallocating.
+//
+// The pool is not thread safe for acquire(), it is intended to be owned by a
+// single producer (the LCM thread).  Releasing slabs from other threads is safe
+// because QByteArray reference counting is atomic.
+
+class DD_APP_EXPORT ddLCMMessageBufferPool
+{
+public:
+
+  ddLCMMessageBufferPool()
+  {
+    mMaxFreeSlabsPerClass = 4;
+    mSlabsInUse = 0;
+    mHighWaterMark = 0;
+    mHighWaterMarkBytes = 0;
+    mNumberOfAllocations = 0;
+    mAcquiresSinceUpdate = 0;
+  }
+
+  ~ddLCMMessageBufferPool()
+  {
+  }
+
+  // Returns a QByteArray that holds a copy of the given data.  The returned
+  // array shares a pooled slab, copies of it are reference counted views of
+  // the same memory.  An empty message returns an empty array and does not
+  // use a slab.
+  QByteArray acquire(const void* data, int size)
+  {
+    if (size <= 0)
+    {
+      return QByteArray();
+    }
+
+    const int sizeClass = this->sizeClass(size);
+    if (mSlabs.size() <= sizeClass)
+    {
+      mSlabs.resize(sizeClass + 1);
+    }
+
+    QList<QByteArray>& slabs = mSlabs[sizeClass];
+
+    // the slabs are kept in the order they were last acquired.  Consumers
+    // usually release messages in the order they were received, so the free
+    // slab is normally found at the front of the list.
+    int index = 0;
+    while (index < slabs.size() && !slabs[index].isDetached())
+    {
+      ++index;
+    }
+
+    const bool allocated = (index == slabs.size());
+    if (allocated)
+    {
+      slabs.append(QByteArray());
+      slabs.last().reserve(1 << sizeClass);
+      ++mNumberOfAllocations;
+    }
+    else
+    {
+      slabs.move(index, slabs.size() - 1);
+    }
+
+    QByteArray* slab = &slabs.last();
+    slab->resize(size);
+    memcpy(slab->data(), data, size);
+
+    // take the consumer reference before updating statistics so the new slab
+    // is counted as in use and is not trimmed.  Statistics and trimming scan
+    // every slab, so they run when the pool grows and otherwise only once
+    // every StatisticsInterval messages.
+    QByteArray message = *slab;
+    if (allocated || ++mAcquiresSinceUpdate >= StatisticsInterval)
+    {
+      mAcquiresSinceUpdate = 0;
+      this->updateStatistics();
+      this->trimSlabs();
+    }
+    return message;
+  }
+
+  // The maximum number of slabs that were referenced by consumers at the
+  // same time.  The statistics are sampled when the pool grows and every
+  // StatisticsInterval messages.
+  int highWaterMark() const
+  {
+    return mHighWaterMark;
+  }
+
+  // The total capacity, in bytes, of all slabs at the high water mark.
+  qint64 highWaterMarkBytes() const
+  {
+    return mHighWaterMarkBytes;
+  }
+
+  // The number of slabs allocated since the pool was created.  When the pool is
+  // warm this number stops increasing.
+  qint64 numberOfAllocations() const
+  {
+    return mNumberOfAllocations;
+  }
+
+  // The number of slabs referenced by consumers when the statistics were
+  // last sampled.
+  int slabsInUse() const
+  {
+    return mSlabsInUse;
+  }
+
+  // Limits the number of unreferenced slabs that are kept in each size class.
+  void setMaxFreeSlabsPerSizeClass(int count)
+  {
+    mMaxFreeSlabsPerClass = count;
+  }
+
+private:
+
+  enum
+  {
+    StatisticsInterval = 64
+  };
+
+  static int sizeClass(int size)
+  {
+    int sizeClass = 6;
+    while ((1 << sizeClass) < size)
+    {
+      ++sizeClass;
+    }
+    return sizeClass;
+  }
+
+  void updateStatistics()
+  {
+    int inUse = 0;
+    qint64 inUseBytes = 0;
+    for (int sizeClass = 0; sizeClass < mSlabs.size(); ++sizeClass)
+    {
+      const QList<QByteArray>& slabs = mSlabs[sizeClass];
+      for (int i = 0; i < slabs.size(); ++i)
+      {
+        if (!slabs[i].isDetached())
+        {
+          ++inUse;
+          inUseBytes += (qint64(1) << sizeClass);
+        }
+      }
+    }
+
+    mSlabsInUse = inUse;
+    if (inUse > mHighWaterMark)
+    {
+      mHighWaterMark = inUse;
+      mHighWaterMarkBytes = inUseBytes;
+    }
+  }
+
+  void trimSlabs()
+  {
+    for (int sizeClass = 0; sizeClass < mSlabs.size(); ++sizeClass)
+    {
+      QList<QByteArray>& slabs = mSlabs[sizeClass];
+      int freeSlabs = 0;
+      for (int i = slabs.size() - 1; i >= 0; --i)
+      {
+        if (slabs[i].isDetached() && ++freeSlabs > mMaxFreeSlabsPerClass)
+        {
+          slabs.removeAt(i);
+        }
+      }
+    }
+  }
+
+  ddLCMMessageBufferPool(const ddLCMMessageBufferPool&); // Not implemented
+  void operator=(const ddLCMMessageBufferPool&); // Not implemented
+
+  QVector<QList<QByteArray> > mSlabs;
+  int mMaxFreeSlabsPerClass;
+  int mSlabsInUse;
+  int mHighWaterMark;
+  qint64 mHighWaterMarkBytes;
+  qint64 mNumberOfAllocations;
+  int mAcquiresSinceUpdate;
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "ddLCMRecorder.h"
+
+#include "ddLCMDispatcher.h"
+#include "ddLCMLogWriter.h"
+
+#include <algorithm>
+
+namespace
+{
+
+const char* CompressionNames[] = {"none", "lz4", "zstd"};
+
+}
+
+//-----------------------------------------------------------------------------
+ddLCMRecorder::ddLCMRecorder(QObject* parent) : QObject(parent)
+{
+  mWriter.reset(new ddLCMLogWriter);
+  mCompression = "none";
+  mSubscription = -1;
+}
+
+//-----------------------------------------------------------------------------
+ddLCMRecorder::~ddLCMRecorder()
+{
+  this->stop();
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMRecorder::setChannels(const QStringList& channels)
+{
+  mChannels = channels;
+}
+
+//-----------------------------------------------------------------------------
+QStringList ddLCMRecorder::channels() const
+{
+  return mChannels;
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMRecorder::setCompression(const QString& compression)
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    ddLCMLogWriter::Compression value = static_cast<ddLCMLogWriter::Compression>(i);
+    if (compression == CompressionNames[i] && ddLCMLogWriter::compressionIsSupported(value))
+    {
+      mWriter->setCompression(value);
+      mCompression = compression;
+      return true;
+    }
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+QString ddLCMRecorder::compression() const
+{
+  return mCompression;
+}
+
+//-----------------------------------------------------------------------------
+QStringList ddLCMRecorder::supportedCompressions()
+{
+  QStringList compressions;
+  for (int i = 0; i < 3; ++i)
+  {
+    if (ddLCMLogWriter::compressionIsSupported(static_cast<ddLCMLogWriter::Compression>(i)))
+    {
+      compressions << CompressionNames[i];
+    }
+  }
+  return compressions;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMRecorder::setMaxFileSize(qint64 maxFileSize)
+{
+  mWriter->setMaxFileSize(std::max(qint64(0), maxFileSize));
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMRecorder::setQueueSize(qint64 queueSize)
+{
+  mWriter->setQueueSize(std::max(qint64(0), queueSize));
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMRecorder::start(const QString& filename)
+{
+  this->stop();
+
+  if (!mWriter->open(filename.toLocal8Bit().data()))
+  {
+    return false;
+  }
+
+  // lcm matches the whole channel name, so the alternation needs no anchors
+  QString channel = ".*";
+  if (!mChannels.isEmpty())
+  {
+    channel = "((" + mChannels.join(")|(") + "))";
+  }
+
+  mSubscription = ddLCMDispatcher::instance()->subscribe(channel.toAscii().data(),
+    [this](const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+    {
+      this->handleMessage(rbuf, channel);
+    });
+
+  if (mSubscription < 0)
+  {
+    mWriter->close();
+    return false;
+  }
+
+  ddLCMDispatcher::instance()->start();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMRecorder::stop()
+{
+  if (mSubscription >= 0)
+  {
+    ddLCMDispatcher::instance()->unsubscribe(mSubscription);
+    ddLCMDispatcher::instance()->stop();
+    mSubscription = -1;
+  }
+  mWriter->close();
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMRecorder::isRecording() const
+{
+  return mWriter->isOpen();
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMRecorder::handleMessage(const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+{
+  // the writer queue has a single producer, messages injected during log
+  // replay are delivered on the player thread instead of the receive thread
+  std::lock_guard<std::mutex> lock(mWriteMutex);
+  mWriter->write(channel, rbuf->data, rbuf->data_size, rbuf->recv_utime);
+}
+
+//-----------------------------------------------------------------------------
+QStringList ddLCMRecorder::filenames() const
+{
+  QStringList filenames;
+  std::vector<std::string> names = mWriter->filenames();
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    filenames << QString::fromLocal8Bit(names[i].c_str());
+  }
+  return filenames;
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddLCMRecorder::getNumberOfEvents() const
+{
+  return mWriter->numberOfEvents();
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddLCMRecorder::getDroppedEvents() const
+{
+  return mWriter->numberOfDroppedEvents();
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddLCMRecorder::getBytesWritten() const
+{
+  return mWriter->bytesWritten();
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMRecorder::decompressLog(const QString& inputFilename, const QString& outputFilename)
+{
+  return ddLCMLogWriter::decompressLog(inputFilename.toLocal8Bit().data(), outputFilename.toLocal8Bit().data());
+}
@@ -0,0 +1,84 @@
+#ifndef __ddLCMRecorder_h
+#define __ddLCMRecorder_h
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+#include <mutex>
+
+#include "ddAppConfigure.h"
+
+class ddLCMLogWriter;
+
+namespace lcm
+{
+  class ReceiveBuffer;
+}
+
+
+// Records lcm messages to a log file from inside the application.
+//
+// The recorder subscribes through the ddLCMDispatcher, so it shares the
+// application's lcm socket instead of opening another one like lcm-logger
+// does.  The receive thread only copies each message into the queue of a
+// ddLCMLogWriter, which writes the log on its own thread; if the writer falls
+// behind messages are dropped and counted rather than delaying the receive
+// thread.  Compression and file rollover are ddLCMLogWriter options.
+
+class DD_APP_EXPORT ddLCMRecorder : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  ddLCMRecorder(QObject* parent=NULL);
+  virtual ~ddLCMRecorder();
+
+  // Sets the channels to record, each a regular expression.  An empty list,
+  // the default, records every channel.
+  void setChannels(const QStringList& channels);
+  QStringList channels() const;
+
+  // Sets the compression to "none", "lz4" or "zstd".  Returns false if the
+  // compression is not in supportedCompressions().
+  bool setCompression(const QString& compression);
+  QString compression() const;
+  static QStringList supportedCompressions();
+
+  // Starts a new file when the current one would exceed the size in bytes
+  // of uncompressed log data, zero disables rollover.
+  void setMaxFileSize(qint64 maxFileSize);
+
+  // Sets the size in bytes of the queue between the receive thread and the
+  // writer thread.
+  void setQueueSize(qint64 queueSize);
+
+  // Options take effect at the next start().
+  bool start(const QString& filename);
+  void stop();
+  bool isRecording() const;
+
+  QStringList filenames() const;
+  qint64 getNumberOfEvents() const;
+  qint64 getDroppedEvents() const;
+  qint64 getBytesWritten() const;
+
+  // Converts a compressed log to an lcm log file.
+  static bool decompressLog(const QString& inputFilename, const QString& outputFilename);
+
+protected:
+
+  void handleMessage(const lcm::ReceiveBuffer* rbuf, const std::string& channel);
+
+  std::unique_ptr<ddLCMLogWriter> mWriter;
+  std::mutex mWriteMutex;
+  QStringList mChannels;
+  QString mCompression;
+  int mSubscription;
+
+  Q_DISABLE_COPY(ddLCMRecorder);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "ddLCMSharedMemoryPublisher.h"
+
+#include "ddLCMDispatcher.h"
+#include "ddSharedMemoryPublisher.h"
+
+#include <algorithm>
+
+namespace
+{
+
+const char* FallbackModeNames[] = {"auto", "always", "never"};
+
+}
+
+//-----------------------------------------------------------------------------
+ddLCMSharedMemoryPublisher::ddLCMSharedMemoryPublisher(QObject* parent) : QObject(parent)
+{
+  mPublisher.reset(new ddSharedMemoryPublisher(ddLCMDispatcher::instance()->lcmHandle()));
+}
+
+//-----------------------------------------------------------------------------
+ddLCMSharedMemoryPublisher::~ddLCMSharedMemoryPublisher()
+{
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMSharedMemoryPublisher::setNumberOfSlots(int numberOfSlots)
+{
+  mPublisher->setNumberOfSlots(std::max(0, numberOfSlots));
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMSharedMemoryPublisher::setSlotSize(int slotSize)
+{
+  mPublisher->setSlotSize(std::max(0, slotSize));
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMSharedMemoryPublisher::setMinimumMessageSize(int minimumMessageSize)
+{
+  mPublisher->setMinimumMessageSize(std::max(0, minimumMessageSize));
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMSharedMemoryPublisher::setFallbackMode(const QString& mode)
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    if (mode == FallbackModeNames[i])
+    {
+      mPublisher->setFallbackMode(static_cast<ddSharedMemoryPublisher::FallbackMode>(i));
+      return true;
+    }
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+QString ddLCMSharedMemoryPublisher::fallbackMode() const
+{
+  return FallbackModeNames[mPublisher->fallbackMode()];
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMSharedMemoryPublisher::publish(const QString& channel, const QByteArray& data)
+{
+  return mPublisher->publish(channel.toAscii().data(), data.constData(), data.size());
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddLCMSharedMemoryPublisher::getNumberOfSharedMemoryMessages() const
+{
+  return mPublisher->numberOfSharedMemoryMessages();
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMSharedMemoryPublisher::lcmIsHostLocal()
+{
+  return ddSharedMemoryPublisher::lcmIsHostLocal();
+}
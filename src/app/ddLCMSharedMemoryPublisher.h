@@ -0,0 +1,49 @@
+#ifndef __ddLCMSharedMemoryPublisher_h
+#define __ddLCMSharedMemoryPublisher_h
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+#include <memory>
+
+#include "ddAppConfigure.h"
+
+class ddSharedMemoryPublisher;
+
+
+// Publishes large messages on the dispatcher's lcm instance through shared
+// memory, see ddSharedMemoryPublisher.  Local processes that subscribe
+// through ddLCMDispatcher receive them without udp fragmentation.
+
+class DD_APP_EXPORT ddLCMSharedMemoryPublisher : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  ddLCMSharedMemoryPublisher(QObject* parent=NULL);
+  virtual ~ddLCMSharedMemoryPublisher();
+
+  void setNumberOfSlots(int numberOfSlots);
+  void setSlotSize(int slotSize);
+  void setMinimumMessageSize(int minimumMessageSize);
+
+  // Sets the fallback mode to "auto", "always" or "never".
+  bool setFallbackMode(const QString& mode);
+  QString fallbackMode() const;
+
+  bool publish(const QString& channel, const QByteArray& data);
+
+  qint64 getNumberOfSharedMemoryMessages() const;
+
+  static bool lcmIsHostLocal();
+
+protected:
+
+  std::unique_ptr<ddSharedMemoryPublisher> mPublisher;
+
+  Q_DISABLE_COPY(ddLCMSharedMemoryPublisher);
+};
+
+#endif
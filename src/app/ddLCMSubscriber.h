@@ -10,11 +10,22 @@
 #include <QMutex>
 #include <QMutexLocker>
 #include <QWaitCondition>
+#include <QQueue>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QTime>
+#include <QStringList>
+#include <QVariant>
 
 #include <lcm/lcm-cpp.hpp>
 
+#include <chrono>
+
 #include "ddFPSCounter.h"
+#include "ddLCMDispatcher.h"
+#include "ddLatencyHistogram.h"
+#include "ddLCMMessageBufferPool.h"
+#include "ddLCMTelemetry.h"
 #include "ddAppConfigure.h"
 
 
@@ -29,28 +40,86 @@ class DD_APP_EXPORT ddLCMSubscriber : public QObject
 
 public:
 
+  // Delivery policies, see setKeepLatest(), setKeepRing() and setByteBudget().
+  enum DeliveryPolicy
+  {
+    KeepLatest,
+    KeepRing,
+    ByteBudget
+  };
+
   ddLCMSubscriber(const QString& channel, QObject* parent=NULL) : QObject(parent)
   {
     mChannel = channel;
+    mSubscription = -1;
+    mLCMHandle = 0;
+    mLCMSubscription = 0;
     this->mEmitMessages = true;
-    this->mNotifyAllMessages = false;
+    this->mDeliveryPolicy = KeepLatest;
+    this->mMaxQueueLength = DefaultMaxQueueLength;
+    this->mMaxQueueBytes = DefaultMaxQueueBytes;
+    this->mQueueBytes = 0;
+    this->mMaxQueueDepth = 0;
+    this->mDroppedMessages = 0;
+    this->mDeliveryScheduled = false;
+    this->mUseWorkerPool = false;
+    this->mBatchDelivery = false;
     this->mRequiredElapsedMilliseconds = 0;
     this->connect(this, SIGNAL(messageReceivedInQueue(const QString&)), SLOT(onMessageInQueue(const QString&)));
+    ddLCMTelemetry::instance()->addSubscriber(this);
   }
 
   virtual ~ddLCMSubscriber()
   {
+    ddLCMTelemetry::instance()->removeSubscriber(this);
+
+    // removes the dispatcher subscription, or the subscription on a handle
+    // that is not the dispatcher's, so neither calls this object again
+    ddLCMSubscriber::unsubscribe(mLCMHandle);
+
+    // wait for a delivery that is running on the worker pool
+    QMutexLocker locker(&this->mMutex);
+    this->mEmitMessages = false;
+    while (this->mUseWorkerPool && this->mDeliveryScheduled)
+    {
+      this->mDeliveryDone.wait(&this->mMutex);
+    }
   }
 
+  // Subscribes through the ddLCMDispatcher if lcmHandle is the dispatcher's,
+  // so messages injected by log replay reach the subscriber too.  Any other
+  // lcm handle is subscribed to directly and does not receive injected
+  // messages.
   virtual void subscribe(lcm::LCM* lcmHandle)
   {
-    mSubscription = lcmHandle->subscribe(mChannel.toAscii().data(), &ddLCMSubscriber::messageHandler, this);
+    if (this->subscribeDirectly(lcmHandle))
+    {
+      mLCMSubscription = lcmHandle->subscribe(mChannel.toAscii().data(), &ddLCMSubscriber::messageHandler, this);
+      return;
+    }
+
+    mSubscription = ddLCMDispatcher::instance()->subscribe(mChannel.toAscii().data(),
+      [this](const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+      {
+        this->messageHandler(rbuf, channel);
+      });
   }
 
   virtual void unsubscribe(lcm::LCM* lcmHandle)
   {
-    lcmHandle->unsubscribe(mSubscription);
-    mSubscription = 0;
+    ddNotUsed(lcmHandle);
+    if (mLCMSubscription)
+    {
+      mLCMHandle->unsubscribe(mLCMSubscription);
+      mLCMHandle = 0;
+      mLCMSubscription = 0;
+    }
+
+    if (mSubscription >= 0)
+    {
+      ddLCMDispatcher::instance()->unsubscribe(mSubscription);
+      mSubscription = -1;
+    }
   }
 
   const QString& channel() const
@@ -68,10 +137,56 @@ public:
     return this->mEmitMessages;
   }
 
+  // See workerPoolIsEnabled()
+  void setWorkerPoolEnabled(bool enabled)
+  {
+    QMutexLocker locker(&this->mMutex);
+    this->mUseWorkerPool = enabled;
+  }
+
+  // See batchDeliveryIsEnabled()
+  void setBatchDeliveryEnabled(bool enabled)
+  {
+    QMutexLocker locker(&this->mMutex);
+    this->mBatchDelivery = enabled;
+  }
+
+  // If true, the messages that were queued since the last delivery are
+  // delivered together by one messagesReceived() signal instead of one
+  // messageReceived() signal per message.  This is intended for high rate
+  // channels with Python callbacks, where each signal crosses into the
+  // interpreter.  Combine with setKeepRing() or setByteBudget(), with the
+  // default KeepLatest policy a batch holds a single message.  The default
+  // is false.
+  bool batchDeliveryIsEnabled() const
+  {
+    QMutexLocker locker(&this->mMutex);
+    return this->mBatchDelivery;
+  }
+
+  // If true, the messageReceived() signal is emitted on a thread of the global
+  // QThreadPool instead of the main thread, so slots connected with
+  // Qt::DirectConnection decode messages in parallel with other channels.
+  // At most one pool thread delivers this subscriber's messages at a time, so
+  // messages are delivered in the order they were received.  Slots must
+  // publish their results in a thread safe way.  The default is false.
+  bool workerPoolIsEnabled() const
+  {
+    QMutexLocker locker(&this->mMutex);
+    return this->mUseWorkerPool;
+  }
+
   // See notifyAllMessagesIsEnabled()
   void setNotifyAllMessagesEnabled(bool enabled)
   {
-    this->mNotifyAllMessages = enabled;
+    if (enabled)
+    {
+      this->setKeepRing(DefaultMaxQueueLength);
+    }
+    else
+    {
+      this->setKeepLatest();
+    }
   }
 
   // If the main thread is busy while several LCM messages are received by this
@@ -83,9 +198,75 @@ public:
   // flag to true if it is important to never miss a message.  The default is
   // false, meaning that messages will be dropped if the main thread is not
   // available to process them before a new message is received.
+  //
+  // Enabling this flag selects the KeepRing policy with a capacity of
+  // DefaultMaxQueueLength messages, so a main thread that falls behind drops
+  // the oldest messages instead of growing an unbounded backlog.
   bool notifyAllMessagesIsEnabled() const
   {
-    return this->mNotifyAllMessages;
+    return this->mDeliveryPolicy != KeepLatest;
+  }
+
+  // Keeps only the most recently received message.  This is the default.
+  void setKeepLatest()
+  {
+    this->setDeliveryPolicy(KeepLatest, 1, this->mMaxQueueBytes);
+  }
+
+  // Keeps up to maxMessages messages, the oldest message is dropped when a
+  // message is received and the queue is full.
+  void setKeepRing(int maxMessages)
+  {
+    this->setDeliveryPolicy(KeepRing, qMax(1, maxMessages), this->mMaxQueueBytes);
+  }
+
+  // Keeps messages while their total size is at most maxBytes, the oldest
+  // messages are dropped to make room for a new message.  The newest message
+  // is always kept, even if it is larger than the budget.
+  void setByteBudget(qint64 maxBytes)
+  {
+    this->setDeliveryPolicy(ByteBudget, this->mMaxQueueLength, qMax(qint64(0), maxBytes));
+  }
+
+  int getDeliveryPolicy() const
+  {
+    return this->mDeliveryPolicy;
+  }
+
+  // The number of messages that were dropped by the delivery policy since the
+  // last call to resetQueueStatistics().
+  qint64 getDroppedMessageCount() const
+  {
+    QMutexLocker locker(&this->mMutex);
+    return this->mDroppedMessages;
+  }
+
+  // The number of messages waiting to be delivered.
+  int getQueueDepth() const
+  {
+    QMutexLocker locker(&this->mMutex);
+    return this->mQueue.size();
+  }
+
+  // The total size of the messages waiting to be delivered.
+  qint64 getQueueBytes() const
+  {
+    QMutexLocker locker(&this->mMutex);
+    return this->mQueueBytes;
+  }
+
+  // The largest queue depth seen since the last call to resetQueueStatistics().
+  int getMaxQueueDepth() const
+  {
+    QMutexLocker locker(&this->mMutex);
+    return this->mMaxQueueDepth;
+  }
+
+  void resetQueueStatistics()
+  {
+    QMutexLocker locker(&this->mMutex);
+    this->mDroppedMessages = 0;
+    this->mMaxQueueDepth = this->mQueue.size();
   }
 
   void setSpeedLimit(double hertz)
@@ -102,60 +283,322 @@ public:
 
   double getMessageRate()
   {
+    QMutexLocker locker(&this->mMutex);
     return this->mFPSCounter.averageFPS();
   }
 
-  QByteArray getNextMessage(int timeout)
+  double getByteRate()
   {
+    QMutexLocker locker(&this->mMutex);
+    return this->mByteRateCounter.averageFPS();
+  }
+
+  // The keys of the map returned by getTelemetry().  Latencies are in
+  // microseconds, see ddLCMTelemetry.
+  static QStringList telemetryNames()
+  {
+    return QStringList()
+      << "channel" << "message_rate" << "byte_rate" << "dropped" << "queue_depth" << "max_queue_depth"
+      << "receive_p50" << "receive_p99" << "receive_max"
+      << "delivery_p50" << "delivery_p99" << "delivery_max"
+      << "handler_p50" << "handler_p99" << "handler_max";
+  }
 
+  QVariantMap getTelemetry()
+  {
     QMutexLocker locker(&this->mMutex);
 
-    QByteArray msg = this->mLastMessage;
-    this->mLastMessage.clear();
+    QVariantMap telemetry;
+    telemetry["channel"] = this->mChannel;
+    telemetry["message_rate"] = this->mFPSCounter.averageFPS();
+    telemetry["byte_rate"] = this->mByteRateCounter.averageFPS();
+    telemetry["dropped"] = this->mDroppedMessages;
+    telemetry["queue_depth"] = this->mQueue.size();
+    telemetry["max_queue_depth"] = this->mMaxQueueDepth;
+    telemetry["receive_p50"] = this->mReceiveLatency.percentile(50);
+    telemetry["receive_p99"] = this->mReceiveLatency.percentile(99);
+    telemetry["receive_max"] = this->mReceiveLatency.max();
+    telemetry["delivery_p50"] = this->mDeliveryLatency.percentile(50);
+    telemetry["delivery_p99"] = this->mDeliveryLatency.percentile(99);
+    telemetry["delivery_max"] = this->mDeliveryLatency.max();
+    telemetry["handler_p50"] = this->mHandlerDuration.percentile(50);
+    telemetry["handler_p99"] = this->mHandlerDuration.percentile(99);
+    telemetry["handler_max"] = this->mHandlerDuration.max();
+    return telemetry;
+  }
+
+  void resetTelemetry()
+  {
+    QMutexLocker locker(&this->mMutex);
+    this->mReceiveLatency.reset();
+    this->mDeliveryLatency.reset();
+    this->mHandlerDuration.reset();
+    this->mDroppedMessages = 0;
+    this->mMaxQueueDepth = this->mQueue.size();
+  }
 
+  // Returns the maximum number of received messages that were held by
+  // consumers at the same time.  See ddLCMMessageBufferPool.
+  int getBufferPoolHighWaterMark() const
+  {
+    return this->mBufferPool.highWaterMark();
+  }
 
-    if (msg.size())
+  // Returns the number of bytes of message buffers at the high water mark.
+  qint64 getBufferPoolHighWaterMarkBytes() const
+  {
+    return this->mBufferPool.highWaterMarkBytes();
+  }
+
+  // Returns the oldest queued message.  If the queue is empty, waits up to
+  // timeout milliseconds for a message and returns an empty array on timeout.
+  QByteArray getNextMessage(int timeout)
+  {
+
+    QMutexLocker locker(&this->mMutex);
+
+    if (this->mQueue.size())
     {
-      return msg;
+      return this->dequeue();
     }
 
     bool haveNewMessage = this->mWaitCondition.wait(&this->mMutex, timeout);
 
-    if (!haveNewMessage)
+    if (!haveNewMessage || this->mQueue.isEmpty())
     {
       return QByteArray();
     }
 
-    msg = this->mLastMessage;
-    this->mLastMessage.clear();
-
-    return msg;
+    return this->dequeue();
   }
 
 signals:
 
+  // The messageData array shares a pooled buffer with the subscriber, copying
+  // the QByteArray does not copy the message bytes.
   void messageReceived(const QByteArray& messageData, const QString& channel);
+
+  // Emitted instead of messageReceived() when batch delivery is enabled.  The
+  // list holds a QByteArray per message, oldest first.
+  void messagesReceived(const QVariantList& messages, const QString& channel);
+
   void messageReceivedInQueue(const QString& channel);
 
 protected slots:
 
   void onMessageInQueue(const QString& channel)
   {
-    QByteArray msg = this->getNextMessage(0);
-    emit this->messageReceived(msg, channel);
+    // deliver only the messages that are queued now, messages that arrive
+    // while they are delivered are announced by a new messageReceivedInQueue()
+    QQueue<QueuedMessage> messages;
+    {
+      QMutexLocker locker(&this->mMutex);
+      messages.swap(this->mQueue);
+      this->mQueueBytes = 0;
+      this->mDeliveryScheduled = false;
+    }
+
+    this->deliver(messages, channel);
   }
 
 
 protected:
 
+  struct QueuedMessage
+  {
+    QByteArray mData;
+    qint64 mEnqueueUtime;
+  };
+
+  // Returns true and remembers the handle if lcmHandle is not the
+  // dispatcher's lcm handle, see subscribe().
+  bool subscribeDirectly(lcm::LCM* lcmHandle)
+  {
+    if (!lcmHandle || lcmHandle == ddLCMDispatcher::instance()->lcmHandle())
+    {
+      return false;
+    }
+    mLCMHandle = lcmHandle;
+    return true;
+  }
+
+  static qint64 currentUtime()
+  {
+    // the same clock as lcm::ReceiveBuffer::recv_utime
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  // Emits messageReceived() for each message, or messagesReceived() once for
+  // all messages, and records the delivery latency and the time spent in the
+  // connected slots.
+  void deliver(QQueue<QueuedMessage>& messages, const QString& channel)
+  {
+    this->mMutex.lock();
+    const bool batchDelivery = this->mBatchDelivery;
+    this->mMutex.unlock();
+
+    if (batchDelivery && !messages.isEmpty())
+    {
+      QVariantList batch;
+      batch.reserve(messages.size());
+
+      const qint64 startUtime = currentUtime();
+      {
+        QMutexLocker locker(&this->mMutex);
+        foreach (const QueuedMessage& message, messages)
+        {
+          batch.append(message.mData);
+          this->mDeliveryLatency.record(startUtime - message.mEnqueueUtime);
+        }
+      }
+      messages.clear();
+
+      emit this->messagesReceived(batch, channel);
+      const qint64 endUtime = currentUtime();
+
+      QMutexLocker locker(&this->mMutex);
+      this->mHandlerDuration.record(endUtime - startUtime);
+      return;
+    }
+
+    while (!messages.isEmpty())
+    {
+      QueuedMessage message = messages.dequeue();
+
+      const qint64 startUtime = currentUtime();
+      emit this->messageReceived(message.mData, channel);
+      const qint64 endUtime = currentUtime();
+
+      QMutexLocker locker(&this->mMutex);
+      this->mDeliveryLatency.record(startUtime - message.mEnqueueUtime);
+      this->mHandlerDuration.record(endUtime - startUtime);
+    }
+  }
+
+  class DeliveryTask : public QRunnable
+  {
+  public:
+
+    DeliveryTask(ddLCMSubscriber* subscriber, const QString& channel)
+      : mSubscriber(subscriber), mChannel(channel)
+    {
+    }
+
+    void run()
+    {
+      mSubscriber->deliverOnWorker(mChannel);
+    }
+
+  private:
+
+    ddLCMSubscriber* mSubscriber;
+    QString mChannel;
+  };
+
+  // Delivers queued messages on a worker pool thread until the queue is empty.
+  void deliverOnWorker(const QString& channel)
+  {
+    while (true)
+    {
+      QQueue<QueuedMessage> messages;
+      {
+        QMutexLocker locker(&this->mMutex);
+        if (this->mQueue.isEmpty() || !this->mEmitMessages)
+        {
+          this->mDeliveryScheduled = false;
+          this->mDeliveryDone.wakeAll();
+          return;
+        }
+        messages.swap(this->mQueue);
+        this->mQueueBytes = 0;
+      }
+
+      this->deliver(messages, channel);
+    }
+  }
+
+  enum
+  {
+    DefaultMaxQueueLength = 1000,
+    DefaultMaxQueueBytes = 64*1024*1024
+  };
+
+  void setDeliveryPolicy(DeliveryPolicy policy, int maxMessages, qint64 maxBytes)
+  {
+    QMutexLocker locker(&this->mMutex);
+    this->mDeliveryPolicy = policy;
+    this->mMaxQueueLength = maxMessages;
+    this->mMaxQueueBytes = maxBytes;
+    this->trimQueue();
+  }
+
+  // Returns true if the queue holds more than the delivery policy allows.
+  // Called with mMutex locked.
+  bool queueIsOverLimit() const
+  {
+    if (this->mQueue.size() <= 1)
+    {
+      return false;
+    }
+
+    switch (this->mDeliveryPolicy)
+    {
+      case KeepRing:
+        return this->mQueue.size() > this->mMaxQueueLength;
+      case ByteBudget:
+        return this->mQueueBytes > this->mMaxQueueBytes;
+      default:
+        return true;
+    }
+  }
+
+  // Drops the oldest messages until the queue is within the policy limits.
+  // Called with mMutex locked.
+  void trimQueue()
+  {
+    while (this->queueIsOverLimit())
+    {
+      this->mQueueBytes -= this->mQueue.dequeue().mData.size();
+      ++this->mDroppedMessages;
+    }
+  }
+
+  // Called with mMutex locked.
+  void enqueue(const QByteArray& messageBytes)
+  {
+    QueuedMessage message;
+    message.mData = messageBytes;
+    message.mEnqueueUtime = currentUtime();
+    this->mQueue.enqueue(message);
+    this->mQueueBytes += messageBytes.size();
+    this->trimQueue();
+    this->mMaxQueueDepth = qMax(this->mMaxQueueDepth, this->mQueue.size());
+  }
+
+  // Called with mMutex locked.
+  QByteArray dequeue()
+  {
+    QByteArray messageBytes = this->mQueue.dequeue().mData;
+    this->mQueueBytes -= messageBytes.size();
+    return messageBytes;
+  }
 
   void messageHandler(const lcm::ReceiveBuffer* rbuf, const std::string& channel)
   {
     ddNotUsed(channel);
 
-    QByteArray messageBytes = QByteArray((char*)rbuf->data, rbuf->data_size);
+    QByteArray messageBytes = this->mBufferPool.acquire(rbuf->data, rbuf->data_size);
 
-    mFPSCounter.update();
+    {
+      QMutexLocker locker(&this->mMutex);
+      this->mFPSCounter.update();
+      this->mByteRateCounter.update(rbuf->data_size);
+      // recv_utime of an injected message is its log time, which the
+      // dispatcher's clock follows during replay
+      const qint64 receiveUtime = mLCMHandle ? currentUtime() : ddLCMDispatcher::instance()->currentUtime();
+      this->mReceiveLatency.record(receiveUtime - rbuf->recv_utime);
+    }
 
     if (this->mEmitMessages)
     {
@@ -163,21 +606,23 @@ protected:
       {
         this->mTimer.restart();
 
-        if (this->mNotifyAllMessages)
+        // messages are delivered on the main thread by onMessageInQueue(), or
+        // on the worker pool by deliverOnWorker().  Only schedule a delivery
+        // if one is not already pending.
+        this->mMutex.lock();
+        this->enqueue(messageBytes);
+        bool doSchedule = !this->mDeliveryScheduled;
+        this->mDeliveryScheduled = true;
+        bool useWorkerPool = this->mUseWorkerPool;
+        this->mMutex.unlock();
+
+        if (doSchedule && useWorkerPool)
         {
-          emit this->messageReceived(messageBytes, QString(channel.c_str()));
+          QThreadPool::globalInstance()->start(new DeliveryTask(this, QString(channel.c_str())));
         }
-        else
+        else if (doSchedule)
         {
-          this->mMutex.lock();
-          bool doEmit = !this->mLastMessage.size();
-          this->mLastMessage = messageBytes;
-          this->mMutex.unlock();
-
-          if (doEmit)
-          {
-            emit this->messageReceivedInQueue(QString(channel.c_str()));
-          }
+          emit this->messageReceivedInQueue(QString(channel.c_str()));
         }
 
       }
@@ -185,7 +630,7 @@ protected:
     else
     {
       this->mMutex.lock();
-      this->mLastMessage = messageBytes;
+      this->enqueue(messageBytes);
       this->mMutex.unlock();
       this->mWaitCondition.wakeAll();
     }
@@ -193,15 +638,31 @@ protected:
   }
 
   bool mEmitMessages;
-  bool mNotifyAllMessages;
+  DeliveryPolicy mDeliveryPolicy;
+  int mMaxQueueLength;
+  qint64 mMaxQueueBytes;
   int mRequiredElapsedMilliseconds;
   mutable QMutex mMutex;
   QWaitCondition mWaitCondition;
-  QByteArray mLastMessage;
+  QQueue<QueuedMessage> mQueue;
+  qint64 mQueueBytes;
+  int mMaxQueueDepth;
+  qint64 mDroppedMessages;
+  bool mDeliveryScheduled;
+  bool mUseWorkerPool;
+  bool mBatchDelivery;
+  QWaitCondition mDeliveryDone;
   ddFPSCounter mFPSCounter;
+  ddFPSCounter mByteRateCounter;
+  ddLatencyHistogram mReceiveLatency;
+  ddLatencyHistogram mDeliveryLatency;
+  ddLatencyHistogram mHandlerDuration;
+  ddLCMMessageBufferPool mBufferPool;
   QTime mTimer;
   QString mChannel;
-  lcm::Subscription* mSubscription;
+  int mSubscription;
+  lcm::LCM* mLCMHandle;
+  lcm::Subscription* mLCMSubscription;
 
 };
 
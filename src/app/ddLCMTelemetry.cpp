@@ -0,0 +1,71 @@
+#include "ddLCMTelemetry.h"
+
+#include "ddLCMSubscriber.h"
+
+//-----------------------------------------------------------------------------
+ddLCMTelemetry* ddLCMTelemetry::instance()
+{
+  static ddLCMTelemetry* telemetry = new ddLCMTelemetry;
+  return telemetry;
+}
+
+//-----------------------------------------------------------------------------
+ddLCMTelemetry::ddLCMTelemetry(QObject* parent) : QObject(parent)
+{
+}
+
+//-----------------------------------------------------------------------------
+ddLCMTelemetry::~ddLCMTelemetry()
+{
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMTelemetry::addSubscriber(ddLCMSubscriber* subscriber)
+{
+  QMutexLocker locker(&mMutex);
+  mSubscribers.append(subscriber);
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMTelemetry::removeSubscriber(ddLCMSubscriber* subscriber)
+{
+  QMutexLocker locker(&mMutex);
+  mSubscribers.removeAll(subscriber);
+}
+
+//-----------------------------------------------------------------------------
+int ddLCMTelemetry::numberOfSubscribers() const
+{
+  QMutexLocker locker(&mMutex);
+  return mSubscribers.size();
+}
+
+//-----------------------------------------------------------------------------
+QStringList ddLCMTelemetry::getStatisticsNames() const
+{
+  return ddLCMSubscriber::telemetryNames();
+}
+
+//-----------------------------------------------------------------------------
+QVariantList ddLCMTelemetry::getStatistics() const
+{
+  QMutexLocker locker(&mMutex);
+
+  QVariantList statistics;
+  foreach (ddLCMSubscriber* subscriber, mSubscribers)
+  {
+    statistics.append(subscriber->getTelemetry());
+  }
+  return statistics;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMTelemetry::resetStatistics()
+{
+  QMutexLocker locker(&mMutex);
+
+  foreach (ddLCMSubscriber* subscriber, mSubscribers)
+  {
+    subscriber->resetTelemetry();
+  }
+}
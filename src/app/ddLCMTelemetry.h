@@ -0,0 +1,58 @@
+#ifndef __ddLCMTelemetry_h
+#define __ddLCMTelemetry_h
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QStringList>
+#include <QVariant>
+#include "ddAppConfigure.h"
+
+
+class ddLCMSubscriber;
+
+// A registry of every ddLCMSubscriber in the process.
+//
+// Subscribers add themselves when they are constructed and remove themselves
+// when they are destroyed.  getStatistics() returns a snapshot of the rates,
+// drop counts and latency histograms of all subscribers, one QVariantMap per
+// subscriber, with the keys listed by getStatisticsNames().  Latencies are
+// in microseconds:
+//
+//   receive latency:   lcm packet received to subscriber message handler,
+//                      during log replay the log time of the message to
+//                      the log time of the last injected message
+//   delivery latency:  message handler to messageReceived() emitted, time
+//                      spent waiting for the main thread or worker pool
+//   handler duration:  time spent in the slots connected to messageReceived()
+
+class DD_APP_EXPORT ddLCMTelemetry : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  static ddLCMTelemetry* instance();
+
+  void addSubscriber(ddLCMSubscriber* subscriber);
+  void removeSubscriber(ddLCMSubscriber* subscriber);
+
+  int numberOfSubscribers() const;
+
+  QStringList getStatisticsNames() const;
+  QVariantList getStatistics() const;
+
+  void resetStatistics();
+
+protected:
+
+  ddLCMTelemetry(QObject* parent=0);
+  virtual ~ddLCMTelemetry();
+
+  mutable QMutex mMutex;
+  QList<ddLCMSubscriber*> mSubscribers;
+
+  Q_DISABLE_COPY(ddLCMTelemetry);
+};
+
+#endif
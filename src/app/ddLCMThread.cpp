@@ -1,20 +1,17 @@
 #include "ddLCMThread.h"
 
 #include "ddLCMSubscriber.h"
+#include "ddLCMEventLoop.h"
+#include "ddLCMDispatcher.h"
 
 #include <lcm/lcm-cpp.hpp>
 #include <iostream>
 
-#ifdef _WIN32
-  #include <Windows.h>
-#endif
-
 //-----------------------------------------------------------------------------
 ddLCMThread::ddLCMThread(QObject* parent) : QThread(parent)
 {
-  mSelectTimeout = 0.3;
-  mShouldStop = false;
   mLCM = 0;
+  mEventLoop = ddLCMDispatcher::instance()->eventLoop();
 }
 
 //-----------------------------------------------------------------------------
@@ -33,7 +30,9 @@ void ddLCMThread::initLCM()
     return;
   }
 
-  mLCM = new lcm::LCM();
+  // the lcm handle is shared with the vtk lcm sources, it is serviced by the
+  // dispatcher's receive thread
+  mLCM = ddLCMDispatcher::instance()->lcmHandle();
   if (!mLCM->good())
   {
     printf("initLCM() failed.\n");
@@ -57,64 +56,62 @@ void ddLCMThread::removeSubscriber(ddLCMSubscriber* subscriber)
 }
 
 //-----------------------------------------------------------------------------
-bool ddLCMThread::waitForLCM(double timeout)
+void ddLCMThread::run()
 {
-  int lcmFd = this->mLCM->getFileno();
-
-  timeval tv;
-  tv.tv_sec = (int) timeout;
-  tv.tv_usec = (int) ((timeout - tv.tv_sec) * 1.0e6);
+  this->initLCM();
 
-  fd_set fds;
-  FD_ZERO(&fds);
-  FD_SET(lcmFd, &fds);
+  // hold a reference on the dispatcher while this thread is running
+  ddLCMDispatcher::instance()->start();
+  this->exec();
+  ddLCMDispatcher::instance()->stop();
+}
 
-  int status = select(lcmFd + 1, &fds, 0, 0, &tv);
-  if (status == -1 && errno != EINTR)
-  {
-    printf("select() returned error: %d\n", errno);
-  }
-  else if (status == -1 && errno == EINTR)
+//-----------------------------------------------------------------------------
+void ddLCMThread::stop()
+{
+  if (!this->isRunning())
   {
-    printf("select() interrupted\n");
+    return;
   }
-  return (status > 0 && FD_ISSET(lcmFd, &fds));
+
+  // the dispatcher wakes its event loop immediately, there is no polling
+  // timeout to wait for
+  this->quit();
+  this->wait();
 }
 
 //-----------------------------------------------------------------------------
-void ddLCMThread::threadLoopWithSelect()
+double ddLCMThread::getLastDispatchLatency() const
 {
-  while (!this->mShouldStop)
-  {
-    bool lcmReady = this->waitForLCM(this->mSelectTimeout);
-
-    if (this->mShouldStop)
-    {
-      break;
-    }
-
-    if (lcmReady)
-    {
-      if (this->mLCM->handle() != 0)
-      {
-        std::cout << "Error: lcm->handle() returned non-zero.  Stopping thread." << std::endl;
-        break;
-      }
-    }
-  }
+  return mEventLoop->lastDispatchLatency();
 }
 
 //-----------------------------------------------------------------------------
-void ddLCMThread::run()
+double ddLCMThread::getAverageDispatchLatency() const
 {
-  this->mShouldStop = false;
-  this->initLCM();
-  this->threadLoopWithSelect();
+  return mEventLoop->averageDispatchLatency();
 }
 
 //-----------------------------------------------------------------------------
-void ddLCMThread::stop()
+double ddLCMThread::getMaxDispatchLatency() const
 {
-  mShouldStop = true;
-  this->wait();
+  return mEventLoop->maxDispatchLatency();
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMThread::resetDispatchLatency()
+{
+  mEventLoop->resetDispatchLatency();
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddLCMThread::getSharedMemoryMessages() const
+{
+  return ddLCMDispatcher::instance()->numberOfSharedMemoryMessages();
+}
+
+//-----------------------------------------------------------------------------
+qint64 ddLCMThread::getSharedMemoryOverruns() const
+{
+  return ddLCMDispatcher::instance()->numberOfSharedMemoryOverruns();
 }
@@ -7,6 +7,7 @@
 
 
 class ddLCMSubscriber;
+class ddLCMEventLoop;
 
 namespace lcm
 {
@@ -27,23 +28,39 @@ public:
   void addSubscriber(ddLCMSubscriber* subscriber);
   void removeSubscriber(ddLCMSubscriber* subscriber);
 
+  // The process wide lcm handle owned by ddLCMDispatcher.
   lcm::LCM* lcmHandle()
   {
     this->initLCM();
     return mLCM;
   }
 
+  // The event loop of the dispatcher's receive thread.  Additional lcm
+  // handles and file descriptors can be added to the loop so they are
+  // serviced by the receive thread.
+  ddLCMEventLoop* eventLoop() const
+  {
+    return mEventLoop;
+  }
+
+  // Dispatch latency statistics of the receive thread, in seconds.
+  double getLastDispatchLatency() const;
+  double getAverageDispatchLatency() const;
+  double getMaxDispatchLatency() const;
+  void resetDispatchLatency();
+
+  // Messages received from shared memory, see ddSharedMemoryPublisher.
+  qint64 getSharedMemoryMessages() const;
+  qint64 getSharedMemoryOverruns() const;
+
  protected:
 
   void run();
-  void threadLoopWithSelect();
-  bool waitForLCM(double timeout);
   void initLCM();
 
-  bool mShouldStop;
-  double mSelectTimeout;
   QList<ddLCMSubscriber*> mSubscribers;
   lcm::LCM* mLCM;
+  ddLCMEventLoop* mEventLoop;
 
   QMutex mMutex;
 };
@@ -0,0 +1,144 @@
+#ifndef __ddLatencyHistogram_h
+#define __ddLatencyHistogram_h
+
+#include <QVector>
+#include "ddAppConfigure.h"
+
+
+// A histogram of latencies in microseconds with logarithmic buckets.
+//
+// The bucket layout follows HdrHistogram: values below 32 us have their own
+// bucket, above that each power of two range is split into 16 linear
+// sub-buckets, so any recorded value is reported within about 6% of its
+// true value.  Values from 1 us to about 19 hours use a fixed table of 544
+// counters; recording a value never allocates.
+//
+// The class is not thread safe, callers serialize access.
+
+class DD_APP_EXPORT ddLatencyHistogram
+{
+public:
+
+  ddLatencyHistogram()
+  {
+    mCounts.fill(0, NumberOfBuckets);
+    this->reset();
+  }
+
+  ~ddLatencyHistogram()
+  {
+  }
+
+  void record(qint64 microseconds)
+  {
+    if (microseconds < 0)
+    {
+      microseconds = 0;
+    }
+
+    ++mCounts[bucketIndex(microseconds)];
+    ++mTotalCount;
+    mTotal += microseconds;
+    if (microseconds > mMax)
+    {
+      mMax = microseconds;
+    }
+  }
+
+  void reset()
+  {
+    mCounts.fill(0);
+    mTotalCount = 0;
+    mTotal = 0;
+    mMax = 0;
+  }
+
+  qint64 count() const
+  {
+    return mTotalCount;
+  }
+
+  qint64 max() const
+  {
+    return mMax;
+  }
+
+  double mean() const
+  {
+    return mTotalCount ? double(mTotal) / mTotalCount : 0.0;
+  }
+
+  // Returns the highest value in the bucket that contains the given
+  // percentile, percentile is in the range [0, 100].
+  qint64 percentile(double percentile) const
+  {
+    if (!mTotalCount)
+    {
+      return 0;
+    }
+
+    const qint64 target = qMax(qint64(1), qint64(percentile / 100.0 * mTotalCount + 0.5));
+    qint64 cumulativeCount = 0;
+    for (int i = 0; i < NumberOfBuckets; ++i)
+    {
+      cumulativeCount += mCounts[i];
+      if (cumulativeCount >= target)
+      {
+        return qMin(bucketHighValue(i), mMax);
+      }
+    }
+    return mMax;
+  }
+
+private:
+
+  enum
+  {
+    LinearBuckets = 32,
+    SubBuckets = 16,
+    MaxShift = 32,
+    NumberOfBuckets = LinearBuckets + MaxShift * SubBuckets
+  };
+
+  static int bucketIndex(qint64 value)
+  {
+    if (value < LinearBuckets)
+    {
+      return static_cast<int>(value);
+    }
+
+    // shift the value so it lands in [SubBuckets, 2*SubBuckets)
+    int shift = 0;
+    while ((value >> shift) >= 2*SubBuckets)
+    {
+      ++shift;
+    }
+
+    if (shift > MaxShift)
+    {
+      return NumberOfBuckets - 1;
+    }
+
+    return LinearBuckets + (shift - 1) * SubBuckets + static_cast<int>((value >> shift) - SubBuckets);
+  }
+
+  static qint64 bucketHighValue(int index)
+  {
+    if (index < LinearBuckets)
+    {
+      return index;
+    }
+
+    const int offset = index - LinearBuckets;
+    const int shift = offset / SubBuckets + 1;
+    const qint64 subBucket = offset % SubBuckets + SubBuckets;
+    return ((subBucket + 1) << shift) - 1;
+  }
+
+  QVector<qint64> mCounts;
+  qint64 mTotalCount;
+  qint64 mTotal;
+  qint64 mMax;
+};
+
+#endif
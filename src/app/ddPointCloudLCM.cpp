@@ -1,45 +1,31 @@
 #include "ddPointCloudLCM.h"
 
-#include <vtkIdTypeArray.h>
-#include <vtkCellArray.h>
 #include <vtkNew.h>
+#include <vtkUnsignedCharArray.h>
 
-#include <multisense_utils/conversions_lcm.hpp>
-
-namespace pcl
-{
-  // Euclidean Velodyne coordinate, including intensity and ring number. 
-  struct PointXYZIR
-  {
-    PCL_ADD_POINT4D;                    // quad-word XYZ
-    float    intensity;                 ///< laser intensity reading
-    uint16_t ring;                      ///< laser ring number
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW     // ensure proper alignment
-  } EIGEN_ALIGN16;
-
-};
-
-POINT_CLOUD_REGISTER_POINT_STRUCT(pcl::PointXYZIR,
-                                  (float, x, x)
-                                  (float, y, y)
-                                  (float, z, z)
-                                  (float, intensity, intensity)
-                                  (uint16_t, ring, ring))
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 
 //-----------------------------------------------------------------------------
 ddPointCloudLCM::ddPointCloudLCM(QObject* parent) : QObject(parent)
 {
   mBotParam = 0;
+  mLCM = 0;
+  mUtime = 0;
+
+  mPointCloudChannel = "POINTCLOUD";
+  mPointCloud2Channel = "VELODYNE";
 
   mPolyData = vtkSmartPointer<vtkPolyData>::New();
 }
 
 
 //-----------------------------------------------------------------------------
-void ddPointCloudLCM::init(ddLCMThread* lcmThread, const QString& botConfigFile)
+void ddPointCloudLCM::initBotParam(ddLCMThread* lcmThread, const QString& botConfigFile)
 {
-
   if (botConfigFile.length()) {
     mBotParam = bot_param_new_from_file(botConfigFile.toAscii().data());
   } else {
@@ -48,95 +34,330 @@ void ddPointCloudLCM::init(ddLCMThread* lcmThread, const QString& botConfigFile)
           lcmThread->lcmHandle()->getUnderlyingLCM(), 0);
     }
   }
-  
+
   mLCM = lcmThread;
+}
 
-  QString channelName = "POINTCLOUD";
-  ddLCMSubscriber* subscriber = new ddLCMSubscriber(channelName, this);
-  this->connect(subscriber, SIGNAL(messageReceived(const QByteArray&, const QString&)),
-          SLOT(onPointCloudFrame(const QByteArray&, const QString&)), Qt::DirectConnection);
-  mLCM->addSubscriber(subscriber);
 
-  QString channelName2 = "VELODYNE";
-  ddLCMSubscriber* subscriber2 = new ddLCMSubscriber(channelName2, this);
-  this->connect(subscriber2, SIGNAL(messageReceived(const QByteArray&, const QString&)),
-          SLOT(onPointCloud2Frame(const QByteArray&, const QString&)), Qt::DirectConnection);
-  mLCM->addSubscriber(subscriber2);
+//-----------------------------------------------------------------------------
+void ddPointCloudLCM::init(ddLCMThread* lcmThread, const QString& botConfigFile)
+{
+  this->initBotParam(lcmThread, botConfigFile);
+  this->subscribe();
+}
 
+
+//-----------------------------------------------------------------------------
+void ddPointCloudLCM::init(ddLCMThread* lcmThread, const QString& botConfigFile, const QString& sensorName)
+{
+  this->initBotParam(lcmThread, botConfigFile);
+
+  const QString prefix = QString("point_clouds.") + sensorName + QString(".");
+  if (!mBotParam || !bot_param_has_key(mBotParam, (QString("point_clouds.") + sensorName).toAscii().data())) {
+    printf("Could not find point_clouds.%s in the config, using the default channels\n", sensorName.toAscii().data());
+  } else {
+    const char* keys[] = {"pointcloud_channel", "pointcloud2_channel"};
+    QString* channels[] = {&mPointCloudChannel, &mPointCloud2Channel};
+    for (int i = 0; i < 2; ++i) {
+      char* channelName = 0;
+      if (bot_param_get_str(mBotParam, (prefix + keys[i]).toAscii().data(), &channelName) == 0) {
+        *channels[i] = channelName;
+        free(channelName);
+      } else {
+        channels[i]->clear();
+      }
+    }
+  }
+
+  this->subscribe();
 }
 
 
+//-----------------------------------------------------------------------------
+void ddPointCloudLCM::subscribe()
+{
+  if (mPointCloudChannel.length()) {
+    ddLCMSubscriber* subscriber = new ddLCMSubscriber(mPointCloudChannel, this);
+    subscriber->setWorkerPoolEnabled(true);
+    this->connect(subscriber, SIGNAL(messageReceived(const QByteArray&, const QString&)),
+            SLOT(onPointCloudFrame(const QByteArray&, const QString&)), Qt::DirectConnection);
+    mLCM->addSubscriber(subscriber);
+  }
 
-namespace {
+  if (mPointCloud2Channel.length()) {
+    ddLCMSubscriber* subscriber2 = new ddLCMSubscriber(mPointCloud2Channel, this);
+    subscriber2->setWorkerPoolEnabled(true);
+    this->connect(subscriber2, SIGNAL(messageReceived(const QByteArray&, const QString&)),
+            SLOT(onPointCloud2Frame(const QByteArray&, const QString&)), Qt::DirectConnection);
+    mLCM->addSubscriber(subscriber2);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void ddPointCloudLCM::setPointCloudChannel(const QString& channelName)
+{
+  mPointCloudChannel = channelName;
+}
+
+
+//-----------------------------------------------------------------------------
+void ddPointCloudLCM::setPointCloud2Channel(const QString& channelName)
+{
+  mPointCloud2Channel = channelName;
+}
+
+
+//-----------------------------------------------------------------------------
+QString ddPointCloudLCM::getPointCloudChannel() const
+{
+  return mPointCloudChannel;
+}
+
+
+//-----------------------------------------------------------------------------
+QString ddPointCloudLCM::getPointCloud2Channel() const
+{
+  return mPointCloud2Channel;
+}
 
 
 
+namespace {
+
+
 //----------------------------------------------------------------------------
-vtkSmartPointer<vtkCellArray> NewVertexCells(vtkIdType numberOfVerts)
+// Reads a field value of type T at an unaligned address, swapping the bytes
+// if the message byte order is not the host byte order.
+template <class T, bool Swap>
+float ReadField(const uint8_t* ptr)
 {
-  vtkNew<vtkIdTypeArray> cells;
-  cells->SetNumberOfValues(numberOfVerts*2);
-  vtkIdType* ids = cells->GetPointer(0);
-  for (vtkIdType i = 0; i < numberOfVerts; ++i)
+  T value;
+  if (Swap)
+  {
+    uint8_t bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); ++i)
     {
-    ids[i*2] = 1;
-    ids[i*2+1] = i;
+      bytes[i] = ptr[sizeof(T) - 1 - i];
     }
+    std::memcpy(&value, bytes, sizeof(T));
+  }
+  else
+  {
+    std::memcpy(&value, ptr, sizeof(T));
+  }
+  return static_cast<float>(value);
+}
 
-  vtkSmartPointer<vtkCellArray> cellArray = vtkSmartPointer<vtkCellArray>::New();
-  cellArray->SetCells(numberOfVerts, cells.GetPointer());
-  return cellArray;
+typedef float (*FieldReader)(const uint8_t* ptr);
+
+//----------------------------------------------------------------------------
+template <bool Swap>
+FieldReader GetFieldReader(int datatype)
+{
+  switch (datatype)
+  {
+    case bot_core::pointfield_t::INT8: return &ReadField<int8_t, Swap>;
+    case bot_core::pointfield_t::UINT8: return &ReadField<uint8_t, Swap>;
+    case bot_core::pointfield_t::INT16: return &ReadField<int16_t, Swap>;
+    case bot_core::pointfield_t::UINT16: return &ReadField<uint16_t, Swap>;
+    case bot_core::pointfield_t::INT32: return &ReadField<int32_t, Swap>;
+    case bot_core::pointfield_t::UINT32: return &ReadField<uint32_t, Swap>;
+    case bot_core::pointfield_t::FLOAT32: return &ReadField<float, Swap>;
+    case bot_core::pointfield_t::FLOAT64: return &ReadField<double, Swap>;
+    default: return 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int FieldSize(int datatype)
+{
+  switch (datatype)
+  {
+    case bot_core::pointfield_t::INT8:
+    case bot_core::pointfield_t::UINT8: return 1;
+    case bot_core::pointfield_t::INT16:
+    case bot_core::pointfield_t::UINT16: return 2;
+    case bot_core::pointfield_t::INT32:
+    case bot_core::pointfield_t::UINT32:
+    case bot_core::pointfield_t::FLOAT32: return 4;
+    case bot_core::pointfield_t::FLOAT64: return 8;
+    default: return 0;
+  }
 }
 
+//----------------------------------------------------------------------------
+// A field of the message's points, read with the reader for its data type.
+struct PointField
+{
+  PointField() : Offset(0), Size(0), Reader(0)
+  {
+  }
+
+  bool isValid() const
+  {
+    return this->Reader != 0;
+  }
+
+  int Offset;
+  int Size;
+  FieldReader Reader;
+};
 
+//----------------------------------------------------------------------------
+PointField FindField(const bot_core::pointcloud2_t& msg, const std::string& name, bool swapBytes)
+{
+  PointField field;
+  for (size_t i = 0; i < msg.fields.size(); ++i)
+  {
+    const bot_core::pointfield_t& desc = msg.fields[i];
+    if (desc.name != name)
+    {
+      continue;
+    }
+
+    field.Size = FieldSize(desc.datatype);
+    field.Offset = desc.offset;
+    if (field.Size && desc.offset >= 0 && desc.offset + field.Size <= msg.point_step)
+    {
+      field.Reader = swapBytes ? GetFieldReader<true>(desc.datatype) : GetFieldReader<false>(desc.datatype);
+    }
+    break;
+  }
+  return field;
+}
+
+//----------------------------------------------------------------------------
+bool HostIsBigEndian()
+{
+  const uint16_t value = 1;
+  uint8_t firstByte;
+  std::memcpy(&firstByte, &value, 1);
+  return firstByte == 0;
+}
 
 //----------------------------------------------------------------------------
-vtkSmartPointer<vtkPolyData> PolyDataFromPointCloud2Message(pcl::PointCloud<pcl::PointXYZIR>::ConstPtr cloud)
+// Converts the message to polydata in one pass over the message data.  The
+// fields are found by name and read with a reader for their data type, at
+// any offset and point step, so no intermediate point cloud is made.  Points
+// with a non finite coordinate are skipped.
+vtkSmartPointer<vtkPolyData> PolyDataFromPointCloud2Message(const bot_core::pointcloud2_t& msg)
 {
-  vtkIdType nr_points = cloud->points.size();
+  vtkSmartPointer<vtkPolyData> polyData = vtkSmartPointer<vtkPolyData>::New();
+
+  const bool swapBytes = (msg.is_bigendian != 0) != HostIsBigEndian();
+  const PointField xField = FindField(msg, "x", swapBytes);
+  const PointField yField = FindField(msg, "y", swapBytes);
+  const PointField zField = FindField(msg, "z", swapBytes);
+  const PointField intensityField = FindField(msg, "intensity", swapBytes);
+  const PointField ringField = FindField(msg, "ring", swapBytes);
+  PointField rgbField = FindField(msg, "rgb", swapBytes);
+  if (rgbField.Size != 4)
+  {
+    rgbField = PointField();
+  }
+
+  const size_t width = std::max(msg.width, 0);
+  const size_t height = std::max(msg.height, 0);
+  const size_t pointStep = std::max(msg.point_step, 0);
+  const size_t rowStep = msg.row_step > 0 ? msg.row_step : width*pointStep;
+  const size_t dataSize = std::min(msg.data.size(), static_cast<size_t>(std::max(msg.data_nbytes, 0)));
+
+  if (!xField.isValid() || !yField.isValid() || !zField.isValid() || !width || !height
+      || rowStep < width*pointStep || (height - 1)*rowStep + width*pointStep > dataSize)
+  {
+    printf("Error: invalid pointcloud2_t message, expected x, y and z fields within %d points\n", msg.width*msg.height);
+    return polyData;
+  }
+
+  const vtkIdType maxPoints = static_cast<vtkIdType>(width*height);
 
   vtkNew<vtkPoints> points;
   points->SetDataTypeToFloat();
-  points->SetNumberOfPoints(nr_points);
+  points->SetNumberOfPoints(maxPoints);
+  float* pointsPtr = static_cast<float*>(points->GetVoidPointer(0));
 
   vtkNew<vtkFloatArray> intensityArray;
   intensityArray->SetName("intensity");
   intensityArray->SetNumberOfComponents(1);
-  intensityArray->SetNumberOfValues(nr_points);
+  intensityArray->SetNumberOfValues(intensityField.isValid() ? maxPoints : 0);
+  float* intensityPtr = intensityField.isValid() ? intensityArray->GetPointer(0) : 0;
 
   vtkNew<vtkUnsignedIntArray> ringArray;
   ringArray->SetName("ring");
   ringArray->SetNumberOfComponents(1);
-  ringArray->SetNumberOfValues(nr_points);
-
-  vtkIdType j = 0;    
-  for (vtkIdType i = 0; i < nr_points; ++i)
-  {
-    // Check if the point is invalid
-    if (!pcl_isfinite (cloud->points[i].x) ||
-        !pcl_isfinite (cloud->points[i].y) ||
-        !pcl_isfinite (cloud->points[i].z))
-      continue;
-
-    float point[3] = {cloud->points[i].x, cloud->points[i].y, cloud->points[i].z};
-    points->SetPoint(j, point);
+  ringArray->SetNumberOfValues(ringField.isValid() ? maxPoints : 0);
+  unsigned int* ringPtr = ringField.isValid() ? ringArray->GetPointer(0) : 0;
 
-    float intensity = cloud->points[i].intensity;
-    intensityArray->SetValue(j,intensity);
+  vtkNew<vtkUnsignedCharArray> rgbArray;
+  rgbArray->SetName("rgb_colors");
+  rgbArray->SetNumberOfComponents(3);
+  rgbArray->SetNumberOfTuples(rgbField.isValid() ? maxPoints : 0);
+  unsigned char* rgbPtr = rgbField.isValid() ? rgbArray->GetPointer(0) : 0;
 
-    uint16_t ring = cloud->points[i].ring;
-    ringArray->SetValue(j,ring);
-
-    j++;
+  vtkIdType j = 0;
+  for (size_t row = 0; row < height; ++row)
+  {
+    const uint8_t* pointPtr = msg.data.data() + row*rowStep;
+    for (size_t col = 0; col < width; ++col, pointPtr += pointStep)
+    {
+      const float x = xField.Reader(pointPtr + xField.Offset);
+      const float y = yField.Reader(pointPtr + yField.Offset);
+      const float z = zField.Reader(pointPtr + zField.Offset);
+      if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z))
+      {
+        continue;
+      }
+
+      pointsPtr[3*j] = x;
+      pointsPtr[3*j + 1] = y;
+      pointsPtr[3*j + 2] = z;
+
+      if (intensityPtr)
+      {
+        intensityPtr[j] = intensityField.Reader(pointPtr + intensityField.Offset);
+      }
+      if (ringPtr)
+      {
+        ringPtr[j] = static_cast<unsigned int>(ringField.Reader(pointPtr + ringField.Offset));
+      }
+      if (rgbPtr)
+      {
+        // packed like pcl, bgr in the low bytes of a little endian word
+        uint8_t bgra[4];
+        std::memcpy(bgra, pointPtr + rgbField.Offset, 4);
+        if (swapBytes)
+        {
+          std::swap(bgra[0], bgra[3]);
+          std::swap(bgra[1], bgra[2]);
+        }
+        rgbPtr[3*j] = bgra[2];
+        rgbPtr[3*j + 1] = bgra[1];
+        rgbPtr[3*j + 2] = bgra[0];
+      }
+
+      ++j;
+    }
   }
-  nr_points = j;
-  points->SetNumberOfPoints(nr_points);
 
-  vtkSmartPointer<vtkPolyData> polyData = vtkSmartPointer<vtkPolyData>::New();
+  const vtkIdType nr_points = j;
+  points->SetNumberOfPoints(nr_points);
   polyData->SetPoints(points.GetPointer());
-  polyData->GetPointData()->AddArray(intensityArray.GetPointer());
-  polyData->GetPointData()->AddArray(ringArray.GetPointer());
-  polyData->SetVerts(NewVertexCells(nr_points));
+  if (intensityPtr)
+  {
+    intensityArray->SetNumberOfTuples(nr_points);
+    polyData->GetPointData()->AddArray(intensityArray.GetPointer());
+  }
+  if (ringPtr)
+  {
+    ringArray->SetNumberOfTuples(nr_points);
+    polyData->GetPointData()->AddArray(ringArray.GetPointer());
+  }
+  if (rgbPtr)
+  {
+    rgbArray->SetNumberOfTuples(nr_points);
+    polyData->GetPointData()->AddArray(rgbArray.GetPointer());
+  }
   return polyData;
 }
 
@@ -200,7 +421,6 @@ vtkSmartPointer<vtkPolyData> PolyDataFromPointCloudMessage(bot_core::pointcloud_
     }
   }
 
-  polyData->SetVerts(NewVertexCells(nr_points));
   return polyData;
 }
 
@@ -218,10 +438,7 @@ void ddPointCloudLCM::onPointCloud2Frame(const QByteArray& data, const QString&
   bot_core::pointcloud2_t message;
   message.decode(data.data(), 0, data.size());
 
-  //convert to pcl object:
-  pcl::PointCloud<pcl::PointXYZIR>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZIR> ());
-  pcl::fromLCMPointCloud2( message, *cloud);
-  vtkSmartPointer<vtkPolyData> polyData = PolyDataFromPointCloud2Message(cloud);
+  vtkSmartPointer<vtkPolyData> polyData = PolyDataFromPointCloud2Message(message);
 
   QMutexLocker locker(&this->mPolyDataMutex);
   this->mPolyData = polyData;
@@ -30,8 +30,25 @@ class DD_APP_EXPORT ddPointCloudLCM : public QObject
 public:
 
   ddPointCloudLCM(QObject* parent=NULL);
-  
+
+  // Subscribes to the pointcloud_t and pointcloud2_t channels, POINTCLOUD
+  // and VELODYNE unless set before init().  An empty channel name is not
+  // subscribed.
   void init(ddLCMThread* lcmThread, const QString& botConfigFile);
+
+  // Reads the channels of the sensor from the point_clouds.<sensorName>
+  // block of the config, keys pointcloud_channel and pointcloud2_channel; a
+  // channel missing from the block is not subscribed.
+  void init(ddLCMThread* lcmThread, const QString& botConfigFile, const QString& sensorName);
+
+  void setPointCloudChannel(const QString& channelName);
+  void setPointCloud2Channel(const QString& channelName);
+  QString getPointCloudChannel() const;
+  QString getPointCloud2Channel() const;
+
+  // Shallow copies the latest cloud into polyDataRender and returns its
+  // utime.  The cloud has points and point data but no vertex cells, it is
+  // drawn with vtkPointCloudMapper.
   qint64 getPointCloudFromPointCloud(vtkPolyData* polyDataRender);
 
   QStringList getLidarNames() const;
@@ -50,8 +67,14 @@ protected slots:
 
 protected:
 
+  void initBotParam(ddLCMThread* lcmThread, const QString& botConfigFile);
+  void subscribe();
+
   BotParam* mBotParam;
 
+  QString mPointCloudChannel;
+  QString mPointCloud2Channel;
+
   ddLCMThread* mLCM;
 
   vtkSmartPointer<vtkPolyData> mPolyData;
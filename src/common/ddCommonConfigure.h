@@ -0,0 +1,14 @@
+#ifndef __ddCommonConfigure_h
+#define __ddCommonConfigure_h
+
+#if defined(WIN32)
+#  if defined(ddCommon_EXPORTS)
+#    define DD_COMMON_EXPORT __declspec( dllexport )
+#  else
+#    define DD_COMMON_EXPORT __declspec( dllimport )
+#  endif
+#else
+#  define DD_COMMON_EXPORT
+#endif
+
+#endif
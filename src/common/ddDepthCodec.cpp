@@ -0,0 +1,240 @@
+#include "ddDepthCodec.h"
+
+#include <zlib.h>
+
+#ifdef DD_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef DD_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace
+{
+
+// pixel format tags are four character codes like the bot_core image_t
+// pixel formats: 'D' 'D', the compression, then the predictor
+const char CompressionCodes[] = {'Z', '4', 'S'};
+const char NoPredictorCode = '0';
+const char DeltaPredictorCode = 'D';
+
+//-----------------------------------------------------------------------------
+int32_t FourCC(char a, char b, char c, char d)
+{
+  return static_cast<int32_t>(static_cast<uint32_t>(static_cast<uint8_t>(a))
+    | (static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8)
+    | (static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16)
+    | (static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24));
+}
+
+//-----------------------------------------------------------------------------
+// Per thread scratch space for the predicted planes.
+std::vector<uint8_t>& ScratchBuffer(size_t size)
+{
+  static thread_local std::vector<uint8_t> buffer;
+  if (buffer.size() < size)
+  {
+    buffer.resize(size);
+  }
+  return buffer;
+}
+
+//-----------------------------------------------------------------------------
+// Writes the zigzag encoded differences of neighbouring pixels as a plane of
+// low bytes followed by a plane of high bytes.
+void ApplyDeltaPredictor(const uint16_t* depth, size_t numberOfPixels, uint8_t* planes)
+{
+  uint8_t* lowBytes = planes;
+  uint8_t* highBytes = planes + numberOfPixels;
+  uint16_t previous = 0;
+  for (size_t i = 0; i < numberOfPixels; ++i)
+  {
+    const int16_t delta = static_cast<int16_t>(depth[i] - previous);
+    const uint16_t zigzag = static_cast<uint16_t>((static_cast<uint16_t>(delta) << 1) ^ (delta >> 15));
+    lowBytes[i] = static_cast<uint8_t>(zigzag);
+    highBytes[i] = static_cast<uint8_t>(zigzag >> 8);
+    previous = depth[i];
+  }
+}
+
+//-----------------------------------------------------------------------------
+void RemoveDeltaPredictor(const uint8_t* planes, size_t numberOfPixels, uint16_t* depth)
+{
+  const uint8_t* lowBytes = planes;
+  const uint8_t* highBytes = planes + numberOfPixels;
+  uint16_t previous = 0;
+  for (size_t i = 0; i < numberOfPixels; ++i)
+  {
+    const uint16_t zigzag = static_cast<uint16_t>(lowBytes[i] | (highBytes[i] << 8));
+    const uint16_t delta = static_cast<uint16_t>((zigzag >> 1) ^ (0 - (zigzag & 1)));
+    previous = static_cast<uint16_t>(previous + delta);
+    depth[i] = previous;
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool Compress(ddDepthCodec::Compression compression, const void* input, size_t inputSize, std::vector<uint8_t>& output)
+{
+  switch (compression)
+  {
+    case ddDepthCodec::ZlibCompression:
+    {
+      uLongf outputSize = compressBound(inputSize);
+      output.resize(outputSize);
+      if (compress2(output.data(), &outputSize, static_cast<const Bytef*>(input), inputSize, Z_BEST_SPEED) != Z_OK)
+      {
+        return false;
+      }
+      output.resize(outputSize);
+      return true;
+    }
+#ifdef DD_HAVE_LZ4
+    case ddDepthCodec::LZ4Compression:
+    {
+      output.resize(LZ4_compressBound(static_cast<int>(inputSize)));
+      const int outputSize = LZ4_compress_default(static_cast<const char*>(input), reinterpret_cast<char*>(output.data()),
+        static_cast<int>(inputSize), static_cast<int>(output.size()));
+      output.resize(outputSize);
+      return outputSize > 0;
+    }
+#endif
+#ifdef DD_HAVE_ZSTD
+    case ddDepthCodec::ZstdCompression:
+    {
+      output.resize(ZSTD_compressBound(inputSize));
+      const size_t outputSize = ZSTD_compress(output.data(), output.size(), input, inputSize, 1);
+      if (ZSTD_isError(outputSize))
+      {
+        return false;
+      }
+      output.resize(outputSize);
+      return true;
+    }
+#endif
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool Decompress(ddDepthCodec::Compression compression, const uint8_t* input, size_t inputSize, void* output, size_t outputSize)
+{
+  switch (compression)
+  {
+    case ddDepthCodec::ZlibCompression:
+    {
+      uLongf size = outputSize;
+      return uncompress(static_cast<Bytef*>(output), &size, input, inputSize) == Z_OK && size == outputSize;
+    }
+#ifdef DD_HAVE_LZ4
+    case ddDepthCodec::LZ4Compression:
+      return LZ4_decompress_safe(reinterpret_cast<const char*>(input), static_cast<char*>(output),
+        static_cast<int>(inputSize), static_cast<int>(outputSize)) == static_cast<int>(outputSize);
+#endif
+#ifdef DD_HAVE_ZSTD
+    case ddDepthCodec::ZstdCompression:
+      return ZSTD_decompress(output, outputSize, input, inputSize) == outputSize;
+#endif
+    default:
+      return false;
+  }
+}
+
+}
+
+//-----------------------------------------------------------------------------
+bool ddDepthCodec::compressionIsSupported(Compression compression)
+{
+  switch (compression)
+  {
+    case ZlibCompression:
+      return true;
+#ifdef DD_HAVE_LZ4
+    case LZ4Compression:
+      return true;
+#endif
+#ifdef DD_HAVE_ZSTD
+    case ZstdCompression:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+int32_t ddDepthCodec::pixelFormat(Compression compression, bool deltaPredictor)
+{
+  return FourCC('D', 'D', CompressionCodes[compression], deltaPredictor ? DeltaPredictorCode : NoPredictorCode);
+}
+
+//-----------------------------------------------------------------------------
+bool ddDepthCodec::parsePixelFormat(int32_t pixelFormat, Compression* compression, bool* deltaPredictor)
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    for (int predictor = 0; predictor < 2; ++predictor)
+    {
+      if (pixelFormat == ddDepthCodec::pixelFormat(static_cast<Compression>(i), predictor == 1))
+      {
+        *compression = static_cast<Compression>(i);
+        *deltaPredictor = (predictor == 1);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+bool ddDepthCodec::encode(const uint16_t* depth, size_t numberOfPixels, Compression compression,
+                          bool deltaPredictor, std::vector<uint8_t>& output)
+{
+  if (!compressionIsSupported(compression))
+  {
+    return false;
+  }
+
+  const size_t size = numberOfPixels*sizeof(uint16_t);
+  if (!deltaPredictor)
+  {
+    return Compress(compression, depth, size, output);
+  }
+
+  std::vector<uint8_t>& planes = ScratchBuffer(size);
+  ApplyDeltaPredictor(depth, numberOfPixels, planes.data());
+  return Compress(compression, planes.data(), size, output);
+}
+
+//-----------------------------------------------------------------------------
+bool ddDepthCodec::decode(const uint8_t* data, size_t size, Compression compression,
+                          bool deltaPredictor, uint16_t* depth, size_t numberOfPixels)
+{
+  const size_t outputSize = numberOfPixels*sizeof(uint16_t);
+  if (!deltaPredictor)
+  {
+    return Decompress(compression, data, size, depth, outputSize);
+  }
+
+  std::vector<uint8_t>& planes = ScratchBuffer(outputSize);
+  if (!Decompress(compression, data, size, planes.data(), outputSize))
+  {
+    return false;
+  }
+  RemoveDeltaPredictor(planes.data(), numberOfPixels, depth);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool ddDepthCodec::decode(int32_t pixelFormat, const uint8_t* data, size_t size,
+                          uint16_t* depth, size_t numberOfPixels)
+{
+  Compression compression;
+  bool deltaPredictor;
+  if (!parsePixelFormat(pixelFormat, &compression, &deltaPredictor))
+  {
+    return false;
+  }
+  return decode(data, size, compression, deltaPredictor, depth, numberOfPixels);
+}
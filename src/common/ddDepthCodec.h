@@ -0,0 +1,65 @@
+#ifndef __ddDepthCodec_h
+#define __ddDepthCodec_h
+
+#include "ddCommonConfigure.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Lossless compression of 16 bit depth images.
+//
+// Depth images are compressed with zlib, lz4 or zstd (level 1).  lz4 and
+// zstd are several times faster than zlib at a similar ratio on depth data;
+// they are available if the library was built with USE_LZ4 or USE_ZSTD.
+//
+// The optional delta predictor replaces each pixel with its difference from
+// the previous pixel, zigzag encoded, and stores the low and high bytes of
+// the differences in separate planes.  Neighbouring depth values are close,
+// so the high byte plane is mostly zero and both planes compress much better
+// than the raw values, which matters most for lz4.
+//
+// Each combination has a pixel format tag that is sent in the pixelformat
+// field of a bot_core image_t, so a receiver can tell how an image was
+// compressed and whether it can decode it.  Scratch buffers are per thread,
+// so images may be compressed and decompressed on several threads at once.
+
+class DD_COMMON_EXPORT ddDepthCodec
+{
+public:
+
+  enum Compression
+  {
+    ZlibCompression = 0,
+    LZ4Compression = 1,
+    ZstdCompression = 2
+  };
+
+  // Returns true if the library was built with the compression.
+  static bool compressionIsSupported(Compression compression);
+
+  // Returns the pixel format tag of the compression and predictor.
+  static int32_t pixelFormat(Compression compression, bool deltaPredictor);
+
+  // Returns true if the pixel format is a tag returned by pixelFormat(), and
+  // sets the compression and predictor of the tag.
+  static bool parsePixelFormat(int32_t pixelFormat, Compression* compression, bool* deltaPredictor);
+
+  // Compresses numberOfPixels depth values into output.  Returns false if the
+  // compression is not supported.
+  static bool encode(const uint16_t* depth, size_t numberOfPixels, Compression compression,
+                     bool deltaPredictor, std::vector<uint8_t>& output);
+
+  // Decompresses numberOfPixels depth values.  Returns false if the data is
+  // corrupt, does not hold numberOfPixels values, or the compression is not
+  // supported.
+  static bool decode(const uint8_t* data, size_t size, Compression compression,
+                     bool deltaPredictor, uint16_t* depth, size_t numberOfPixels);
+
+  // Decompresses an image tagged with pixelFormat().
+  static bool decode(int32_t pixelFormat, const uint8_t* data, size_t size,
+                     uint16_t* depth, size_t numberOfPixels);
+};
+
+#endif
@@ -0,0 +1,420 @@
+#include "ddFrameTransformCache.h"
+#include "ddLCMDispatcher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <map>
+
+#include <bot_core/trans.h>
+#include <glib.h>
+#include <lcmtypes/bot_core/rigid_transform_t.hpp>
+
+namespace
+{
+
+// a sample this much older than the last sample of a link clears the link's
+// history, older samples within this time are inserted in order
+const int64_t SeekBackTime = 1000000;
+
+}
+
+//-----------------------------------------------------------------------------
+class ddFrameTransformCache::Link
+{
+public:
+
+  struct Sample
+  {
+    int64_t Utime;
+    // w, x, y, z like BotTrans
+    double Rotation[4];
+    double Translation[3];
+  };
+
+  Link() : Parent(-1), Samples(HistoryCapacity), Sequence(0), Count(0), First(0)
+  {
+  }
+
+  // the parent frame, -1 for the root frame
+  int Parent;
+
+  std::vector<Sample> Samples;
+  // odd while a sample is added
+  std::atomic<uint64_t> Sequence;
+  // the samples in the history are [First, Count), sample i is at
+  // Samples[i % HistoryCapacity]
+  std::atomic<uint64_t> Count;
+  std::atomic<uint64_t> First;
+
+  //---------------------------------------------------------------------------
+  void add(const Sample& sample)
+  {
+    const uint64_t sequence = this->Sequence.load(std::memory_order_relaxed);
+    this->Sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint64_t count = this->Count.load(std::memory_order_relaxed);
+    uint64_t first = this->First.load(std::memory_order_relaxed);
+
+    // the index to store the sample at, the samples after it are shifted up
+    uint64_t index = count;
+    if (count > first)
+    {
+      const Sample& last = this->Samples[(count - 1) % HistoryCapacity];
+      if (sample.Utime < last.Utime - SeekBackTime)
+      {
+        // log playback seeked back, start a new history
+        first = count;
+      }
+      else
+      {
+        while (index > first && this->Samples[(index - 1) % HistoryCapacity].Utime > sample.Utime)
+        {
+          --index;
+        }
+      }
+    }
+
+    if (index > first && this->Samples[(index - 1) % HistoryCapacity].Utime == sample.Utime)
+    {
+      // replace the sample with the same time
+      this->Samples[(index - 1) % HistoryCapacity] = sample;
+    }
+    else if (index == first && index < count && count - first == HistoryCapacity)
+    {
+      // older than every sample of a full history, drop it
+    }
+    else
+    {
+      for (uint64_t i = count; i > index; --i)
+      {
+        this->Samples[i % HistoryCapacity] = this->Samples[(i - 1) % HistoryCapacity];
+      }
+      this->Samples[index % HistoryCapacity] = sample;
+      ++count;
+      first = std::max(first, count > HistoryCapacity ? count - HistoryCapacity : 0);
+    }
+
+    this->Count.store(count, std::memory_order_relaxed);
+    this->First.store(first, std::memory_order_relaxed);
+    this->Sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  //---------------------------------------------------------------------------
+  // Interpolates the sample at utime, or the latest sample if utime < 0.
+  // Returns false if the history is empty.
+  bool get(int64_t utime, Eigen::Isometry3d& transform) const
+  {
+    for (;;)
+    {
+      const uint64_t sequence = this->Sequence.load(std::memory_order_acquire);
+      if (sequence & 1)
+      {
+        continue;
+      }
+
+      const uint64_t count = this->Count.load(std::memory_order_relaxed);
+      const uint64_t first = this->First.load(std::memory_order_relaxed);
+      if (count == first)
+      {
+        return false;
+      }
+
+      // the first sample after utime
+      uint64_t begin = first;
+      uint64_t end = count;
+      if (utime < 0)
+      {
+        begin = count;
+      }
+      while (begin < end)
+      {
+        const uint64_t middle = begin + (end - begin)/2;
+        if (this->Samples[middle % HistoryCapacity].Utime <= utime)
+        {
+          begin = middle + 1;
+        }
+        else
+        {
+          end = middle;
+        }
+      }
+
+      const Sample a = this->Samples[(begin == first ? begin : begin - 1) % HistoryCapacity];
+      const Sample b = this->Samples[(begin == count ? begin - 1 : begin) % HistoryCapacity];
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (this->Sequence.load(std::memory_order_relaxed) != sequence)
+      {
+        continue;
+      }
+
+      const Eigen::Quaterniond qa(a.Rotation[0], a.Rotation[1], a.Rotation[2], a.Rotation[3]);
+      const Eigen::Vector3d ta(a.Translation[0], a.Translation[1], a.Translation[2]);
+      if (a.Utime == b.Utime)
+      {
+        transform.setIdentity();
+        transform.translate(ta);
+        transform.rotate(qa);
+        return true;
+      }
+
+      const Eigen::Quaterniond qb(b.Rotation[0], b.Rotation[1], b.Rotation[2], b.Rotation[3]);
+      const Eigen::Vector3d tb(b.Translation[0], b.Translation[1], b.Translation[2]);
+      const double t = static_cast<double>(utime - a.Utime)/(b.Utime - a.Utime);
+
+      transform.setIdentity();
+      transform.translate(ta + t*(tb - ta));
+      transform.rotate(qa.slerp(t, qb));
+      return true;
+    }
+  }
+};
+
+//-----------------------------------------------------------------------------
+ddFrameTransformCache* ddFrameTransformCache::instance(BotFrames* botFrames, BotParam* botParam)
+{
+  static std::mutex mutex;
+  static std::map<BotFrames*, ddFrameTransformCache*> caches;
+
+  if (!botFrames)
+  {
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  ddFrameTransformCache*& cache = caches[botFrames];
+  if (!cache)
+  {
+    // lives as long as the bot frames, which are never destroyed
+    cache = new ddFrameTransformCache(botFrames, botParam);
+  }
+  return cache;
+}
+
+//-----------------------------------------------------------------------------
+ddFrameTransformCache::ddFrameTransformCache(BotFrames* botFrames, BotParam* botParam)
+{
+  mBotFrames = botFrames;
+
+  const int numberOfFrames = bot_frames_get_num_frames(botFrames);
+  char** frameNames = bot_frames_get_frame_names(botFrames);
+  for (int i = 0; i < numberOfFrames; ++i)
+  {
+    mFrameIds[frameNames[i]] = static_cast<int>(mFrameNames.size());
+    mFrameNames.push_back(frameNames[i]);
+    mLinks.push_back(std::unique_ptr<Link>(new Link));
+  }
+  g_strfreev(frameNames);
+
+  for (int i = 0; i < numberOfFrames; ++i)
+  {
+    const char* relativeTo = bot_frames_get_relative_to(botFrames, mFrameNames[i].c_str());
+    if (!relativeTo)
+    {
+      continue;
+    }
+
+    const int parent = this->frameId(relativeTo);
+    mLinks[i]->Parent = parent;
+
+    // an updated link has no transform until its first update, its initial
+    // transform from the config has no time
+    const std::string updateChannelKey = "coordinate_frames." + mFrameNames[i] + ".update_channel";
+    char* updateChannel = 0;
+    if (botParam && bot_param_get_str(botParam, updateChannelKey.c_str(), &updateChannel) == 0)
+    {
+      if (parent >= 0)
+      {
+        this->subscribeUpdates(i, updateChannel);
+      }
+      free(updateChannel);
+      continue;
+    }
+
+    BotTrans trans;
+    if (parent >= 0 && bot_frames_get_trans(botFrames, mFrameNames[i].c_str(), relativeTo, &trans))
+    {
+      // a fixed link, its only sample holds at all times
+      this->addTransform(i, 0,
+        Eigen::Quaterniond(trans.rot_quat[0], trans.rot_quat[1], trans.rot_quat[2], trans.rot_quat[3]),
+        Eigen::Vector3d(trans.trans_vec[0], trans.trans_vec[1], trans.trans_vec[2]));
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+ddFrameTransformCache::~ddFrameTransformCache()
+{
+}
+
+//-----------------------------------------------------------------------------
+void ddFrameTransformCache::subscribeUpdates(int frameId, const std::string& channel)
+{
+  // decoding a transform is cheap, handle it on the receive thread
+  ddLCMDispatcher::instance()->subscribe(channel, [this, frameId](const lcm::ReceiveBuffer* rbuf, const std::string&)
+  {
+    bot_core::rigid_transform_t msg;
+    if (msg.decode(rbuf->data, 0, rbuf->data_size) < 0)
+    {
+      return;
+    }
+
+    this->addTransform(frameId, msg.utime,
+      Eigen::Quaterniond(msg.quat[0], msg.quat[1], msg.quat[2], msg.quat[3]),
+      Eigen::Vector3d(msg.trans[0], msg.trans[1], msg.trans[2]));
+  });
+}
+
+//-----------------------------------------------------------------------------
+int ddFrameTransformCache::frameId(const std::string& frameName) const
+{
+  std::unordered_map<std::string, int>::const_iterator itr = mFrameIds.find(frameName);
+  return itr == mFrameIds.end() ? -1 : itr->second;
+}
+
+//-----------------------------------------------------------------------------
+const std::string& ddFrameTransformCache::frameName(int frameId) const
+{
+  static const std::string empty;
+  return (frameId >= 0 && frameId < this->numberOfFrames()) ? mFrameNames[frameId] : empty;
+}
+
+//-----------------------------------------------------------------------------
+int ddFrameTransformCache::numberOfFrames() const
+{
+  return static_cast<int>(mFrameNames.size());
+}
+
+//-----------------------------------------------------------------------------
+void ddFrameTransformCache::addTransform(int frameId, int64_t utime, const Eigen::Quaterniond& rotation, const Eigen::Vector3d& translation)
+{
+  if (frameId < 0 || frameId >= this->numberOfFrames())
+  {
+    return;
+  }
+
+  Link::Sample sample;
+  sample.Utime = utime;
+  sample.Rotation[0] = rotation.w();
+  sample.Rotation[1] = rotation.x();
+  sample.Rotation[2] = rotation.y();
+  sample.Rotation[3] = rotation.z();
+  sample.Translation[0] = translation[0];
+  sample.Translation[1] = translation[1];
+  sample.Translation[2] = translation[2];
+
+  std::lock_guard<std::mutex> lock(mWriteMutex);
+  mLinks[frameId]->add(sample);
+}
+
+//-----------------------------------------------------------------------------
+size_t ddFrameTransformCache::historySize(int frameId) const
+{
+  if (frameId < 0 || frameId >= this->numberOfFrames())
+  {
+    return 0;
+  }
+
+  const Link& link = *mLinks[frameId];
+  for (;;)
+  {
+    const uint64_t sequence = link.Sequence.load(std::memory_order_acquire);
+    const uint64_t size = link.Count.load(std::memory_order_relaxed) - link.First.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!(sequence & 1) && link.Sequence.load(std::memory_order_relaxed) == sequence)
+    {
+      return size;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ddFrameTransformCache::pathToRoot(int frameId, std::vector<int>& path) const
+{
+  path.clear();
+  while (frameId >= 0 && mLinks[frameId]->Parent >= 0 && path.size() < mLinks.size())
+  {
+    path.push_back(frameId);
+    frameId = mLinks[frameId]->Parent;
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool ddFrameTransformCache::transformToRoot(const std::vector<int>& path, int64_t utime, Eigen::Isometry3d& transform) const
+{
+  transform.setIdentity();
+  Eigen::Isometry3d link;
+  for (size_t i = 0; i < path.size(); ++i)
+  {
+    if (!mLinks[path[i]]->get(utime, link))
+    {
+      return false;
+    }
+    transform = link*transform;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool ddFrameTransformCache::getTransform(int fromFrame, int toFrame, int64_t utime, Eigen::Isometry3d& transform) const
+{
+  const int64_t times[] = {std::max(utime, int64_t(0))};
+  TransformVector transforms;
+  if (!this->getTransforms(fromFrame, toFrame, times, 1, transforms))
+  {
+    return false;
+  }
+  transform = transforms[0];
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool ddFrameTransformCache::getTransform(int fromFrame, int toFrame, Eigen::Isometry3d& transform) const
+{
+  const int64_t times[] = {-1};
+  TransformVector transforms;
+  if (!this->getTransforms(fromFrame, toFrame, times, 1, transforms))
+  {
+    return false;
+  }
+  transform = transforms[0];
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool ddFrameTransformCache::getTransforms(int fromFrame, int toFrame, const int64_t* utimes, size_t numberOfTimes,
+                                          TransformVector& transforms) const
+{
+  if (fromFrame < 0 || fromFrame >= this->numberOfFrames() || toFrame < 0 || toFrame >= this->numberOfFrames())
+  {
+    return false;
+  }
+
+  std::vector<int> fromPath;
+  std::vector<int> toPath;
+  this->pathToRoot(fromFrame, fromPath);
+  this->pathToRoot(toFrame, toPath);
+
+  // drop the links the two paths share below the root
+  while (!fromPath.empty() && !toPath.empty() && fromPath.back() == toPath.back())
+  {
+    fromPath.pop_back();
+    toPath.pop_back();
+  }
+
+  transforms.resize(numberOfTimes);
+  Eigen::Isometry3d fromToCommon;
+  Eigen::Isometry3d toToCommon;
+  for (size_t i = 0; i < numberOfTimes; ++i)
+  {
+    if (!this->transformToRoot(fromPath, utimes[i], fromToCommon)
+        || !this->transformToRoot(toPath, utimes[i], toToCommon))
+    {
+      return false;
+    }
+    transforms[i] = toToCommon.inverse()*fromToCommon;
+  }
+  return true;
+}
@@ -0,0 +1,117 @@
+#ifndef __ddFrameTransformCache_h
+#define __ddFrameTransformCache_h
+
+#include "ddCommonConfigure.h"
+
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <bot_frames/bot_frames.h>
+#include <bot_param/param_client.h>
+
+
+// A cache of the coordinate frame transforms of bot_frames.
+//
+// Frames are looked up by name once with frameId(), and transforms are then
+// queried by the integer ids.  The cache keeps a time ordered history of the
+// transform of each frame to its parent frame.  The histories are filled from
+// the rigid_transform_t messages on the update channels of the links, which
+// the cache receives through ddLCMDispatcher, so queries never reach
+// bot_frames and its string lookups and lock.  During in process log replay
+// the dispatcher injects the logged updates, so the histories follow the log
+// time like every other subscriber.  A transform between two frames at a time interpolates each link
+// on the path through the frame tree, rotations by SLERP and translations
+// linearly, and clamps to the first and last samples of a link's history.
+//
+// A link with an update channel in the config has no samples, and a
+// transform through it is not available, until its first update arrives.
+// A link without an update channel is fixed and has a single sample, read
+// from bot_frames when the cache is created, that holds at all times.
+//
+// Queries do not take a lock.  Each history has a sequence number that is
+// odd while a sample is being added, a query checks it before and after it
+// reads the history and retries if a sample was added meanwhile.  Samples
+// that arrive out of order are inserted in time order.  A sample more than
+// one second older than the last sample of a link, which arrives when log
+// playback seeks back, clears the link's history.
+
+class DD_COMMON_EXPORT ddFrameTransformCache
+{
+public:
+
+  typedef std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> > TransformVector;
+
+  // Returns the cache for the bot frames, created on first use.  The frames
+  // are read from bot_frames, and their update channels from the param, when
+  // the cache is created.
+  static ddFrameTransformCache* instance(BotFrames* botFrames, BotParam* botParam);
+
+  // Returns the id of the frame, or -1 if bot_frames has no such frame.
+  int frameId(const std::string& frameName) const;
+  const std::string& frameName(int frameId) const;
+  int numberOfFrames() const;
+
+  // Gets the transform from the from frame to the to frame at the given
+  // time, the same transform as bot_frames_get_trans_with_utime().  Returns
+  // false if a frame id is invalid or a link on the path has no samples.
+  bool getTransform(int fromFrame, int toFrame, int64_t utime, Eigen::Isometry3d& transform) const;
+
+  // Gets the latest transform.
+  bool getTransform(int fromFrame, int toFrame, Eigen::Isometry3d& transform) const;
+
+  // Gets the transforms at each of the times, looking up the path through
+  // the frame tree once.  A negative time gets the latest transform.
+  bool getTransforms(int fromFrame, int toFrame, const int64_t* utimes, size_t numberOfTimes,
+                     TransformVector& transforms) const;
+
+  // Adds a sample of the transform from the frame to its parent frame.  The
+  // update channel subscriptions call this, other sources may add samples
+  // too.
+  void addTransform(int frameId, int64_t utime, const Eigen::Quaterniond& rotation, const Eigen::Vector3d& translation);
+
+  // Returns the number of samples in the frame's history.
+  size_t historySize(int frameId) const;
+
+  // The number of samples kept for each frame.
+  static const size_t HistoryCapacity = 1024;
+
+private:
+
+  class Link;
+
+  ddFrameTransformCache(BotFrames* botFrames, BotParam* botParam);
+  ~ddFrameTransformCache();
+
+  // Subscribes to the update channel of the frame's link.
+  void subscribeUpdates(int frameId, const std::string& channel);
+
+  // Sets path to the frames from the frame up to the root, excluding the root.
+  void pathToRoot(int frameId, std::vector<int>& path) const;
+
+  // The transform from the frame to the root at the time, utime < 0 for the
+  // latest transform.
+  bool transformToRoot(const std::vector<int>& path, int64_t utime, Eigen::Isometry3d& transform) const;
+
+  ddFrameTransformCache(const ddFrameTransformCache&); // Not implemented
+  void operator=(const ddFrameTransformCache&); // Not implemented
+
+  BotFrames* mBotFrames;
+
+  // the frames are fixed when the cache is created, so lookups need no lock
+  std::vector<std::string> mFrameNames;
+  std::unordered_map<std::string, int> mFrameIds;
+  std::vector<std::unique_ptr<Link> > mLinks;
+
+  // serializes addTransform()
+  std::mutex mWriteMutex;
+};
+
+#endif
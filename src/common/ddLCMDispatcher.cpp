@@ -0,0 +1,758 @@
+#include "ddLCMDispatcher.h"
+#include "ddSharedMemoryPublisher.h"
+#include "ddSharedMemoryRing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <limits>
+
+#include <regex.h>
+
+namespace
+{
+
+// A worker queues at most this many messages.  Injected messages wait for
+// space, so replaying a log faster than real time does not queue the whole
+// log.  Received messages cannot wait without stalling the receive thread, so
+// a full queue drops its oldest message, preferably one for the same
+// subscription, and a handler slower than its sensor skips messages.
+const size_t MaxWorkerQueueSize = 64;
+
+// Each worker keeps at most this many message buffers for reuse, like the
+// slabs of ddLCMMessageBufferPool.
+const size_t MaxFreeBuffersPerWorker = 8;
+
+// Each subscription remembers at most this many messages that it delivered
+// from shared memory or from a normal message and has not yet seen the other
+// copy of, see ddSharedMemoryPublisher.
+const size_t MaxSharedMemoryKeys = 64;
+
+//-----------------------------------------------------------------------------
+bool IsSharedMemoryNotification(const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+{
+  const size_t suffixLength = strlen(ddSharedMemoryPublisher::notificationSuffix());
+  ddSharedMemoryPublisher::Notification notification;
+  return channel.size() > suffixLength
+    && channel.compare(channel.size() - suffixLength, suffixLength, ddSharedMemoryPublisher::notificationSuffix()) == 0
+    && ddSharedMemoryPublisher::decodeNotification(rbuf->data, rbuf->data_size, &notification);
+}
+
+}
+
+
+//-----------------------------------------------------------------------------
+class ddLCMDispatcher::Subscription
+{
+public:
+
+  Subscription(ddLCMDispatcher* dispatcher, const std::string& channel, const Handler& handler, int worker)
+    : Dispatcher(dispatcher), Callback(handler), Worker(worker), LCMSubscription(0),
+      LCMSharedMemorySubscription(0), MinimumSharedMemoryDataSize(std::numeric_limits<uint32_t>::max()), Active(true), InFlight(0)
+  {
+    // lcm matches channels against the whole regular expression
+    const std::string pattern = "^" + channel + "$";
+    this->HasPattern = (regcomp(&this->Pattern, pattern.c_str(), REG_NOSUB | REG_EXTENDED) == 0);
+  }
+
+  ~Subscription()
+  {
+    if (this->HasPattern)
+    {
+      regfree(&this->Pattern);
+    }
+  }
+
+  bool Matches(const std::string& channel) const
+  {
+    return this->HasPattern && regexec(&this->Pattern, channel.c_str(), 0, 0, 0) == 0;
+  }
+
+  // Called by lcm on the receive thread.
+  void OnMessage(const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+  {
+    if (this->Dispatcher->replayIsEnabled()
+        || IsSharedMemoryNotification(rbuf, channel))
+    {
+      return;
+    }
+
+    // messages smaller than any shared memory message of the subscription
+    // cannot be a fallback copy and are not hashed
+    if (rbuf->data_size < this->MinimumSharedMemoryDataSize)
+    {
+      this->Dispatcher->route(this->Self.lock(), rbuf, channel);
+      return;
+    }
+
+    // drop the message if it is the fallback copy of a message that was
+    // delivered from shared memory
+    const SharedMemoryKey key = {channel, rbuf->data_size, ddSharedMemoryPublisher::digest(rbuf->data, rbuf->data_size)};
+    if (this->TakeSharedMemoryKey(key))
+    {
+      return;
+    }
+
+    this->Dispatcher->route(this->Self.lock(), rbuf, channel);
+    this->AddSharedMemoryKey(key);
+  }
+
+  // Called by lcm on the receive thread for notifications on <channel>_SHM.
+  void OnSharedMemoryMessage(const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+  {
+    if (this->Dispatcher->replayIsEnabled())
+    {
+      return;
+    }
+    this->Dispatcher->routeSharedMemory(this->Self.lock(), rbuf, channel);
+  }
+
+  struct SharedMemoryKey
+  {
+    std::string Channel;
+    uint32_t DataSize;
+    uint64_t Digest;
+
+    bool operator==(const SharedMemoryKey& other) const
+    {
+      return this->Digest == other.Digest && this->DataSize == other.DataSize
+        && this->Channel == other.Channel;
+    }
+  };
+
+  // Returns true and forgets the key if a copy of the message was delivered.
+  bool TakeSharedMemoryKey(const SharedMemoryKey& key)
+  {
+    std::deque<SharedMemoryKey>::iterator itr = std::find(this->SharedMemoryKeys.begin(), this->SharedMemoryKeys.end(), key);
+    if (itr == this->SharedMemoryKeys.end())
+    {
+      return false;
+    }
+    this->SharedMemoryKeys.erase(itr);
+    return true;
+  }
+
+  // Records that a copy of the message was delivered.
+  void AddSharedMemoryKey(const SharedMemoryKey& key)
+  {
+    this->SharedMemoryKeys.push_back(key);
+    if (this->SharedMemoryKeys.size() > MaxSharedMemoryKeys)
+    {
+      this->SharedMemoryKeys.pop_front();
+    }
+  }
+
+  // Calls the handler unless the subscription has been removed.
+  void Call(const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      if (!this->Active)
+      {
+        return;
+      }
+      ++this->InFlight;
+      this->CallingThread = std::this_thread::get_id();
+    }
+
+    this->Callback(rbuf, channel);
+
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      --this->InFlight;
+      this->CallingThread = std::thread::id();
+    }
+    this->Done.notify_all();
+  }
+
+  // Stops future calls and waits for a running call to return.
+  void Deactivate()
+  {
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    this->Active = false;
+    if (this->CallingThread == std::this_thread::get_id())
+    {
+      return;
+    }
+    while (this->InFlight)
+    {
+      this->Done.wait(lock);
+    }
+  }
+
+  ddLCMDispatcher* Dispatcher;
+  Handler Callback;
+  int Worker;
+  lcm::Subscription* LCMSubscription;
+  lcm::Subscription* LCMSharedMemorySubscription;
+  regex_t Pattern;
+  bool HasPattern;
+  std::weak_ptr<Subscription> Self;
+
+  // Only used on the receive thread.
+  std::deque<SharedMemoryKey> SharedMemoryKeys;
+  uint32_t MinimumSharedMemoryDataSize;
+
+  std::mutex Mutex;
+  std::condition_variable Done;
+  bool Active;
+  int InFlight;
+  std::thread::id CallingThread;
+};
+
+//-----------------------------------------------------------------------------
+class ddLCMDispatcher::Worker
+{
+public:
+
+  struct Message
+  {
+    std::shared_ptr<Subscription> Target;
+    std::string Channel;
+    std::vector<uint8_t> Data;
+    int64_t RecvUtime;
+  };
+
+  Worker() : NumberOfDroppedMessages(0), ShouldStop(false)
+  {
+    this->Thread = std::thread(&Worker::ThreadLoop, this);
+  }
+
+  ~Worker()
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->ShouldStop = true;
+    }
+    this->Condition.notify_one();
+    this->Popped.notify_all();
+    this->Thread.join();
+  }
+
+  // Queues the message.  If wait is true and the queue is full, first waits
+  // until the worker has handled a message, otherwise drops a queued message.
+  void Push(const std::shared_ptr<Subscription>& target, const lcm::ReceiveBuffer* rbuf, const std::string& channel, bool wait)
+  {
+    Message message;
+    message.Target = target;
+    message.Channel = channel;
+    message.RecvUtime = rbuf->recv_utime;
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->AcquireBuffer(rbuf->data_size, &message.Data);
+    }
+
+    // copy outside the lock, so the worker can take messages meanwhile
+    message.Data.assign(static_cast<const uint8_t*>(rbuf->data), static_cast<const uint8_t*>(rbuf->data) + rbuf->data_size);
+
+    {
+      std::unique_lock<std::mutex> lock(this->Mutex);
+      while (wait && !this->ShouldStop && this->Queue.size() >= MaxWorkerQueueSize)
+      {
+        this->Popped.wait(lock);
+      }
+
+      if (this->Queue.size() >= MaxWorkerQueueSize)
+      {
+        std::deque<Message>::iterator itr = this->Queue.begin();
+        while (itr != this->Queue.end() && itr->Target != target)
+        {
+          ++itr;
+        }
+        if (itr == this->Queue.end())
+        {
+          itr = this->Queue.begin();
+        }
+        this->RecycleBuffer(itr->Data);
+        this->Queue.erase(itr);
+        ++this->NumberOfDroppedMessages;
+      }
+
+      this->Queue.push_back(std::move(message));
+    }
+    this->Condition.notify_one();
+  }
+
+  size_t QueueSize() const
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    return this->Queue.size();
+  }
+
+  uint64_t DroppedMessages() const
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    return this->NumberOfDroppedMessages;
+  }
+
+private:
+
+  // Moves a free buffer that can hold size bytes without reallocating into
+  // data, or the largest free buffer if none can.  Called with Mutex held.
+  void AcquireBuffer(size_t size, std::vector<uint8_t>* data)
+  {
+    if (this->FreeBuffers.empty())
+    {
+      return;
+    }
+
+    size_t best = 0;
+    for (size_t i = 0; i < this->FreeBuffers.size(); ++i)
+    {
+      const size_t capacity = this->FreeBuffers[i].capacity();
+      const size_t bestCapacity = this->FreeBuffers[best].capacity();
+      if (capacity >= size ? (bestCapacity < size || capacity < bestCapacity) : capacity > bestCapacity)
+      {
+        best = i;
+      }
+    }
+
+    data->swap(this->FreeBuffers[best]);
+    this->FreeBuffers[best].swap(this->FreeBuffers.back());
+    this->FreeBuffers.pop_back();
+  }
+
+  // Returns the buffer of a handled or dropped message to the free list.
+  // Called with Mutex held.
+  void RecycleBuffer(std::vector<uint8_t>& data)
+  {
+    if (this->FreeBuffers.size() < MaxFreeBuffersPerWorker)
+    {
+      this->FreeBuffers.push_back(std::vector<uint8_t>());
+      this->FreeBuffers.back().swap(data);
+    }
+  }
+
+  void ThreadLoop()
+  {
+    while (true)
+    {
+      Message message;
+      {
+        std::unique_lock<std::mutex> lock(this->Mutex);
+        while (!this->ShouldStop && this->Queue.empty())
+        {
+          this->Condition.wait(lock);
+        }
+        if (this->ShouldStop)
+        {
+          return;
+        }
+        message = std::move(this->Queue.front());
+        this->Queue.pop_front();
+      }
+      this->Popped.notify_all();
+
+      lcm::ReceiveBuffer rbuf;
+      rbuf.data = message.Data.empty() ? 0 : &message.Data[0];
+      rbuf.data_size = static_cast<uint32_t>(message.Data.size());
+      rbuf.recv_utime = message.RecvUtime;
+      message.Target->Call(&rbuf, message.Channel);
+      message.Target.reset();
+
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->RecycleBuffer(message.Data);
+    }
+  }
+
+  mutable std::mutex Mutex;
+  std::condition_variable Condition;
+  std::condition_variable Popped;
+  std::deque<Message> Queue;
+  std::vector<std::vector<uint8_t> > FreeBuffers;
+  uint64_t NumberOfDroppedMessages;
+  bool ShouldStop;
+  std::thread Thread;
+};
+
+//-----------------------------------------------------------------------------
+ddLCMDispatcher* ddLCMDispatcher::instance()
+{
+  // never deleted, the dispatcher threads may still be referenced by static
+  // objects that are destroyed at exit
+  static ddLCMDispatcher* dispatcher = new ddLCMDispatcher;
+  return dispatcher;
+}
+
+//-----------------------------------------------------------------------------
+ddLCMDispatcher::ddLCMDispatcher()
+{
+  mStartCount = 0;
+  mNextSubscriptionId = 0;
+  mNextWorker = 0;
+  mReplayEnabled = false;
+  mReplayUtime = 0;
+  mHostId = ddSharedMemoryRing::hostId();
+  mSharedMemoryMessages = 0;
+  mSharedMemoryOverruns = 0;
+
+  const int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+  mNumberOfWorkers = std::max(1, std::min(4, hardwareThreads - 1));
+
+  mLCM = std::shared_ptr<lcm::LCM>(new lcm::LCM);
+  if (!mLCM->good())
+  {
+    std::cerr << "ddLCMDispatcher: lcm is not good()" << std::endl;
+    return;
+  }
+
+  mEventLoop.addLCM(mLCM.get());
+}
+
+//-----------------------------------------------------------------------------
+ddLCMDispatcher::~ddLCMDispatcher()
+{
+  mEventLoop.stop();
+  if (mReceiveThread)
+  {
+    mReceiveThread->join();
+  }
+  mWorkers.clear();
+}
+
+//-----------------------------------------------------------------------------
+int ddLCMDispatcher::subscribe(const std::string& channel, const Handler& handler, int worker)
+{
+  if (!mLCM->good())
+  {
+    return -1;
+  }
+
+  if (worker == AnyWorker)
+  {
+    worker = this->allocateWorker();
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  std::shared_ptr<Subscription> subscription(new Subscription(this, channel, handler, worker));
+  subscription->Self = subscription;
+  subscription->LCMSubscription = mLCM->subscribe(channel, &Subscription::OnMessage, subscription.get());
+  if (!subscription->LCMSubscription)
+  {
+    return -1;
+  }
+
+  const std::string notificationChannel = "(" + channel + ")" + ddSharedMemoryPublisher::notificationSuffix();
+  subscription->LCMSharedMemorySubscription = mLCM->subscribe(notificationChannel, &Subscription::OnSharedMemoryMessage, subscription.get());
+
+  const int subscriptionId = mNextSubscriptionId++;
+  mSubscriptions[subscriptionId] = subscription;
+  mChannelSubscriptions.clear();
+  return subscriptionId;
+}
+
+//-----------------------------------------------------------------------------
+int ddLCMDispatcher::allocateWorker()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mNextWorker++;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMDispatcher::unsubscribe(int subscriptionId)
+{
+  std::shared_ptr<Subscription> subscription;
+  bool postToReceiveThread = false;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::map<int, std::shared_ptr<Subscription> >::iterator itr = mSubscriptions.find(subscriptionId);
+    if (itr == mSubscriptions.end())
+    {
+      return;
+    }
+    subscription = itr->second;
+    mSubscriptions.erase(itr);
+    mChannelSubscriptions.clear();
+    postToReceiveThread = mReceiveThread && mReceiveThread->get_id() != std::this_thread::get_id();
+  }
+
+  subscription->Deactivate();
+
+  // the lcm subscription must not be removed while handle() is running on
+  // the receive thread, so hand it to the receive thread.  The command holds
+  // a reference that keeps the subscription alive until then.
+  std::shared_ptr<lcm::LCM> lcmHandle = mLCM;
+  lcm::Subscription* lcmSubscription = subscription->LCMSubscription;
+  lcm::Subscription* lcmSharedMemorySubscription = subscription->LCMSharedMemorySubscription;
+  std::function<void()> unsubscribeLCM = [lcmHandle, lcmSubscription, lcmSharedMemorySubscription, subscription]()
+  {
+    lcmHandle->unsubscribe(lcmSubscription);
+    if (lcmSharedMemorySubscription)
+    {
+      lcmHandle->unsubscribe(lcmSharedMemorySubscription);
+    }
+  };
+
+  if (postToReceiveThread)
+  {
+    mEventLoop.post(unsubscribeLCM);
+  }
+  else
+  {
+    unsubscribeLCM();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMDispatcher::route(const std::shared_ptr<Subscription>& subscription, const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+{
+  if (!subscription)
+  {
+    return;
+  }
+
+  // mWorkers is only modified while the receive thread is stopped
+  if (subscription->Worker < 0 || mWorkers.empty())
+  {
+    subscription->Call(rbuf, channel);
+    return;
+  }
+
+  mWorkers[subscription->Worker % mWorkers.size()]->Push(subscription, rbuf, channel, false);
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMDispatcher::routeSharedMemory(const std::shared_ptr<Subscription>& subscription, const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+{
+  ddSharedMemoryPublisher::Notification notification;
+  if (!subscription
+      || !ddSharedMemoryPublisher::decodeNotification(rbuf->data, rbuf->data_size, &notification)
+      || notification.HostId != mHostId)
+  {
+    return;
+  }
+
+  // only the receive thread uses the segment cache
+  std::shared_ptr<ddSharedMemoryRing>& ring = mSharedMemoryRings[notification.SegmentName];
+  if (!ring || ring->segmentId() != notification.SegmentId)
+  {
+    ring.reset(new ddSharedMemoryRing);
+    if (!ring->open(notification.SegmentName) || ring->segmentId() != notification.SegmentId)
+    {
+      ring.reset();
+      return;
+    }
+  }
+
+  // the fallback copy of the message arrived first
+  const std::string messageChannel = channel.substr(0, channel.size() - strlen(ddSharedMemoryPublisher::notificationSuffix()));
+  const Subscription::SharedMemoryKey key = {messageChannel, notification.DataSize, notification.Digest};
+  if (notification.HasFallback)
+  {
+    subscription->MinimumSharedMemoryDataSize = std::min(subscription->MinimumSharedMemoryDataSize, notification.DataSize);
+    if (subscription->TakeSharedMemoryKey(key))
+    {
+      return;
+    }
+  }
+
+  // copy the message out of the slot and check that the publisher did not
+  // reuse the slot meanwhile, a torn message is never delivered and the
+  // fallback copy, if any, is delivered instead
+  lcm::ReceiveBuffer messageBuffer;
+  int64_t publishUtime = 0;
+  if (!ring->read(notification.Slot, notification.Sequence, &mSharedMemoryBuffer, &publishUtime)
+      || mSharedMemoryBuffer.size() != notification.DataSize)
+  {
+    ++mSharedMemoryOverruns;
+    return;
+  }
+
+  messageBuffer.data = mSharedMemoryBuffer.data();
+  messageBuffer.data_size = static_cast<uint32_t>(mSharedMemoryBuffer.size());
+  messageBuffer.recv_utime = rbuf->recv_utime;
+
+  this->route(subscription, &messageBuffer, messageChannel);
+  if (notification.HasFallback)
+  {
+    subscription->AddSharedMemoryKey(key);
+  }
+  ++mSharedMemoryMessages;
+}
+
+//-----------------------------------------------------------------------------
+uint64_t ddLCMDispatcher::numberOfSharedMemoryMessages() const
+{
+  return mSharedMemoryMessages;
+}
+
+//-----------------------------------------------------------------------------
+uint64_t ddLCMDispatcher::numberOfSharedMemoryOverruns() const
+{
+  return mSharedMemoryOverruns;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMDispatcher::setReplayEnabled(bool enabled)
+{
+  mReplayEnabled = enabled;
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMDispatcher::replayIsEnabled() const
+{
+  return mReplayEnabled;
+}
+
+//-----------------------------------------------------------------------------
+int64_t ddLCMDispatcher::currentUtime() const
+{
+  if (mReplayEnabled)
+  {
+    return mReplayUtime;
+  }
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMDispatcher::inject(const std::string& channel, const void* data, uint32_t dataSize, int64_t utime)
+{
+  mReplayUtime = utime;
+
+  std::vector<std::shared_ptr<Subscription> > subscriptions;
+  std::vector<std::shared_ptr<Worker> > workers;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    std::map<std::string, std::vector<std::shared_ptr<Subscription> > >::iterator itr = mChannelSubscriptions.find(channel);
+    if (itr == mChannelSubscriptions.end())
+    {
+      std::vector<std::shared_ptr<Subscription> >& matches = mChannelSubscriptions[channel];
+      for (std::map<int, std::shared_ptr<Subscription> >::const_iterator sitr = mSubscriptions.begin(); sitr != mSubscriptions.end(); ++sitr)
+      {
+        if (sitr->second->Matches(channel))
+        {
+          matches.push_back(sitr->second);
+        }
+      }
+      itr = mChannelSubscriptions.find(channel);
+    }
+
+    subscriptions = itr->second;
+    workers = mWorkers;
+  }
+
+  lcm::ReceiveBuffer rbuf;
+  rbuf.data = const_cast<void*>(data);
+  rbuf.data_size = dataSize;
+  rbuf.recv_utime = utime;
+
+  for (size_t i = 0; i < subscriptions.size(); ++i)
+  {
+    const std::shared_ptr<Subscription>& subscription = subscriptions[i];
+    if (subscription->Worker < 0 || workers.empty())
+    {
+      subscription->Call(&rbuf, channel);
+    }
+    else
+    {
+      workers[subscription->Worker % workers.size()]->Push(subscription, &rbuf, channel, true);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMDispatcher::start()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mStartCount++)
+  {
+    return;
+  }
+
+  if (!mLCM->good())
+  {
+    return;
+  }
+
+  for (int i = 0; i < mNumberOfWorkers; ++i)
+  {
+    mWorkers.push_back(std::shared_ptr<Worker>(new Worker));
+  }
+
+  mReceiveThread = std::shared_ptr<std::thread>(new std::thread(&ddLCMDispatcher::receiveThreadLoop, this));
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMDispatcher::stop()
+{
+  std::shared_ptr<std::thread> receiveThread;
+  std::vector<std::shared_ptr<Worker> > workers;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mStartCount || --mStartCount)
+    {
+      return;
+    }
+    receiveThread.swap(mReceiveThread);
+  }
+
+  if (receiveThread)
+  {
+    mEventLoop.stop();
+    receiveThread->join();
+  }
+
+  // the receive thread has exited, nothing else pushes to the workers
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    workers.swap(mWorkers);
+  }
+  workers.clear();
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMDispatcher::receiveThreadLoop()
+{
+  mEventLoop.run();
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMDispatcher::isRunning() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mReceiveThread.get() != 0;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMDispatcher::setNumberOfWorkers(int numberOfWorkers)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  mNumberOfWorkers = std::max(1, numberOfWorkers);
+}
+
+//-----------------------------------------------------------------------------
+int ddLCMDispatcher::numberOfWorkers() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mNumberOfWorkers;
+}
+
+//-----------------------------------------------------------------------------
+size_t ddLCMDispatcher::workerQueueSize(int worker) const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  if (worker < 0 || worker >= static_cast<int>(mWorkers.size()))
+  {
+    return 0;
+  }
+  return mWorkers[worker]->QueueSize();
+}
+
+//-----------------------------------------------------------------------------
+uint64_t ddLCMDispatcher::workerDroppedMessages(int worker) const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  if (worker < 0 || worker >= static_cast<int>(mWorkers.size()))
+  {
+    return 0;
+  }
+  return mWorkers[worker]->DroppedMessages();
+}
@@ -0,0 +1,195 @@
+#ifndef __ddLCMDispatcher_h
+#define __ddLCMDispatcher_h
+
+#include "ddCommonConfigure.h"
+#include "ddLCMEventLoop.h"
+
+#include <lcm/lcm-cpp.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// A process wide lcm dispatcher.
+//
+// The dispatcher owns a single lcm::LCM instance and a receive thread that
+// runs a ddLCMEventLoop on it, so every lcm packet received by the process is
+// read from one socket and parsed once.  Clients subscribe to channels through
+// the dispatcher and choose where their handler runs: on the receive thread,
+// or on one of a fixed number of worker threads.  Each subscription is bound
+// to a single worker, so messages on a channel are always handled in the order
+// they were received.  Work that is slow, such as building point clouds, can
+// be moved off the receive thread without the number of threads growing with
+// the number of sensors.
+//
+// ddLCMThread and the VTK lcm sources share the dispatcher.  Use start() and
+// stop() to hold a reference on the receive thread; it runs while at least
+// one client has started it.
+//
+// For log replay, inject() hands a message directly to the subscriptions
+// whose channel matches, without going through the network.  While replay is
+// enabled messages received from lcm are ignored and currentUtime() returns
+// the timestamp of the last injected message, so code that asks for the
+// current time sees the log time.
+//
+// Every subscription also listens for the notifications that a
+// ddSharedMemoryPublisher in another process on this host publishes on
+// <channel>_SHM, and receives those messages from shared memory as if they
+// had arrived on <channel>.
+
+class ddSharedMemoryRing;
+
+class DD_COMMON_EXPORT ddLCMDispatcher
+{
+public:
+
+  typedef std::function<void(const lcm::ReceiveBuffer* rbuf, const std::string& channel)> Handler;
+
+  enum
+  {
+    // Run the handler on the receive thread.
+    ReceiveThread = -1,
+
+    // Run the handler on a worker thread chosen by the dispatcher.
+    AnyWorker = -2
+  };
+
+  static ddLCMDispatcher* instance();
+
+  lcm::LCM* lcmHandle()
+  {
+    return mLCM.get();
+  }
+
+  ddLCMEventLoop* eventLoop()
+  {
+    return &mEventLoop;
+  }
+
+  // Subscribes the handler to the channel.  The worker argument is either
+  // ReceiveThread, AnyWorker, or a worker index.  Returns a subscription id
+  // that is passed to unsubscribe(), or -1 on error.
+  int subscribe(const std::string& channel, const Handler& handler, int worker=ReceiveThread);
+
+  // Subscribes a method that takes a decoded lcm message.
+  template <class MessageType, class HandlerClass>
+  int subscribe(const std::string& channel,
+      void (HandlerClass::*handlerMethod)(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const MessageType* msg),
+      HandlerClass* handler, int worker=ReceiveThread)
+  {
+    return this->subscribe(channel, [handlerMethod, handler](const lcm::ReceiveBuffer* rbuf, const std::string& channel)
+    {
+      MessageType msg;
+      if (msg.decode(rbuf->data, 0, rbuf->data_size) < 0)
+      {
+        return;
+      }
+      (handler->*handlerMethod)(rbuf, channel, &msg);
+    }, worker);
+  }
+
+  // Returns a worker index chosen round robin.  Subscriptions that are made
+  // with the same worker index are handled in order on one thread.
+  int allocateWorker();
+
+  // Removes the subscription.  When this returns the handler is not running
+  // and will not be called again, unless unsubscribe() is called from the
+  // handler itself.
+  void unsubscribe(int subscriptionId);
+
+  // Starts the receive thread and the workers if they are not running, and
+  // increments the number of clients.
+  void start();
+
+  // Decrements the number of clients and stops the threads when it reaches
+  // zero.  Must not be called from a handler.
+  void stop();
+
+  bool isRunning() const;
+
+  // Sets the number of worker threads.  Takes effect the next time the
+  // dispatcher is started.
+  void setNumberOfWorkers(int numberOfWorkers);
+  int numberOfWorkers() const;
+
+  // Returns the number of messages waiting to be handled by the worker.
+  size_t workerQueueSize(int worker) const;
+
+  // Returns the number of received messages the worker dropped because its
+  // queue was full.  The worker's queue is bounded, so a handler that is
+  // slower than the rate of its channel skips messages instead of queuing
+  // them without limit.  Injected messages are never dropped.
+  uint64_t workerDroppedMessages(int worker) const;
+
+  void setReplayEnabled(bool enabled);
+  bool replayIsEnabled() const;
+
+  // Routes the message to the matching subscriptions as if it had been
+  // received with the given receive time.  Handlers that run on the receive
+  // thread are called on the calling thread.  Blocks while the worker of a
+  // matching subscription has a long queue.  Must be called from a single
+  // thread.
+  void inject(const std::string& channel, const void* data, uint32_t dataSize, int64_t utime);
+
+  // Returns the system time in microseconds, or the time of the last injected
+  // message while replay is enabled.
+  int64_t currentUtime() const;
+
+  // Returns the number of messages delivered from shared memory, and the
+  // number that were overwritten by the publisher before or while they were
+  // copied out of shared memory.  An overrun message is only delivered if
+  // its fallback copy was published.  Overruns mean the publisher's ring has too few slots for the
+  // time the handlers take.
+  uint64_t numberOfSharedMemoryMessages() const;
+  uint64_t numberOfSharedMemoryOverruns() const;
+
+private:
+
+  class Subscription;
+  class Worker;
+
+  ddLCMDispatcher();
+  ~ddLCMDispatcher();
+
+  void receiveThreadLoop();
+  void route(const std::shared_ptr<Subscription>& subscription, const lcm::ReceiveBuffer* rbuf, const std::string& channel);
+  void routeSharedMemory(const std::shared_ptr<Subscription>& subscription, const lcm::ReceiveBuffer* rbuf, const std::string& channel);
+
+  ddLCMDispatcher(const ddLCMDispatcher&); // Not implemented
+  void operator=(const ddLCMDispatcher&); // Not implemented
+
+  std::shared_ptr<lcm::LCM> mLCM;
+  ddLCMEventLoop mEventLoop;
+
+  mutable std::mutex mMutex;
+  int mStartCount;
+  int mNumberOfWorkers;
+  int mNextSubscriptionId;
+  int mNextWorker;
+  std::shared_ptr<std::thread> mReceiveThread;
+  std::vector<std::shared_ptr<Worker> > mWorkers;
+  std::map<int, std::shared_ptr<Subscription> > mSubscriptions;
+
+  // The subscriptions that match each injected channel, cleared when a
+  // subscription is added or removed.
+  std::map<std::string, std::vector<std::shared_ptr<Subscription> > > mChannelSubscriptions;
+
+  std::atomic<bool> mReplayEnabled;
+  std::atomic<int64_t> mReplayUtime;
+
+  // Shared memory state, only used on the receive thread.
+  uint64_t mHostId;
+  std::map<std::string, std::shared_ptr<ddSharedMemoryRing> > mSharedMemoryRings;
+  std::vector<uint8_t> mSharedMemoryBuffer;
+  std::atomic<uint64_t> mSharedMemoryMessages;
+  std::atomic<uint64_t> mSharedMemoryOverruns;
+};
+
+#endif
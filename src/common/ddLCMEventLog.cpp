@@ -0,0 +1,607 @@
+#include "ddLCMEventLog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+// lcm limits channel names to 63 characters, allow some slack for logs
+// written by other tools.
+const uint32_t MaxChannelLength = 255;
+
+// Ranges smaller than this are not worth a thread.
+const uint64_t MinRangeSize = 16*1024*1024;
+
+// The sidecar index file, all integers little endian:
+//
+//   char[4]  magic "DDLI"
+//   uint32   version
+//   uint64   log size
+//   int64    log modification time, seconds and nanoseconds
+//   uint64   number of events
+//   uint32   number of channels
+//   per channel: uint32 name length, name
+//   per event: int64 timestamp, uint32 channel id, uint32 data size
+//
+// Events are contiguous from the start of the log, so their offsets, the
+// per channel event lists and the time histogram are rebuilt at load time.
+const char IndexFileMagic[4] = {'D', 'D', 'L', 'I'};
+const uint32_t IndexFileVersion = 2;
+const size_t IndexFileHeaderSize = 44;
+const size_t IndexFileEventSize = 16;
+
+//-----------------------------------------------------------------------------
+void PutUInt32LE(std::vector<uint8_t>& buffer, uint32_t value)
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    buffer.push_back(static_cast<uint8_t>(value >> (8*i)));
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PutUInt64LE(std::vector<uint8_t>& buffer, uint64_t value)
+{
+  for (int i = 0; i < 8; ++i)
+  {
+    buffer.push_back(static_cast<uint8_t>(value >> (8*i)));
+  }
+}
+
+//-----------------------------------------------------------------------------
+uint32_t GetUInt32LE(const uint8_t* data)
+{
+  return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+}
+
+//-----------------------------------------------------------------------------
+uint64_t GetUInt64LE(const uint8_t* data)
+{
+  return uint64_t(GetUInt32LE(data)) | (uint64_t(GetUInt32LE(data + 4)) << 32);
+}
+
+//-----------------------------------------------------------------------------
+uint32_t ReadUInt32(const uint8_t* data)
+{
+  return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+}
+
+//-----------------------------------------------------------------------------
+int64_t ReadInt64(const uint8_t* data)
+{
+  return static_cast<int64_t>((uint64_t(ReadUInt32(data)) << 32) | uint64_t(ReadUInt32(data + 4)));
+}
+
+} // end namespace
+
+
+//-----------------------------------------------------------------------------
+// The events that start in [Begin, End), with channel ids local to the range.
+struct ddLCMEventLog::Range
+{
+  uint64_t Begin;
+  uint64_t End;
+  bool SearchSync;
+
+  std::vector<Event> Events;
+  std::vector<std::string> Channels;
+  std::map<std::string, int> ChannelIds;
+
+  // The offset after the last event, where the next range must continue.
+  uint64_t NextOffset;
+  bool Truncated;
+};
+
+//-----------------------------------------------------------------------------
+ddLCMEventLog::ddLCMEventLog()
+{
+  mFileDescriptor = -1;
+  mData = 0;
+  mSize = 0;
+  mModifiedTime = 0;
+  mModifiedTimeNanoseconds = 0;
+  mIndexWasLoaded = false;
+  mTimeHistogramBinWidth = 1;
+}
+
+//-----------------------------------------------------------------------------
+ddLCMEventLog::~ddLCMEventLog()
+{
+  this->close();
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMEventLog::open(const std::string& filename, int numberOfThreads, bool useIndexFile)
+{
+  this->close();
+
+  mFileDescriptor = ::open(filename.c_str(), O_RDONLY);
+  if (mFileDescriptor < 0)
+  {
+    return false;
+  }
+
+  struct stat fileStat;
+  if (fstat(mFileDescriptor, &fileStat) != 0 || fileStat.st_size <= 0)
+  {
+    this->close();
+    return false;
+  }
+
+  mSize = static_cast<uint64_t>(fileStat.st_size);
+  mModifiedTime = fileStat.st_mtime;
+#if defined(__APPLE__)
+  mModifiedTimeNanoseconds = fileStat.st_mtimespec.tv_nsec;
+#else
+  mModifiedTimeNanoseconds = fileStat.st_mtim.tv_nsec;
+#endif
+
+  void* data = mmap(0, mSize, PROT_READ, MAP_PRIVATE, mFileDescriptor, 0);
+  if (data == MAP_FAILED)
+  {
+    this->close();
+    return false;
+  }
+
+  mData = static_cast<const uint8_t*>(data);
+  mFilename = filename;
+
+  if (useIndexFile && this->readIndexFile())
+  {
+    mIndexWasLoaded = true;
+    return true;
+  }
+
+  this->indexEvents(numberOfThreads);
+  this->buildChannelEvents();
+  this->buildTimeHistogram();
+
+  if (useIndexFile)
+  {
+    this->writeIndexFile();
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLog::indexEvents(int numberOfThreads)
+{
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+
+  const uint64_t maxRanges = std::max(uint64_t(1), mSize / MinRangeSize);
+  const int numberOfRanges = static_cast<int>(std::min(uint64_t(numberOfThreads), maxRanges));
+
+  std::vector<Range> ranges(numberOfRanges);
+  for (int i = 0; i < numberOfRanges; ++i)
+  {
+    ranges[i].Begin = mSize * i / numberOfRanges;
+    ranges[i].End = mSize * (i + 1) / numberOfRanges;
+    ranges[i].SearchSync = (i > 0);
+  }
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < numberOfRanges; ++i)
+  {
+    threads.push_back(std::thread(&ddLCMEventLog::indexRange, this, &ranges[i]));
+  }
+  this->indexRange(&ranges[0]);
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].join();
+  }
+
+  // stitch the ranges in file order, rescanning a range that did not start
+  // where the previous range ended
+  uint64_t expectedOffset = 0;
+  for (int i = 0; i < numberOfRanges; ++i)
+  {
+    Range& range = ranges[i];
+
+    if (expectedOffset >= range.End)
+    {
+      // the range lies inside the payload of an event of a previous range
+      continue;
+    }
+
+    const bool startsAtExpectedOffset = !range.Events.empty() && range.Events.front().Offset == expectedOffset;
+    if (!startsAtExpectedOffset)
+    {
+      range.Begin = expectedOffset;
+      range.SearchSync = false;
+      this->indexRange(&range);
+    }
+
+    mEvents.reserve(mEvents.size() + range.Events.size());
+    for (size_t j = 0; j < range.Events.size(); ++j)
+    {
+      Event event = range.Events[j];
+      event.ChannelId = this->internChannel(range.Channels[event.ChannelId]);
+      mEvents.push_back(event);
+    }
+
+    expectedOffset = range.NextOffset;
+    if (range.Truncated)
+    {
+      break;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLog::close()
+{
+  if (mData)
+  {
+    munmap(const_cast<uint8_t*>(mData), mSize);
+  }
+
+  if (mFileDescriptor >= 0)
+  {
+    ::close(mFileDescriptor);
+  }
+
+  mFileDescriptor = -1;
+  mData = 0;
+  mSize = 0;
+  mModifiedTime = 0;
+  mModifiedTimeNanoseconds = 0;
+  mIndexWasLoaded = false;
+  mFilename.clear();
+  mEvents.clear();
+  mChannelNames.clear();
+  mChannelIds.clear();
+  mChannelEvents.clear();
+  mTimeHistogram.clear();
+  mTimeHistogramBinWidth = 1;
+}
+
+//-----------------------------------------------------------------------------
+std::string ddLCMEventLog::indexFilename(const std::string& filename)
+{
+  return filename + ".ddindex";
+}
+
+//-----------------------------------------------------------------------------
+const void* ddLCMEventLog::eventData(size_t index) const
+{
+  const Event& event = mEvents[index];
+  return mData + event.Offset + EventHeaderSize + mChannelNames[event.ChannelId].size();
+}
+
+//-----------------------------------------------------------------------------
+int ddLCMEventLog::channelId(const std::string& channelName) const
+{
+  std::map<std::string, int>::const_iterator itr = mChannelIds.find(channelName);
+  return itr == mChannelIds.end() ? -1 : itr->second;
+}
+
+//-----------------------------------------------------------------------------
+size_t ddLCMEventLog::findEvent(int64_t timestamp) const
+{
+  struct CompareTimestamp
+  {
+    bool operator()(const Event& event, int64_t timestamp) const
+    {
+      return event.Timestamp < timestamp;
+    }
+  };
+
+  return std::lower_bound(mEvents.begin(), mEvents.end(), timestamp, CompareTimestamp()) - mEvents.begin();
+}
+
+//-----------------------------------------------------------------------------
+int64_t ddLCMEventLog::startTimestamp() const
+{
+  return mEvents.empty() ? 0 : mEvents.front().Timestamp;
+}
+
+//-----------------------------------------------------------------------------
+int64_t ddLCMEventLog::endTimestamp() const
+{
+  return mEvents.empty() ? 0 : mEvents.back().Timestamp;
+}
+
+//-----------------------------------------------------------------------------
+size_t ddLCMEventLog::findNextEventOnChannel(int channelId, size_t index) const
+{
+  if (channelId < 0 || channelId >= this->numberOfChannels())
+  {
+    return mEvents.size();
+  }
+
+  const std::vector<uint64_t>& channelEvents = mChannelEvents[channelId];
+  std::vector<uint64_t>::const_iterator itr = std::lower_bound(channelEvents.begin(), channelEvents.end(), uint64_t(index));
+  return itr == channelEvents.end() ? mEvents.size() : static_cast<size_t>(*itr);
+}
+
+//-----------------------------------------------------------------------------
+int64_t ddLCMEventLog::eventNumber(size_t index) const
+{
+  return ReadInt64(mData + mEvents[index].Offset + 4);
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMEventLog::readEventAt(uint64_t offset, Event* event, std::string* channel) const
+{
+  if (offset + EventHeaderSize > mSize)
+  {
+    return false;
+  }
+
+  const uint8_t* header = mData + offset;
+  if (ReadUInt32(header) != SyncWord)
+  {
+    return false;
+  }
+
+  const uint32_t channelLength = ReadUInt32(header + 20);
+  const uint32_t dataSize = ReadUInt32(header + 24);
+  if (channelLength == 0 || channelLength > MaxChannelLength || dataSize > 0x7fffffff)
+  {
+    return false;
+  }
+
+  if (offset + EventHeaderSize + channelLength + dataSize > mSize)
+  {
+    return false;
+  }
+
+  event->Timestamp = ReadInt64(header + 12);
+  event->Offset = offset;
+  event->ChannelId = -1;
+  event->DataSize = dataSize;
+  channel->assign(reinterpret_cast<const char*>(header + EventHeaderSize), channelLength);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLog::indexRange(Range* range) const
+{
+  range->Events.clear();
+  range->Channels.clear();
+  range->ChannelIds.clear();
+  range->NextOffset = range->Begin;
+  range->Truncated = false;
+
+  Event event;
+  std::string channel;
+  uint64_t offset = range->Begin;
+
+  if (range->SearchSync)
+  {
+    // find the first sync word that starts a valid event which is followed by
+    // another event or the end of the file
+    for (; offset < range->End; ++offset)
+    {
+      if (mData[offset] != 0xED || !this->readEventAt(offset, &event, &channel))
+      {
+        continue;
+      }
+
+      const uint64_t nextOffset = offset + EventHeaderSize + channel.size() + event.DataSize;
+      if (nextOffset == mSize || (nextOffset + 4 <= mSize && ReadUInt32(mData + nextOffset) == SyncWord))
+      {
+        break;
+      }
+    }
+
+    if (offset >= range->End)
+    {
+      range->NextOffset = range->End;
+      return;
+    }
+  }
+
+  while (offset < range->End)
+  {
+    if (!this->readEventAt(offset, &event, &channel))
+    {
+      range->Truncated = true;
+      break;
+    }
+
+    std::map<std::string, int>::const_iterator itr = range->ChannelIds.find(channel);
+    if (itr == range->ChannelIds.end())
+    {
+      itr = range->ChannelIds.insert(std::make_pair(channel, static_cast<int>(range->Channels.size()))).first;
+      range->Channels.push_back(channel);
+    }
+
+    event.ChannelId = itr->second;
+    range->Events.push_back(event);
+    offset += EventHeaderSize + channel.size() + event.DataSize;
+  }
+
+  range->NextOffset = offset;
+}
+
+//-----------------------------------------------------------------------------
+int ddLCMEventLog::internChannel(const std::string& channel)
+{
+  std::map<std::string, int>::const_iterator itr = mChannelIds.find(channel);
+  if (itr != mChannelIds.end())
+  {
+    return itr->second;
+  }
+
+  const int channelId = static_cast<int>(mChannelNames.size());
+  mChannelIds[channel] = channelId;
+  mChannelNames.push_back(channel);
+  return channelId;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLog::buildChannelEvents()
+{
+  mChannelEvents.assign(mChannelNames.size(), std::vector<uint64_t>());
+  for (size_t i = 0; i < mEvents.size(); ++i)
+  {
+    mChannelEvents[mEvents[i].ChannelId].push_back(i);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLog::buildTimeHistogram()
+{
+  const int64_t duration = this->endTimestamp() - this->startTimestamp();
+  mTimeHistogramBinWidth = std::max(int64_t(1), duration / TimeHistogramBins + 1);
+  mTimeHistogram.assign(TimeHistogramBins, 0);
+
+  const int64_t startTimestamp = this->startTimestamp();
+  for (size_t i = 0; i < mEvents.size(); ++i)
+  {
+    const int64_t bin = (mEvents[i].Timestamp - startTimestamp) / mTimeHistogramBinWidth;
+    ++mTimeHistogram[std::min(std::max(bin, int64_t(0)), int64_t(TimeHistogramBins - 1))];
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMEventLog::readIndexFile()
+{
+  FILE* file = fopen(indexFilename(mFilename).c_str(), "rb");
+  if (!file)
+  {
+    return false;
+  }
+
+  std::vector<uint8_t> buffer;
+  uint8_t chunk[65536];
+  size_t bytesRead = 0;
+  while ((bytesRead = fread(chunk, 1, sizeof(chunk), file)) > 0)
+  {
+    buffer.insert(buffer.end(), chunk, chunk + bytesRead);
+  }
+  const bool readError = ferror(file) != 0;
+  fclose(file);
+
+  if (readError || buffer.size() < IndexFileHeaderSize)
+  {
+    return false;
+  }
+
+  const uint8_t* data = buffer.data();
+  const uint8_t* end = data + buffer.size();
+  const uint64_t numberOfEvents = GetUInt64LE(data + 32);
+  const uint32_t numberOfChannels = GetUInt32LE(data + 40);
+
+  bool success = memcmp(data, IndexFileMagic, 4) == 0
+    && GetUInt32LE(data + 4) == IndexFileVersion
+    && GetUInt64LE(data + 8) == mSize
+    && static_cast<int64_t>(GetUInt64LE(data + 16)) == mModifiedTime
+    && static_cast<int64_t>(GetUInt64LE(data + 24)) == mModifiedTimeNanoseconds
+    && numberOfEvents <= mSize / EventHeaderSize;
+  data += IndexFileHeaderSize;
+
+  for (uint32_t i = 0; success && i < numberOfChannels; ++i)
+  {
+    success = end - data >= 4;
+    const uint32_t channelLength = success ? GetUInt32LE(data) : 0;
+    success = success && channelLength <= MaxChannelLength
+      && static_cast<uint64_t>(end - data - 4) >= channelLength;
+    if (success)
+    {
+      const std::string channel(reinterpret_cast<const char*>(data + 4), channelLength);
+      success = this->internChannel(channel) == static_cast<int>(i);
+      data += 4 + channelLength;
+    }
+  }
+
+  success = success && static_cast<uint64_t>(end - data) == numberOfEvents * IndexFileEventSize;
+
+  // the offsets follow from the sizes, reject an index that points outside
+  // of the log
+  uint64_t offset = 0;
+  if (success)
+  {
+    mEvents.resize(numberOfEvents);
+  }
+  for (size_t i = 0; success && i < mEvents.size(); ++i, data += IndexFileEventSize)
+  {
+    Event& event = mEvents[i];
+    event.Timestamp = static_cast<int64_t>(GetUInt64LE(data));
+    event.ChannelId = static_cast<int32_t>(GetUInt32LE(data + 8));
+    event.DataSize = GetUInt32LE(data + 12);
+    event.Offset = offset;
+    success = event.ChannelId >= 0 && event.ChannelId < this->numberOfChannels()
+      && event.DataSize <= 0x7fffffff;
+    if (success)
+    {
+      offset += EventHeaderSize + mChannelNames[event.ChannelId].size() + event.DataSize;
+      success = offset <= mSize;
+    }
+  }
+
+  if (!success)
+  {
+    mEvents.clear();
+    mChannelNames.clear();
+    mChannelIds.clear();
+    return false;
+  }
+
+  this->buildChannelEvents();
+  this->buildTimeHistogram();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMEventLog::writeIndexFile() const
+{
+  std::vector<uint8_t> buffer;
+  buffer.reserve(IndexFileHeaderSize + mEvents.size() * IndexFileEventSize);
+
+  buffer.insert(buffer.end(), IndexFileMagic, IndexFileMagic + 4);
+  PutUInt32LE(buffer, IndexFileVersion);
+  PutUInt64LE(buffer, mSize);
+  PutUInt64LE(buffer, static_cast<uint64_t>(mModifiedTime));
+  PutUInt64LE(buffer, static_cast<uint64_t>(mModifiedTimeNanoseconds));
+  PutUInt64LE(buffer, mEvents.size());
+  PutUInt32LE(buffer, static_cast<uint32_t>(mChannelNames.size()));
+
+  for (size_t i = 0; i < mChannelNames.size(); ++i)
+  {
+    PutUInt32LE(buffer, static_cast<uint32_t>(mChannelNames[i].size()));
+    buffer.insert(buffer.end(), mChannelNames[i].begin(), mChannelNames[i].end());
+  }
+
+  for (size_t i = 0; i < mEvents.size(); ++i)
+  {
+    PutUInt64LE(buffer, static_cast<uint64_t>(mEvents[i].Timestamp));
+    PutUInt32LE(buffer, static_cast<uint32_t>(mEvents[i].ChannelId));
+    PutUInt32LE(buffer, mEvents[i].DataSize);
+  }
+
+  // write to a temporary file and rename it, so a reader never sees a
+  // partially written index
+  const std::string filename = indexFilename(mFilename);
+  const std::string tempFilename = filename + ".tmp";
+
+  FILE* file = fopen(tempFilename.c_str(), "wb");
+  if (!file)
+  {
+    return false;
+  }
+
+  bool success = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+  success = (fclose(file) == 0) && success;
+
+  if (!success || rename(tempFilename.c_str(), filename.c_str()) != 0)
+  {
+    remove(tempFilename.c_str());
+    return false;
+  }
+
+  return true;
+}
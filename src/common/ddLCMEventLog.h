@@ -0,0 +1,185 @@
+#ifndef __ddLCMEventLog_h
+#define __ddLCMEventLog_h
+
+#include "ddCommonConfigure.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// A read only, memory mapped lcm log file with an index of its events.
+//
+// open() maps the file and builds the index with several threads: the file
+// is split into ranges, each thread walks the events that start in its range,
+// and the ranges are stitched together in file order.  A range that starts
+// inside the payload of an event, where a false sync word can be found, is
+// rescanned from the end of the previous range, so the index always matches
+// a serial scan of the file.  The index holds the timestamp, file offset and
+// channel id of each event; findEvent() seeks by timestamp in O(log n) and
+// event data is read directly from the mapping without a copy.
+//
+// The index is saved to a sidecar file next to the log, see indexFilename().
+// The sidecar records the size and modification time of the log and is only
+// loaded if they match, so reopening a log does not rescan it.  It is a
+// versioned little endian file that stores 16 bytes per event; the event
+// offsets, the event indices of each channel, used by
+// findNextEventOnChannel(), and a coarse histogram of event times are
+// rebuilt from it when it is loaded.
+
+class DD_COMMON_EXPORT ddLCMEventLog
+{
+public:
+
+  struct Event
+  {
+    int64_t Timestamp;
+    uint64_t Offset;
+    int32_t ChannelId;
+    uint32_t DataSize;
+  };
+
+  ddLCMEventLog();
+  ~ddLCMEventLog();
+
+  // Maps the file and loads its index from the sidecar file, or indexes its
+  // events and writes the sidecar file if useIndexFile is true.  A
+  // numberOfThreads of zero uses one thread per core.  Returns false if the
+  // file cannot be mapped.  A log that ends with a truncated event is indexed
+  // up to the truncated event.  Failing to write the sidecar file, for
+  // example in a read only directory, is not an error.
+  bool open(const std::string& filename, int numberOfThreads=0, bool useIndexFile=true);
+  void close();
+
+  // Returns the name of the sidecar index file of a log file.
+  static std::string indexFilename(const std::string& filename);
+
+  // Returns true if the index was loaded from the sidecar file.
+  bool indexWasLoaded() const
+  {
+    return mIndexWasLoaded;
+  }
+
+  bool isOpen() const
+  {
+    return mData != 0;
+  }
+
+  const std::string& filename() const
+  {
+    return mFilename;
+  }
+
+  uint64_t fileSize() const
+  {
+    return mSize;
+  }
+
+  size_t numberOfEvents() const
+  {
+    return mEvents.size();
+  }
+
+  const Event& event(size_t index) const
+  {
+    return mEvents[index];
+  }
+
+  const std::vector<Event>& events() const
+  {
+    return mEvents;
+  }
+
+  // Returns a pointer into the mapped file, valid until close().
+  const void* eventData(size_t index) const;
+
+  const std::string& channelName(int channelId) const
+  {
+    return mChannelNames[channelId];
+  }
+
+  // Returns the id of the channel, or -1 if the log has no events on it.
+  int channelId(const std::string& channelName) const;
+
+  int numberOfChannels() const
+  {
+    return static_cast<int>(mChannelNames.size());
+  }
+
+  // Returns the index of the first event with a timestamp that is not less
+  // than the given timestamp, or numberOfEvents() if there is none.  Event
+  // timestamps are assumed to be nondecreasing, as written by lcm-logger.
+  size_t findEvent(int64_t timestamp) const;
+
+  int64_t startTimestamp() const;
+  int64_t endTimestamp() const;
+
+  // Returns the index of the first event on the channel at or after the
+  // given event index, or numberOfEvents() if there is none.
+  size_t findNextEventOnChannel(int channelId, size_t index) const;
+
+  // Returns the indices of the events on the channel in file order.
+  const std::vector<uint64_t>& channelEvents(int channelId) const
+  {
+    return mChannelEvents[channelId];
+  }
+
+  // Returns the number of events in each of the histogram bins, which divide
+  // the time from startTimestamp() in bins of timeHistogramBinWidth()
+  // microseconds.
+  const std::vector<uint64_t>& timeHistogram() const
+  {
+    return mTimeHistogram;
+  }
+
+  int64_t timeHistogramBinWidth() const
+  {
+    return mTimeHistogramBinWidth;
+  }
+
+  // Returns the lcm event number header field of the event.
+  int64_t eventNumber(size_t index) const;
+
+  enum
+  {
+    SyncWord = 0xEDA1DA01,
+    EventHeaderSize = 28,
+    TimeHistogramBins = 1024
+  };
+
+private:
+
+  struct Range;
+
+  void indexEvents(int numberOfThreads);
+  void indexRange(Range* range) const;
+  bool readEventAt(uint64_t offset, Event* event, std::string* channel) const;
+  int internChannel(const std::string& channel);
+  void buildChannelEvents();
+  void buildTimeHistogram();
+
+  bool readIndexFile();
+  bool writeIndexFile() const;
+
+  ddLCMEventLog(const ddLCMEventLog&); // Not implemented
+  void operator=(const ddLCMEventLog&); // Not implemented
+
+  std::string mFilename;
+  int mFileDescriptor;
+  const uint8_t* mData;
+  uint64_t mSize;
+  int64_t mModifiedTime;
+  int64_t mModifiedTimeNanoseconds;
+  bool mIndexWasLoaded;
+
+  std::vector<Event> mEvents;
+  std::vector<std::string> mChannelNames;
+  std::map<std::string, int> mChannelIds;
+  std::vector<std::vector<uint64_t> > mChannelEvents;
+  std::vector<uint64_t> mTimeHistogram;
+  int64_t mTimeHistogramBinWidth;
+};
+
+#endif
@@ -0,0 +1,405 @@
+#include "ddLCMEventLoop.h"
+
+#include <lcm/lcm-cpp.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+#else
+  #include <poll.h>
+#endif
+
+namespace
+{
+  const int MaxEventsPerIteration = 32;
+}
+
+//-----------------------------------------------------------------------------
+ddLCMEventLoop::ddLCMEventLoop()
+{
+  mShouldStop = false;
+  mIsRunning = false;
+  mLastDispatchLatency = 0.0;
+  mAverageDispatchLatency = 0.0;
+  mMaxDispatchLatency = 0.0;
+
+#ifdef __linux__
+  mPollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (mPollFd < 0)
+  {
+    std::cerr << "ddLCMEventLoop: epoll_create1() failed: " << strerror(errno) << std::endl;
+  }
+
+  mWakeupFd[0] = mWakeupFd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (mWakeupFd[0] < 0)
+  {
+    std::cerr << "ddLCMEventLoop: eventfd() failed: " << strerror(errno) << std::endl;
+  }
+#else
+  mPollFd = -1;
+  if (pipe(mWakeupFd) != 0)
+  {
+    std::cerr << "ddLCMEventLoop: pipe() failed: " << strerror(errno) << std::endl;
+    mWakeupFd[0] = mWakeupFd[1] = -1;
+  }
+  else
+  {
+    for (int i = 0; i < 2; ++i)
+    {
+      fcntl(mWakeupFd[i], F_SETFL, fcntl(mWakeupFd[i], F_GETFL) | O_NONBLOCK);
+      fcntl(mWakeupFd[i], F_SETFD, FD_CLOEXEC);
+    }
+  }
+#endif
+
+  this->watch(mWakeupFd[0]);
+}
+
+//-----------------------------------------------------------------------------
+ddLCMEventLoop::~ddLCMEventLoop()
+{
+  if (mWakeupFd[0] >= 0)
+  {
+    close(mWakeupFd[0]);
+  }
+  if (mWakeupFd[1] >= 0 && mWakeupFd[1] != mWakeupFd[0])
+  {
+    close(mWakeupFd[1]);
+  }
+  if (mPollFd >= 0)
+  {
+    close(mPollFd);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMEventLoop::watch(int fd)
+{
+#ifdef __linux__
+  epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  if (epoll_ctl(mPollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+  {
+    std::cerr << "ddLCMEventLoop: epoll_ctl() failed for fd " << fd << ": " << strerror(errno) << std::endl;
+    return false;
+  }
+#else
+  // the poll set is rebuilt from mCallbacks each iteration, just wake the
+  // loop so it picks up the new descriptor
+  this->signalWakeup();
+#endif
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::unwatch(int fd)
+{
+#ifdef __linux__
+  epoll_ctl(mPollFd, EPOLL_CTL_DEL, fd, 0);
+#else
+  this->signalWakeup();
+#endif
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMEventLoop::addLCM(lcm::LCM* lcmHandle)
+{
+  if (!lcmHandle || !lcmHandle->good())
+  {
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mLCMHandles.count(lcmHandle))
+    {
+      return true;
+    }
+  }
+
+  const int fd = lcmHandle->getFileno();
+  Callback callback = [this, lcmHandle]()
+  {
+    if (lcmHandle->handle() != 0)
+    {
+      std::cerr << "ddLCMEventLoop: lcm->handle() returned non-zero, removing lcm handle from the loop." << std::endl;
+      this->removeLCM(lcmHandle);
+    }
+  };
+
+  if (!this->addFileDescriptor(fd, callback))
+  {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  mLCMHandles[lcmHandle] = fd;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::removeLCM(lcm::LCM* lcmHandle)
+{
+  int fd = -1;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::map<lcm::LCM*, int>::iterator itr = mLCMHandles.find(lcmHandle);
+    if (itr == mLCMHandles.end())
+    {
+      return;
+    }
+    fd = itr->second;
+    mLCMHandles.erase(itr);
+  }
+
+  this->removeFileDescriptor(fd);
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMEventLoop::addFileDescriptor(int fd, const Callback& callback)
+{
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCallbacks.count(fd))
+    {
+      mCallbacks[fd] = callback;
+      return true;
+    }
+    mCallbacks[fd] = callback;
+  }
+
+  if (!this->watch(fd))
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCallbacks.erase(fd);
+    return false;
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::removeFileDescriptor(int fd)
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mCallbacks.erase(fd))
+    {
+      return;
+    }
+  }
+
+  this->unwatch(fd);
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::post(const Callback& command)
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPostedCommands.push_back(command);
+  }
+  this->signalWakeup();
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::stop()
+{
+  mShouldStop = true;
+  this->signalWakeup();
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::signalWakeup()
+{
+#ifdef __linux__
+  const uint64_t value = 1;
+#else
+  const char value = 1;
+#endif
+  ssize_t written = write(mWakeupFd[1], &value, sizeof(value));
+  (void)written;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::drainWakeup()
+{
+#ifdef __linux__
+  uint64_t value;
+  ssize_t bytesRead = read(mWakeupFd[0], &value, sizeof(value));
+  (void)bytesRead;
+#else
+  char buffer[64];
+  while (read(mWakeupFd[0], buffer, sizeof(buffer)) > 0)
+  {
+  }
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::runPostedCommands()
+{
+  std::deque<Callback> commands;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    commands.swap(mPostedCommands);
+  }
+
+  for (size_t i = 0; i < commands.size(); ++i)
+  {
+    commands[i]();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::dispatch(int fd)
+{
+  if (fd == mWakeupFd[0])
+  {
+    this->drainWakeup();
+    this->runPostedCommands();
+    return;
+  }
+
+  Callback callback;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::map<int, Callback>::const_iterator itr = mCallbacks.find(fd);
+    if (itr == mCallbacks.end())
+    {
+      return;
+    }
+    callback = itr->second;
+  }
+
+  callback();
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::run()
+{
+  mIsRunning = true;
+
+  while (!mShouldStop)
+  {
+    std::vector<int> readyFds;
+
+#ifdef __linux__
+    epoll_event events[MaxEventsPerIteration];
+    const int status = epoll_wait(mPollFd, events, MaxEventsPerIteration, -1);
+    for (int i = 0; i < status; ++i)
+    {
+      readyFds.push_back(events[i].data.fd);
+    }
+#else
+    std::vector<pollfd> pollFds;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      pollfd wakeup = {mWakeupFd[0], POLLIN, 0};
+      pollFds.push_back(wakeup);
+      for (std::map<int, Callback>::const_iterator itr = mCallbacks.begin(); itr != mCallbacks.end(); ++itr)
+      {
+        pollfd entry = {itr->first, POLLIN, 0};
+        pollFds.push_back(entry);
+      }
+    }
+
+    const int status = poll(&pollFds[0], pollFds.size(), -1);
+    for (size_t i = 0; status > 0 && i < pollFds.size(); ++i)
+    {
+      if (pollFds[i].revents & (POLLIN | POLLERR | POLLHUP))
+      {
+        readyFds.push_back(pollFds[i].fd);
+      }
+    }
+#endif
+
+    if (status < 0 && errno != EINTR)
+    {
+      std::cerr << "ddLCMEventLoop: wait returned error: " << strerror(errno) << std::endl;
+      break;
+    }
+
+    if (mShouldStop)
+    {
+      break;
+    }
+
+    const std::chrono::steady_clock::time_point wakeTime = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < readyFds.size(); ++i)
+    {
+      this->dispatch(readyFds[i]);
+    }
+
+    if (!readyFds.empty())
+    {
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - wakeTime;
+      this->recordDispatchLatency(elapsed.count());
+    }
+  }
+
+  // leave the loop ready to be run again
+  mShouldStop = false;
+  mIsRunning = false;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::recordDispatchLatency(double seconds)
+{
+  const double alpha = 0.05;
+
+  std::lock_guard<std::mutex> lock(mLatencyMutex);
+  mLastDispatchLatency = seconds;
+  mAverageDispatchLatency = alpha * seconds + (1.0 - alpha) * mAverageDispatchLatency;
+  if (seconds > mMaxDispatchLatency)
+  {
+    mMaxDispatchLatency = seconds;
+  }
+}
+
+//-----------------------------------------------------------------------------
+double ddLCMEventLoop::lastDispatchLatency() const
+{
+  std::lock_guard<std::mutex> lock(mLatencyMutex);
+  return mLastDispatchLatency;
+}
+
+//-----------------------------------------------------------------------------
+double ddLCMEventLoop::averageDispatchLatency() const
+{
+  std::lock_guard<std::mutex> lock(mLatencyMutex);
+  return mAverageDispatchLatency;
+}
+
+//-----------------------------------------------------------------------------
+double ddLCMEventLoop::maxDispatchLatency() const
+{
+  std::lock_guard<std::mutex> lock(mLatencyMutex);
+  return mMaxDispatchLatency;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMEventLoop::resetDispatchLatency()
+{
+  std::lock_guard<std::mutex> lock(mLatencyMutex);
+  mLastDispatchLatency = 0.0;
+  mAverageDispatchLatency = 0.0;
+  mMaxDispatchLatency = 0.0;
+}
@@ -0,0 +1,97 @@
+#ifndef __ddLCMEventLoop_h
+#define __ddLCMEventLoop_h
+
+#include "ddCommonConfigure.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+
+namespace lcm
+{
+  class LCM;
+}
+
+// An event loop that waits on any number of lcm handles and file descriptors
+// from a single thread.
+//
+// On Linux the loop is built on epoll, on other platforms it falls back to
+// poll().  The loop owns a wake-up descriptor (an eventfd on Linux, a pipe
+// elsewhere) that is signaled by stop() and post(), so stopping the loop and
+// delivering control commands never waits for a timeout.
+//
+// The loop records the time spent dispatching handlers on each iteration.
+
+class DD_COMMON_EXPORT ddLCMEventLoop
+{
+public:
+
+  typedef std::function<void()> Callback;
+
+  ddLCMEventLoop();
+  ~ddLCMEventLoop();
+
+  // Watches the file descriptor of the given lcm handle and calls
+  // lcmHandle->handle() when it is readable.
+  bool addLCM(lcm::LCM* lcmHandle);
+  void removeLCM(lcm::LCM* lcmHandle);
+
+  // Watches the given file descriptor and calls the callback on the loop
+  // thread when it is readable.
+  bool addFileDescriptor(int fd, const Callback& callback);
+  void removeFileDescriptor(int fd);
+
+  // Queues a command to be called on the loop thread and wakes the loop.
+  void post(const Callback& command);
+
+  // Runs the loop on the calling thread until stop() is called.
+  void run();
+
+  // Wakes the loop and makes run() return.  Safe to call from any thread.
+  void stop();
+
+  bool isRunning() const
+  {
+    return mIsRunning;
+  }
+
+  // Dispatch latency statistics, in seconds.  Dispatch latency is the time
+  // from the loop waking up to all ready handlers having returned.
+  double lastDispatchLatency() const;
+  double averageDispatchLatency() const;
+  double maxDispatchLatency() const;
+  void resetDispatchLatency();
+
+private:
+
+  bool watch(int fd);
+  void unwatch(int fd);
+  void signalWakeup();
+  void drainWakeup();
+  void runPostedCommands();
+  void dispatch(int fd);
+  void recordDispatchLatency(double seconds);
+
+  ddLCMEventLoop(const ddLCMEventLoop&); // Not implemented
+  void operator=(const ddLCMEventLoop&); // Not implemented
+
+  int mPollFd;
+  int mWakeupFd[2];
+
+  std::atomic<bool> mShouldStop;
+  std::atomic<bool> mIsRunning;
+
+  std::mutex mMutex;
+  std::map<int, Callback> mCallbacks;
+  std::map<lcm::LCM*, int> mLCMHandles;
+  std::deque<Callback> mPostedCommands;
+
+  mutable std::mutex mLatencyMutex;
+  double mLastDispatchLatency;
+  double mAverageDispatchLatency;
+  double mMaxDispatchLatency;
+};
+
+#endif
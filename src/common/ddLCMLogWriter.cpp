@@ -0,0 +1,634 @@
+#include "ddLCMLogWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef DD_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef DD_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace
+{
+
+// The writer buffers this much of the log before writing it, and compresses
+// blocks of this size.
+const size_t WriteBufferSize = 4*1024*1024;
+const size_t WriteBufferAlignment = 4096;
+
+// A partially filled buffer is written after the writer has been idle for
+// this long, so a crash loses little data.
+const std::chrono::milliseconds FlushInterval(250);
+
+const uint64_t DefaultQueueSize = 256*1024*1024;
+
+const uint32_t LCMSyncWord = 0xEDA1DA01;
+const size_t LCMEventHeaderSize = 28;
+
+// The ring buffer record header.  A record size of zero marks the unused end
+// of the ring, the next record starts at the beginning.
+struct RecordHeader
+{
+  uint32_t RecordSize;
+  uint32_t ChannelLength;
+  int64_t Timestamp;
+  uint32_t DataSize;
+  uint32_t Padding;
+};
+
+// The compressed file format, fields are in host byte order.
+const char CompressedFileMagic[8] = {'D', 'D', 'L', 'C', 'M', 'Z', '0', '1'};
+const uint32_t ChunkMagic = 0x4b434444;
+
+// the chunk holds the block uncompressed, written when compression fails
+const uint32_t RawChunkFlag = 1;
+
+struct CompressedFileHeader
+{
+  char Magic[8];
+  uint32_t Compression;
+  uint32_t Reserved;
+};
+
+struct ChunkHeader
+{
+  uint32_t Magic;
+  uint32_t RawSize;
+  uint32_t CompressedSize;
+  uint32_t Flags;
+};
+
+//-----------------------------------------------------------------------------
+size_t AlignRecordSize(size_t size)
+{
+  return (size + 7) & ~size_t(7);
+}
+
+//-----------------------------------------------------------------------------
+void WriteUInt32(uint8_t* data, uint32_t value)
+{
+  data[0] = value >> 24;
+  data[1] = value >> 16;
+  data[2] = value >> 8;
+  data[3] = value;
+}
+
+//-----------------------------------------------------------------------------
+void WriteInt64(uint8_t* data, int64_t value)
+{
+  WriteUInt32(data, static_cast<uint32_t>(uint64_t(value) >> 32));
+  WriteUInt32(data + 4, static_cast<uint32_t>(value));
+}
+
+//-----------------------------------------------------------------------------
+size_t CompressBound(ddLCMLogWriter::Compression compression, size_t size)
+{
+  switch (compression)
+  {
+#ifdef DD_HAVE_LZ4
+    case ddLCMLogWriter::LZ4Compression:
+      return LZ4_compressBound(static_cast<int>(size));
+#endif
+#ifdef DD_HAVE_ZSTD
+    case ddLCMLogWriter::ZstdCompression:
+      return ZSTD_compressBound(size);
+#endif
+    default:
+      return size;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Returns the compressed size, or zero on error.
+size_t Compress(ddLCMLogWriter::Compression compression, const void* input, size_t inputSize, void* output, size_t outputCapacity)
+{
+  switch (compression)
+  {
+#ifdef DD_HAVE_LZ4
+    case ddLCMLogWriter::LZ4Compression:
+    {
+      const int size = LZ4_compress_default(static_cast<const char*>(input), static_cast<char*>(output),
+        static_cast<int>(inputSize), static_cast<int>(outputCapacity));
+      return size > 0 ? size : 0;
+    }
+#endif
+#ifdef DD_HAVE_ZSTD
+    case ddLCMLogWriter::ZstdCompression:
+    {
+      // level 1 keeps up with a gigabit link on one core
+      const size_t size = ZSTD_compress(output, outputCapacity, input, inputSize, 1);
+      return ZSTD_isError(size) ? 0 : size;
+    }
+#endif
+    default:
+      return 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool Decompress(uint32_t compression, const void* input, size_t inputSize, void* output, size_t outputSize)
+{
+  switch (compression)
+  {
+#ifdef DD_HAVE_LZ4
+    case ddLCMLogWriter::LZ4Compression:
+      return LZ4_decompress_safe(static_cast<const char*>(input), static_cast<char*>(output),
+        static_cast<int>(inputSize), static_cast<int>(outputSize)) == static_cast<int>(outputSize);
+#endif
+#ifdef DD_HAVE_ZSTD
+    case ddLCMLogWriter::ZstdCompression:
+      return ZSTD_decompress(output, outputSize, input, inputSize) == outputSize;
+#endif
+    default:
+      return false;
+  }
+}
+
+} // end namespace
+
+
+//-----------------------------------------------------------------------------
+// A block of memory aligned for efficient writes.
+class ddLCMLogWriter::Buffer
+{
+public:
+
+  Buffer(size_t capacity) : Data(0), Capacity(capacity), Size(0)
+  {
+    void* data = 0;
+    if (posix_memalign(&data, WriteBufferAlignment, capacity) == 0)
+    {
+      this->Data = static_cast<uint8_t*>(data);
+    }
+  }
+
+  ~Buffer()
+  {
+    free(this->Data);
+  }
+
+  uint8_t* Data;
+  size_t Capacity;
+  size_t Size;
+};
+
+
+//-----------------------------------------------------------------------------
+ddLCMLogWriter::ddLCMLogWriter()
+{
+  mCompression = NoCompression;
+  mMaxFileSize = 0;
+  mQueueSize = DefaultQueueSize;
+  mFileIndex = 0;
+  mFileDescriptor = -1;
+  mFileLogSize = 0;
+  mFileEventNumber = 0;
+  mHead = 0;
+  mTail = 0;
+  mShouldStop = false;
+  mWriterIsWaiting = false;
+  mNumberOfEvents = 0;
+  mNumberOfDroppedEvents = 0;
+  mBytesWritten = 0;
+}
+
+//-----------------------------------------------------------------------------
+ddLCMLogWriter::~ddLCMLogWriter()
+{
+  this->close();
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogWriter::compressionIsSupported(Compression compression)
+{
+  switch (compression)
+  {
+    case NoCompression:
+      return true;
+#ifdef DD_HAVE_LZ4
+    case LZ4Compression:
+      return true;
+#endif
+#ifdef DD_HAVE_ZSTD
+    case ZstdCompression:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogWriter::setCompression(Compression compression)
+{
+  mCompression = compression;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogWriter::setMaxFileSize(uint64_t maxFileSize)
+{
+  mMaxFileSize = maxFileSize;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogWriter::setQueueSize(uint64_t queueSize)
+{
+  mQueueSize = std::max(uint64_t(WriteBufferSize), queueSize);
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogWriter::open(const std::string& filename)
+{
+  this->close();
+
+  if (!compressionIsSupported(mCompression))
+  {
+    return false;
+  }
+
+  mFilename = filename;
+  mFileIndex = 0;
+  {
+    std::lock_guard<std::mutex> lock(mFilenamesMutex);
+    mFilenames.clear();
+  }
+
+  mBuffer.reset(new Buffer(WriteBufferSize));
+  mCompressedBuffer.reset(mCompression == NoCompression ? 0 :
+    new Buffer(sizeof(ChunkHeader) + CompressBound(mCompression, WriteBufferSize)));
+  if (!mBuffer->Data || (mCompressedBuffer && !mCompressedBuffer->Data))
+  {
+    return false;
+  }
+
+  if (!this->openFile())
+  {
+    return false;
+  }
+
+  mRing.assign(AlignRecordSize(mQueueSize), 0);
+  mHead = 0;
+  mTail = 0;
+  mNumberOfEvents = 0;
+  mNumberOfDroppedEvents = 0;
+  mBytesWritten = 0;
+  mShouldStop = false;
+  mThread = std::thread(&ddLCMLogWriter::threadLoop, this);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogWriter::close()
+{
+  if (mThread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mWakeMutex);
+      mShouldStop = true;
+    }
+    mWakeCondition.notify_one();
+    mThread.join();
+  }
+
+  this->closeFile();
+  mBuffer.reset();
+  mCompressedBuffer.reset();
+  std::vector<uint8_t>().swap(mRing);
+}
+
+//-----------------------------------------------------------------------------
+std::vector<std::string> ddLCMLogWriter::filenames() const
+{
+  std::lock_guard<std::mutex> lock(mFilenamesMutex);
+  return mFilenames;
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogWriter::write(const std::string& channel, const void* data, uint32_t dataSize, int64_t timestamp)
+{
+  const uint64_t capacity = mRing.size();
+  const size_t recordSize = AlignRecordSize(sizeof(RecordHeader) + channel.size() + dataSize);
+  if (!capacity || mShouldStop)
+  {
+    return false;
+  }
+
+  const uint64_t head = mHead.load(std::memory_order_relaxed);
+  const uint64_t tail = mTail.load(std::memory_order_acquire);
+
+  // a record is never split, if it does not fit at the end of the ring the
+  // end is skipped
+  const uint64_t position = head % capacity;
+  const uint64_t contiguous = capacity - position;
+  const uint64_t required = (contiguous < recordSize) ? contiguous + recordSize : recordSize;
+
+  if ((head - tail) + required > capacity)
+  {
+    ++mNumberOfDroppedEvents;
+    return false;
+  }
+
+  uint8_t* record = &mRing[position];
+  if (contiguous < recordSize)
+  {
+    reinterpret_cast<RecordHeader*>(record)->RecordSize = 0;
+    record = &mRing[0];
+  }
+
+  RecordHeader* header = reinterpret_cast<RecordHeader*>(record);
+  header->RecordSize = static_cast<uint32_t>(recordSize);
+  header->ChannelLength = static_cast<uint32_t>(channel.size());
+  header->Timestamp = timestamp;
+  header->DataSize = dataSize;
+  header->Padding = 0;
+  memcpy(record + sizeof(RecordHeader), channel.data(), channel.size());
+  memcpy(record + sizeof(RecordHeader) + channel.size(), data, dataSize);
+
+  mHead.store(head + required);
+
+  // mHead and mWriterIsWaiting are sequentially consistent, so either the
+  // writer sees the record before it waits or the record is published while
+  // it waits and this wakes it
+  if (mWriterIsWaiting)
+  {
+    std::lock_guard<std::mutex> lock(mWakeMutex);
+    mWakeCondition.notify_one();
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogWriter::threadLoop()
+{
+  std::chrono::steady_clock::time_point lastWrite = std::chrono::steady_clock::now();
+
+  while (true)
+  {
+    if (this->writeNextRecord())
+    {
+      lastWrite = std::chrono::steady_clock::now();
+      continue;
+    }
+
+    if (mShouldStop)
+    {
+      break;
+    }
+
+    if (mBuffer->Size && std::chrono::steady_clock::now() - lastWrite > FlushInterval)
+    {
+      this->flushBuffer();
+    }
+
+    // sleep until write() publishes a record, waking up to flush a partially
+    // filled buffer
+    std::unique_lock<std::mutex> lock(mWakeMutex);
+    mWriterIsWaiting = true;
+    if (mHead.load() == mTail.load(std::memory_order_relaxed) && !mShouldStop)
+    {
+      mWakeCondition.wait_for(lock, FlushInterval);
+    }
+    mWriterIsWaiting = false;
+  }
+
+  this->flushBuffer();
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogWriter::writeNextRecord()
+{
+  const uint64_t capacity = mRing.size();
+  uint64_t tail = mTail.load(std::memory_order_relaxed);
+  const uint64_t head = mHead.load(std::memory_order_acquire);
+
+  if (tail == head)
+  {
+    return false;
+  }
+
+  const RecordHeader* header = reinterpret_cast<const RecordHeader*>(&mRing[tail % capacity]);
+  if (header->RecordSize == 0)
+  {
+    tail += capacity - (tail % capacity);
+    header = reinterpret_cast<const RecordHeader*>(&mRing[0]);
+  }
+
+  const uint8_t* channel = reinterpret_cast<const uint8_t*>(header) + sizeof(RecordHeader);
+  const uint64_t eventSize = LCMEventHeaderSize + header->ChannelLength + header->DataSize;
+
+  // roll over to a new file before the event that would exceed the limit,
+  // comparing uncompressed log bytes in every mode
+  const uint64_t fileLogSize = mFileLogSize + mBuffer->Size;
+  if (mMaxFileSize && fileLogSize > 0 && fileLogSize + eventSize > mMaxFileSize)
+  {
+    this->flushBuffer();
+    this->closeFile();
+    this->openFile();
+  }
+
+  uint8_t eventHeader[LCMEventHeaderSize];
+  WriteUInt32(eventHeader, LCMSyncWord);
+  WriteInt64(eventHeader + 4, mFileEventNumber++);
+  WriteInt64(eventHeader + 12, header->Timestamp);
+  WriteUInt32(eventHeader + 20, header->ChannelLength);
+  WriteUInt32(eventHeader + 24, header->DataSize);
+
+  this->appendToBuffer(eventHeader, LCMEventHeaderSize);
+  this->appendToBuffer(channel, header->ChannelLength + header->DataSize);
+
+  ++mNumberOfEvents;
+  mTail.store(tail + header->RecordSize, std::memory_order_release);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogWriter::appendToBuffer(const void* data, size_t size)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  while (size)
+  {
+    const size_t count = std::min(size, mBuffer->Capacity - mBuffer->Size);
+    memcpy(mBuffer->Data + mBuffer->Size, bytes, count);
+    mBuffer->Size += count;
+    bytes += count;
+    size -= count;
+
+    if (mBuffer->Size == mBuffer->Capacity)
+    {
+      this->flushBuffer();
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogWriter::flushBuffer()
+{
+  if (!mBuffer || !mBuffer->Size)
+  {
+    return;
+  }
+
+  if (mCompression == NoCompression)
+  {
+    this->writeToFile(mBuffer->Data, mBuffer->Size);
+  }
+  else
+  {
+    ChunkHeader* chunk = reinterpret_cast<ChunkHeader*>(mCompressedBuffer->Data);
+    const size_t compressedSize = Compress(mCompression, mBuffer->Data, mBuffer->Size,
+      mCompressedBuffer->Data + sizeof(ChunkHeader), mCompressedBuffer->Capacity - sizeof(ChunkHeader));
+
+    chunk->Magic = ChunkMagic;
+    chunk->RawSize = static_cast<uint32_t>(mBuffer->Size);
+    chunk->CompressedSize = static_cast<uint32_t>(compressedSize);
+    chunk->Flags = 0;
+    if (compressedSize)
+    {
+      this->writeToFile(mCompressedBuffer->Data, sizeof(ChunkHeader) + compressedSize);
+    }
+    else
+    {
+      fprintf(stderr, "ddLCMLogWriter: failed to compress a block of %s, writing it uncompressed\n", mFilename.c_str());
+      chunk->CompressedSize = chunk->RawSize;
+      chunk->Flags = RawChunkFlag;
+      this->writeToFile(chunk, sizeof(ChunkHeader));
+      this->writeToFile(mBuffer->Data, mBuffer->Size);
+    }
+  }
+
+  mFileLogSize += mBuffer->Size;
+  mBuffer->Size = 0;
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogWriter::writeToFile(const void* data, size_t size)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  while (size && mFileDescriptor >= 0)
+  {
+    const ssize_t count = ::write(mFileDescriptor, bytes, size);
+    if (count < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      perror("ddLCMLogWriter: write failed");
+      return false;
+    }
+
+    bytes += count;
+    size -= count;
+    mBytesWritten += count;
+  }
+  return size == 0;
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogWriter::openFile()
+{
+  std::string filename = mFilename;
+  if (mMaxFileSize)
+  {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%02d", mFileIndex);
+    filename += suffix;
+  }
+  ++mFileIndex;
+
+  mFileDescriptor = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (mFileDescriptor < 0)
+  {
+    perror(("ddLCMLogWriter: failed to open " + filename).c_str());
+    return false;
+  }
+
+  mFileLogSize = 0;
+  mFileEventNumber = 0;
+  {
+    std::lock_guard<std::mutex> lock(mFilenamesMutex);
+    mFilenames.push_back(filename);
+  }
+
+  if (mCompression != NoCompression)
+  {
+    CompressedFileHeader header;
+    memcpy(header.Magic, CompressedFileMagic, sizeof(header.Magic));
+    header.Compression = mCompression;
+    header.Reserved = 0;
+    this->writeToFile(&header, sizeof(header));
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddLCMLogWriter::closeFile()
+{
+  if (mFileDescriptor >= 0)
+  {
+    ::close(mFileDescriptor);
+    mFileDescriptor = -1;
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool ddLCMLogWriter::decompressLog(const std::string& inputFilename, const std::string& outputFilename)
+{
+  FILE* input = fopen(inputFilename.c_str(), "rb");
+  if (!input)
+  {
+    return false;
+  }
+
+  CompressedFileHeader header;
+  if (fread(&header, sizeof(header), 1, input) != 1
+      || memcmp(header.Magic, CompressedFileMagic, sizeof(header.Magic)) != 0
+      || !compressionIsSupported(static_cast<Compression>(header.Compression)))
+  {
+    fclose(input);
+    return false;
+  }
+
+  FILE* output = fopen(outputFilename.c_str(), "wb");
+  if (!output)
+  {
+    fclose(input);
+    return false;
+  }
+
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> raw;
+  bool success = true;
+
+  ChunkHeader chunk;
+  while (success && fread(&chunk, sizeof(chunk), 1, input) == 1)
+  {
+    const bool isRaw = (chunk.Flags & RawChunkFlag) != 0;
+    success = chunk.Magic == ChunkMagic && chunk.RawSize <= WriteBufferSize
+      && (!isRaw || chunk.CompressedSize == chunk.RawSize);
+    if (success)
+    {
+      compressed.resize(chunk.CompressedSize);
+      raw.resize(chunk.RawSize);
+      success = fread(compressed.data(), 1, compressed.size(), input) == compressed.size()
+        && (isRaw || Decompress(header.Compression, compressed.data(), compressed.size(), raw.data(), raw.size()))
+        && fwrite(isRaw ? compressed.data() : raw.data(), 1, raw.size(), output) == raw.size();
+    }
+  }
+
+  fclose(input);
+  success = (fclose(output) == 0) && success;
+  return success;
+}
@@ -0,0 +1,140 @@
+#ifndef __ddLCMLogWriter_h
+#define __ddLCMLogWriter_h
+
+#include "ddCommonConfigure.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Writes lcm events to log files on a dedicated writer thread.
+//
+// write() copies an event into a lock free single producer, single consumer
+// ring buffer and returns; it never allocates, and takes a lock only to wake
+// the writer thread when it is idle.  If the ring buffer is full the event is
+// dropped and counted.  The writer thread drains the ring into an aligned
+// buffer and writes it to the file in large blocks, so disk latency does not
+// reach the thread that receives messages.
+//
+// Files are lcm log files, readable by ddLCMEventLog and the lcm tools,
+// unless a compression is set.  A compressed file is a sequence of chunks,
+// each holding a compressed block of the lcm log byte stream; use
+// decompressLog() to convert it to an lcm log.  A block that fails to
+// compress is stored uncompressed in a raw chunk.  If a maximum file size is set
+// the log rolls over to a new file, named like lcm-logger names split files:
+// <filename>.00, <filename>.01, ...  The size limits the uncompressed log
+// bytes of a file, so a compressed file is smaller than the limit.
+
+class DD_COMMON_EXPORT ddLCMLogWriter
+{
+public:
+
+  enum Compression
+  {
+    NoCompression = 0,
+    LZ4Compression = 1,
+    ZstdCompression = 2
+  };
+
+  ddLCMLogWriter();
+  ~ddLCMLogWriter();
+
+  // Returns true if the library was built with the compression.
+  static bool compressionIsSupported(Compression compression);
+
+  // Options, they take effect at the next open().
+  void setCompression(Compression compression);
+  void setMaxFileSize(uint64_t maxFileSize);
+  void setQueueSize(uint64_t queueSize);
+
+  // Opens the first file and starts the writer thread.
+  bool open(const std::string& filename);
+
+  // Writes the queued events and closes the file.
+  void close();
+
+  bool isOpen() const
+  {
+    return mThread.joinable();
+  }
+
+  // Queues an event, called from a single thread.  Returns false if the event
+  // was dropped.
+  bool write(const std::string& channel, const void* data, uint32_t dataSize, int64_t timestamp);
+
+  // Returns the names of the files written since open().
+  std::vector<std::string> filenames() const;
+
+  uint64_t numberOfEvents() const
+  {
+    return mNumberOfEvents;
+  }
+
+  uint64_t numberOfDroppedEvents() const
+  {
+    return mNumberOfDroppedEvents;
+  }
+
+  // Returns the number of bytes written to disk, after compression.
+  uint64_t bytesWritten() const
+  {
+    return mBytesWritten;
+  }
+
+  // Converts a compressed log file to an lcm log file.
+  static bool decompressLog(const std::string& inputFilename, const std::string& outputFilename);
+
+private:
+
+  class Buffer;
+
+  void threadLoop();
+  bool openFile();
+  void closeFile();
+  void flushBuffer();
+  bool writeToFile(const void* data, size_t size);
+  void appendToBuffer(const void* data, size_t size);
+  bool writeNextRecord();
+
+  ddLCMLogWriter(const ddLCMLogWriter&); // Not implemented
+  void operator=(const ddLCMLogWriter&); // Not implemented
+
+  Compression mCompression;
+  uint64_t mMaxFileSize;
+  uint64_t mQueueSize;
+
+  std::string mFilename;
+  int mFileIndex;
+  int mFileDescriptor;
+  // the uncompressed log bytes flushed to the current file
+  uint64_t mFileLogSize;
+  int64_t mFileEventNumber;
+  mutable std::mutex mFilenamesMutex;
+  std::vector<std::string> mFilenames;
+
+  // the ring buffer, mHead is written by the producer, mTail by the writer
+  std::vector<uint8_t> mRing;
+  std::atomic<uint64_t> mHead;
+  std::atomic<uint64_t> mTail;
+
+  std::unique_ptr<Buffer> mBuffer;
+  std::unique_ptr<Buffer> mCompressedBuffer;
+
+  std::thread mThread;
+  std::atomic<bool> mShouldStop;
+  // the writer thread sleeps on mWakeCondition while the ring is empty
+  std::mutex mWakeMutex;
+  std::condition_variable mWakeCondition;
+  std::atomic<bool> mWriterIsWaiting;
+  std::atomic<uint64_t> mNumberOfEvents;
+  std::atomic<uint64_t> mNumberOfDroppedEvents;
+  std::atomic<uint64_t> mBytesWritten;
+};
+
+#endif
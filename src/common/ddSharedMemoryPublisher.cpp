@@ -0,0 +1,188 @@
+#include "ddSharedMemoryPublisher.h"
+
+#include "ddSharedMemoryRing.h"
+
+#include <lcm/lcm-cpp.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace
+{
+
+const uint32_t NotificationMagic = 0x4e534444;
+
+}
+
+//-----------------------------------------------------------------------------
+ddSharedMemoryPublisher::ddSharedMemoryPublisher(lcm::LCM* lcmHandle)
+{
+  mLCM = lcmHandle;
+  mHostId = ddSharedMemoryRing::hostId();
+  mNumberOfSlots = 8;
+  mSlotSize = 16*1024*1024;
+  mMinimumMessageSize = 64*1024;
+  mFallbackMode = AutomaticFallback;
+  mNumberOfSharedMemoryMessages = 0;
+}
+
+//-----------------------------------------------------------------------------
+ddSharedMemoryPublisher::~ddSharedMemoryPublisher()
+{
+}
+
+//-----------------------------------------------------------------------------
+const char* ddSharedMemoryPublisher::notificationSuffix()
+{
+  return "_SHM";
+}
+
+//-----------------------------------------------------------------------------
+void ddSharedMemoryPublisher::setNumberOfSlots(uint32_t numberOfSlots)
+{
+  mNumberOfSlots = std::max(uint32_t(2), numberOfSlots);
+}
+
+//-----------------------------------------------------------------------------
+void ddSharedMemoryPublisher::setSlotSize(uint32_t slotSize)
+{
+  mSlotSize = slotSize;
+}
+
+//-----------------------------------------------------------------------------
+void ddSharedMemoryPublisher::setMinimumMessageSize(uint32_t minimumMessageSize)
+{
+  mMinimumMessageSize = minimumMessageSize;
+}
+
+//-----------------------------------------------------------------------------
+void ddSharedMemoryPublisher::setFallbackMode(FallbackMode mode)
+{
+  mFallbackMode = mode;
+}
+
+//-----------------------------------------------------------------------------
+bool ddSharedMemoryPublisher::lcmIsHostLocal()
+{
+  // lcm's default url is udpm://239.255.76.67:7667?ttl=0
+  const char* url = getenv("LCM_DEFAULT_URL");
+  if (!url || !*url)
+  {
+    return true;
+  }
+
+  const std::string urlString(url);
+  if (urlString.compare(0, 7, "memq://") == 0)
+  {
+    return true;
+  }
+
+  const size_t ttl = urlString.find("ttl=");
+  return urlString.compare(0, 7, "udpm://") == 0
+    && (ttl == std::string::npos || atoi(urlString.c_str() + ttl + 4) == 0);
+}
+
+//-----------------------------------------------------------------------------
+ddSharedMemoryRing* ddSharedMemoryPublisher::channelRing(const std::string& channel)
+{
+  std::shared_ptr<ddSharedMemoryRing>& ring = mRings[channel];
+  if (!ring)
+  {
+    // shared memory names may not contain slashes after the first character
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "/dd-lcm-%d-", static_cast<int>(getpid()));
+    std::string name = prefix + channel;
+    for (size_t i = 1; i < name.size(); ++i)
+    {
+      if (name[i] == '/')
+      {
+        name[i] = '_';
+      }
+    }
+
+    ring.reset(new ddSharedMemoryRing);
+    if (name.size() >= sizeof(Notification().SegmentName) || !ring->create(name, mNumberOfSlots, mSlotSize))
+    {
+      fprintf(stderr, "ddSharedMemoryPublisher: failed to create shared memory for %s\n", channel.c_str());
+      ring->close();
+    }
+  }
+
+  return ring->isOpen() ? ring.get() : 0;
+}
+
+//-----------------------------------------------------------------------------
+bool ddSharedMemoryPublisher::publish(const std::string& channel, const void* data, uint32_t dataSize)
+{
+  ddSharedMemoryRing* ring = (dataSize >= mMinimumMessageSize) ? this->channelRing(channel) : 0;
+
+  Notification notification;
+  const int64_t utime = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+  if (!ring || !ring->write(data, dataSize, utime, &notification.Slot, &notification.Sequence))
+  {
+    return mLCM->publish(channel, data, dataSize) == 0;
+  }
+
+  const bool fallback = (mFallbackMode == AlwaysFallback || (mFallbackMode == AutomaticFallback && !lcmIsHostLocal()));
+
+  notification.Magic = NotificationMagic;
+  notification.HostId = mHostId;
+  notification.SegmentId = ring->segmentId();
+  notification.DataSize = dataSize;
+  notification.HasFallback = fallback ? 1 : 0;
+  notification.Digest = fallback ? digest(data, dataSize) : 0;
+  memset(notification.SegmentName, 0, sizeof(notification.SegmentName));
+  strncpy(notification.SegmentName, ring->name().c_str(), sizeof(notification.SegmentName) - 1);
+
+  ++mNumberOfSharedMemoryMessages;
+  bool success = mLCM->publish(channel + notificationSuffix(), &notification, sizeof(notification)) == 0;
+
+  if (fallback)
+  {
+    success = (mLCM->publish(channel, data, dataSize) == 0) && success;
+  }
+
+  return success;
+}
+
+//-----------------------------------------------------------------------------
+bool ddSharedMemoryPublisher::decodeNotification(const void* data, uint32_t dataSize, Notification* notification)
+{
+  if (dataSize != sizeof(Notification))
+  {
+    return false;
+  }
+
+  memcpy(notification, data, sizeof(Notification));
+  notification->SegmentName[sizeof(notification->SegmentName) - 1] = 0;
+  return notification->Magic == NotificationMagic;
+}
+
+//-----------------------------------------------------------------------------
+uint64_t ddSharedMemoryPublisher::digest(const void* data, uint32_t dataSize)
+{
+  // FNV-1a over 8 byte words, with the size mixed in first
+  const uint64_t prime = 1099511628211ull;
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t hash = (14695981039346656037ull ^ dataSize) * prime;
+
+  uint32_t i = 0;
+  for (; i + sizeof(uint64_t) <= dataSize; i += sizeof(uint64_t))
+  {
+    uint64_t word;
+    memcpy(&word, bytes + i, sizeof(word));
+    hash = (hash ^ word) * prime;
+    hash ^= hash >> 29;
+  }
+  for (; i < dataSize; ++i)
+  {
+    hash = (hash ^ bytes[i]) * prime;
+  }
+  return hash;
+}
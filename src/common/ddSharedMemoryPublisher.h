@@ -0,0 +1,129 @@
+#ifndef __ddSharedMemoryPublisher_h
+#define __ddSharedMemoryPublisher_h
+
+#include "ddCommonConfigure.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+class ddSharedMemoryRing;
+
+namespace lcm
+{
+  class LCM;
+}
+
+
+// Publishes large lcm messages to processes on the same host through shared
+// memory.
+//
+// A message is copied into a ddSharedMemoryRing segment owned by the
+// publisher, one segment per channel, and a small notification naming the
+// segment, slot and sequence number is published on <channel>_SHM.  The
+// ddLCMDispatcher of a subscribing process on the same host maps the segment
+// and delivers the message to the subscriptions of <channel> straight from
+// the mapping, so a multi-megabyte image is not fragmented into udp packets
+// and reassembled.  Subscribers on other hosts ignore the notification.
+//
+// The fallback mode decides whether the message is also published normally
+// on <channel>, for subscribers on other hosts and for processes that do not
+// use the dispatcher, such as lcm-logger.  The automatic mode publishes it
+// only if the lcm provider reaches other hosts, which the default lcm url with
+// ttl=0 does not.  The fallback copy is the unchanged message, so loggers and
+// other subscribers see the same bytes as without shared memory.  The
+// notification carries the size and digest() of the message instead, and
+// each subscription of a dispatcher delivers whichever of the two copies
+// arrives first and drops the other, so local subscribers see each message
+// once and an overrun slot is still delivered from the fallback copy.
+// Messages smaller than minimumMessageSize() or larger than the slot size are
+// always published normally.
+
+class DD_COMMON_EXPORT ddSharedMemoryPublisher
+{
+public:
+
+  enum FallbackMode
+  {
+    AutomaticFallback,
+    AlwaysFallback,
+    NeverFallback
+  };
+
+  // The message published on the notification channel, in host byte order.
+  struct Notification
+  {
+    uint32_t Magic;
+    uint32_t Slot;
+    uint64_t HostId;
+    uint64_t SegmentId;
+    uint64_t Sequence;
+    uint32_t DataSize;
+    // 1 if the message was also published normally
+    uint32_t HasFallback;
+    uint64_t Digest;
+    char SegmentName[64];
+  };
+
+  // Returns false if the data is not a notification.
+  static bool decodeNotification(const void* data, uint32_t dataSize, Notification* notification);
+
+  // Returns a 64 bit hash of the message that identifies its fallback copy.
+  // It is not a cryptographic hash.
+  static uint64_t digest(const void* data, uint32_t dataSize);
+
+  ddSharedMemoryPublisher(lcm::LCM* lcmHandle);
+  ~ddSharedMemoryPublisher();
+
+  // Segment options, they apply to segments created afterwards.  The
+  // defaults are 8 slots of 16 MB; pages of a slot are only allocated once a
+  // message is written to it.
+  void setNumberOfSlots(uint32_t numberOfSlots);
+  void setSlotSize(uint32_t slotSize);
+
+  void setMinimumMessageSize(uint32_t minimumMessageSize);
+  uint32_t minimumMessageSize() const
+  {
+    return mMinimumMessageSize;
+  }
+
+  void setFallbackMode(FallbackMode mode);
+  FallbackMode fallbackMode() const
+  {
+    return mFallbackMode;
+  }
+
+  // Publishes the message.  Returns false if lcm failed to publish it.
+  bool publish(const std::string& channel, const void* data, uint32_t dataSize);
+
+  // Returns the number of messages that were published through shared memory.
+  uint64_t numberOfSharedMemoryMessages() const
+  {
+    return mNumberOfSharedMemoryMessages;
+  }
+
+  // Returns true if the lcm url of the process does not reach other hosts.
+  static bool lcmIsHostLocal();
+
+  // The suffix of the notification channel of a channel.
+  static const char* notificationSuffix();
+
+private:
+
+  ddSharedMemoryRing* channelRing(const std::string& channel);
+
+  ddSharedMemoryPublisher(const ddSharedMemoryPublisher&); // Not implemented
+  void operator=(const ddSharedMemoryPublisher&); // Not implemented
+
+  lcm::LCM* mLCM;
+  uint64_t mHostId;
+  uint32_t mNumberOfSlots;
+  uint32_t mSlotSize;
+  uint32_t mMinimumMessageSize;
+  FallbackMode mFallbackMode;
+  uint64_t mNumberOfSharedMemoryMessages;
+  std::map<std::string, std::shared_ptr<ddSharedMemoryRing> > mRings;
+};
+
+#endif
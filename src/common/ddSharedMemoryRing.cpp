@@ -0,0 +1,293 @@
+#include "ddSharedMemoryRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+const char SegmentMagic[8] = {'D', 'D', 'S', 'H', 'M', 'R', '0', '1'};
+
+// Slots start on their own cache line so readers of one slot do not contend
+// with the writer of the next.
+const size_t SlotAlignment = 64;
+
+size_t AlignSize(size_t size, size_t alignment)
+{
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+}
+
+//-----------------------------------------------------------------------------
+struct ddSharedMemoryRing::SegmentHeader
+{
+  char Magic[8];
+  uint64_t SegmentId;
+  uint32_t NumberOfSlots;
+  uint32_t SlotSize;
+  uint64_t SlotStride;
+};
+
+//-----------------------------------------------------------------------------
+struct ddSharedMemoryRing::SlotHeader
+{
+  // twice the sequence number of the message in the slot, plus one while the
+  // message is being written
+  std::atomic<uint64_t> State;
+  uint32_t DataSize;
+  uint32_t Reserved;
+  int64_t Utime;
+};
+
+//-----------------------------------------------------------------------------
+ddSharedMemoryRing::ddSharedMemoryRing()
+{
+  mData = 0;
+  mSize = 0;
+  mOwner = false;
+  mNextSequence = 1;
+}
+
+//-----------------------------------------------------------------------------
+ddSharedMemoryRing::~ddSharedMemoryRing()
+{
+  this->close();
+}
+
+//-----------------------------------------------------------------------------
+bool ddSharedMemoryRing::create(const std::string& name, uint32_t numberOfSlots, uint32_t slotSize)
+{
+  this->close();
+
+  if (!numberOfSlots || !slotSize)
+  {
+    return false;
+  }
+
+  const size_t headerSize = AlignSize(sizeof(SegmentHeader), SlotAlignment);
+  const size_t slotStride = AlignSize(sizeof(SlotHeader) + slotSize, SlotAlignment);
+  const size_t size = headerSize + slotStride * numberOfSlots;
+
+  // replace a segment left behind by a process that did not exit cleanly
+  shm_unlink(name.c_str());
+
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  if (ftruncate(fd, size) != 0)
+  {
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  mData = static_cast<uint8_t*>(mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  ::close(fd);
+  if (mData == MAP_FAILED)
+  {
+    mData = 0;
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  mName = name;
+  mSize = size;
+  mOwner = true;
+  mNextSequence = 1;
+
+  // ftruncate zero fills the segment, so every slot starts out empty
+  SegmentHeader* header = reinterpret_cast<SegmentHeader*>(mData);
+  header->SegmentId = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count() ^ (uint64_t(getpid()) << 48);
+  header->NumberOfSlots = numberOfSlots;
+  header->SlotSize = slotSize;
+  header->SlotStride = slotStride;
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(header->Magic, SegmentMagic, sizeof(header->Magic));
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool ddSharedMemoryRing::open(const std::string& name)
+{
+  this->close();
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(SegmentHeader))
+  {
+    ::close(fd);
+    return false;
+  }
+
+  mData = static_cast<uint8_t*>(mmap(0, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0));
+  ::close(fd);
+  if (mData == MAP_FAILED)
+  {
+    mData = 0;
+    return false;
+  }
+
+  mName = name;
+  mSize = fileStat.st_size;
+  mOwner = false;
+
+  const SegmentHeader* header = reinterpret_cast<const SegmentHeader*>(mData);
+  const size_t headerSize = AlignSize(sizeof(SegmentHeader), SlotAlignment);
+  if (memcmp(header->Magic, SegmentMagic, sizeof(header->Magic)) != 0
+      || header->SlotStride < sizeof(SlotHeader) + header->SlotSize
+      || headerSize + header->SlotStride * header->NumberOfSlots > mSize)
+  {
+    this->close();
+    return false;
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void ddSharedMemoryRing::close()
+{
+  if (mData)
+  {
+    munmap(mData, mSize);
+    if (mOwner)
+    {
+      shm_unlink(mName.c_str());
+    }
+  }
+
+  mData = 0;
+  mSize = 0;
+  mOwner = false;
+  mName.clear();
+}
+
+//-----------------------------------------------------------------------------
+uint64_t ddSharedMemoryRing::segmentId() const
+{
+  return mData ? reinterpret_cast<const SegmentHeader*>(mData)->SegmentId : 0;
+}
+
+//-----------------------------------------------------------------------------
+uint32_t ddSharedMemoryRing::numberOfSlots() const
+{
+  return mData ? reinterpret_cast<const SegmentHeader*>(mData)->NumberOfSlots : 0;
+}
+
+//-----------------------------------------------------------------------------
+uint32_t ddSharedMemoryRing::slotSize() const
+{
+  return mData ? reinterpret_cast<const SegmentHeader*>(mData)->SlotSize : 0;
+}
+
+//-----------------------------------------------------------------------------
+ddSharedMemoryRing::SlotHeader* ddSharedMemoryRing::slotHeader(uint32_t slot) const
+{
+  const SegmentHeader* header = reinterpret_cast<const SegmentHeader*>(mData);
+  const size_t headerSize = AlignSize(sizeof(SegmentHeader), SlotAlignment);
+  return reinterpret_cast<SlotHeader*>(mData + headerSize + header->SlotStride * slot);
+}
+
+//-----------------------------------------------------------------------------
+bool ddSharedMemoryRing::write(const void* data, uint32_t dataSize, int64_t utime, uint32_t* slot, uint64_t* sequence)
+{
+  if (!mData || !mOwner || dataSize > this->slotSize())
+  {
+    return false;
+  }
+
+  const uint64_t messageSequence = mNextSequence++;
+  const uint32_t messageSlot = static_cast<uint32_t>(messageSequence % this->numberOfSlots());
+  SlotHeader* header = this->slotHeader(messageSlot);
+
+  // mark the slot as being written before touching the data, a reader that
+  // sees the old state after reading the data knows the data is intact
+  header->State.store(2*messageSequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  header->DataSize = dataSize;
+  header->Utime = utime;
+  memcpy(reinterpret_cast<uint8_t*>(header) + sizeof(SlotHeader), data, dataSize);
+
+  header->State.store(2*messageSequence, std::memory_order_release);
+
+  *slot = messageSlot;
+  *sequence = messageSequence;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool ddSharedMemoryRing::slotIsValid(uint32_t slot, uint64_t sequence) const
+{
+  if (!mData || slot >= this->numberOfSlots())
+  {
+    return false;
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return this->slotHeader(slot)->State.load(std::memory_order_relaxed) == 2*sequence;
+}
+
+//-----------------------------------------------------------------------------
+bool ddSharedMemoryRing::read(uint32_t slot, uint64_t sequence, std::vector<uint8_t>* data, int64_t* utime) const
+{
+  if (!mData || slot >= this->numberOfSlots())
+  {
+    return false;
+  }
+
+  const SlotHeader* header = this->slotHeader(slot);
+  if (header->State.load(std::memory_order_acquire) != 2*sequence)
+  {
+    return false;
+  }
+
+  const uint32_t dataSize = std::min(header->DataSize, this->slotSize());
+  *utime = header->Utime;
+  const uint8_t* slotData = reinterpret_cast<const uint8_t*>(header) + sizeof(SlotHeader);
+  data->assign(slotData, slotData + dataSize);
+
+  // the writer marks the slot before it touches the data, so an unchanged
+  // state means the copy is intact
+  return this->slotIsValid(slot, sequence);
+}
+
+//-----------------------------------------------------------------------------
+uint64_t ddSharedMemoryRing::hostId()
+{
+  // the boot id changes on every boot, shared memory does not outlive it
+  std::string id;
+  std::ifstream bootId("/proc/sys/kernel/random/boot_id");
+  if (!std::getline(bootId, id))
+  {
+    char hostname[256] = {0};
+    gethostname(hostname, sizeof(hostname) - 1);
+    id = hostname;
+  }
+
+  // FNV-1a, stable across processes unlike std::hash
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < id.size(); ++i)
+  {
+    hash = (hash ^ static_cast<uint8_t>(id[i])) * 1099511628211ull;
+  }
+  return hash;
+}
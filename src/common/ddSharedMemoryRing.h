@@ -0,0 +1,92 @@
+#ifndef __ddSharedMemoryRing_h
+#define __ddSharedMemoryRing_h
+
+#include "ddCommonConfigure.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// A ring of fixed size message slots in a POSIX shared memory segment.
+//
+// One process creates the segment and writes messages into the slots in turn,
+// overwriting the oldest message.  Other processes on the same host open the
+// segment read only and copy messages out of it.  Each slot has a sequence
+// number that is odd while the slot is being written, a reader checks it
+// before and after copying the data to detect that the writer has reused the
+// slot, so readers never block the writer.
+//
+// ddSharedMemoryPublisher and ddLCMDispatcher use the ring to move large lcm
+// messages between processes on one host, see ddSharedMemoryPublisher.h.
+
+class DD_COMMON_EXPORT ddSharedMemoryRing
+{
+public:
+
+  ddSharedMemoryRing();
+  ~ddSharedMemoryRing();
+
+  // Creates a new segment with the given name, which starts with a slash.
+  // The name is unlinked by close(), readers that have it mapped keep their
+  // mapping.
+  bool create(const std::string& name, uint32_t numberOfSlots, uint32_t slotSize);
+
+  // Maps an existing segment read only.
+  bool open(const std::string& name);
+
+  void close();
+
+  bool isOpen() const
+  {
+    return mData != 0;
+  }
+
+  const std::string& name() const
+  {
+    return mName;
+  }
+
+  // Returns an id that differs between segments created with the same name,
+  // so a reader can tell that the writer has recreated the segment.
+  uint64_t segmentId() const;
+
+  uint32_t numberOfSlots() const;
+
+  // Returns the maximum size of a message.
+  uint32_t slotSize() const;
+
+  // Copies the message into the next slot.  Returns false if the message is
+  // larger than slotSize() or the ring was not created by this process.
+  bool write(const void* data, uint32_t dataSize, int64_t utime, uint32_t* slot, uint64_t* sequence);
+
+  // Copies the message in the slot if the slot holds the message with the
+  // given sequence number.  Returns false if the writer had reused the slot
+  // before or while the message was copied, the copy is then torn.
+  bool read(uint32_t slot, uint64_t sequence, std::vector<uint8_t>* data, int64_t* utime) const;
+
+  bool slotIsValid(uint32_t slot, uint64_t sequence) const;
+
+  // Returns an id that is the same for processes on one host, and changes
+  // when the host reboots.
+  static uint64_t hostId();
+
+private:
+
+  struct SegmentHeader;
+  struct SlotHeader;
+
+  SlotHeader* slotHeader(uint32_t slot) const;
+
+  ddSharedMemoryRing(const ddSharedMemoryRing&); // Not implemented
+  void operator=(const ddSharedMemoryRing&); // Not implemented
+
+  std::string mName;
+  uint8_t* mData;
+  size_t mSize;
+  bool mOwner;
+  uint64_t mNextSequence;
+};
+
+#endif
@@ -52,8 +52,17 @@ def makeSphere(radius, resolution):
     return shallowCopy(s.GetOutput())
 
 
-def colorizePoints(polyData, cameraName='MULTISENSE_CAMERA_LEFT'):
-    imageManager.queue.colorizePoints(cameraName, polyData)
+def colorizePoints(polyData, cameraName='MULTISENSE_CAMERA_LEFT', utime=None):
+    '''
+    If utime is given, the points are colored from the camera image nearest
+    to that time instead of the latest image.  The camera only keeps past
+    images after imageManager.queue.setImageHistoryMemoryBudget() is called
+    with a budget in bytes.
+    '''
+    if utime is None:
+        imageManager.queue.colorizePoints(cameraName, polyData)
+    else:
+        imageManager.queue.colorizePoints(cameraName, polyData, utime)
 
 
 
@@ -167,10 +176,32 @@ class ImageManager(object):
     def getUtime(self, imageName):
         return self.imageUtimes[imageName]
 
+    def setDecodeScale(self, imageName, scale):
+        self.queue.setImageDecodeScale(imageName, scale)
+
+    def getScaledImage(self, imageName, scale, image=None):
+        if image is None:
+            image = vtk.vtkImageData()
+        self.queue.getScaledImage(imageName, scale, image)
+        if self.imageRotations180.get(imageName):
+            image.ShallowCopy(filterUtils.rotateImage180(image))
+        return image
+
     def getTexture(self, imageName):
         return self.textures[imageName]
 
 
+def getImageScale(imageWidth, displayWidth):
+    '''
+    Returns the largest image scale, 1, 2, 4 or 8, at which an image of the
+    given width is still at least displayWidth pixels wide.
+    '''
+    scale = 1
+    while scale < 8 and imageWidth / (2*scale) >= displayWidth:
+        scale *= 2
+    return scale
+
+
 def disableCameraTexture(obj):
     obj.actor.SetTexture(None)
     obj.actor.GetProperty().LightingOn()
@@ -392,6 +423,11 @@ class ImageWidget(object):
         self.updateUtime = 0
         self.initialized = False
 
+        # the widget shows a small image, so it uses an image scaled to the
+        # widget size, which is much cheaper to decode than the full image
+        self.image = vtk.vtkImageData()
+        self.imageScale = 1
+
         self.imageWidget = vtk.vtkLogoWidget()
         imageRep = self.imageWidget.GetRepresentation()
         self.imageWidget.ResizableOff()
@@ -402,7 +438,7 @@ class ImageWidget(object):
 
         self.flip = vtk.vtkImageFlip()
         self.flip.SetFilteredAxis(1)
-        self.flip.SetInput(imageManager.getImage(imageName))
+        self.flip.SetInput(self.image)
         imageRep.SetImage(self.flip.GetOutput())
 
         self.eventFilter = PythonQt.dd.ddPythonEventFilter()
@@ -417,11 +453,12 @@ class ImageWidget(object):
 
     def setWidgetSize(self, desiredWidth=400):
 
-        image = self.imageManager.getImage(self.imageName)
-        dims = image.GetDimensions()
+        dims = self.image.GetDimensions()
         if 0.0 in dims:
             return
 
+        self.imageScale = getImageScale(dims[0]*self.imageScale, desiredWidth)
+
         aspectRatio = float(dims[0])/dims[1]
         imageWidth, imageHeight = desiredWidth, desiredWidth/aspectRatio
         viewWidth, viewHeight = self.view.width, self.view.height
@@ -442,7 +479,9 @@ class ImageWidget(object):
 
     def setImageName(self, imageName):
         self.imageName = imageName
-        self.flip.SetInput(imageManager.getImage(imageName))
+        self.imageScale = 1
+        self.updateUtime = 0
+        self.initialized = False
 
     def setOpacity(self, opacity=1.0):
         self.imageWidget.GetRepresentation().GetImageProperty().SetOpacity(opacity)
@@ -459,17 +498,17 @@ class ImageWidget(object):
             self.view.render()
 
     def haveImage(self):
-        image = self.imageManager.getImage(self.imageName)
-        dims = image.GetDimensions()
+        dims = self.image.GetDimensions()
         return 0.0 not in dims
 
     def updateView(self):
         if not self.visible or not self.view.isVisible():
             return
 
-        currentUtime = self.imageManager.updateImage(self.imageName)
+        currentUtime = self.imageManager.queue.getCurrentImageTime(self.imageName)
         if currentUtime != self.updateUtime:
             self.updateUtime = currentUtime
+            self.imageManager.getScaledImage(self.imageName, self.imageScale, self.image)
             self.flip.Update()
             self.view.render()
 
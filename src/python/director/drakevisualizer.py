@@ -315,9 +315,9 @@ class DrakeVisualizer(object):
     def _addSubscribers(self):
         self.subscribers.append(lcmUtils.addSubscriber('DRAKE_VIEWER_LOAD_ROBOT', lcmrl.viewer_load_robot_t, self.onViewerLoadRobot))
         self.subscribers.append(lcmUtils.addSubscriber('DRAKE_VIEWER_ADD_ROBOT', lcmrl.viewer_load_robot_t, self.onViewerAddRobot))
-        self.subscribers.append(lcmUtils.addSubscriber('DRAKE_VIEWER_DRAW', lcmrl.viewer_draw_t, self.onViewerDraw))
-        self.subscribers.append(lcmUtils.addSubscriber('DRAKE_PLANAR_LIDAR_.*', lcmbot.planar_lidar_t, self.onPlanarLidar, callbackNeedsChannel=True))
-        self.subscribers.append(lcmUtils.addSubscriber('DRAKE_POINTCLOUD_.*', lcmbot.pointcloud_t, self.onPointCloud, callbackNeedsChannel=True))
+        self.subscribers.append(lcmUtils.addDecodedSubscriber('DRAKE_VIEWER_DRAW', 'ddViewerDrawSubscriber', self.onViewerDraw))
+        self.subscribers.append(lcmUtils.addDecodedSubscriber('DRAKE_PLANAR_LIDAR_.*', 'ddPlanarLidarSubscriber', self.onPlanarLidar, callbackNeedsChannel=True))
+        self.subscribers.append(lcmUtils.addDecodedSubscriber('DRAKE_POINTCLOUD_.*', 'ddPointCloudSubscriber', self.onPointCloud, callbackNeedsChannel=True))
 
     def _removeSubscribers(self):
         for sub in self.subscribers:
@@ -405,14 +405,19 @@ class DrakeVisualizer(object):
         msg.command_data = message
         lcmUtils.publish('DRAKE_VIEWER_STATUS', msg)
 
-    def onViewerDraw(self, msg):
+    def onViewerDraw(self, drawData):
 
-        for i in xrange(msg.num_links):
+        positions = vnp.getNumpyFromVtk(drawData, 'Points')
+        quaternions = vnp.getNumpyFromVtk(drawData, 'quaternion')
+        robotNums = vnp.getNumpyFromVtk(drawData, 'robot_num')
+        linkNames = drawData.GetPointData().GetAbstractArray('link_name')
 
-            pos = msg.position[i]
-            quat = msg.quaternion[i]
-            robotNum = msg.robot_num[i]
-            linkName = msg.link_name[i]
+        for i in xrange(drawData.GetNumberOfPoints()):
+
+            pos = positions[i]
+            quat = quaternions[i]
+            robotNum = int(robotNums[i])
+            linkName = linkNames.GetValue(i)
 
             try:
                 link = self.getLink(robotNum, linkName)
@@ -425,7 +430,7 @@ class DrakeVisualizer(object):
 
         self.view.render()
 
-    def onPlanarLidar(self, msg, channel):
+    def onPlanarLidar(self, scanData, channel):
 
         linkName = channel.replace('DRAKE_PLANAR_LIDAR_', '', 1)
         robotNum, linkName = linkName.split('_', 1)
@@ -452,41 +457,16 @@ class DrakeVisualizer(object):
                 self.addLinkGeometry(g, linkName, linkFolder)
                 g.polyDataItem.actor.SetUserTransform(link.transform)
 
-            points = vtk.vtkPoints()
-            verts = vtk.vtkCellArray()
-
-            t = msg.rad0
-            for r in msg.ranges:
-                if r >= 0:
-                    x = r * math.cos(t)
-                    y = r * math.sin(t)
-
-                    pointId = points.InsertNextPoint([x,y,0])
-                    verts.InsertNextCell(1)
-                    verts.InsertCellPoint(pointId)
+            polyData.SetPoints(scanData.GetPoints())
+            polyData.SetVerts(scanData.GetVerts())
 
-                t += msg.radstep
 
-            polyData.SetPoints(points)
-            polyData.SetVerts(verts)
-
-
-    def onPointCloud(self, msg, channel):
+    def onPointCloud(self, polyData, channel):
         pointcloudName = channel.replace('DRAKE_POINTCLOUD_', '', 1)
 
-        polyData = vnp.numpyToPolyData(np.asarray(msg.points), createVertexCells=True)
-
-        # If the user provided color channels, then use them to colorize
-        # the pointcloud.
-        channels = {msg.channel_names[i]: msg.channels[i] for i in range(msg.n_channels)}
-        if "r" in channels and "g" in channels and "b" in channels:
-            colorized = True
-            colorArray = np.empty((msg.n_points, 3), dtype=np.uint8)
-            for (colorIndex, color) in enumerate(["r", "g", "b"]):
-                colorArray[:, colorIndex] = 255 * np.asarray(channels[color])
-            vnp.addNumpyToVtk(polyData, colorArray, "rgb")
-        else:
-            colorized = False
+        # If the user provided color channels, then the subscriber combined
+        # them into the rgb array, use it to colorize the pointcloud.
+        colorized = polyData.GetPointData().GetArray('rgb') is not None
 
         folder = self.getPointCloudFolder()
 
@@ -81,7 +81,7 @@ class KinectSource(TimerCallback):
         self.visible = True
         
         self.p = vtk.vtkPolyData()
-        utime = KinectQueue.getPointCloudFromKinect(self.p)
+        utime = self.KinectQueue.getPointCloudFromKinect(self.p)
         self.polyDataObj = vis.PolyDataItem('kinect source', shallowCopy(self.p), view)
         self.polyDataObj.actor.SetPickable(1)
         self.polyDataObj.initialized = False
@@ -128,10 +128,21 @@ class KinectSource(TimerCallback):
             self.polyDataObj.initialized = True
 
 
-def init(view):
+def init(view, sensorName=None):
+    '''
+    Starts a kinect source.  If sensorName is given the channel, decimation
+    and calibration are read from the depth_cameras.<sensorName> block of
+    the config.  Needs director built with USE_KINECT.
+    '''
+    if not hasattr(PythonQt.dd, 'ddKinectLCM'):
+        raise Exception('ddKinectLCM is not available, director was built without USE_KINECT')
+
     global KinectQueue, _kinectItem, _kinectSource
     KinectQueue = PythonQt.dd.ddKinectLCM(lcmUtils.getGlobalLCMThread())
-    KinectQueue.init(lcmUtils.getGlobalLCMThread(), drcargs.args().config_file)
+    if sensorName:
+        KinectQueue.init(lcmUtils.getGlobalLCMThread(), drcargs.args().config_file, sensorName)
+    else:
+        KinectQueue.init(lcmUtils.getGlobalLCMThread(), drcargs.args().config_file)
     
     _kinectSource = KinectSource(view, KinectQueue)
     _kinectSource.start()
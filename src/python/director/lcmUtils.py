@@ -10,6 +10,7 @@ import tempfile
 import imp
 import sys
 import re
+from director import vtkAll as vtk
 
 class GlobalLCM(object):
 
@@ -95,7 +96,12 @@ def captureMessageCallback(channel, messageClass, callback):
     return subscriber
 
 
-def addSubscriber(channel, messageClass=None, callback=None, historicalLoader=None, callbackNeedsChannel=False):
+def addSubscriber(channel, messageClass=None, callback=None, historicalLoader=None, callbackNeedsChannel=False, batch=False):
+    '''
+    If batch is True, the subscriber keeps every message and the callback is
+    called once per main loop iteration with a list of the messages that were
+    received since the previous call, oldest first.
+    '''
 
     lcmThread = getGlobalLCMThread()
     subscriber = PythonQt.dd.ddLCMSubscriber(channel, lcmThread)
@@ -120,7 +126,22 @@ def addSubscriber(channel, messageClass=None, callback=None, historicalLoader=No
         else:
             print 'error decoding message on channel:', channel
 
-    if callback is not None:
+    def handleMessages(messageDataList, channel):
+        if messageClass is not None:
+            messages = [messageClass.decode(messageData.data()) for messageData in messageDataList]
+        else:
+            messages = messageDataList
+
+        if callbackNeedsChannel:
+            callback(messages, channel=channel)
+        else:
+            callback(messages)
+
+    if callback is not None and batch:
+        subscriber.setNotifyAllMessagesEnabled(True)
+        subscriber.setBatchDeliveryEnabled(True)
+        subscriber.connect('messagesReceived(const QVariantList&, const QString&)', handleMessages)
+    elif callback is not None:
         if messageClass is not None:
             subscriber.connect('messageReceived(const QByteArray&, const QString&)', handleMessage)
         else:
@@ -132,6 +153,30 @@ def addSubscriber(channel, messageClass=None, callback=None, historicalLoader=No
     return subscriber
 
 
+def addDecodedSubscriber(channel, subscriberClassName, callback, callbackNeedsChannel=False):
+    '''
+    Adds a subscriber that decodes messages in C++ on the lcm thread, for
+    example 'ddPointCloudSubscriber'.  The callback is called with a
+    vtkPolyData that shares the decoded arrays, use vtkNumpy.getNumpyFromVtk()
+    to access them as numpy arrays without a copy.
+    '''
+
+    lcmThread = getGlobalLCMThread()
+    subscriber = getattr(PythonQt.dd, subscriberClassName)(channel, lcmThread)
+
+    def handleMessage(messageData, channel):
+        polyData = vtk.vtkPolyData()
+        subscriber.getPolyData(channel, polyData)
+        if callbackNeedsChannel:
+            callback(polyData, channel=channel)
+        else:
+            callback(polyData)
+
+    subscriber.connect('messageReceived(const QByteArray&, const QString&)', handleMessage)
+    lcmThread.addSubscriber(subscriber)
+    return subscriber
+
+
 def removeSubscriber(subscriber):
     lcmThread = getGlobalLCMThread()
     lcmThread.removeSubscriber(subscriber)
@@ -455,6 +500,7 @@ class LCMLoggerManager(object):
         self.filePatternPrefix = 'lcmlog'
         self.baseDir = os.path.expanduser('~/logs/raw')
         self.existingLoggerProcesses = {}
+        self.recorder = None
 
     @staticmethod
     def getTimeTag():
@@ -476,6 +522,43 @@ class LCMLoggerManager(object):
         p = subprocess.Popen(command, stdout=devnull, stderr=devnull)
         return p.pid
 
+    def startNewRecorder(self, tag='', baseDir=None, channels=None, compression='none', maxFileSize=0):
+        '''
+        Records to a log file from inside this process, on the lcm socket
+        that the application already has open, instead of starting an
+        lcm-logger process.  Returns the log file name.
+        '''
+        filePattern = [self.filePatternPrefix, self.getTimeTag()]
+        if tag:
+            filePattern.append(tag)
+        filePattern = '__'.join(filePattern)
+
+        if baseDir is None:
+            baseDir = self.baseDir
+
+        if self.recorder is None:
+            self.recorder = PythonQt.dd.ddLCMRecorder()
+
+        self.recorder.stop()
+        self.recorder.setChannels(channels or [])
+        if not self.recorder.setCompression(compression):
+            raise ValueError('unsupported compression: %s, supported: %s' % (compression, self.recorder.supportedCompressions()))
+        self.recorder.setMaxFileSize(maxFileSize)
+
+        fileArg = os.path.join(baseDir, filePattern)
+        if not self.recorder.start(fileArg):
+            raise IOError('failed to start recording: ' + fileArg)
+        return fileArg
+
+    def stopRecorder(self):
+        if self.recorder is not None:
+            self.recorder.stop()
+
+    def getRecorderFilenames(self):
+        if self.recorder is not None and self.recorder.isRecording():
+            return list(self.recorder.filenames())
+        return []
+
     def updateExistingLoggerProcesses(self):
         output = subprocess.check_output(['ps', '-eo', 'pid,command'])
         self.existingLoggerProcesses = {}
@@ -1,3 +1,4 @@
+import PythonQt
 from PythonQt import QtCore, QtGui
 from director import lcmUtils
 from director.simpletimer import SimpleTimer
@@ -12,6 +13,10 @@ class LCMLoggerWidget(object):
         self.manager = lcmUtils.LCMLoggerManager()
         self.statusBar = statusBar
 
+        # record with the in-process recorder when it is built, otherwise
+        # start lcm-logger processes
+        self.useRecorder = hasattr(PythonQt.dd, 'ddLCMRecorder')
+
         self.lastActiveLogFile = None
         self.numProcesses = 0
         self.numLogFiles = 0
@@ -32,8 +37,9 @@ class LCMLoggerWidget(object):
         t = SimpleTimer()
         self.manager.updateExistingLoggerProcesses()
 
-        activeLogFiles = self.manager.getActiveLogFilenames()
-        self.numProcesses = len(self.manager.getActiveLoggerPids())
+        recorderFiles = self.manager.getRecorderFilenames()
+        activeLogFiles = self.manager.getActiveLogFilenames() + recorderFiles[-1:]
+        self.numProcesses = len(self.manager.getActiveLoggerPids()) + (1 if recorderFiles else 0)
         self.numLogFiles = len(activeLogFiles)
 
         if self.numLogFiles == 1:
@@ -51,13 +57,26 @@ class LCMLoggerWidget(object):
         self.button.setToolTip('%s log file: %s' % (statusDescription, logFileDescription))
 
 
+    def startLogging(self):
+        if self.useRecorder:
+            try:
+                self.manager.startNewRecorder(tag=self.userTag)
+                return
+            except IOError as e:
+                print 'falling back to lcm-logger:', e
+        self.manager.startNewLogger(tag=self.userTag)
+
+    def stopLogging(self):
+        self.manager.stopRecorder()
+        self.manager.killAllLoggingProcesses()
+
     def onClick(self):
         if self.numProcesses == 0:
-            self.manager.startNewLogger(tag=self.userTag)
+            self.startLogging()
             self.updateState()
-            self.showStatusMessage('start logging: ' + self.lastActiveLogFile)
+            self.showStatusMessage('start logging: ' + (self.lastActiveLogFile or '<unknown>'))
         else:
-            self.manager.killAllLoggingProcesses()
+            self.stopLogging()
             self.showStatusMessage('stopped logging')
             self.updateState()
 
@@ -97,13 +116,13 @@ class LCMLoggerWidget(object):
             self.showStatusMessage('copy to clipboard: ' + self.lastActiveLogFile)
 
         elif selectedAction.text == 'Stop logger':
-            self.manager.killAllLoggingProcesses()
+            self.stopLogging()
             self.showStatusMessage('stopped logger')
             self.updateState()
 
         elif selectedAction.text == 'Stop and delete log file':
             logFileToRemove = self.lastActiveLogFile
-            self.manager.killAllLoggingProcesses()
+            self.stopLogging()
             self.updateState()
             os.remove(logFileToRemove)
             self.showStatusMessage('deleted: ' + logFileToRemove)
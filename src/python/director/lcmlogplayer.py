@@ -3,12 +3,18 @@ from director.timercallback import TimerCallback
 
 import lcm
 import numpy as np
+import PythonQt
 from PythonQt import QtCore, QtGui
 
 
 class LcmLogPlayer(object):
 
     def __init__(self, lcmHandle=None):
+        '''
+        Events are published on lcmHandle, the global lcm by default.  The
+        native player publishes through the lcm instance of the C++
+        dispatcher, so it is only used when lcmHandle is the global lcm.
+        '''
         if not lcmHandle:
             lcmHandle = lcmUtils.getGlobalLCM()
         self.lcmHandle = lcmHandle
@@ -18,6 +24,9 @@ class LcmLogPlayer(object):
         self.timer = TimerCallback()
         self.timestamps = np.array([])
         self.timestampOffset = 0.0
+        self.nativePlayer = None
+        self.inProcessReplay = False
+        self.publishedChannels = []
 
     def findEventIndex(self, timestampRequest):
         requestIndex = self.timestamps.searchsorted(timestampRequest)
@@ -52,18 +61,65 @@ class LcmLogPlayer(object):
                     and self.timestamps[self.nextEventIndex] <= endTimestamp)
 
     def skipToTime(self, timeRequest, playLength=0.0):
+        if self.nativePlayer:
+            self.nativePlayer.skipToTime(timeRequest, playLength)
+            return
+
         self.resetPlayPosition(timeRequest)
         self.advanceTime(playLength)
 
+    def setInProcessReplayEnabled(self, enabled, publishedChannels=None):
+        '''
+        If enabled, the native player injects events directly into the
+        subscribers of this process instead of publishing them over lcm, and
+        live lcm traffic is ignored.  publishedChannels lists channels that
+        are still published, for clients that do not subscribe through the
+        dispatcher.
+        '''
+        if enabled and not self.usesGlobalLCM():
+            raise ValueError('in process replay requires the global lcm handle')
+
+        self.inProcessReplay = enabled
+        self.publishedChannels = publishedChannels or []
+        if self.nativePlayer:
+            self.nativePlayer.setInProcessReplayEnabled(enabled)
+            self.nativePlayer.setPublishedChannels(self.publishedChannels)
+
+    def usesGlobalLCM(self):
+        return self.lcmHandle is lcmUtils.getGlobalLCM()
+
+    def skipToNextMessage(self, channel, playLength=0.0):
+        '''
+        Seeks to the next message on the channel after the current play
+        position.  Returns the new time, or None if there is no next message.
+        Requires the native player.
+        '''
+        assert self.nativePlayer
+        t = self.nativePlayer.getNextEventTime(channel, self.nativePlayer.getCurrentTime())
+        if t < 0:
+            return None
+        self.skipToTime(t, playLength)
+        return t
+
     def getEndTime(self):
+        if self.nativePlayer:
+            return self.nativePlayer.getEndTime()
+
         assert len(self.timestamps)
         return self.timestamps[-1]*1e-6
 
     def stop(self):
+        if self.nativePlayer:
+            self.nativePlayer.stop()
         self.timer.stop()
 
     def playback(self, startTime, playLength):
 
+        if self.nativePlayer:
+            self.nativePlayer.setPlaybackFactor(self.playbackFactor)
+            self.nativePlayer.playback(startTime, startTime + playLength)
+            return
+
         self.resetPlayPosition(startTime)
 
         startTimestamp = self.timestamps[self.nextEventIndex]
@@ -82,6 +138,29 @@ class LcmLogPlayer(object):
         self.timer.start()
 
     def readLog(self, filename, eventTimeFunction=None, progressFunction=None):
+        '''
+        Indexes the log.  Unless an eventTimeFunction or a non-global
+        lcmHandle is given, the log is indexed and played back by
+        ddLCMLogPlayer in C++.
+        '''
+        # closing the previous player turns off its in-process replay before
+        # the new player turns it on
+        if self.nativePlayer:
+            self.nativePlayer.stop()
+            self.nativePlayer.closeLog()
+            self.nativePlayer = None
+
+        if (eventTimeFunction is None and self.usesGlobalLCM()
+                and hasattr(PythonQt.dd, 'ddLCMLogPlayer')):
+            nativePlayer = PythonQt.dd.ddLCMLogPlayer()
+            if not nativePlayer.openLog(filename):
+                raise Exception('Failed to read log file: %s' % filename)
+            nativePlayer.setInProcessReplayEnabled(self.inProcessReplay)
+            nativePlayer.setPublishedChannels(self.publishedChannels)
+            self.nativePlayer = nativePlayer
+            self.timestampOffset = self.nativePlayer.getTimestampOffset()
+            return
+
         log = lcm.EventLog(filename, 'r')
         self.log = log
 
@@ -159,7 +238,7 @@ class LcmLogPlayerGui(object):
         self.logPlayer.playback(0.0, self.logPlayer.getEndTime())
 
     def onStop(self):
-        self.logPlayer.timer.stop()
+        self.logPlayer.stop()
 
     def onSlider(self, value):
         t = self.logPlayer.getEndTime()*value/self.slider.maximum
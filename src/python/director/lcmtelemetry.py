@@ -0,0 +1,63 @@
+import PythonQt
+from director.timercallback import TimerCallback
+
+
+def getTelemetry():
+    '''
+    Returns a list of dicts, one per ddLCMSubscriber, with message and byte
+    rates, drop counts, queue depths and latency percentiles in microseconds.
+    '''
+    return PythonQt.dd.ddLCMTelemetry.instance().getStatistics()
+
+
+def resetTelemetry():
+    PythonQt.dd.ddLCMTelemetry.instance().resetStatistics()
+
+
+def formatValue(value):
+    if isinstance(value, float):
+        return '%.1f' % value
+    return str(value)
+
+
+def updateSpreadsheet(spreadsheetView):
+    '''
+    Fills the spreadsheet view with one row per subscriber.  The first row
+    holds the column names.
+    '''
+    names = list(PythonQt.dd.ddLCMTelemetry.instance().getStatisticsNames())
+    rows = sorted(getTelemetry(), key=lambda stats: stats['channel'])
+
+    spreadsheetView.clear()
+    spreadsheetView.appendRow(names)
+    for stats in rows:
+        spreadsheetView.appendRow([formatValue(stats[name]) for name in names])
+
+
+class TelemetrySpreadsheet(object):
+    '''
+    Refreshes a spreadsheet view with subscriber telemetry at a fixed rate.
+    '''
+
+    def __init__(self, spreadsheetView, updateRate=1.0):
+        self.view = spreadsheetView
+        self.timer = TimerCallback(targetFps=updateRate, callback=self.update)
+
+    def start(self):
+        self.timer.start()
+
+    def stop(self):
+        self.timer.stop()
+
+    def update(self):
+        updateSpreadsheet(self.view)
+
+
+def showTelemetry(viewManager, updateRate=1.0):
+    '''
+    Creates a spreadsheet view named LCM Telemetry and starts refreshing it.
+    '''
+    view = viewManager.findView('LCM Telemetry') or viewManager.createView('LCM Telemetry', 'Spreadsheet View')
+    telemetry = TelemetrySpreadsheet(view, updateRate)
+    telemetry.start()
+    return telemetry
@@ -36,6 +36,11 @@ class PointCloudItem(om.ObjectModelItem):
         self.addProperty('Framerate', model.targetFps,
                          attributes=om.PropertyAttributes(decimals=0, minimum=1.0, maximum=30.0, singleStep=1, hidden=False))
         self.addProperty('Visible', model.visible)
+        self.addProperty('Accumulate', model.accumulate)
+        self.addProperty('Voxel Size', model.accumulator.GetResolution(),
+                         attributes=om.PropertyAttributes(decimals=2, minimum=0.01, maximum=1.0, singleStep=0.01, hidden=False))
+        self.addProperty('Decay Time', model.accumulator.GetDecayTime(),
+                         attributes=om.PropertyAttributes(decimals=0, minimum=0.0, maximum=600.0, singleStep=1, hidden=False))
         
     def _onPropertyChanged(self, propertySet, propertyName):
         om.ObjectModelItem._onPropertyChanged(self, propertySet, propertyName)
@@ -55,6 +60,15 @@ class PointCloudItem(om.ObjectModelItem):
         elif propertyName == 'Color By':
             self._updateColorBy()
 
+        elif propertyName == 'Accumulate':
+            self.model.setAccumulate(self.getProperty(propertyName))
+
+        elif propertyName == 'Voxel Size':
+            self.model.accumulator.SetResolution(self.getProperty(propertyName))
+
+        elif propertyName == 'Decay Time':
+            self.model.accumulator.SetDecayTime(self.getProperty(propertyName))
+
         self.model.polyDataObj._renderAllViews()
 
 
@@ -78,9 +92,15 @@ class PointCloudSource(TimerCallback):
         self.PointCloudQueue = _PointCloudQueue
 
         self.visible = True
+        self.accumulate = False
+        self.lastUtime = None
+
+        # fuses the clouds into a voxel map of bounded size when accumulating
+        self.accumulator = vtk.vtkVoxelAccumulationSource()
+        self.accumulator.SetMaxNumberOfPoints(2000000)
         
         self.p = vtk.vtkPolyData()
-        utime = PointCloudQueue.getPointCloudFromPointCloud(self.p)
+        utime = self.PointCloudQueue.getPointCloudFromPointCloud(self.p)
         self.polyDataObj = vis.PolyDataItem('pointcloud source', shallowCopy(self.p), view)
         self.polyDataObj.actor.SetPickable(1)
         self.polyDataObj.initialized = False
@@ -110,6 +130,11 @@ class PointCloudSource(TimerCallback):
     def setVisible(self, visible):
         self.polyDataObj.setProperty('Visible', visible)
 
+    def setAccumulate(self, accumulate):
+        self.accumulate = accumulate
+        self.accumulator.RemoveAllPoints()
+        self.lastUtime = None
+
     def _updateSource(self):
         p = vtk.vtkPolyData()
         utime = self.PointCloudQueue.getPointCloudFromPointCloud(p)
@@ -119,17 +144,32 @@ class PointCloudSource(TimerCallback):
 
         sensorToLocalFused = vtk.vtkTransform()
         self.queue.getTransform('local', 'local', utime, sensorToLocalFused)
-        p = filterUtils.transformPolyData(p,sensorToLocalFused)
-        self.polyDataObj.setPolyData(p)
+
+        if self.accumulate:
+            if utime != self.lastUtime:
+                self.lastUtime = utime
+                self.accumulator.AddPoints(p, sensorToLocalFused, utime)
+                self.accumulator.Update()
+                self.polyDataObj.setPolyData(shallowCopy(self.accumulator.GetOutput()))
+        else:
+            p = filterUtils.transformPolyData(p,sensorToLocalFused)
+            self.polyDataObj.setPolyData(p)
 
         if not self.polyDataObj.initialized:
             self.polyDataObj.initialized = True
 
 
-def init(view):
+def init(view, sensorName=None):
+    '''
+    Starts a point cloud source.  If sensorName is given the channels are
+    read from the point_clouds.<sensorName> block of the config.
+    '''
     global PointCloudQueue, _pointcloudItem, _pointcloudSource
     PointCloudQueue = PythonQt.dd.ddPointCloudLCM(lcmUtils.getGlobalLCMThread())
-    PointCloudQueue.init(lcmUtils.getGlobalLCMThread(), drcargs.args().config_file)
+    if sensorName:
+        PointCloudQueue.init(lcmUtils.getGlobalLCMThread(), drcargs.args().config_file, sensorName)
+    else:
+        PointCloudQueue.init(lcmUtils.getGlobalLCMThread(), drcargs.args().config_file)
     
     _pointcloudSource = PointCloudSource(view, PointCloudQueue)
     _pointcloudSource.start()
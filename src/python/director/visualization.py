@@ -31,7 +31,7 @@ class PolyDataItem(om.ObjectModelItem):
 
         self.views = []
         self.polyData = polyData
-        self.mapper = vtk.vtkPolyDataMapper()
+        self.mapper = self._newMapper(polyData)
         self.mapper.SetInput(self.polyData)
         self.actor = vtk.vtkActor()
         self.actor.SetMapper(self.mapper)
@@ -48,6 +48,8 @@ class PolyDataItem(om.ObjectModelItem):
         self.addProperty('Point Size', self.actor.GetProperty().GetPointSize(),
                          attributes=om.PropertyAttributes(decimals=0, minimum=1, maximum=20, singleStep=1, hidden=False))
 
+        self.addProperty('Round Points', False, attributes=om.PropertyAttributes(hidden=True))
+
         self.addProperty('Surface Mode', 0,
                          attributes=om.PropertyAttributes(enumNames=['Surface', 'Wireframe', 'Surface with edges', 'Points'], hidden=True))
 
@@ -55,6 +57,7 @@ class PolyDataItem(om.ObjectModelItem):
         self.addProperty('Show Scalar Bar', False)
 
         self._updateSurfaceProperty()
+        self._updatePointCloudProperty()
         self._updateColorByProperty()
 
         if view is not None:
@@ -70,9 +73,11 @@ class PolyDataItem(om.ObjectModelItem):
     def setPolyData(self, polyData):
 
         self.polyData = polyData
+        self._updateMapper()
         self.mapper.SetInput(polyData)
 
         self._updateSurfaceProperty()
+        self._updatePointCloudProperty()
         self._updateColorByProperty()
         self._updateColorBy(retainColorMap=True)
 
@@ -91,6 +96,38 @@ class PolyDataItem(om.ObjectModelItem):
         self.colorBy(None)
 
 
+    @staticmethod
+    def _usePointCloudMapper(polyData):
+        '''
+        Points without cells are drawn by vtkPointCloudMapper, which needs no
+        vertex cells.
+        '''
+        return (hasattr(vtk, 'vtkPointCloudMapper') and polyData.GetNumberOfPoints()
+                and not polyData.GetNumberOfCells())
+
+    def _newMapper(self, polyData):
+        if self._usePointCloudMapper(polyData):
+            return vtk.vtkPointCloudMapper()
+        return vtk.vtkPolyDataMapper()
+
+    def _updateMapper(self):
+        usePointCloudMapper = bool(self._usePointCloudMapper(self.polyData))
+        if usePointCloudMapper == self.mapper.IsA('vtkPointCloudMapper'):
+            return
+
+        mapper = self._newMapper(self.polyData)
+        mapper.ShallowCopy(self.mapper)
+        self.mapper = mapper
+        self.actor.SetMapper(mapper)
+        if self.shadowActor:
+            self.shadowActor.SetMapper(mapper)
+
+    def _updatePointCloudProperty(self):
+        isPointCloudMapper = self.mapper.IsA('vtkPointCloudMapper')
+        self.properties.setPropertyAttribute('Round Points', 'hidden', not isPointCloudMapper)
+        if isPointCloudMapper:
+            self.mapper.SetRoundPoints(self.getProperty('Round Points'))
+
     def _isPointCloud(self):
         return self.polyData.GetNumberOfPoints() and (self.polyData.GetNumberOfCells() == self.polyData.GetNumberOfVerts())
 
@@ -168,6 +205,9 @@ class PolyDataItem(om.ObjectModelItem):
             color = self.getProperty(propertyName)
             self.actor.GetProperty().SetColor(color)
 
+        elif propertyName == 'Round Points':
+            self._updatePointCloudProperty()
+
         elif propertyName == 'Color By':
             self._updateColorBy()
 
@@ -33,6 +33,8 @@ def getNumpyFromVtk(dataObj, arrayName='Points'):
         vtkArray = dataObj.GetPoints().GetData()
     else:
         vtkArray = dataObj.GetPointData().GetArray(arrayName)
+        if not vtkArray:
+            vtkArray = dataObj.GetFieldData().GetArray(arrayName)
 
     if not vtkArray:
         raise KeyError('Array not found')
@@ -0,0 +1,82 @@
+from director import vtkAll as vtk
+from director import vtkNumpy as vnp
+import numpy as np
+import PythonQt
+
+'''
+This tests the depth image compressions of ddDepthCodec through
+ddBotImageQueue.compressDepthImage and decompressDepthImage.  Each
+supported compression, with and without the delta predictor, must return
+the original depth values.
+'''
+
+ImageQueue = PythonQt.dd.ddBotImageQueue
+
+compressionNames = {0:'zlib', 1:'lz4', 2:'zstd'}
+
+width = 640
+height = 480
+
+
+def makeDepthImage(depth):
+    image = vtk.vtkImageData()
+    image.SetDimensions(width, height, 1)
+    array = vnp.getVtkFromNumpy(depth)
+    array.SetName('depth')
+    image.GetPointData().SetScalars(array)
+    return image
+
+
+def makeDepth():
+    '''
+    A slanted plane in millimeters with sensor noise, a step edge, and a
+    band of invalid zero pixels, like a depth camera image.
+    '''
+    random = np.random.RandomState(0)
+    x, y = np.meshgrid(np.arange(width), np.arange(height))
+    depth = 1000 + 2*x + 3*y + random.randint(-4, 5, size=(height, width))
+    depth[:, width/2:] += 1500
+    depth[height/3:height/3 + 20, :] = 0
+    return depth.astype(np.uint16).flatten()
+
+
+def testRoundTrip(depth, compression, deltaPredictor):
+
+    data = str(ImageQueue.compressDepthImage(makeDepthImage(depth), compression, deltaPredictor))
+    assert len(data) > 0
+    assert len(data) < depth.nbytes
+
+    decoded = makeDepthImage(np.zeros_like(depth))
+    assert ImageQueue.decompressDepthImage(data, compression, deltaPredictor, decoded)
+    assert np.array_equal(vnp.getNumpyFromVtk(decoded, 'depth'), depth)
+
+    # truncated data must not decode silently
+    truncated = data[:len(data)/2]
+    assert not ImageQueue.decompressDepthImage(truncated, compression, deltaPredictor, decoded)
+
+    print '%s predictor=%s: %d -> %d bytes' % (compressionNames[compression], deltaPredictor, depth.nbytes, len(data))
+
+
+def testUnsupported(depth):
+
+    # only 16 bit images are compressed
+    image = makeDepthImage(depth.astype(np.float32))
+    assert len(str(ImageQueue.compressDepthImage(image, 0, False))) == 0
+
+    assert not ImageQueue.depthCompressionIsSupported(3)
+    assert len(str(ImageQueue.compressDepthImage(makeDepthImage(depth), 3, False))) == 0
+
+
+depth = makeDepth()
+
+# zlib is always available
+assert ImageQueue.depthCompressionIsSupported(0)
+
+for compression in sorted(compressionNames.keys()):
+    if not ImageQueue.depthCompressionIsSupported(compression):
+        print 'skipped %s, it is not supported by this build' % compressionNames[compression]
+        continue
+    for deltaPredictor in (False, True):
+        testRoundTrip(depth, compression, deltaPredictor)
+
+testUnsupported(depth)
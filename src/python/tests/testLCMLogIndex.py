@@ -0,0 +1,104 @@
+from director.consoleapp import ConsoleApp
+import PythonQt
+import os
+import struct
+
+'''
+This tests the sidecar index file that ddLCMEventLog writes next to a log.
+The index must be loaded when the log is reopened unchanged, and rebuilt
+when the size or modification time of the log changes or the index file is
+corrupt.
+'''
+
+outputDir = ConsoleApp.getTestingOutputDirectory()
+logFilename = os.path.join(outputDir, 'testLCMLogIndex.lcmlog')
+indexFilename = logFilename + '.ddindex'
+
+channels = ['DD_TEST_INDEX_A', 'DD_TEST_INDEX_B']
+startTimestamp = 1000000
+
+
+def packEvent(eventNumber, timestamp, channel, data):
+    return struct.pack('>IqqII', 0xEDA1DA01, eventNumber, timestamp, len(channel), len(data)) + channel + data
+
+
+def makeEvents(numberOfEvents, timeStep):
+    '''
+    Returns (timestamp, channel, data) tuples.  Channel A has the even events
+    and channel B the odd events.
+    '''
+    return [(startTimestamp + i*timeStep, channels[i % 2], chr(i % 256)*(100 + i)) for i in xrange(numberOfEvents)]
+
+
+def writeLog(events, mode='wb', firstEventNumber=0):
+    with open(logFilename, mode) as f:
+        for i, (timestamp, channel, data) in enumerate(events):
+            f.write(packEvent(firstEventNumber + i, timestamp, channel, data))
+
+
+def openLog(indexShouldLoad):
+    player = PythonQt.dd.ddLCMLogPlayer()
+    assert player.openLog(logFilename)
+    assert player.indexWasLoaded() == indexShouldLoad, (player.indexWasLoaded(), indexShouldLoad)
+    assert os.path.isfile(indexFilename)
+    return player
+
+
+def checkLog(player, events):
+    '''
+    Compares the index of the player to the events of the log.
+    '''
+    assert player.getNumberOfEvents() == len(events)
+    assert sorted(player.getChannelNames()) == sorted(set(channel for _, channel, _ in events))
+    assert player.getTimestampOffset() == events[0][0]
+
+    endTime = (events[-1][0] - events[0][0])*1e-6
+    assert abs(player.getEndTime() - endTime) < 1e-9
+
+    # the first event of channel B is the second event
+    secondEventTime = (events[1][0] - events[0][0])*1e-6
+    assert abs(player.getNextEventTime(channels[1], 0.0) - secondEventTime) < 1e-9
+    assert player.getNextEventTime(channels[0], endTime + 1.0) == -1
+
+
+def testIndex():
+
+    for filename in (logFilename, indexFilename):
+        if os.path.isfile(filename):
+            os.remove(filename)
+
+    events = makeEvents(1000, 1000)
+    writeLog(events)
+
+    # the first open indexes the log and writes the index file
+    checkLog(openLog(indexShouldLoad=False), events)
+
+    # reopening the unchanged log loads the index
+    checkLog(openLog(indexShouldLoad=True), events)
+
+    # appending an event changes the size of the log
+    appended = makeEvents(1001, 1000)[-1:]
+    writeLog(appended, mode='ab', firstEventNumber=len(events))
+    events += appended
+    checkLog(openLog(indexShouldLoad=False), events)
+    checkLog(openLog(indexShouldLoad=True), events)
+
+    # rewriting the log with the same size but other timestamps only changes
+    # its modification time
+    size = os.path.getsize(logFilename)
+    modifiedTime = os.path.getmtime(logFilename)
+    events = makeEvents(len(events), 2000)
+    writeLog(events)
+    assert os.path.getsize(logFilename) == size
+    os.utime(logFilename, (modifiedTime + 10, modifiedTime + 10))
+    checkLog(openLog(indexShouldLoad=False), events)
+    checkLog(openLog(indexShouldLoad=True), events)
+
+    # a truncated index file is rebuilt
+    with open(indexFilename, 'r+b') as f:
+        f.truncate(os.path.getsize(indexFilename)/2)
+    checkLog(openLog(indexShouldLoad=False), events)
+    checkLog(openLog(indexShouldLoad=True), events)
+
+
+testIndex()
@@ -0,0 +1,134 @@
+from director.consoleapp import ConsoleApp
+from director import lcmUtils
+import PythonQt
+import os
+import struct
+import time
+
+'''
+This tests the event index of ddLCMEventLog through ddLCMLogPlayer, and in
+process replay of a time range into a subscriber.  The log is larger than
+an indexing range, so it is indexed by several threads when the machine has
+several cores, and the payloads hold sync words that the parallel index
+must skip.  The log ends with a truncated event.
+'''
+
+outputDir = ConsoleApp.getTestingOutputDirectory()
+logFilename = os.path.join(outputDir, 'testLCMLogPlayer.lcmlog')
+
+channels = ['DD_TEST_PLAYER_A', 'DD_TEST_PLAYER_B', 'DD_TEST_PLAYER_C']
+numberOfEvents = 4000
+startTimestamp = 1000000
+timeStep = 2500
+
+syncWord = 0xEDA1DA01
+eventHeader = struct.Struct('>IqqII')
+
+
+def makeEvents():
+    '''
+    Returns (timestamp, channel, data) tuples of about 10 KB each, 40 MB in
+    total.  Each payload repeats a sync word and the event index.
+    '''
+    events = []
+    for i in xrange(numberOfEvents):
+        chunk = struct.pack('>II', syncWord, i)
+        events.append((startTimestamp + i*timeStep, channels[i % 3], chunk*(1250 + i % 7)))
+    return events
+
+
+def writeLog(events):
+    with open(logFilename, 'wb') as f:
+        for i, (timestamp, channel, data) in enumerate(events):
+            f.write(eventHeader.pack(syncWord, i, timestamp, len(channel), len(data)) + channel + data)
+
+        # an event cut off by a crash of the logger
+        f.write(eventHeader.pack(syncWord, len(events), startTimestamp + len(events)*timeStep, len(channels[0]), 1000))
+        f.write(channels[0] + 'x'*10)
+
+
+def eventTime(event):
+    return (event[0] - startTimestamp)*1e-6
+
+
+def testIndex(player, events):
+
+    assert player.getNumberOfEvents() == len(events)
+    assert sorted(player.getChannelNames()) == sorted(channels)
+    assert player.getTimestampOffset() == startTimestamp
+    assert abs(player.getEndTime() - eventTime(events[-1])) < 1e-9
+    assert sum(player.getTimeHistogram()) == len(events)
+
+    for channel in channels:
+        for t in [0.0, 0.0025, 1.0, 3.3337, 9.0]:
+            expected = [eventTime(e) for e in events if e[1] == channel and eventTime(e) >= t - 1e-9]
+            expected = expected[0] if expected else -1
+            assert abs(player.getNextEventTime(channel, t) - expected) < 1e-9, (channel, t)
+
+
+def testSeek(player, events):
+
+    # skipping publishes the event at the time, then the next event is the
+    # current one
+    for index in [0, 1, 1234, len(events) - 2]:
+        player.skipToTime(eventTime(events[index]))
+        assert abs(player.getCurrentTime() - eventTime(events[index + 1])) < 1e-9
+
+    # past the end the last event is published
+    player.skipToTime(player.getEndTime() + 1.0)
+    assert abs(player.getCurrentTime() - player.getEndTime()) < 1e-9
+
+
+def testReplay(player, events):
+
+    startTime = 2.0
+    endTime = 4.0
+    channel = channels[0]
+    expected = [e[2] for e in events if e[1] == channel and startTime - 1e-9 <= eventTime(e) <= endTime + 1e-9]
+
+    lcmThread = lcmUtils.getGlobalLCMThread()
+    subscriber = PythonQt.dd.ddLCMSubscriber(channel, lcmThread)
+    subscriber.setCallbackEnabled(False)
+    subscriber.setKeepRing(len(expected) + 1)
+    lcmThread.addSubscriber(subscriber)
+
+    player.setRealTimeEnabled(False)
+    player.playback(startTime, endTime)
+
+    received = []
+    while len(received) < len(expected):
+        message = str(subscriber.getNextMessage(5000))
+        assert message, len(received)
+        received.append(message)
+
+    while player.isPlaying():
+        time.sleep(0.01)
+
+    assert received == expected
+    assert not str(subscriber.getNextMessage(100))
+    assert subscriber.getDroppedMessageCount() == 0
+
+    lcmThread.removeSubscriber(subscriber)
+
+
+events = makeEvents()
+writeLog(events)
+if os.path.isfile(logFilename + '.ddindex'):
+    os.remove(logFilename + '.ddindex')
+
+player = PythonQt.dd.ddLCMLogPlayer()
+player.setInProcessReplayEnabled(True)
+
+assert player.openLog(logFilename)
+assert not player.indexWasLoaded()
+testIndex(player, events)
+
+# the index loaded from the sidecar file matches the scan
+assert player.openLog(logFilename)
+assert player.indexWasLoaded()
+testIndex(player, events)
+
+testSeek(player, events)
+testReplay(player, events)
+
+player.closeLog()
@@ -0,0 +1,165 @@
+from director.consoleapp import ConsoleApp
+import PythonQt
+import os
+import struct
+
+'''
+This tests ddLCMRecorder.  A log is replayed in process with ddLCMLogPlayer,
+which delivers its events to the recorder through the dispatcher without
+using the network.  The recorded log, decompressed if it was compressed,
+must hold the same events as the replayed log, and rollover must split it
+into files named like lcm-logger names split files.
+'''
+
+outputDir = ConsoleApp.getTestingOutputDirectory()
+sourceFilename = os.path.join(outputDir, 'testLCMRecorderSource.lcmlog')
+
+channels = ['DD_TEST_RECORDER_A', 'DD_TEST_RECORDER_B']
+numberOfEvents = 500
+
+syncWord = 0xEDA1DA01
+eventHeader = struct.Struct('>IqqII')
+
+
+def makeEvents():
+    '''
+    Returns (timestamp, channel, data) tuples.  The data repeats, so it
+    compresses.
+    '''
+    return [(1000000 + i*1000, channels[i % 2], ('%04d' % i)*(25 + i % 200)) for i in xrange(numberOfEvents)]
+
+
+def writeLog(filename, events):
+    with open(filename, 'wb') as f:
+        for i, (timestamp, channel, data) in enumerate(events):
+            f.write(eventHeader.pack(syncWord, i, timestamp, len(channel), len(data)) + channel + data)
+
+
+def readLog(filename):
+    '''
+    Returns the (timestamp, channel, data) tuples of an lcm log and checks
+    that the event numbers of the file start at zero.
+    '''
+    events = []
+    with open(filename, 'rb') as f:
+        contents = f.read()
+
+    offset = 0
+    while offset < len(contents):
+        sync, eventNumber, timestamp, channelLength, dataSize = eventHeader.unpack_from(contents, offset)
+        assert sync == syncWord
+        assert eventNumber == len(events)
+        offset += eventHeader.size
+        channel = contents[offset:offset + channelLength]
+        offset += channelLength
+        data = contents[offset:offset + dataSize]
+        offset += dataSize
+        events.append((timestamp, channel, data))
+
+    assert offset == len(contents)
+    return events
+
+
+def removeFiles(prefix):
+    for name in os.listdir(outputDir):
+        if name.startswith(prefix):
+            os.remove(os.path.join(outputDir, name))
+
+
+def record(player, filename, compression, maxFileSize):
+    '''
+    Records the replayed log and returns the names of the recorded files.
+    '''
+    recorder = PythonQt.dd.ddLCMRecorder()
+    recorder.setChannels(['DD_TEST_RECORDER_.*'])
+    assert recorder.setCompression(compression)
+    recorder.setMaxFileSize(maxFileSize)
+    recorder.setQueueSize(16*1024*1024)
+
+    assert recorder.start(filename)
+    assert recorder.isRecording()
+
+    # replays every event on this thread
+    player.skipToTime(0.0, player.getEndTime() + 1.0)
+
+    recorder.stop()
+    assert not recorder.isRecording()
+    assert recorder.getNumberOfEvents() == numberOfEvents
+    assert recorder.getDroppedEvents() == 0
+
+    filenames = [str(name) for name in recorder.filenames()]
+    assert sum(os.path.getsize(name) for name in filenames) == recorder.getBytesWritten()
+    return filenames
+
+
+def readRecordedLog(filename, compression):
+    if compression == 'none':
+        return readLog(filename)
+
+    decompressedFilename = filename + '.decompressed'
+    assert PythonQt.dd.ddLCMRecorder.decompressLog(filename, decompressedFilename)
+    return readLog(decompressedFilename)
+
+
+def testRoundTrip(player, events, compression):
+
+    filename = os.path.join(outputDir, 'testLCMRecorder_%s.lcmlog' % compression)
+    removeFiles(os.path.basename(filename))
+
+    filenames = record(player, filename, compression, maxFileSize=0)
+    assert filenames == [filename]
+
+    assert readRecordedLog(filename, compression) == events
+    if compression == 'none':
+        # the event numbers start at zero like the source log's, so the
+        # recorded log is a copy of it
+        assert open(filename, 'rb').read() == open(sourceFilename, 'rb').read()
+    else:
+        assert os.path.getsize(filename) < os.path.getsize(sourceFilename)
+        # an lcm log is not a compressed log
+        assert not PythonQt.dd.ddLCMRecorder.decompressLog(sourceFilename, filename + '.invalid')
+
+    print '%s: %d -> %d bytes' % (compression, os.path.getsize(sourceFilename), os.path.getsize(filename))
+
+
+def testRollover(player, events, compression):
+
+    filename = os.path.join(outputDir, 'testLCMRecorderRollover_%s.lcmlog' % compression)
+    removeFiles(os.path.basename(filename))
+
+    # the limit counts uncompressed log bytes in every mode
+    maxFileSize = os.path.getsize(sourceFilename)/3 + 1
+    filenames = record(player, filename, compression, maxFileSize)
+
+    assert len(filenames) >= 3
+    assert filenames == ['%s.%02d' % (filename, i) for i in xrange(len(filenames))]
+    assert not os.path.exists(filename)
+
+    recordedEvents = []
+    for name in filenames:
+        fileEvents = readRecordedLog(name, compression)
+        assert len(fileEvents)
+        if compression == 'none':
+            assert os.path.getsize(name) <= maxFileSize
+        recordedEvents += fileEvents
+
+    assert recordedEvents == events
+
+
+events = makeEvents()
+writeLog(sourceFilename, events)
+assert readLog(sourceFilename) == events
+
+player = PythonQt.dd.ddLCMLogPlayer()
+player.setInProcessReplayEnabled(True)
+assert player.openLog(sourceFilename)
+assert player.getNumberOfEvents() == numberOfEvents
+
+compressions = [str(compression) for compression in PythonQt.dd.ddLCMRecorder.supportedCompressions()]
+assert 'none' in compressions
+
+for compression in compressions:
+    testRoundTrip(player, events, compression)
+    testRollover(player, events, compression)
+
+player.closeLog()
@@ -0,0 +1,68 @@
+from director.consoleapp import ConsoleApp
+from director import lcmUtils
+from director.timercallback import TimerCallback
+import PythonQt
+
+app = ConsoleApp()
+
+channel = 'DD_TEST_SHM_TRANSPORT'
+overrunChannel = 'DD_TEST_SHM_TRANSPORT_OVERRUN'
+numberOfMessages = 10
+
+# every message has distinct content, so a torn message does not match any
+# of the published payloads
+def makePayload(index):
+    return ''.join(chr((i + index) % 256) for i in xrange(1024*1024))
+
+payloads = [makePayload(i) for i in xrange(numberOfMessages)]
+
+received = []
+overrunReceived = []
+
+lcmThread = lcmUtils.getGlobalLCMThread()
+
+def addSubscriber(channel, messages):
+    subscriber = PythonQt.dd.ddLCMSubscriber(channel, lcmThread)
+    subscriber.setKeepRing(numberOfMessages)
+    subscriber.connect('messageReceived(const QByteArray&, const QString&)', lambda data, channel: messages.append(str(data)))
+    lcmThread.addSubscriber(subscriber)
+    return subscriber
+
+subscriber = addSubscriber(channel, received)
+overrunSubscriber = addSubscriber(overrunChannel, overrunReceived)
+
+# one slot per message, so no slot is reused before it is read
+publisher = PythonQt.dd.ddLCMSharedMemoryPublisher()
+publisher.setNumberOfSlots(numberOfMessages)
+publisher.setFallbackMode('always')
+
+# two slots, so slots are reused while the subscriber may still be reading
+# them, an overrun message must come from its fallback copy
+overrunPublisher = PythonQt.dd.ddLCMSharedMemoryPublisher()
+overrunPublisher.setNumberOfSlots(2)
+overrunPublisher.setFallbackMode('always')
+
+def publish():
+    for payload in payloads:
+        assert publisher.publish(channel, payload)
+    for payload in payloads:
+        assert overrunPublisher.publish(overrunChannel, payload)
+
+publishTimer = TimerCallback(callback=publish)
+publishTimer.singleShot(0.5)
+app.startQuitTimer(3.0)
+app.start(enableAutomaticQuit=False)
+
+assert publisher.getNumberOfSharedMemoryMessages() == numberOfMessages
+assert overrunPublisher.getNumberOfSharedMemoryMessages() == numberOfMessages
+
+# every notification is either delivered or counted as an overrun
+assert lcmThread.getSharedMemoryMessages() + lcmThread.getSharedMemoryOverruns() == 2*numberOfMessages
+
+# each message is delivered once, the fallback copies are dropped
+assert received == payloads, len(received)
+
+# each message is delivered once and intact, from shared memory or from its
+# fallback copy
+assert len(overrunReceived) == numberOfMessages, len(overrunReceived)
+assert sorted(overrunReceived) == sorted(payloads)
@@ -0,0 +1,135 @@
+from director import vtkAll as vtk
+from director import vtkNumpy as vnp
+import numpy as np
+
+'''
+This tests the limits of vtkVoxelAccumulationSource: the per voxel cap,
+the total cap, decay of old points and clearing the map when the clouds
+seek back in time.
+'''
+
+
+def makeCloud(points):
+    '''
+    Returns a poly data of the points with an intensity array that holds the
+    x coordinate of each point, so a point's data can be checked after it
+    is moved in the map.
+    '''
+    points = np.asarray(points, dtype=np.float64)
+    polyData = vnp.numpyToPolyData(points)
+    vnp.addNumpyToVtk(polyData, points[:,0].copy(), 'intensity')
+    return polyData
+
+
+def voxelCenters(xs):
+    '''
+    Points at the centers of unit voxels along the x axis.
+    '''
+    return [[x + 0.5, 0.5, 0.5] for x in xs]
+
+
+def getPoints(source):
+    source.Update()
+    output = source.GetOutput()
+    assert output.GetNumberOfPoints() == source.GetNumberOfPoints()
+
+    points = vnp.getNumpyFromVtk(output, 'Points')
+    intensity = vnp.getNumpyFromVtk(output, 'intensity')
+    assert np.allclose(points[:,0], intensity)
+    return points
+
+
+def newSource():
+    source = vtk.vtkVoxelAccumulationSource()
+    source.SetResolution(1.0)
+    return source
+
+
+def testPerVoxelCap():
+
+    source = newSource()
+    source.SetMaxPointsPerVoxel(3)
+
+    # ten points in one voxel, the voxel keeps the newest three
+    xs = [0.05*(i + 1) for i in xrange(10)]
+    source.AddPoints(makeCloud([[x, 0.5, 0.5] for x in xs]), 1000000)
+
+    assert source.GetNumberOfVoxels() == 1
+    assert source.GetNumberOfPoints() == 3
+    assert np.allclose(sorted(getPoints(source)[:,0]), xs[-3:])
+
+    # a point in another voxel does not replace them
+    source.AddPoints(makeCloud(voxelCenters([5])), 1000000)
+    assert source.GetNumberOfVoxels() == 2
+    assert source.GetNumberOfPoints() == 4
+
+
+def testTotalCap():
+
+    source = newSource()
+    source.SetMaxNumberOfPoints(100)
+
+    # 250 points in distinct voxels, added in clouds of 50, the map keeps
+    # the newest 100
+    for i in xrange(5):
+        source.AddPoints(makeCloud(voxelCenters(range(50*i, 50*(i + 1)))), 1000000 + i*1000)
+
+    assert source.GetNumberOfPoints() == 100
+    assert source.GetNumberOfVoxels() == 100
+    assert np.allclose(sorted(getPoints(source)[:,0]), np.arange(150, 250) + 0.5)
+
+    # lowering the cap removes the oldest points at the next cloud
+    source.SetMaxNumberOfPoints(10)
+    source.AddPoints(makeCloud(voxelCenters([1000])), 1010000)
+    assert source.GetNumberOfPoints() == 10
+    assert np.allclose(sorted(getPoints(source)[:,0]), np.append(np.arange(241, 250), 1000) + 0.5)
+
+
+def testDecay():
+
+    source = newSource()
+    source.SetDecayTime(0.5)
+
+    source.AddPoints(makeCloud(voxelCenters([0, 1])), 1000000)
+    source.AddPoints(makeCloud(voxelCenters([2])), 1200000)
+    assert source.GetNumberOfPoints() == 3
+
+    # points older than half a second before the newest cloud are removed
+    source.AddPoints(makeCloud(voxelCenters([3])), 1700000)
+    assert source.GetNumberOfPoints() == 2
+    assert np.allclose(sorted(getPoints(source)[:,0]), [2.5, 3.5])
+
+    # a point that replaces an old point in its voxel is new
+    source.AddPoints(makeCloud(voxelCenters([2])), 2000000)
+    assert source.GetNumberOfPoints() == 2
+    source.AddPoints(makeCloud(voxelCenters([4])), 2400000)
+    assert np.allclose(sorted(getPoints(source)[:,0]), [2.5, 4.5])
+
+
+def testSeekBack():
+
+    source = newSource()
+
+    source.AddPoints(makeCloud(voxelCenters([0, 1])), 10000000)
+
+    # a cloud slightly out of order is added to the map
+    source.AddPoints(makeCloud(voxelCenters([2])), 9500000)
+    assert source.GetNumberOfPoints() == 3
+
+    # a cloud more than a second older than the newest clears the map
+    source.AddPoints(makeCloud(voxelCenters([5])), 8000000)
+    assert source.GetNumberOfPoints() == 1
+    assert source.GetNumberOfVoxels() == 1
+    assert np.allclose(getPoints(source)[:,0], [5.5])
+
+    # RemoveAllPoints clears the map and its arrays
+    source.RemoveAllPoints()
+    source.Update()
+    assert source.GetNumberOfPoints() == 0
+    assert source.GetOutput().GetNumberOfPoints() == 0
+
+
+testPerVoxelCap()
+testTotalCap()
+testDecay()
+testSeekBack()
@@ -36,6 +36,7 @@
 
 #include <Eigen/Dense>
 #include <lcm/lcm-cpp.hpp>
+#include <ddLCMDispatcher.h>
 
 #include <lcmtypes/maps/image_t.hpp>
 #include <lcmtypes/maps/cloud_t.hpp>
@@ -50,9 +51,9 @@
 #include <maps/OctreeView.hpp>
 #include <maps/ScanBundleView.hpp>
 
-#include <sys/select.h>
 #include <map>
 #include <deque>
+#include <atomic>
 #include <mutex>
 #include <thread>
 #include <functional>
@@ -240,37 +241,62 @@ public:
     this->HeightRange[0] = -80.0;
     this->HeightRange[1] =  80.0;
 
-    this->LCMHandle = std::shared_ptr<lcm::LCM>(new lcm::LCM);
-    if(!this->LCMHandle->good())
-    {
-      std::cerr <<"ERROR: lcm is not good()" <<std::endl;
-    }
+    // messages are received by the shared dispatcher and handled in order on
+    // one of its worker threads
+    this->Dispatcher = ddLCMDispatcher::instance();
+    this->LCMHandle = this->Dispatcher->lcmHandle();
+    this->Worker = this->Dispatcher->allocateWorker();
+
+    this->Subscriptions.push_back(this->Dispatcher->subscribe("MAP_DEPTH", &LCMListener::depthHandler, this, this->Worker));
+    this->Subscriptions.push_back(this->Dispatcher->subscribe("MAP_DEBUG", &LCMListener::depthHandler, this, this->Worker));
+    this->Subscriptions.push_back(this->Dispatcher->subscribe("MAP_CLOUD", &LCMListener::cloudHandler, this, this->Worker));
+    this->Subscriptions.push_back(this->Dispatcher->subscribe("MAP_OCTREE", &LCMListener::octreeHandler, this, this->Worker));
+    this->Subscriptions.push_back(this->Dispatcher->subscribe("MAP_SCANS", &LCMListener::scanBundleHandler, this, this->Worker));
+  }
 
-    this->LCMHandle->subscribe( "MAP_DEPTH", &LCMListener::depthHandler, this);
-    this->LCMHandle->subscribe( "MAP_DEBUG", &LCMListener::depthHandler, this);
-    this->LCMHandle->subscribe( "MAP_CLOUD", &LCMListener::cloudHandler, this);
-    this->LCMHandle->subscribe( "MAP_OCTREE", &LCMListener::octreeHandler, this);
-    this->LCMHandle->subscribe( "MAP_SCANS", &LCMListener::scanBundleHandler, this);
+  ~LCMListener()
+  {
+    this->Stop();
+    for (size_t i = 0; i < this->Subscriptions.size(); ++i)
+      {
+      this->Dispatcher->unsubscribe(this->Subscriptions[i]);
+      }
   }
 
 
   void cloudHandler(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const maps::cloud_t* msg)
   {
+    if (this->ShouldStop)
+      {
+      return;
+      }
     this->HandleNewData(msg);
   }
 
   void depthHandler(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const maps::image_t* msg)
   {
+    if (this->ShouldStop)
+      {
+      return;
+      }
     this->HandleNewData(msg);
   }
 
   void octreeHandler(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const maps::octree_t* msg)
   {
+    if (this->ShouldStop)
+      {
+      return;
+      }
     this->HandleNewData(msg);
   }
 
   void scanBundleHandler(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const maps::scans_t* msg)
   {
+    if (this->ShouldStop)
+      {
+      return;
+      }
     this->HandleNewData(msg);
   }
 
@@ -304,86 +330,23 @@ public:
     return newData;
   }
 
-  bool WaitForLCM(double timeout)
-  {
-    int lcmFd = this->LCMHandle->getFileno();
-
-    timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = timeout * 1e6;
-
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(lcmFd, &fds);
-
-    int status = select(lcmFd + 1, &fds, 0, 0, &tv);
-    if (status == -1 && errno != EINTR)
-    {
-      printf("select() returned error: %d\n", errno);
-    }
-    else if (status == -1 && errno == EINTR)
-    {
-      printf("select() interrupted\n");
-    }
-    return (status > 0 && FD_ISSET(lcmFd, &fds));
-  }
-
-  void ThreadLoopWithSelect()
-  {
-    while (!this->ShouldStop)
-    {
-      const double timeoutInSeconds = 0.3;
-      bool lcmReady = this->WaitForLCM(timeoutInSeconds);
-
-      if (this->ShouldStop)
-      {
-        break;
-      }
-
-      if (lcmReady)
-      {
-        if (this->LCMHandle->handle() != 0)
-        {
-          printf("lcm->handle() returned non-zero\n");
-          break;
-        }
-      }
-    }
-
-  }
-
-
-  void ThreadLoop()
-  {
-    while (!this->ShouldStop)
-    {
-      if (this->LCMHandle->handle() != 0)
-      {
-        printf("lcm->handle() returned non-zero\n");
-        break;
-      }
-    }
-  }
-
   void Start()
   {
-    if (this->Thread)
+    if (!this->ShouldStop)
       {
       return;
       }
 
     this->ShouldStop = false;
-    this->Thread = std::shared_ptr<std::thread>(
-      new std::thread(std::bind(&LCMListener::ThreadLoopWithSelect, this)));
+    this->Dispatcher->start();
   }
 
   void Stop()
   {
-    if (this->Thread)
+    if (!this->ShouldStop)
       {
       this->ShouldStop = true;
-      this->Thread->join();
-      this->Thread.reset();
+      this->Dispatcher->stop();
       }
   }
 
@@ -715,7 +678,7 @@ protected:
   }
 
   bool NewData;
-  bool ShouldStop;
+  std::atomic<bool> ShouldStop;
   int MaxNumberOfDatasets;
   vtkIdType CurrentMapId;
   vtkSmartPointer<vtkIntArray> ViewIds;
@@ -731,9 +694,11 @@ protected:
   std::map<int, std::deque<MapData> > Datasets;
   std::map<int, vtkIdType> CurrentMapIds;
 
-  std::shared_ptr<lcm::LCM> LCMHandle;
+  ddLCMDispatcher* Dispatcher;
+  lcm::LCM* LCMHandle;
+  int Worker;
+  std::vector<int> Subscriptions;
 
-  std::shared_ptr<std::thread> Thread;
 
 };
 
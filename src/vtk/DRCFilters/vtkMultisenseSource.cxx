@@ -29,14 +29,16 @@
 
 #include <Eigen/Dense>
 #include <lcm/lcm-cpp.hpp>
+#include <ddFrameTransformCache.h>
+#include <ddLCMDispatcher.h>
 
 #include <bot_frames/bot_frames.h>
 #include <bot_param/param_client.h>
 #include <lcmtypes/bot_core/planar_lidar_t.hpp>
 
-#include <sys/select.h>
 #include <queue>
 #include <deque>
+#include <atomic>
 #include <mutex>
 #include <thread>
 #include <functional>
@@ -150,6 +152,12 @@ public:
     this->MaxNumberOfScanLines = 10000;
     this->botparam_ = 0;
     this->botframes_ = 0;
+    this->FrameCache = 0;
+    this->ScanFrameId = -1;
+    this->LocalFrameId = -1;
+    this->BodyFrameId = -1;
+    this->PreSpindleFrameId = -1;
+    this->PostSpindleFrameId = -1;
 
     this->SweepPolyDataRevolution = -1;
     this->SweepPolyData = 0;
@@ -161,18 +169,31 @@ public:
     this->HeightRange[0] = -80.0;
     this->HeightRange[1] = 80.0;
 
-    this->LCMHandle = std::shared_ptr<lcm::LCM>(new lcm::LCM);
-    if(!this->LCMHandle->good())
-    {
-      std::cerr <<"ERROR: lcm is not good()" <<std::endl;
-    }
+    // messages are received by the shared dispatcher and handled in order on
+    // one of its worker threads
+    this->Dispatcher = ddLCMDispatcher::instance();
+    this->LCMHandle = this->Dispatcher->lcmHandle();
+    this->Worker = this->Dispatcher->allocateWorker();
+
+    this->Subscriptions.push_back(this->Dispatcher->subscribe("MULTISENSE_SCAN", &LCMListener::lidarHandler, this, this->Worker));
+  }
 
-    this->LCMHandle->subscribe("MULTISENSE_SCAN", &LCMListener::lidarHandler, this);
+  ~LCMListener()
+  {
+    this->Stop();
+    for (size_t i = 0; i < this->Subscriptions.size(); ++i)
+      {
+      this->Dispatcher->unsubscribe(this->Subscriptions[i]);
+      }
   }
 
 
   void lidarHandler(const lcm::ReceiveBuffer* rbuf, const std::string& channel, const bot_core::planar_lidar_t* msg)
   {
+    if (this->ShouldStop)
+      {
+      return;
+      }
     this->HandleNewData(msg);
   }
 
@@ -186,93 +207,51 @@ public:
       }
     else
       {
+      // share the param server client and frames with the other lcm sources
       while (!botparam_)
         {
-        botparam_ = bot_param_new_from_server(this->LCMHandle->getUnderlyingLCM(), 0);
+        botparam_ = bot_param_get_global(this->LCMHandle->getUnderlyingLCM(), 0);
         }
       }
 
     botframes_ = bot_frames_get_global(this->LCMHandle->getUnderlyingLCM(), botparam_);
+    this->FrameCache = ddFrameTransformCache::instance(botframes_, botparam_);
+    this->UpdateFrameIds();
   }
 
-  bool CheckForNewData()
-  {
-    std::lock_guard<std::mutex> lock(this->Mutex);
-    bool newData = this->NewData;
-    this->NewData = false;
-    return newData;
-  }
-
-  bool WaitForLCM(double timeout)
-  {
-    int lcmFd = this->LCMHandle->getFileno();
-
-    timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = timeout * 1e6;
-
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(lcmFd, &fds);
-
-    int status = select(lcmFd + 1, &fds, 0, 0, &tv);
-    if (status == -1 && errno != EINTR)
-    {
-      printf("select() returned error: %d\n", errno);
-    }
-    else if (status == -1 && errno == EINTR)
-    {
-      printf("select() interrupted\n");
-    }
-    return (status > 0 && FD_ISSET(lcmFd, &fds));
-  }
-
-  void ThreadLoopWithSelect()
+  // Looks up the frames used for each scan line once, so scan lines are
+  // transformed without looking up frames by name.
+  void UpdateFrameIds()
   {
-    while (!this->ShouldStop)
-    {
-      const double timeoutInSeconds = 0.3;
-      bool lcmReady = this->WaitForLCM(timeoutInSeconds);
-
-      if (this->ShouldStop)
+    if (!this->FrameCache)
       {
-        break;
-      }
-
-      if (lcmReady)
-      {
-        if (this->LCMHandle->handle() != 0)
-        {
-          printf("lcm->handle() returned non-zero\n");
-          break;
-        }
+      return;
       }
-    }
 
+    this->ScanFrameId = this->FrameCache->frameId("MULTISENSE_SCAN");
+    this->LocalFrameId = this->FrameCache->frameId("local");
+    this->BodyFrameId = this->FrameCache->frameId("body");
+    this->PreSpindleFrameId = this->FrameCache->frameId("PRE_SPINDLE");
+    this->PostSpindleFrameId = this->FrameCache->frameId("POST_SPINDLE");
   }
 
-  void ThreadLoop()
+  bool CheckForNewData()
   {
-    while (!this->ShouldStop)
-    {
-      if (this->LCMHandle->handle() != 0)
-      {
-        printf("lcm->handle() returned non-zero\n");
-        break;
-      }
-    }
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    bool newData = this->NewData;
+    this->NewData = false;
+    return newData;
   }
 
   void Start()
   {
-    if (this->Thread)
+    if (!this->ShouldStop)
       {
       return;
       }
 
     this->ShouldStop = false;
-    this->Thread = std::shared_ptr<std::thread>(
-      new std::thread(std::bind(&LCMListener::ThreadLoopWithSelect, this)));
+    this->Dispatcher->start();
 
     this->SweepThread = std::shared_ptr<std::thread>(
       new std::thread(std::bind(&LCMListener::SweepThreadLoop, this)));
@@ -280,12 +259,11 @@ public:
 
   void Stop()
   {
-    if (this->Thread)
+    if (!this->ShouldStop)
       {
       this->ShouldStop = true;
+      this->Dispatcher->stop();
       this->Condition.notify_one();
-      this->Thread->join();
-      this->Thread.reset();
       this->SweepThread->join();
       this->SweepThread.reset();
       }
@@ -360,22 +338,24 @@ public:
   int get_trans_with_utime(std::string from_frame, std::string to_frame,
                                  vtkIdType utime, Eigen::Isometry3d & mat)
   {
-    if (!botframes_)
+    if (!this->FrameCache)
     {
       std::cout << "vtkMultisenseSource::LCMListener: botframe is not initialized" << std::endl;
       mat = mat.matrix().Identity();
       return 0;
     }
 
-    int status;
-    double matx[16];
-    status = bot_frames_get_trans_mat_4x4_with_utime( botframes_, from_frame.c_str(),  to_frame.c_str(), utime, matx);
-    for (int i = 0; i < 4; ++i) {
-      for (int j = 0; j < 4; ++j) {
-        mat(i,j) = matx[i*4+j];
-      }
+    return get_trans_with_utime(this->FrameCache->frameId(from_frame), this->FrameCache->frameId(to_frame), utime, mat);
+  }
+
+  int get_trans_with_utime(int fromFrame, int toFrame, vtkIdType utime, Eigen::Isometry3d & mat)
+  {
+    if (!this->FrameCache || !this->FrameCache->getTransform(fromFrame, toFrame, utime, mat))
+    {
+      mat = mat.matrix().Identity();
+      return 0;
     }
-    return status;
+    return 1;
   }
 
   void SetDistanceRange(double distanceRange[2])
@@ -447,17 +427,22 @@ protected:
   {
     this->CurrentScanTime = msg->utime;
 
-    Eigen::Isometry3d scanToLocalStart;
-    Eigen::Isometry3d scanToLocalEnd;
-    Eigen::Isometry3d bodyToLocalStart;
-
-    get_trans_with_utime("MULTISENSE_SCAN", "local", msg->utime, scanToLocalStart);
-    get_trans_with_utime("MULTISENSE_SCAN", "local", msg->utime +  1e6*3/(40*4), scanToLocalEnd);
+    // the scan frame at the start and end of the scan line in one query
+    const int64_t scanTimes[] = {msg->utime, msg->utime + static_cast<int64_t>(1e6*3/(40*4))};
+    ddFrameTransformCache::TransformVector scanToLocal;
+    if (!this->FrameCache
+        || !this->FrameCache->getTransforms(this->ScanFrameId, this->LocalFrameId, scanTimes, 2, scanToLocal))
+    {
+      scanToLocal.assign(2, Eigen::Isometry3d::Identity());
+    }
+    Eigen::Isometry3d scanToLocalStart = scanToLocal[0];
+    Eigen::Isometry3d scanToLocalEnd = scanToLocal[1];
 
-    get_trans_with_utime("body", "local", msg->utime, bodyToLocalStart);
+    Eigen::Isometry3d bodyToLocalStart;
+    get_trans_with_utime(this->BodyFrameId, this->LocalFrameId, msg->utime, bodyToLocalStart);
 
     Eigen::Isometry3d spindleRotation;
-    get_trans_with_utime("PRE_SPINDLE", "POST_SPINDLE", msg->utime, spindleRotation);
+    get_trans_with_utime(this->PreSpindleFrameId, this->PostSpindleFrameId, msg->utime, spindleRotation);
 
     Eigen::Matrix3d rot = spindleRotation.rotation();
     Eigen::Vector3d eulerAngles = rot.eulerAngles(0, 1, 2);
@@ -501,7 +486,7 @@ protected:
   }
 
   bool NewData;
-  bool ShouldStop;
+  std::atomic<bool> ShouldStop;
   int MaxNumberOfScanLines;
   int CurrentRevolution;
   int CurrentScanLine;
@@ -523,15 +508,23 @@ protected:
 
   std::deque<ScanLineData> ScanLines;
 
-  std::shared_ptr<lcm::LCM> LCMHandle;
+  ddLCMDispatcher* Dispatcher;
+  lcm::LCM* LCMHandle;
+  int Worker;
+  std::vector<int> Subscriptions;
 
-  std::shared_ptr<std::thread> Thread;
   std::shared_ptr<std::thread> SweepThread;
 
   vtkIdType CurrentScanTime;
 
   BotParam* botparam_;
   BotFrames* botframes_;
+  ddFrameTransformCache* FrameCache;
+  std::atomic<int> ScanFrameId;
+  std::atomic<int> LocalFrameId;
+  std::atomic<int> BodyFrameId;
+  std::atomic<int> PreSpindleFrameId;
+  std::atomic<int> PostSpindleFrameId;
 
 };
 
@@ -0,0 +1,370 @@
+/*=========================================================================
+
+Program:   Visualization Toolkit
+
+Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+All rights reserved.
+See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+This software is distributed WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "vtkPointCloudMapper.h"
+
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkCommand.h>
+#include <vtkProperty.h>
+#include <vtkRenderer.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkOpenGLRenderWindow.h>
+#include <vtkOpenGLExtensionManager.h>
+#include <vtkTimerLog.h>
+#include <vtkVersion.h>
+
+#include <vtkOpenGL.h>
+#include <vtkgl.h>
+
+#include <vector>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkPointCloudMapper);
+
+
+class vtkPointCloudMapper::vtkInternal {
+public:
+  vtkInternal()
+    {
+      this->Context = 0;
+      this->UseBuffers = false;
+      this->UsePointSprites = false;
+      this->VertexBuffer = 0;
+      this->ColorBuffer = 0;
+      this->SpriteTexture = 0;
+      this->PointsMTime = 0;
+      this->ColorsMTime = 0;
+      this->NumberOfPoints = 0;
+      this->VertexType = GL_FLOAT;
+      this->NumberOfColorComponents = 0;
+      this->RGBAColors = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    }
+
+  // Loads the buffer object functions of the context if it has them.
+  void LoadExtensions(vtkOpenGLRenderWindow* renWin)
+    {
+    vtkOpenGLExtensionManager* extensions = renWin->GetExtensionManager();
+
+    this->UseBuffers = extensions->ExtensionSupported("GL_VERSION_1_5")
+      && extensions->LoadSupportedExtension("GL_VERSION_1_5");
+
+    this->UsePointSprites = extensions->ExtensionSupported("GL_VERSION_2_0")
+      || extensions->ExtensionSupported("GL_ARB_point_sprite");
+    }
+
+  void ReleaseBuffers()
+    {
+    if (this->VertexBuffer)
+      {
+      vtkgl::DeleteBuffers(1, &this->VertexBuffer);
+      vtkgl::DeleteBuffers(1, &this->ColorBuffer);
+      }
+    if (this->SpriteTexture)
+      {
+      glDeleteTextures(1, &this->SpriteTexture);
+      }
+    this->VertexBuffer = 0;
+    this->ColorBuffer = 0;
+    this->SpriteTexture = 0;
+    this->PointsMTime = 0;
+    this->ColorsMTime = 0;
+    }
+
+  // An alpha texture of a disc, alpha tested at 0.5 it makes point sprites
+  // round.
+  void BuildSpriteTexture()
+    {
+    const int size = 32;
+    std::vector<unsigned char> alpha(size*size);
+    for (int j = 0; j < size; ++j)
+      {
+      for (int i = 0; i < size; ++i)
+        {
+        const double x = (i + 0.5)/size*2.0 - 1.0;
+        const double y = (j + 0.5)/size*2.0 - 1.0;
+        alpha[j*size + i] = (x*x + y*y <= 1.0) ? 255 : 0;
+        }
+      }
+
+    glGenTextures(1, &this->SpriteTexture);
+    glBindTexture(GL_TEXTURE_2D, this->SpriteTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, size, size, 0, GL_ALPHA, GL_UNSIGNED_BYTE, &alpha[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+  vtkWindow* Context;
+  bool UseBuffers;
+  bool UsePointSprites;
+
+  GLuint VertexBuffer;
+  GLuint ColorBuffer;
+  GLuint SpriteTexture;
+
+  // the modified times of the arrays in the buffers, the modified time is
+  // unique to an array so it also tells when the array is replaced
+  unsigned long PointsMTime;
+  unsigned long ColorsMTime;
+
+  vtkIdType NumberOfPoints;
+  GLenum VertexType;
+  int NumberOfColorComponents;
+
+  // colors with 1 or 2 components expanded to RGBA
+  vtkSmartPointer<vtkUnsignedCharArray> RGBAColors;
+};
+
+//----------------------------------------------------------------------------
+vtkPointCloudMapper::vtkPointCloudMapper()
+{
+  this->PointSize = 0.0;
+  this->RoundPoints = false;
+  this->NumberOfUploads = 0;
+  this->Internal = new vtkInternal;
+}
+
+//----------------------------------------------------------------------------
+vtkPointCloudMapper::~vtkPointCloudMapper()
+{
+  if (this->Internal->Context)
+    {
+    this->ReleaseGraphicsResources(this->Internal->Context);
+    }
+  delete this->Internal;
+}
+
+//----------------------------------------------------------------------------
+void vtkPointCloudMapper::ReleaseGraphicsResources(vtkWindow *win)
+{
+  if (win && win == this->Internal->Context && win->GetMapped())
+    {
+    win->MakeCurrent();
+    this->Internal->ReleaseBuffers();
+    }
+  this->Internal->VertexBuffer = 0;
+  this->Internal->ColorBuffer = 0;
+  this->Internal->SpriteTexture = 0;
+  this->Internal->PointsMTime = 0;
+  this->Internal->ColorsMTime = 0;
+  this->Internal->Context = 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkPointCloudMapper::RenderPiece(vtkRenderer* ren, vtkActor* act)
+{
+  vtkPolyData* input = this->GetInput();
+  if (!input)
+    {
+    vtkErrorMacro(<< "No input!");
+    return;
+    }
+
+  this->InvokeEvent(vtkCommand::StartEvent, NULL);
+  if (!this->Static)
+    {
+#if VTK_MAJOR_VERSION == 5
+    input->Update();
+#else
+    this->GetInputAlgorithm()->Update();
+#endif
+    }
+  this->InvokeEvent(vtkCommand::EndEvent, NULL);
+
+  vtkPoints* points = input->GetPoints();
+  const vtkIdType numberOfPoints = points ? points->GetNumberOfPoints() : 0;
+  if (!numberOfPoints)
+    {
+    return;
+    }
+
+  vtkDataArray* pointData = points->GetData();
+  if (pointData->GetDataType() != VTK_FLOAT && pointData->GetDataType() != VTK_DOUBLE)
+    {
+    vtkErrorMacro(<< "Points must be float or double.");
+    return;
+    }
+
+  vtkOpenGLRenderWindow* renWin = vtkOpenGLRenderWindow::SafeDownCast(ren->GetRenderWindow());
+  if (!renWin)
+    {
+    return;
+    }
+
+  const double startTime = vtkTimerLog::GetUniversalTime();
+
+  renWin->MakeCurrent();
+  if (this->Internal->Context != renWin)
+    {
+    this->ReleaseGraphicsResources(this->Internal->Context);
+    this->Internal->LoadExtensions(renWin);
+    this->Internal->Context = renWin;
+    }
+
+  vtkProperty* property = act->GetProperty();
+  vtkUnsignedCharArray* colors = this->MapScalars(property->GetOpacity());
+  if (colors && (colors->GetNumberOfTuples() != numberOfPoints || this->ScalarMode == VTK_SCALAR_MODE_USE_CELL_DATA
+      || this->ScalarMode == VTK_SCALAR_MODE_USE_CELL_FIELD_DATA))
+    {
+    // only point colors apply to points
+    colors = 0;
+    }
+
+  if (colors && colors->GetNumberOfComponents() < 3)
+    {
+    // glColorPointer takes 3 or 4 components, expand luminance to RGBA
+    vtkUnsignedCharArray* rgba = this->Internal->RGBAColors;
+    if (rgba->GetMTime() < colors->GetMTime() || rgba->GetNumberOfTuples() != numberOfPoints)
+      {
+      const int components = colors->GetNumberOfComponents();
+      rgba->SetNumberOfComponents(4);
+      rgba->SetNumberOfTuples(numberOfPoints);
+      const unsigned char* in = colors->GetPointer(0);
+      unsigned char* out = rgba->GetPointer(0);
+      for (vtkIdType i = 0; i < numberOfPoints; ++i, in += components, out += 4)
+        {
+        out[0] = out[1] = out[2] = in[0];
+        out[3] = components == 2 ? in[1] : 255;
+        }
+      rgba->Modified();
+      }
+    colors = rgba;
+    }
+
+  vtkInternal* internal = this->Internal;
+  internal->VertexType = pointData->GetDataType() == VTK_FLOAT ? GL_FLOAT : GL_DOUBLE;
+  internal->NumberOfColorComponents = colors ? colors->GetNumberOfComponents() : 0;
+
+  // upload the arrays that were modified since the last upload
+  if (internal->UseBuffers)
+    {
+    if (!internal->VertexBuffer)
+      {
+      vtkgl::GenBuffers(1, &internal->VertexBuffer);
+      vtkgl::GenBuffers(1, &internal->ColorBuffer);
+      }
+
+    if (internal->PointsMTime != pointData->GetMTime() || internal->NumberOfPoints != numberOfPoints)
+      {
+      vtkgl::BindBuffer(vtkgl::ARRAY_BUFFER, internal->VertexBuffer);
+      vtkgl::BufferData(vtkgl::ARRAY_BUFFER, numberOfPoints*3*pointData->GetDataTypeSize(),
+        pointData->GetVoidPointer(0), vtkgl::STATIC_DRAW);
+      internal->PointsMTime = pointData->GetMTime();
+      internal->NumberOfPoints = numberOfPoints;
+      ++this->NumberOfUploads;
+      }
+
+    if (colors && internal->ColorsMTime != colors->GetMTime())
+      {
+      vtkgl::BindBuffer(vtkgl::ARRAY_BUFFER, internal->ColorBuffer);
+      vtkgl::BufferData(vtkgl::ARRAY_BUFFER, numberOfPoints*colors->GetNumberOfComponents(),
+        colors->GetVoidPointer(0), vtkgl::STATIC_DRAW);
+      internal->ColorsMTime = colors->GetMTime();
+      }
+
+    vtkgl::BindBuffer(vtkgl::ARRAY_BUFFER, 0);
+    }
+
+  if (this->RoundPoints && internal->UsePointSprites && !internal->SpriteTexture)
+    {
+    internal->BuildSpriteTexture();
+    }
+
+  glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT | GL_CURRENT_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT);
+  glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+  // points have no normals
+  glDisable(GL_LIGHTING);
+  glPointSize(this->PointSize > 0.0 ? this->PointSize : property->GetPointSize());
+
+  if (!colors)
+    {
+    double* color = property->GetColor();
+    glColor4d(color[0], color[1], color[2], property->GetOpacity());
+    }
+
+  if (this->RoundPoints)
+    {
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GREATER, 0.5f);
+    if (internal->UsePointSprites)
+      {
+      glEnable(GL_TEXTURE_2D);
+      glBindTexture(GL_TEXTURE_2D, internal->SpriteTexture);
+      glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+      glEnable(vtkgl::POINT_SPRITE);
+      glTexEnvi(vtkgl::POINT_SPRITE, vtkgl::COORD_REPLACE, GL_TRUE);
+      }
+    else
+      {
+      // antialiased points have the coverage of a disc in their alpha
+      glEnable(GL_POINT_SMOOTH);
+      }
+    }
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  if (internal->UseBuffers)
+    {
+    vtkgl::BindBuffer(vtkgl::ARRAY_BUFFER, internal->VertexBuffer);
+    glVertexPointer(3, internal->VertexType, 0, 0);
+    }
+  else
+    {
+    glVertexPointer(3, internal->VertexType, 0, pointData->GetVoidPointer(0));
+    }
+
+  if (colors)
+    {
+    glEnableClientState(GL_COLOR_ARRAY);
+    if (internal->UseBuffers)
+      {
+      vtkgl::BindBuffer(vtkgl::ARRAY_BUFFER, internal->ColorBuffer);
+      glColorPointer(internal->NumberOfColorComponents, GL_UNSIGNED_BYTE, 0, 0);
+      }
+    else
+      {
+      glColorPointer(internal->NumberOfColorComponents, GL_UNSIGNED_BYTE, 0, colors->GetVoidPointer(0));
+      }
+    }
+
+  glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(numberOfPoints));
+
+  if (internal->UseBuffers)
+    {
+    vtkgl::BindBuffer(vtkgl::ARRAY_BUFFER, 0);
+    }
+
+  glPopClientAttrib();
+  glPopAttrib();
+
+  this->TimeToDraw = vtkTimerLog::GetUniversalTime() - startTime;
+  if (this->TimeToDraw == 0.0)
+    {
+    this->TimeToDraw = 0.0001;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkPointCloudMapper::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "PointSize: " << this->PointSize << "\n";
+  os << indent << "RoundPoints: " << this->RoundPoints << "\n";
+}
@@ -0,0 +1,87 @@
+/*=========================================================================
+
+Program:   Visualization Toolkit
+
+Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+All rights reserved.
+See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+This software is distributed WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkPointCloudMapper - Renders the points of a poly data as GL_POINTS
+// .SECTION Description
+// vtkPointCloudMapper draws every point of its input, it ignores the cells,
+// so a point cloud needs no vertex cells.  The points and the mapped scalar
+// colors are uploaded to vertex buffer objects, and uploaded again only when
+// the point or color arrays are modified; a point cloud that does not change
+// is drawn from the GPU.  Without vertex buffer objects the points are drawn
+// from client side vertex arrays.
+//
+// Scalar coloring works like vtkPolyDataMapper's for point scalars.  The
+// point size is the actor property's point size unless PointSize is set.
+// With RoundPoints on, points are drawn as round sprites rather than squares.
+
+// .SECTION See Also
+// vtkPolyDataMapper
+
+
+#ifndef __vtkPointCloudMapper_h
+#define __vtkPointCloudMapper_h
+
+#include "vtkPolyDataMapper.h"
+
+#include <vtkDRCFiltersModule.h>
+
+class VTKDRCFILTERS_EXPORT vtkPointCloudMapper : public vtkPolyDataMapper
+{
+public:
+  // Description:
+  // Instantiate the class.
+  static vtkPointCloudMapper *New();
+
+  // Description:
+  // Standard methods for the class.
+  vtkTypeMacro(vtkPointCloudMapper,vtkPolyDataMapper);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Description:
+  // The point size in pixels, 0 to use the actor property's point size.
+  vtkSetClampMacro(PointSize, float, 0.0, 64.0);
+  vtkGetMacro(PointSize, float);
+
+  // Description:
+  // Draw points as round sprites.  Off by default.
+  vtkSetMacro(RoundPoints, bool);
+  vtkGetMacro(RoundPoints, bool);
+  vtkBooleanMacro(RoundPoints, bool);
+
+  // Description:
+  // Methods supporting, and required by, the rendering process.
+  virtual void RenderPiece(vtkRenderer* ren, vtkActor* act);
+  virtual void ReleaseGraphicsResources(vtkWindow*);
+
+  // Description:
+  // The number of times the points were uploaded, for testing.
+  vtkGetMacro(NumberOfUploads, int);
+
+protected:
+  vtkPointCloudMapper();
+  ~vtkPointCloudMapper();
+
+  float PointSize;
+  bool RoundPoints;
+  int NumberOfUploads;
+
+private:
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
+  vtkPointCloudMapper(const vtkPointCloudMapper&);  //Not implemented
+  void operator=(const vtkPointCloudMapper&);  //Not implemented
+};
+
+#endif
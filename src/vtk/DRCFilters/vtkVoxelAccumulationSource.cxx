@@ -0,0 +1,491 @@
+/*=========================================================================
+
+Program:   Visualization Toolkit
+
+Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+All rights reserved.
+See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+This software is distributed WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "vtkVoxelAccumulationSource.h"
+
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkPolyData.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkFloatArray.h>
+#include <vtkTransform.h>
+#include <vtkMatrix4x4.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkVoxelAccumulationSource);
+
+namespace {
+
+const int NoSlot = -1;
+
+// a cloud this much older than the newest points clears the map
+const vtkIdType SeekBackTime = 1000000;
+
+//----------------------------------------------------------------------------
+// Packs the voxel indices, 21 bits each, into a key.
+inline unsigned long long VoxelKey(const double point[3], double inverseResolution)
+{
+  const unsigned long long mask = (1ull << 21) - 1;
+  const long long i = static_cast<long long>(std::floor(point[0]*inverseResolution));
+  const long long j = static_cast<long long>(std::floor(point[1]*inverseResolution));
+  const long long k = static_cast<long long>(std::floor(point[2]*inverseResolution));
+  return ((static_cast<unsigned long long>(i) & mask) << 42)
+    | ((static_cast<unsigned long long>(j) & mask) << 21)
+    | (static_cast<unsigned long long>(k) & mask);
+}
+
+}
+
+//----------------------------------------------------------------------------
+// The points of the map are kept in slots, slot i is tuple i of the arrays.
+// Each slot is on two doubly linked lists: the points of its voxel, oldest
+// first, and all points, oldest first.  Removing a slot moves the last slot
+// into its place and relinks the moved slot's neighbours, so the arrays stay
+// packed and every operation is O(1).
+class vtkVoxelAccumulationSource::vtkInternal {
+public:
+
+  struct Slot
+  {
+    unsigned long long Key;
+    vtkIdType Utime;
+    int VoxelPrev;
+    int VoxelNext;
+    int AgePrev;
+    int AgeNext;
+  };
+
+  struct Voxel
+  {
+    int Head;
+    int Tail;
+    int Count;
+  };
+
+  typedef std::unordered_map<unsigned long long, Voxel> VoxelMap;
+
+  vtkInternal()
+    {
+      this->Oldest = NoSlot;
+      this->Newest = NoSlot;
+      this->NewestUtime = 0;
+      this->ArraysInitialized = false;
+
+      this->PointArray = vtkSmartPointer<vtkFloatArray>::New();
+      this->PointArray->SetNumberOfComponents(3);
+      vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+      points->SetData(this->PointArray);
+      this->PolyData = vtkSmartPointer<vtkPolyData>::New();
+      this->PolyData->SetPoints(points);
+    }
+
+  std::vector<Slot> Slots;
+  VoxelMap Voxels;
+  int Oldest;
+  int Newest;
+  vtkIdType NewestUtime;
+
+  vtkSmartPointer<vtkPolyData> PolyData;
+  vtkSmartPointer<vtkFloatArray> PointArray;
+  // the point data arrays of PolyData
+  std::vector<vtkDataArray*> Arrays;
+  bool ArraysInitialized;
+
+  // the input array for each of Arrays, or null, for the cloud being added
+  std::vector<vtkDataArray*> InputArrays;
+  std::vector<double> ZeroTuple;
+
+  //--------------------------------------------------------------------------
+  void UnlinkVoxel(int i, Voxel& voxel)
+    {
+    Slot& slot = this->Slots[i];
+    if (slot.VoxelPrev != NoSlot) this->Slots[slot.VoxelPrev].VoxelNext = slot.VoxelNext;
+    else voxel.Head = slot.VoxelNext;
+    if (slot.VoxelNext != NoSlot) this->Slots[slot.VoxelNext].VoxelPrev = slot.VoxelPrev;
+    else voxel.Tail = slot.VoxelPrev;
+    --voxel.Count;
+    }
+
+  //--------------------------------------------------------------------------
+  void LinkVoxel(int i, Voxel& voxel)
+    {
+    Slot& slot = this->Slots[i];
+    slot.VoxelPrev = voxel.Tail;
+    slot.VoxelNext = NoSlot;
+    if (voxel.Tail != NoSlot) this->Slots[voxel.Tail].VoxelNext = i;
+    else voxel.Head = i;
+    voxel.Tail = i;
+    ++voxel.Count;
+    }
+
+  //--------------------------------------------------------------------------
+  void UnlinkAge(int i)
+    {
+    Slot& slot = this->Slots[i];
+    if (slot.AgePrev != NoSlot) this->Slots[slot.AgePrev].AgeNext = slot.AgeNext;
+    else this->Oldest = slot.AgeNext;
+    if (slot.AgeNext != NoSlot) this->Slots[slot.AgeNext].AgePrev = slot.AgePrev;
+    else this->Newest = slot.AgePrev;
+    }
+
+  //--------------------------------------------------------------------------
+  void LinkAge(int i)
+    {
+    Slot& slot = this->Slots[i];
+    slot.AgePrev = this->Newest;
+    slot.AgeNext = NoSlot;
+    if (this->Newest != NoSlot) this->Slots[this->Newest].AgeNext = i;
+    else this->Oldest = i;
+    this->Newest = i;
+    }
+
+  //--------------------------------------------------------------------------
+  // Moves slot from to the unlinked slot to.
+  void Relocate(int from, int to)
+    {
+    this->Slots[to] = this->Slots[from];
+    const Slot& slot = this->Slots[to];
+
+    Voxel& voxel = this->Voxels.find(slot.Key)->second;
+    if (slot.VoxelPrev != NoSlot) this->Slots[slot.VoxelPrev].VoxelNext = to;
+    else voxel.Head = to;
+    if (slot.VoxelNext != NoSlot) this->Slots[slot.VoxelNext].VoxelPrev = to;
+    else voxel.Tail = to;
+
+    if (slot.AgePrev != NoSlot) this->Slots[slot.AgePrev].AgeNext = to;
+    else this->Oldest = to;
+    if (slot.AgeNext != NoSlot) this->Slots[slot.AgeNext].AgePrev = to;
+    else this->Newest = to;
+
+    float* points = this->PointArray->GetPointer(0);
+    std::memcpy(points + to*3, points + from*3, 3*sizeof(float));
+    for (size_t a = 0; a < this->Arrays.size(); ++a)
+      {
+      this->Arrays[a]->SetTuple(to, from, this->Arrays[a]);
+      }
+    }
+
+  //--------------------------------------------------------------------------
+  void RemoveSlot(int i)
+    {
+    VoxelMap::iterator itr = this->Voxels.find(this->Slots[i].Key);
+    this->UnlinkVoxel(i, itr->second);
+    if (!itr->second.Count)
+      {
+      this->Voxels.erase(itr);
+      }
+    this->UnlinkAge(i);
+
+    const int last = static_cast<int>(this->Slots.size()) - 1;
+    if (i != last)
+      {
+      this->Relocate(last, i);
+      }
+    this->Slots.pop_back();
+    }
+
+  //--------------------------------------------------------------------------
+  // Grows the arrays to hold at least size points, keeping their values.
+  void Reserve(vtkIdType size, vtkIdType maxSize)
+    {
+    if (this->PointArray->GetSize() >= size*3)
+      {
+      return;
+      }
+
+    const vtkIdType capacity = std::min(std::max(size, 2*(this->PointArray->GetSize()/3)), maxSize);
+    this->PointArray->Resize(capacity);
+    for (size_t a = 0; a < this->Arrays.size(); ++a)
+      {
+      this->Arrays[a]->Resize(capacity);
+      }
+    }
+
+  //--------------------------------------------------------------------------
+  // Sets the number of tuples of the arrays to the number of slots.
+  void UpdateArrays()
+    {
+    const vtkIdType numberOfPoints = static_cast<vtkIdType>(this->Slots.size());
+    this->PointArray->SetNumberOfTuples(numberOfPoints);
+    this->PointArray->Modified();
+    for (size_t a = 0; a < this->Arrays.size(); ++a)
+      {
+      this->Arrays[a]->SetNumberOfTuples(numberOfPoints);
+      this->Arrays[a]->Modified();
+      }
+    this->PolyData->GetPoints()->Modified();
+    this->PolyData->Modified();
+    }
+
+  //--------------------------------------------------------------------------
+  // Keeps the point data arrays of the first cloud and finds the arrays of
+  // the cloud being added by name.
+  void MatchArrays(vtkPointData* pointData)
+    {
+    if (!this->ArraysInitialized)
+      {
+      for (int i = 0; i < pointData->GetNumberOfArrays(); ++i)
+        {
+        vtkDataArray* input = pointData->GetArray(i);
+        if (!input || !input->GetName())
+          {
+          continue;
+          }
+        vtkDataArray* array = vtkDataArray::CreateDataArray(input->GetDataType());
+        array->SetName(input->GetName());
+        array->SetNumberOfComponents(input->GetNumberOfComponents());
+        array->Resize(this->PointArray->GetSize()/3);
+        array->SetNumberOfTuples(static_cast<vtkIdType>(this->Slots.size()));
+        this->PolyData->GetPointData()->AddArray(array);
+        this->Arrays.push_back(array);
+        array->Delete();
+        }
+      this->ArraysInitialized = true;
+      }
+
+    int maxComponents = 0;
+    this->InputArrays.resize(this->Arrays.size());
+    for (size_t a = 0; a < this->Arrays.size(); ++a)
+      {
+      vtkDataArray* input = pointData->GetArray(this->Arrays[a]->GetName());
+      const int components = this->Arrays[a]->GetNumberOfComponents();
+      this->InputArrays[a] = (input && input->GetNumberOfComponents() == components) ? input : 0;
+      maxComponents = std::max(maxComponents, components);
+      }
+    this->ZeroTuple.assign(maxComponents, 0.0);
+    }
+
+  //--------------------------------------------------------------------------
+  void Clear()
+    {
+    this->Slots.clear();
+    this->Voxels.clear();
+    this->Oldest = NoSlot;
+    this->Newest = NoSlot;
+    this->NewestUtime = 0;
+    }
+};
+
+//----------------------------------------------------------------------------
+vtkVoxelAccumulationSource::vtkVoxelAccumulationSource()
+{
+  this->Resolution = 0.05;
+  this->MaxPointsPerVoxel = 1;
+  this->MaxNumberOfPoints = 1000000;
+  this->DecayTime = 0.0;
+  this->Internal = new vtkInternal;
+  this->SetNumberOfInputPorts(0);
+}
+
+//----------------------------------------------------------------------------
+vtkVoxelAccumulationSource::~vtkVoxelAccumulationSource()
+{
+  delete this->Internal;
+}
+
+//----------------------------------------------------------------------------
+void vtkVoxelAccumulationSource::SetResolution(double resolution)
+{
+  if (resolution <= 0.0 || resolution == this->Resolution)
+    {
+    return;
+    }
+
+  this->Resolution = resolution;
+  this->Internal->Clear();
+  this->Internal->UpdateArrays();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkVoxelAccumulationSource::RemoveAllPoints()
+{
+  vtkInternal* internal = this->Internal;
+  internal->Clear();
+  internal->PolyData->GetPointData()->Initialize();
+  internal->Arrays.clear();
+  internal->ArraysInitialized = false;
+  internal->UpdateArrays();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkVoxelAccumulationSource::GetNumberOfPoints()
+{
+  return static_cast<vtkIdType>(this->Internal->Slots.size());
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkVoxelAccumulationSource::GetNumberOfVoxels()
+{
+  return static_cast<vtkIdType>(this->Internal->Voxels.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkVoxelAccumulationSource::AddPoints(vtkPolyData* polyData, vtkIdType utime)
+{
+  this->AddPoints(polyData, 0, utime);
+}
+
+//----------------------------------------------------------------------------
+void vtkVoxelAccumulationSource::AddPoints(vtkPolyData* polyData, vtkTransform* transform, vtkIdType utime)
+{
+  if (!polyData)
+    {
+    return;
+    }
+
+  vtkInternal* internal = this->Internal;
+  typedef vtkInternal::Slot Slot;
+  typedef vtkInternal::Voxel Voxel;
+
+  if (!internal->Slots.empty() && utime < internal->NewestUtime - SeekBackTime)
+    {
+    internal->Clear();
+    }
+  internal->NewestUtime = std::max(internal->NewestUtime, utime);
+
+  // the limits may have been lowered
+  while (static_cast<int>(internal->Slots.size()) > this->MaxNumberOfPoints)
+    {
+    internal->RemoveSlot(internal->Oldest);
+    }
+
+  const vtkIdType numberOfPoints = polyData->GetNumberOfPoints();
+  internal->MatchArrays(polyData->GetPointData());
+  internal->Reserve(std::min(static_cast<vtkIdType>(internal->Slots.size()) + numberOfPoints,
+    static_cast<vtkIdType>(this->MaxNumberOfPoints)), this->MaxNumberOfPoints);
+
+  double matrix[16];
+  if (transform)
+    {
+    vtkMatrix4x4::DeepCopy(matrix, transform->GetMatrix());
+    }
+
+  const double inverseResolution = 1.0/this->Resolution;
+  double point[3];
+  double transformed[3];
+
+  for (vtkIdType j = 0; j < numberOfPoints; ++j)
+    {
+    polyData->GetPoint(j, point);
+    if (transform)
+      {
+      for (int r = 0; r < 3; ++r)
+        {
+        transformed[r] = matrix[r*4]*point[0] + matrix[r*4+1]*point[1] + matrix[r*4+2]*point[2] + matrix[r*4+3];
+        }
+      std::copy(transformed, transformed + 3, point);
+      }
+
+    if (!std::isfinite(point[0]) || !std::isfinite(point[1]) || !std::isfinite(point[2]))
+      {
+      continue;
+      }
+
+    const unsigned long long key = VoxelKey(point, inverseResolution);
+
+    int slot;
+    vtkInternal::VoxelMap::iterator itr = internal->Voxels.find(key);
+    if (itr != internal->Voxels.end() && itr->second.Count >= this->MaxPointsPerVoxel)
+      {
+      // replace the oldest point of the full voxel
+      slot = itr->second.Head;
+      internal->UnlinkVoxel(slot, itr->second);
+      internal->UnlinkAge(slot);
+      }
+    else
+      {
+      if (static_cast<int>(internal->Slots.size()) >= this->MaxNumberOfPoints)
+        {
+        internal->RemoveSlot(internal->Oldest);
+        // the removed point may have been the last one in the voxel
+        itr = internal->Voxels.find(key);
+        }
+      if (itr == internal->Voxels.end())
+        {
+        const Voxel voxel = {NoSlot, NoSlot, 0};
+        itr = internal->Voxels.insert(std::make_pair(key, voxel)).first;
+        }
+      slot = static_cast<int>(internal->Slots.size());
+      internal->Slots.push_back(Slot());
+      }
+
+    Slot& s = internal->Slots[slot];
+    s.Key = key;
+    s.Utime = utime;
+    internal->LinkVoxel(slot, itr->second);
+    internal->LinkAge(slot);
+
+    float* p = internal->PointArray->GetPointer(0) + slot*3;
+    p[0] = point[0];
+    p[1] = point[1];
+    p[2] = point[2];
+    for (size_t a = 0; a < internal->Arrays.size(); ++a)
+      {
+      if (internal->InputArrays[a])
+        {
+        internal->Arrays[a]->SetTuple(slot, j, internal->InputArrays[a]);
+        }
+      else
+        {
+        internal->Arrays[a]->SetTuple(slot, &internal->ZeroTuple[0]);
+        }
+      }
+    }
+
+  if (this->DecayTime > 0.0)
+    {
+    const vtkIdType oldestUtime = internal->NewestUtime - static_cast<vtkIdType>(this->DecayTime*1e6);
+    while (internal->Oldest != NoSlot && internal->Slots[internal->Oldest].Utime < oldestUtime)
+      {
+      internal->RemoveSlot(internal->Oldest);
+      }
+    }
+
+  internal->UpdateArrays();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkVoxelAccumulationSource::RequestData(
+  vtkInformation *vtkNotUsed(request),
+  vtkInformationVector **vtkNotUsed(inputVector),
+  vtkInformationVector *outputVector)
+{
+  vtkInformation *outInfo = outputVector->GetInformationObject(0);
+  vtkPolyData *output = vtkPolyData::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
+
+  // the output shares the arrays of the map
+  output->ShallowCopy(this->Internal->PolyData);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkVoxelAccumulationSource::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "Resolution: " << this->Resolution << "\n";
+  os << indent << "MaxPointsPerVoxel: " << this->MaxPointsPerVoxel << "\n";
+  os << indent << "MaxNumberOfPoints: " << this->MaxNumberOfPoints << "\n";
+  os << indent << "DecayTime: " << this->DecayTime << "\n";
+}
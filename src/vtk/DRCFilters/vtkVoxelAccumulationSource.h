@@ -0,0 +1,114 @@
+/*=========================================================================
+
+Program:   Visualization Toolkit
+
+Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+All rights reserved.
+See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+This software is distributed WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkVoxelAccumulationSource - Accumulates point clouds in a voxel map
+// .SECTION Description
+// vtkVoxelAccumulationSource fuses the point clouds passed to AddPoints()
+// into one point cloud of bounded size.  Points are binned in a sparse voxel
+// grid, hashed by voxel index, of the given Resolution.  A voxel keeps at
+// most MaxPointsPerVoxel points, a new point in a full voxel replaces the
+// voxel's oldest point.  At most MaxNumberOfPoints points are kept in total,
+// beyond that the oldest points are removed, and with a DecayTime points
+// older than DecayTime seconds before the newest points are removed.
+//
+// The points and the point data arrays of the first added cloud are kept in
+// packed arrays that the output shares; removing a point moves the last
+// point into its place.  Adding n points costs O(n) regardless of the size
+// of the map, and updating the output does not copy the arrays.  The output
+// has no vertex cells, draw it with vtkPointCloudMapper.
+//
+// A cloud older than the newest by more than a second, as when log playback
+// seeks back, clears the map.
+
+// .SECTION See Also
+// vtkPointCloudMapper
+
+
+#ifndef __vtkVoxelAccumulationSource_h
+#define __vtkVoxelAccumulationSource_h
+
+#include "vtkPolyDataAlgorithm.h"
+
+#include <vtkDRCFiltersModule.h>
+
+class vtkTransform;
+
+class VTKDRCFILTERS_EXPORT vtkVoxelAccumulationSource : public vtkPolyDataAlgorithm
+{
+public:
+  // Description:
+  // Instantiate the class.
+  static vtkVoxelAccumulationSource *New();
+
+  // Description:
+  // Standard methods for the class.
+  vtkTypeMacro(vtkVoxelAccumulationSource,vtkPolyDataAlgorithm);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Description:
+  // The voxel edge length.  Changing it clears the map.  Default 0.05.
+  void SetResolution(double resolution);
+  vtkGetMacro(Resolution, double);
+
+  // Description:
+  // The number of points kept in a voxel.  Default 1.
+  vtkSetClampMacro(MaxPointsPerVoxel, int, 1, VTK_INT_MAX);
+  vtkGetMacro(MaxPointsPerVoxel, int);
+
+  // Description:
+  // The number of points kept in the map.  Default 1000000.
+  vtkSetClampMacro(MaxNumberOfPoints, int, 1, VTK_INT_MAX);
+  vtkGetMacro(MaxNumberOfPoints, int);
+
+  // Description:
+  // Points older than this many seconds before the newest points are
+  // removed, 0 keeps points until they are replaced.  Default 0.
+  vtkSetClampMacro(DecayTime, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(DecayTime, double);
+
+  // Description:
+  // Adds the points of the poly data, received at utime, to the map.  The
+  // transform, if given, maps the points into the frame of the map.
+  void AddPoints(vtkPolyData* polyData, vtkIdType utime);
+  void AddPoints(vtkPolyData* polyData, vtkTransform* transform, vtkIdType utime);
+
+  // Description:
+  // Removes all points, and the point data arrays, from the map.
+  void RemoveAllPoints();
+
+  // Description:
+  // The number of points and voxels in the map.
+  vtkIdType GetNumberOfPoints();
+  vtkIdType GetNumberOfVoxels();
+
+protected:
+  vtkVoxelAccumulationSource();
+  ~vtkVoxelAccumulationSource();
+
+  virtual int RequestData(vtkInformation *, vtkInformationVector **, vtkInformationVector *);
+
+  double Resolution;
+  int MaxPointsPerVoxel;
+  int MaxNumberOfPoints;
+  double DecayTime;
+
+private:
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
+  vtkVoxelAccumulationSource(const vtkVoxelAccumulationSource&);  //Not implemented
+  void operator=(const vtkVoxelAccumulationSource&);  //Not implemented
+};
+
+#endif